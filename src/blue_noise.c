@@ -0,0 +1,233 @@
+/*
+ * Generate a blue noise texture using the void-and-cluster algorithm.
+ * Copyright © 2013  Wessel Dankers <wsl@fruit.je>
+ *
+ * This file is part of libplacebo.
+ *
+ * libplacebo is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libplacebo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libplacebo. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * The original code is taken from mpv, under the same license.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "blue_noise.h"
+
+typedef uint_fast32_t index_t;
+
+#define XY(k, x, y) ((index_t)(((x) | ((y) << (k)->sizeb))))
+
+struct slice {
+    index_t start, end;
+    uint64_t min;       // smallest total of all unset entries in this slice
+    index_t num_min;    // number of entries equal to `min`, see `randomat`
+};
+
+struct blue_noise_work {
+    unsigned int sizeb, size, size2;
+    unsigned int gauss_radius;
+    unsigned int gauss_middle;
+    uint64_t *gauss;
+    uint64_t *gaussmat;
+    bool *calcmat;
+    index_t *randomat;
+    index_t last; // most recently set entry, or `size2` if none
+    struct slice *slices;
+    int num_slices;
+    uint64_t rng;
+};
+
+static void makegauss(struct blue_noise_work *k)
+{
+    k->gauss_radius = k->size / 2 - 1;
+    k->gauss_middle = XY(k, k->gauss_radius, k->gauss_radius);
+
+    unsigned int gauss_size = k->gauss_radius * 2 + 1;
+    unsigned int gauss_size2 = gauss_size * gauss_size;
+
+    double sigma = 0.0;
+    if (k->gauss_radius)
+        sigma = -log(1.5 / (double) UINT64_MAX * gauss_size2) / k->gauss_radius;
+
+    for (index_t gy = 0; gy <= k->gauss_radius; gy++) {
+        for (index_t gx = 0; gx <= gy; gx++) {
+            int cx = (int)gx - k->gauss_radius;
+            int cy = (int)gy - k->gauss_radius;
+            int sq = cx * cx + cy * cy;
+            double e = exp(-sqrt(sq) * sigma);
+            uint64_t v = e / gauss_size2 * (double) UINT64_MAX;
+            k->gauss[XY(k, gx, gy)] =
+                k->gauss[XY(k, gy, gx)] =
+                k->gauss[XY(k, gx, gauss_size - 1 - gy)] =
+                k->gauss[XY(k, gy, gauss_size - 1 - gx)] =
+                k->gauss[XY(k, gauss_size - 1 - gx, gy)] =
+                k->gauss[XY(k, gauss_size - 1 - gy, gx)] =
+                k->gauss[XY(k, gauss_size - 1 - gx, gauss_size - 1 - gy)] =
+                k->gauss[XY(k, gauss_size - 1 - gy, gauss_size - 1 - gx)] = v;
+        }
+    }
+
+#ifndef NDEBUG
+    uint64_t total = 0;
+    for (index_t c = 0; c < k->size2; c++) {
+        uint64_t oldtotal = total;
+        total += k->gauss[c];
+        assert(total >= oldtotal);
+    }
+#endif
+}
+
+// Adds the gaussian centered around the most recently set entry (if any),
+// and finds all candidates for the next one, within a single slice
+void blue_noise_slice(struct blue_noise_work *k, int idx)
+{
+    struct slice *s = &k->slices[idx];
+    const index_t mask = k->size2 - 1;
+    const index_t offset = k->gauss_middle + k->size2 - k->last;
+    const bool add = k->last < k->size2;
+    uint64_t min = UINT64_MAX;
+    index_t num = 0;
+
+    for (index_t c = s->start; c < s->end; c++) {
+        uint64_t total = k->gaussmat[c];
+        if (add)
+            k->gaussmat[c] = total += k->gauss[(offset + c) & mask];
+        if (k->calcmat[c])
+            continue;
+        if (total <= min) {
+            if (total != min) {
+                min = total;
+                num = 0;
+            }
+            k->randomat[s->start + num++] = c;
+        }
+    }
+
+    s->min = min;
+    s->num_min = num;
+}
+
+static inline uint32_t next_rand(struct blue_noise_work *k)
+{
+    // xorshift64*
+    k->rng ^= k->rng >> 12;
+    k->rng ^= k->rng << 25;
+    k->rng ^= k->rng >> 27;
+    return (k->rng * 0x2545F4914F6CDD1DULL) >> 32;
+}
+
+// Picks the next entry to set, out of the candidates of all slices. Since
+// the slices are in order, this is equivalent to a single serial pass.
+static index_t getmin(struct blue_noise_work *k)
+{
+    uint64_t min = UINT64_MAX;
+    index_t resnum = 0;
+    for (int i = 0; i < k->num_slices; i++) {
+        const struct slice *s = &k->slices[i];
+        if (!s->num_min || s->min > min)
+            continue;
+        if (s->min != min) {
+            min = s->min;
+            resnum = 0;
+        }
+        resnum += s->num_min;
+    }
+
+    assert(resnum > 0);
+    if (resnum == k->size2)
+        return k->size2 / 2;
+
+    index_t n = resnum == 1 ? 0 : next_rand(k) % resnum;
+    for (int i = 0; i < k->num_slices; i++) {
+        const struct slice *s = &k->slices[i];
+        if (!s->num_min || s->min != min)
+            continue;
+        if (n < s->num_min)
+            return k->randomat[s->start + n];
+        n -= s->num_min;
+    }
+
+    abort(); // unreachable
+}
+
+static index_t clamp_slices(int shift, int num_slices)
+{
+    index_t size2 = (index_t) 1 << 2 * shift;
+    if (num_slices < 1)
+        return 1;
+    if ((index_t) num_slices > size2)
+        return size2;
+    return num_slices;
+}
+
+size_t blue_noise_scratch_size(int shift, int num_slices)
+{
+    assert(shift >= 0 && shift <= BLUE_NOISE_MAX_SHIFT);
+    size_t size2 = (size_t) 1 << 2 * shift;
+    return size2 * (2 * sizeof(uint64_t) + sizeof(index_t) + sizeof(bool)) +
+           clamp_slices(shift, num_slices) * sizeof(struct slice);
+}
+
+void blue_noise_generate(uint16_t *out, int shift, int num_slices,
+                         blue_noise_run_fn run, void *priv, void *scratch)
+{
+    assert(shift >= 0 && shift <= BLUE_NOISE_MAX_SHIFT);
+    if (!shift) {
+        out[0] = 0;
+        return;
+    }
+
+    struct blue_noise_work k = {
+        .sizeb = shift,
+        .size  = 1 << shift,
+        .size2 = 1 << 2 * shift,
+        .rng   = 0x9E3779B97F4A7C15ULL,
+    };
+
+    num_slices = clamp_slices(shift, num_slices);
+    k.num_slices = num_slices;
+
+    // Carve up the scratch buffer, in order of decreasing alignment
+    memset(scratch, 0, blue_noise_scratch_size(shift, num_slices));
+    uint8_t *ptr = scratch;
+    k.gauss     = (uint64_t *) ptr; ptr += k.size2 * sizeof(*k.gauss);
+    k.gaussmat  = (uint64_t *) ptr; ptr += k.size2 * sizeof(*k.gaussmat);
+    k.slices    = (struct slice *) ptr; ptr += num_slices * sizeof(*k.slices);
+    k.randomat  = (index_t *) ptr; ptr += k.size2 * sizeof(*k.randomat);
+    k.calcmat   = (bool *) ptr;
+
+    for (int i = 0; i < num_slices; i++) {
+        k.slices[i].start = (uint64_t) k.size2 * i / num_slices;
+        k.slices[i].end   = (uint64_t) k.size2 * (i + 1) / num_slices;
+    }
+
+    makegauss(&k);
+    k.last = k.size2;
+    for (index_t c = 0; c < k.size2; c++) {
+        if (run) {
+            run(priv, &k, num_slices);
+        } else {
+            for (int i = 0; i < num_slices; i++)
+                blue_noise_slice(&k, i);
+        }
+
+        index_t r = getmin(&k);
+        k.calcmat[r] = true;
+        k.last = r;
+        out[r] = c;
+    }
+}
@@ -0,0 +1,50 @@
+/*
+ * This file is part of libplacebo.
+ *
+ * libplacebo is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libplacebo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libplacebo. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Void-and-cluster blue noise generation. This has no dependencies on the
+// rest of libplacebo, since it's also compiled into the build-time generator
+// for the precomputed tables (see `blue_noise_gen.c`).
+
+#define BLUE_NOISE_MAX_SHIFT 8
+
+// Every iteration of the algorithm is split into a number of independent
+// slices, which may be processed in parallel. `run` must call
+// `blue_noise_slice(work, i)` once for every `i` in [0, num_slices), and
+// return only after all of them have completed.
+struct blue_noise_work;
+typedef void (*blue_noise_run_fn)(void *priv, struct blue_noise_work *work,
+                                  int num_slices);
+
+void blue_noise_slice(struct blue_noise_work *work, int slice);
+
+// Generates a blue noise matrix of size (1 << shift) x (1 << shift), as a
+// permutation of the indices [0, 1 << 2 * shift), in row-major order. The
+// result is deterministic, and independent of the number of slices used.
+// If `run` is NULL, all slices are processed serially on the calling thread.
+//
+// `scratch` must point to at least `blue_noise_scratch_size(shift,
+// num_slices)` bytes of memory, suitably aligned for `uint64_t`. This is left
+// up to the caller so that the generator itself never allocates.
+size_t blue_noise_scratch_size(int shift, int num_slices);
+void blue_noise_generate(uint16_t *out, int shift, int num_slices,
+                         blue_noise_run_fn run, void *priv, void *scratch);
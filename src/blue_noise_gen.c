@@ -0,0 +1,75 @@
+/*
+ * This file is part of libplacebo.
+ *
+ * libplacebo is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libplacebo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libplacebo. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Build-time generator for the blue noise tables used by
+// `pl_generate_blue_noise`, which would otherwise have to be generated at
+// runtime for every dither shader object.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "blue_noise.h"
+
+// Largest matrix size to precompute (128x128, 32 KiB). Larger matrices are
+// comparatively rare, and expensive to generate even at build time.
+#define TABLE_SHIFT 7
+
+int main(int argc, char **argv)
+{
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <output>\n", argv[0]);
+        return 1;
+    }
+
+    FILE *out = fopen(argv[1], "w");
+    if (!out) {
+        perror("fopen");
+        return 1;
+    }
+
+    static uint16_t data[1 << 2 * TABLE_SHIFT];
+    void *scratch = malloc(blue_noise_scratch_size(TABLE_SHIFT, 1));
+    if (!scratch) {
+        fprintf(stderr, "Failed allocating blue noise scratch memory!\n");
+        return 1;
+    }
+    fprintf(out, "// Generated by blue_noise_gen.c, do not edit\n\n"
+                 "#define BLUE_NOISE_TABLE_SHIFT %d\n\n", TABLE_SHIFT);
+
+    for (int shift = 0; shift <= TABLE_SHIFT; shift++) {
+        const int size2 = 1 << 2 * shift;
+        blue_noise_generate(data, shift, 1, NULL, NULL, scratch);
+
+        fprintf(out, "static const uint16_t blue_noise_%d[%d] = {", shift, size2);
+        for (int i = 0; i < size2; i++)
+            fprintf(out, "%s%d,", i % 16 ? " " : "\n    ", data[i]);
+        fprintf(out, "\n};\n\n");
+    }
+
+    fprintf(out, "static const uint16_t * const blue_noise_tables[] = {\n");
+    for (int shift = 0; shift <= TABLE_SHIFT; shift++)
+        fprintf(out, "    blue_noise_%d,\n", shift);
+    fprintf(out, "};\n");
+    free(scratch);
+
+    if (fclose(out)) {
+        perror("fclose");
+        return 1;
+    }
+
+    return 0;
+}
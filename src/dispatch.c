@@ -27,6 +27,11 @@
 #define MAX_PASSES 100
 #define MIN_AGE 10
 
+// Number of frames worth of uniform buffers to keep in the UBO ring, and the
+// (preferred) size of each individual buffer in it
+#define UBO_RING_FRAMES 4
+#define UBO_RING_CHUNK (64 << 10)
+
 enum {
     TMP_PRELUDE,   // GLSL version, global definitions, etc.
     TMP_MAIN,      // main GLSL shader body
@@ -35,14 +40,25 @@ enum {
     TMP_COUNT,
 };
 
+// Uniform buffers used for the UBO contents of all passes in a single frame
+struct ubo_frame {
+    PL_ARRAY(pl_buf) bufs;
+    int idx;       // index of the buffer currently being suballocated from
+    size_t offset; // first free byte in `bufs.elem[idx]`
+};
+
 struct pl_dispatch_t {
     pl_mutex lock;
+    pl_cond compiled; // signalled whenever deferred passes finish compiling
     pl_log log;
     pl_gpu gpu;
     uint8_t current_ident;
     uint8_t current_index;
     bool dynamic_constants;
+    bool defer;
+    int specialize_frames;
     int max_passes;
+    uint64_t frame; // number of calls to `pl_dispatch_reset_frame`
 
     void (*info_callback)(void *, const struct pl_dispatch_info *);
     void *info_priv;
@@ -50,25 +66,47 @@ struct pl_dispatch_t {
     PL_ARRAY(pl_shader) shaders;                // to avoid re-allocations
     PL_ARRAY(struct pass *) passes;             // compiled passes
     PL_ARRAY(struct cached_pass) cached_passes; // not-yet-compiled passes
+    PL_ARRAY(struct pass *) deferred;           // passes waiting for creation
+    PL_ARRAY(struct pass *) background;         // specialized passes, ditto
+
+    // background thread compiling the specialized passes, if running
+    pl_thread bg_thread;
+    pl_cond bg_wakeup;
+    struct pass *bg_pass; // currently being compiled by `bg_thread`
+    bool bg_running;
+    bool bg_exit;
 
     // temporary buffers to help avoid re_allocations during pass creation
     pl_str_builder tmp[TMP_COUNT];
     uint8_t *ubo_tmp;
+
+    // frame-wide UBO ring, disabled if `ubo_align` is 0
+    struct ubo_frame ubo_frames[UBO_RING_FRAMES];
+    int ubo_frame;
+    uint64_t ubo_gen; // incremented whenever `ubo_frame` changes
+    size_t ubo_align;
+    size_t ubo_chunk;
 };
 
 enum pass_var_type {
     PASS_VAR_NONE = 0,
     PASS_VAR_GLOBAL, // regular/global uniforms
     PASS_VAR_UBO,    // uniform buffers
-    PASS_VAR_PUSHC   // push constants
+    PASS_VAR_PUSHC,  // push constants
+    PASS_VAR_CONST,  // specialization constants, never updated
 };
 
 // Cached metadata about a variable's effective placement / update method
 struct pass_var {
-    int index; // for pl_var_update
+    int index; // for pl_var_update, or the index into pl_pass_params.constants
     enum pass_var_type type;
     struct pl_var_layout layout;
     void *cached_data;
+
+    // for generic passes with adaptive specialization enabled, the frame in
+    // which this (scalar) var last changed, and the raw value it changed to
+    uint64_t last_change;
+    uint32_t last_value;
 };
 
 struct pass {
@@ -77,15 +115,36 @@ struct pass {
     pl_pass pass;
     int last_index;
 
+    // for deferred passes, the params to create `pass` with. These must not
+    // be modified while `pl_dispatch_compile` is busy compiling the pass
+    struct pl_pass_params params;
+    bool deferred;
+    bool compiling;
+
     // contains cached data and update metadata, same order as pl_shader
     struct pass_var *vars;
+    int num_vars;
     int num_var_locs;
 
+    // for adaptive specialization, the hash of the (unspecialized) shader
+    // this generic pass was created from, or 0 for specialized passes. Also
+    // the frame in which a specialized var last changed its value
+    uint64_t family;
+    uint64_t last_respec;
+
     // for uniform buffer updates
     struct pl_shader_desc ubo_desc; // temporary
     int ubo_index;
     pl_buf ubo;
 
+    // for passes using the UBO ring, contains a host copy of the UBO contents
+    // as well as the binding they were last uploaded to
+    uint8_t *ubo_data;
+    size_t ubo_size;
+    bool ubo_dirty;
+    uint64_t ubo_gen;
+    struct pl_desc_binding ubo_binding;
+
     // Cached pl_pass_run_params. This will also contain mutable allocations
     // for the push constants, descriptor bindings (including the binding for
     // the UBO pre-filled), vertex array and variable updates
@@ -107,11 +166,33 @@ struct cached_pass {
     bool stale;
 };
 
+static void remove_deferred(pl_dispatch dp, struct pass *pass)
+{
+    for (int i = 0; i < dp->deferred.num; i++) {
+        if (dp->deferred.elem[i] == pass) {
+            PL_ARRAY_REMOVE_AT(dp->deferred, i);
+            break;
+        }
+    }
+
+    for (int i = 0; i < dp->background.num; i++) {
+        if (dp->background.elem[i] == pass) {
+            PL_ARRAY_REMOVE_AT(dp->background, i);
+            break;
+        }
+    }
+
+    pass->deferred = false;
+}
+
 static void pass_destroy(pl_dispatch dp, struct pass *pass)
 {
     if (!pass)
         return;
 
+    if (pass->deferred)
+        remove_deferred(dp, pass);
+
     pl_buf_destroy(dp->gpu, &pass->ubo);
     pl_pass_destroy(dp->gpu, &pass->pass);
     pl_timer_destroy(dp->gpu, &pass->timer);
@@ -122,12 +203,23 @@ pl_dispatch pl_dispatch_create(pl_log log, pl_gpu gpu)
 {
     struct pl_dispatch_t *dp = pl_zalloc_ptr(NULL, dp);
     pl_mutex_init(&dp->lock);
+    pl_cond_init(&dp->compiled);
+    pl_cond_init(&dp->bg_wakeup);
     dp->log = log;
     dp->gpu = gpu;
     dp->max_passes = MAX_PASSES;
     for (int i = 0; i < PL_ARRAY_SIZE(dp->tmp); i++)
         dp->tmp[i] = pl_str_builder_alloc(dp);
 
+    // Suballocate all UBO contents from persistently mapped buffers if we
+    // can bind sub-ranges of them, to avoid one `pl_buf_write` per pass
+    const struct pl_gpu_limits *limits = &gpu->limits;
+    if (limits->align_ubo_offset && limits->max_mapped_size && limits->max_ubo_size) {
+        dp->ubo_align = limits->align_ubo_offset;
+        dp->ubo_chunk = PL_MIN(UBO_RING_CHUNK, limits->max_ubo_size);
+        dp->ubo_chunk = PL_MIN(dp->ubo_chunk, limits->max_mapped_size);
+    }
+
     return dp;
 }
 
@@ -137,11 +229,26 @@ void pl_dispatch_destroy(pl_dispatch *ptr)
     if (!dp)
         return;
 
+    if (dp->bg_running) {
+        pl_mutex_lock(&dp->lock);
+        dp->bg_exit = true;
+        pl_cond_signal(&dp->bg_wakeup);
+        pl_mutex_unlock(&dp->lock);
+        pl_thread_join(dp->bg_thread);
+    }
+
     for (int i = 0; i < dp->passes.num; i++)
         pass_destroy(dp, dp->passes.elem[i]);
     for (int i = 0; i < dp->shaders.num; i++)
         pl_shader_free(&dp->shaders.elem[i]);
+    for (int i = 0; i < UBO_RING_FRAMES; i++) {
+        struct ubo_frame *f = &dp->ubo_frames[i];
+        for (int n = 0; n < f->bufs.num; n++)
+            pl_buf_destroy(dp->gpu, &f->bufs.elem[n]);
+    }
 
+    pl_cond_destroy(&dp->bg_wakeup);
+    pl_cond_destroy(&dp->compiled);
     pl_mutex_destroy(&dp->lock);
     pl_free(dp);
     *ptr = NULL;
@@ -175,6 +282,197 @@ void pl_dispatch_mark_dynamic(pl_dispatch dp, bool dynamic)
     dp->dynamic_constants = dynamic;
 }
 
+void pl_dispatch_defer(pl_dispatch dp, bool defer)
+{
+    pl_mutex_lock(&dp->lock);
+    dp->defer = defer;
+    pl_mutex_unlock(&dp->lock);
+}
+
+// Must be called after `pass->pass` has been created (or attempted)
+static bool finish_deferred(pl_dispatch dp, struct pass *pass)
+{
+    remove_deferred(dp, pass);
+    pass->run_params.pass = pass->pass;
+    if (!pass->pass) {
+        PL_ERR(dp, "Failed creating render pass for dispatch");
+        return false;
+    }
+
+    return true;
+}
+
+// Makes sure a deferred pass gets created, for passes that are needed right
+// now. This may temporarily release the lock, so it must only be called after
+// the shader has been fully generated.
+static void ensure_pass(pl_dispatch dp, struct pass *pass)
+{
+    if (pass->compiling) {
+        // Wait for the compilation in progress rather than compiling it twice.
+        // Other threads may dispatch shaders meanwhile, so free up the builders
+        for (int i = 0; i < PL_ARRAY_SIZE(dp->tmp); i++)
+            pl_str_builder_reset(dp->tmp[i]);
+        while (pass->compiling)
+            pl_cond_wait(&dp->compiled, &dp->lock);
+    }
+
+    if (pass->deferred) {
+        pass->pass = pl_pass_create(dp->gpu, &pass->params);
+        finish_deferred(dp, pass);
+    }
+}
+
+struct compile_state {
+    pl_gpu gpu;
+    struct pass **passes;
+    pl_pass *out;
+    int num_passes;
+    pl_mutex lock;
+    int idx; // next pass to compile
+};
+
+static PL_THREAD_VOID compile_thread(void *priv)
+{
+    struct compile_state *state = priv;
+
+    while (true) {
+        pl_mutex_lock(&state->lock);
+        int idx = state->idx++;
+        pl_mutex_unlock(&state->lock);
+        if (idx >= state->num_passes)
+            break;
+
+        const struct pass *pass = state->passes[idx];
+        state->out[idx] = pl_pass_create_async(state->gpu, &pass->params);
+    }
+
+    PL_THREAD_RETURN();
+}
+
+// Compiles the specialized passes queued up by `finalize_pass`, one at a
+// time, without holding the lock. Only used for thread-safe GPUs.
+static PL_THREAD_VOID background_thread(void *priv)
+{
+    pl_dispatch dp = priv;
+
+    pl_mutex_lock(&dp->lock);
+    while (!dp->bg_exit) {
+        struct pass *pass;
+        if (!PL_ARRAY_POP(dp->background, &pass)) {
+            pl_cond_wait(&dp->bg_wakeup, &dp->lock);
+            continue;
+        }
+
+        dp->bg_pass = pass;
+        pass->compiling = true;
+        pl_mutex_unlock(&dp->lock);
+        pl_pass gpu_pass = pl_pass_create(dp->gpu, &pass->params);
+        pl_mutex_lock(&dp->lock);
+        pass->pass = gpu_pass;
+        pass->compiling = false;
+        dp->bg_pass = NULL;
+        finish_deferred(dp, pass);
+        pl_cond_broadcast(&dp->compiled);
+    }
+
+    pl_mutex_unlock(&dp->lock);
+    PL_THREAD_RETURN();
+}
+
+// Queues up a specialized pass for compilation in the background, starting
+// the background thread if needed. Returns false if this is not possible.
+static bool queue_background(pl_dispatch dp, struct pass *pass)
+{
+    if (!dp->gpu->limits.thread_safe)
+        return false;
+
+    if (!dp->bg_running) {
+        if (pl_thread_create(&dp->bg_thread, background_thread, dp) != 0)
+            return false;
+        dp->bg_running = true;
+    }
+
+    PL_ARRAY_APPEND(dp, dp->background, pass);
+    pl_cond_signal(&dp->bg_wakeup);
+    return true;
+}
+
+bool pl_dispatch_compile(pl_dispatch dp, int num_threads)
+{
+    pl_mutex_lock(&dp->lock);
+
+    // Also take over the specialized passes still waiting for the background
+    // thread, and wait for the one it is currently compiling (if any)
+    for (int i = 0; i < dp->background.num; i++)
+        PL_ARRAY_APPEND(dp, dp->deferred, dp->background.elem[i]);
+    dp->background.num = 0;
+    while (dp->bg_pass)
+        pl_cond_wait(&dp->compiled, &dp->lock);
+
+    if (!dp->deferred.num) {
+        pl_mutex_unlock(&dp->lock);
+        return true;
+    }
+
+    // Take over all currently deferred passes. Unless the GPU requires us to
+    // serialize everything, they are compiled without holding the lock, so
+    // other threads can keep dispatching (non-deferred) shaders meanwhile
+    const bool thread_safe = dp->gpu->limits.thread_safe;
+    struct compile_state state = {
+        .gpu = dp->gpu,
+        .num_passes = dp->deferred.num,
+    };
+
+    state.passes = pl_memdup(NULL, dp->deferred.elem,
+                             state.num_passes * sizeof(state.passes[0]));
+    state.out = pl_calloc_ptr(state.passes, state.num_passes, state.out);
+    for (int i = 0; i < state.num_passes; i++)
+        state.passes[i]->compiling = true;
+    dp->deferred.num = 0;
+    if (thread_safe)
+        pl_mutex_unlock(&dp->lock);
+
+    pl_mutex_init(&state.lock);
+    if (!thread_safe)
+        num_threads = 1;
+    num_threads = PL_CLAMP(num_threads, 1, state.num_passes);
+    PL_DEBUG(dp, "Compiling %d deferred passes using %d threads",
+             state.num_passes, num_threads);
+
+    // All threads share the same queue of passes
+    pl_thread_fan_out(compile_thread, &state, 0, num_threads);
+    pl_mutex_destroy(&state.lock);
+
+    // Only wait for the passes after all of them have been created, since
+    // the backend may compile them asynchronously
+    for (int i = 0; i < state.num_passes; i++) {
+        pl_pass *pass = &state.out[i];
+        if (*pass && !pl_pass_wait(dp->gpu, *pass))
+            pl_pass_destroy(dp->gpu, pass);
+    }
+
+    if (thread_safe)
+        pl_mutex_lock(&dp->lock);
+
+    bool ok = true;
+    for (int i = 0; i < state.num_passes; i++) {
+        struct pass *pass = state.passes[i];
+        pass->pass = state.out[i];
+        pass->compiling = false;
+        ok &= finish_deferred(dp, pass);
+    }
+
+    pl_cond_broadcast(&dp->compiled);
+    pl_mutex_unlock(&dp->lock);
+    pl_free(state.passes);
+    return ok;
+}
+
+void pl_dispatch_specialize(pl_dispatch dp, int frames)
+{
+    dp->specialize_frames = PL_MAX(frames, 0);
+}
+
 void pl_dispatch_callback(pl_dispatch dp, void *priv,
                           void (*cb)(void *priv, const struct pl_dispatch_info *))
 {
@@ -250,7 +548,7 @@ static bool add_pass_var(pl_dispatch dp, void *tmp, struct pass *pass,
 }
 
 #define ADD(b, ...)     pl_str_builder_addf(b, __VA_ARGS__)
-#define ADD_CAT(b, cat) pl_str_builder_concat(b, cat)
+#define ADD_CAT(b, cat) pl_str_builder_concat_ref(b, cat)
 
 static void add_var(pl_str_builder body, const struct pl_var *var)
 {
@@ -431,17 +729,27 @@ static void generate_shaders(pl_dispatch dp,
         add_buffer_vars(dp, tmp, pre, pc_bvars.elem, pc_bvars.num);
     }
 
-    // Add all of the specialization constants
-    for (int i = 0; i < res->num_constants; i++) {
-        static const char *types[PL_VAR_TYPE_COUNT] = {
-            [PL_VAR_SINT]   = "int",
-            [PL_VAR_UINT]   = "uint",
-            [PL_VAR_FLOAT]  = "float",
-        };
+    // Add all of the specialization constants, including specialized vars
+    static const char *const_types[PL_VAR_TYPE_COUNT] = {
+        [PL_VAR_SINT]   = "int",
+        [PL_VAR_UINT]   = "uint",
+        [PL_VAR_FLOAT]  = "float",
+    };
 
+    for (int i = 0; i < res->num_constants; i++) {
         const struct pl_shader_const *sc = &res->constants[i];
         ADD(pre, "layout(constant_id=%"PRIu32") const %s %s = 1; \n",
-            pass_params->constants[i].id, types[sc->type], sc->name);
+            pass_params->constants[i].id, const_types[sc->type], sc->name);
+    }
+
+    for (int i = 0; i < res->num_variables; i++) {
+        const struct pl_var *var = &res->variables[i].var;
+        const struct pass_var *pv = &pass->vars[i];
+        if (pv->type != PASS_VAR_CONST)
+            continue;
+        ADD(pre, "layout(constant_id=%"PRIu32") const %s %s = 1; \n",
+            pass_params->constants[pv->index].id, const_types[var->type],
+            var->name);
     }
 
     static const char sampler_prefixes[PL_FMT_TYPE_COUNT] = {
@@ -696,11 +1004,19 @@ static void garbage_collect_passes(pl_dispatch dp)
     while (idx < dp->passes.num && pass_age(dp->passes.elem[idx]) < MIN_AGE)
         idx++;
 
-    for (int i = idx; i < dp->passes.num; i++)
-        pass_destroy(dp, dp->passes.elem[i]);
+    // Passes still being compiled by another thread must be kept
+    int num_kept = idx;
+    for (int i = idx; i < dp->passes.num; i++) {
+        struct pass *pass = dp->passes.elem[i];
+        if (pass->compiling) {
+            dp->passes.elem[num_kept++] = pass;
+        } else {
+            pass_destroy(dp, pass);
+        }
+    }
 
-    int num_evicted = dp->passes.num - idx;
-    dp->passes.num = idx;
+    int num_evicted = dp->passes.num - num_kept;
+    dp->passes.num = num_kept;
 
     if (num_evicted) {
         PL_DEBUG(dp, "Evicted %d passes from dispatch cache, consider "
@@ -710,12 +1026,210 @@ static void garbage_collect_passes(pl_dispatch dp)
     }
 }
 
+static bool can_specialize(const struct pl_shader_var *sv)
+{
+    const struct pl_var *var = &sv->var;
+    return !sv->dynamic && var->dim_v == 1 && var->dim_m == 1 && var->dim_a == 1;
+}
+
+// Identifies a shader prior to finalization, i.e. independently of which of
+// its variables end up getting specialized. This is cheap to compute, since
+// the string builders hash their contents incrementally as they are built;
+// and the var names need not be hashed since they're referenced by the body.
+// Also includes the pass configuration, which must match for the generic pass
+// to be usable in place of the specialized one. Returns 0 for shaders with
+// nothing to specialize.
+static uint64_t shader_family(pl_shader sh, pl_tex target, int vert_idx,
+                              const struct pl_blend_params *blend, bool load,
+                              const struct pl_dispatch_vertex_params *vparams)
+{
+    uint64_t hash = sh->vars.num;
+    bool any = false;
+    for (int i = 0; i < sh->vars.num; i++) {
+        const struct pl_shader_var *sv = &sh->vars.elem[i];
+        any |= can_specialize(sv);
+        pl_hash_merge(&hash, ((uint64_t) sv->var.type << 48) |
+                             ((uint64_t) sv->var.dim_v << 32) |
+                             ((uint64_t) sv->var.dim_m << 16) |
+                             ((uint64_t) sv->var.dim_a << 1) |
+                             sv->dynamic);
+    }
+
+    if (!any)
+        return 0;
+
+    for (int i = 0; i < SH_BUF_COUNT; i++)
+        pl_hash_merge(&hash, pl_str_builder_hash(sh->buffers[i]));
+
+    if (pl_shader_is_compute(sh))
+        return PL_DEF(hash, 1);
+
+    // Raster pass configuration, mirroring the pass signature
+    pl_hash_merge(&hash, target->params.format->signature);
+    pl_hash_merge(&hash, ((uint64_t) !!vparams << 33) | ((uint64_t) load << 32) |
+                         (uint32_t) vert_idx);
+    if (blend)
+        pl_hash_merge(&hash, pl_mem_hash(blend, sizeof(*blend)));
+    if (vparams) {
+        pl_hash_merge(&hash, ((uint64_t) vparams->vertex_type << 32) |
+                             (uint64_t) vparams->vertex_stride);
+    }
+    for (int i = 0; i < sh->vas.num; i++) {
+        const struct pl_vertex_attrib *va = &sh->vas.elem[i].attr;
+        pl_hash_merge(&hash, va->fmt->signature);
+        pl_hash_merge(&hash, va->offset);
+    }
+
+    return PL_DEF(hash, 1);
+}
+
+// Track the values of all specializable vars against the generic pass, and
+// pick the ones which have been stable for long enough to be turned into
+// specialization constants. Any change to a var that was specialized (or
+// about to be) causes the generic pass to be used again, until the values
+// have settled down. Returns a mask over `sh->vars`, or NULL.
+static const bool *specialize_vars(pl_dispatch dp, struct pass *generic,
+                                   pl_shader sh)
+{
+    pl_static_assert(sizeof(float) == sizeof(generic->vars[0].last_value));
+    pl_assert(sh->vars.num <= generic->num_vars);
+    const uint64_t frames = dp->specialize_frames;
+    generic->last_index = dp->current_index; // keep the generic pass alive
+
+    int num_stable = 0;
+    for (int i = 0; i < sh->vars.num; i++) {
+        const struct pl_shader_var *sv = &sh->vars.elem[i];
+        struct pass_var *pv = &generic->vars[i];
+        if (!can_specialize(sv))
+            continue;
+
+        if (memcmp(&pv->last_value, sv->data, sizeof(pv->last_value)) != 0) {
+            if (dp->frame - pv->last_change >= frames)
+                generic->last_respec = dp->frame;
+            memcpy(&pv->last_value, sv->data, sizeof(pv->last_value));
+            pv->last_change = dp->frame;
+        } else if (dp->frame - pv->last_change >= frames) {
+            num_stable++;
+        }
+    }
+
+    if (!num_stable || dp->frame - generic->last_respec < frames)
+        return NULL;
+    if (sh->consts.num + num_stable > dp->gpu->limits.max_constants)
+        return NULL;
+
+    bool *mask = pl_calloc_ptr(SH_TMP(sh), sh->vars.num, mask);
+    for (int i = 0; i < sh->vars.num; i++) {
+        const struct pl_shader_var *sv = &sh->vars.elem[i];
+        const struct pass_var *pv = &generic->vars[i];
+        mask[i] = can_specialize(sv) && dp->frame - pv->last_change >= frames;
+    }
+
+    PL_TRACE(dp, "Specializing %d shader variables", num_stable);
+    return mask;
+}
+
+static void track_pass(pl_dispatch dp, struct pass *pass, pl_shader sh,
+                       uint64_t family)
+{
+    if (!family || pass->family)
+        return;
+
+    pass->family = family;
+    for (int i = 0; i < sh->vars.num; i++) {
+        const struct pl_shader_var *sv = &sh->vars.elem[i];
+        struct pass_var *pv = &pass->vars[i];
+        if (!can_specialize(sv))
+            continue;
+        memcpy(&pv->last_value, sv->data, sizeof(pv->last_value));
+        pv->last_change = dp->frame;
+    }
+}
+
+// Falls back to the generic pass while the specialized variant of a shader is
+// still waiting to be compiled. `sh` was already finalized for the specialized
+// variant, which shares all variables and descriptors with the generic pass
+// except for the UBO, and the constant data past the shader's own constants.
+static struct pass *use_generic(pl_dispatch dp, pl_shader sh,
+                                struct pass *generic, int num_descs,
+                                size_t consts_size)
+{
+    pl_assert(sh->vars.num == generic->num_vars);
+    generic->last_index = dp->current_index;
+    ensure_pass(dp, generic);
+
+    sh->descs.num = num_descs;
+    if (generic->ubo || generic->ubo_data) {
+        pl_assert(generic->ubo_index == num_descs);
+        PL_ARRAY_APPEND(sh, sh->descs, (struct pl_shader_desc) {
+            .desc = {
+                .name = "UBO",
+                .type = PL_DESC_BUF_UNIFORM,
+            },
+            .binding.object = generic->ubo,
+        });
+    }
+    sh->res.descriptors = sh->descs.elem;
+    sh->res.num_descriptors = sh->descs.num;
+
+    pl_free(generic->run_params.constant_data);
+    generic->run_params.constant_data = NULL;
+    if (consts_size) {
+        generic->run_params.constant_data = pl_alloc(generic, consts_size);
+        uint8_t *data = generic->run_params.constant_data;
+        for (int i = 0; i < sh->consts.num; i++) {
+            const struct pl_shader_const *sc = &sh->consts.elem[i];
+            size_t size = pl_var_type_size(sc->type);
+            memcpy(data, sc->data, size);
+            data += size;
+        }
+    }
+
+    return generic;
+}
+
 static struct pass *finalize_pass(pl_dispatch dp, pl_shader sh,
                                   pl_tex target, int vert_idx,
                                   const struct pl_blend_params *blend, bool load,
                                   const struct pl_dispatch_vertex_params *vparams,
                                   const struct pl_transform2x2 *proj)
 {
+    // Load projection matrix if required. This is done first, so that the
+    // shader variables match up between generic and specialized passes
+    ident_t out_mat = NULL_IDENT, out_off = NULL_IDENT;
+    if (proj && memcmp(&proj->mat, &pl_matrix2x2_identity, sizeof(proj->mat)) != 0) {
+        out_mat = sh_var(sh, (struct pl_shader_var) {
+            .var = pl_var_mat2("proj"),
+            .data = PL_TRANSPOSE_2X2(proj->mat.m),
+        });
+    }
+
+    if (proj && (proj->c[0] || proj->c[1])) {
+        out_off = sh_var(sh, (struct pl_shader_var) {
+            .var = pl_var_vec2("offset"),
+            .data = proj->c,
+        });
+    }
+
+    // Look up the generic pass for this shader if we may specialize it
+    uint64_t family = 0;
+    struct pass *generic = NULL;
+    const bool *spec = NULL;
+    if (dp->specialize_frames && dp->gpu->limits.max_constants)
+        family = shader_family(sh, target, vert_idx, blend, load, vparams);
+    for (int i = 0; family && i < dp->passes.num; i++) {
+        struct pass *p = dp->passes.elem[i];
+        if (p->family == family) {
+            generic = p;
+            spec = specialize_vars(dp, p, sh);
+            break;
+        }
+    }
+
+    if (spec)
+        family = 0; // not the generic pass
+    const int base_descs = sh->descs.num;
+
     struct pass *pass = pl_alloc_ptr(dp, pass);
     *pass = (struct pass) {
         .signature = 0x0, // updated incrementally below
@@ -744,6 +1258,8 @@ static struct pass *finalize_pass(pl_dispatch dp, pl_shader sh,
         .pass = pass,
         .pass_params = &params,
         .sh = sh,
+        .out_mat = out_mat,
+        .out_off = out_off,
         .vert_idx = vert_idx,
     };
 
@@ -787,28 +1303,21 @@ static struct pass *finalize_pass(pl_dispatch dp, pl_shader sh,
             pl_static_assert(sizeof(*blend) == sizeof(enum pl_blend_mode) * 4);
             pl_hash_merge(&pass->signature, pl_mem_hash(blend, sizeof(*blend)));
         }
-
-        // Load projection matrix if required
-        if (proj && memcmp(&proj->mat, &pl_matrix2x2_identity, sizeof(proj->mat)) != 0) {
-            gen_params.out_mat = sh_var(sh, (struct pl_shader_var) {
-                .var = pl_var_mat2("proj"),
-                .data = PL_TRANSPOSE_2X2(proj->mat.m),
-            });
-        }
-
-        if (proj && (proj->c[0] || proj->c[1])) {
-            gen_params.out_off = sh_var(sh, (struct pl_shader_var) {
-                .var = pl_var_vec2("offset"),
-                .data = proj->c,
-            });
-        }
     }
 
-    // Place all of the compile-time constants
+    // Place all of the compile-time constants, followed by the variables
+    // being specialized (if any), which are appended as extra constants
+    pass->vars = pl_calloc_ptr(pass, sh->vars.num, pass->vars);
+    pass->num_vars = sh->vars.num;
+    int num_consts = sh->consts.num;
+    for (int i = 0; spec && i < sh->vars.num; i++)
+        num_consts += spec[i];
+
     uint8_t *constant_data = NULL;
-    if (sh->consts.num) {
-        params.num_constants = sh->consts.num;
-        params.constants = pl_alloc(tmp, sh->consts.num * sizeof(struct pl_constant));
+    size_t consts_size = 0; // size of the `sh->consts` part
+    if (num_consts) {
+        params.num_constants = num_consts;
+        params.constants = pl_alloc(tmp, num_consts * sizeof(struct pl_constant));
 
         // Compute offsets
         size_t total_size = 0;
@@ -822,6 +1331,22 @@ static struct pass *finalize_pass(pl_dispatch dp, pl_shader sh,
             total_size += pl_var_type_size(sh->consts.elem[i].type);
         }
 
+        consts_size = total_size;
+        for (int i = 0; spec && i < sh->vars.num; i++) {
+            if (!spec[i])
+                continue;
+            enum pl_var_type type = sh->vars.elem[i].var.type;
+            pass->vars[i].type = PASS_VAR_CONST;
+            pass->vars[i].index = const_id;
+            params.constants[const_id] = (struct pl_constant) {
+                .type = type,
+                .id = const_id,
+                .offset = total_size,
+            };
+            const_id++;
+            total_size += pl_var_type_size(type);
+        }
+
         // Write values into the constants buffer
         params.constant_data = constant_data = pl_alloc(pass, total_size);
         for (int i = 0; i < sh->consts.num; i++) {
@@ -829,6 +1354,14 @@ static struct pass *finalize_pass(pl_dispatch dp, pl_shader sh,
             void *data = constant_data + params.constants[i].offset;
             memcpy(data, sc->data, pl_var_type_size(sc->type));
         }
+        for (int i = 0; spec && i < sh->vars.num; i++) {
+            const struct pl_shader_var *sv = &sh->vars.elem[i];
+            const struct pass_var *pv = &pass->vars[i];
+            if (pv->type != PASS_VAR_CONST)
+                continue;
+            void *data = constant_data + params.constants[pv->index].offset;
+            memcpy(data, sv->data, pl_var_type_size(sv->var.type));
+        }
     }
 
     // Place all the variables; these will dynamically end up in different
@@ -836,7 +1369,6 @@ static struct pass *finalize_pass(pl_dispatch dp, pl_shader sh,
     //
     // We go through the list twice, once to place stuff that we definitely
     // want inside PCs, and then a second time to opportunistically place the rest.
-    pass->vars = pl_calloc_ptr(pass, sh->vars.num, pass->vars);
     for (int i = 0; i < sh->vars.num; i++) {
         if (!add_pass_var(dp, tmp, pass, &params, &sh->vars.elem[i], &pass->vars[i], false))
             goto error;
@@ -875,11 +1407,26 @@ static struct pass *finalize_pass(pl_dispatch dp, pl_shader sh,
             continue;
 
         // Found existing shader, re-use directly
+        if (spec && !p->pass && !dp->defer) {
+            pl_free(pass);
+            return use_generic(dp, sh, generic, base_descs, consts_size);
+        }
+
         if (p->ubo)
             sh->descs.elem[p->ubo_index].binding.object = p->ubo;
+        p->last_index = dp->current_index;
+        track_pass(dp, p, sh, family);
+        if (p->deferred && !p->compiling && constant_data) {
+            // Compile the pass with the most recent constant values
+            pl_free((void *) p->params.constant_data);
+            p->params.constant_data = pl_memdup(p, constant_data,
+                                                pl_get_size(constant_data));
+        }
         pl_free(p->run_params.constant_data);
         p->run_params.constant_data = pl_steal(p, constant_data);
-        p->last_index = dp->current_index;
+
+        if (!dp->defer)
+            ensure_pass(dp, p);
         pl_free(pass);
         return p;
     }
@@ -906,10 +1453,27 @@ static struct pass *finalize_pass(pl_dispatch dp, pl_shader sh,
         }
     }
 
-    pass->pass = pl_pass_create(dp->gpu, &params);
-    if (!pass->pass) {
-        PL_ERR(dp, "Failed creating render pass for dispatch");
-        // Add it anyway
+    if (dp->defer || spec) {
+        // Created later, either in the background or as part of
+        // `pl_dispatch_compile`. Specialized variants are never compiled on
+        // demand, since the generic version of the shader can be used in the
+        // meantime
+        pass->params = pl_pass_params_copy(pass, &params);
+        pass->params.cached_program = params.cached_program;
+        pass->params.cached_program_len = params.cached_program_len;
+        if (constant_data) {
+            pass->params.constant_data = pl_memdup(pass, constant_data,
+                                                   pl_get_size(constant_data));
+        }
+        pass->deferred = true;
+        if (dp->defer || !queue_background(dp, pass))
+            PL_ARRAY_APPEND(dp, dp->deferred, pass);
+    } else {
+        pass->pass = pl_pass_create(dp->gpu, &params);
+        if (!pass->pass) {
+            PL_ERR(dp, "Failed creating render pass for dispatch");
+            // Add it anyway
+        }
     }
 
     struct pl_pass_run_params *rparams = &pass->run_params;
@@ -919,7 +1483,13 @@ static struct pass *finalize_pass(pl_dispatch dp, pl_shader sh,
     rparams->desc_bindings = pl_calloc_ptr(pass, params.num_descriptors,
                                            rparams->desc_bindings);
 
-    if (ubo_size && pass->pass) {
+    const bool valid = pass->pass || pass->deferred;
+    if (ubo_size && valid && dp->ubo_align && ubo_size <= dp->ubo_chunk) {
+        // Suballocated from the UBO ring on every dispatch, see `update_pass_ubo`
+        pass->ubo_data = pl_zalloc(pass, ubo_size);
+        pass->ubo_size = ubo_size;
+        pass->ubo_dirty = true;
+    } else if (ubo_size && valid) {
         // Create the UBO
         pass->ubo = pl_buf_create(dp->gpu, pl_buf_params(
             .size = ubo_size,
@@ -943,8 +1513,11 @@ static struct pass *finalize_pass(pl_dispatch dp, pl_shader sh,
     }
 
     pass->timer = pl_timer_create(dp->gpu);
+    track_pass(dp, pass, sh, family);
 
     PL_ARRAY_APPEND(dp, dp->passes, pass);
+    if (spec && !dp->defer)
+        return use_generic(dp, sh, generic, base_descs, consts_size);
     return pass;
 
 error:
@@ -955,6 +1528,9 @@ error:
 static void update_pass_var(pl_dispatch dp, struct pass *pass,
                             const struct pl_shader_var *sv, struct pass_var *pv)
 {
+    if (pv->type == PASS_VAR_CONST)
+        return; // baked into the constant data
+
     struct pl_var_layout host_layout = pl_var_host_layout(0, &sv->var);
     pl_assert(host_layout.size);
 
@@ -968,6 +1544,7 @@ static void update_pass_var(pl_dispatch dp, struct pass *pass,
     struct pl_pass_run_params *rparams = &pass->run_params;
     switch (pv->type) {
     case PASS_VAR_NONE:
+    case PASS_VAR_CONST:
         pl_unreachable();
     case PASS_VAR_GLOBAL: {
         struct pl_var_update vu = {
@@ -978,6 +1555,13 @@ static void update_pass_var(pl_dispatch dp, struct pass *pass,
         break;
     }
     case PASS_VAR_UBO: {
+        if (pass->ubo_data) {
+            // Only update the host copy, this gets uploaded by `update_pass_ubo`
+            memcpy_layout(pass->ubo_data, pv->layout, sv->data, host_layout);
+            pass->ubo_dirty = true;
+            break;
+        }
+
         pl_assert(pass->ubo);
         const size_t offset = pv->layout.offset;
         if (host_layout.stride == pv->layout.stride) {
@@ -1008,6 +1592,111 @@ static void update_pass_var(pl_dispatch dp, struct pass *pass,
     };
 }
 
+static bool ubo_ring_alloc(pl_dispatch dp, size_t size,
+                           struct pl_desc_binding *out_binding)
+{
+    struct ubo_frame *f = &dp->ubo_frames[dp->ubo_frame];
+    size_t offset = PL_ALIGN(f->offset, dp->ubo_align);
+    if (f->idx < f->bufs.num && offset + size > f->bufs.elem[f->idx]->params.size) {
+        // Current buffer is full, move on to the next one
+        f->idx++;
+        offset = 0;
+    }
+
+    if (f->idx == f->bufs.num) {
+        pl_buf buf = pl_buf_create(dp->gpu, pl_buf_params(
+            .size = PL_MAX(dp->ubo_chunk, size),
+            .uniform = true,
+            .host_mapped = true,
+        ));
+
+        if (!buf)
+            return false;
+
+        PL_ARRAY_APPEND(dp, f->bufs, buf);
+    }
+
+    *out_binding = (struct pl_desc_binding) {
+        .object = f->bufs.elem[f->idx],
+        .buf_offset = offset,
+        .buf_size = size,
+    };
+
+    f->offset = offset + size;
+    return true;
+}
+
+static void ubo_ring_advance(pl_dispatch dp)
+{
+    if (!dp->ubo_align)
+        return;
+
+    dp->ubo_frame = (dp->ubo_frame + 1) % UBO_RING_FRAMES;
+    dp->ubo_gen++;
+
+    // Rather than blocking on buffers that are still in use by the GPU, just
+    // drop them and allocate new ones as needed
+    struct ubo_frame *f = &dp->ubo_frames[dp->ubo_frame];
+    for (int i = f->bufs.num - 1; i >= 0; i--) {
+        if (pl_buf_poll(dp->gpu, f->bufs.elem[i], 0)) {
+            PL_TRACE(dp, "UBO ring buffer still in use, reallocating");
+            pl_buf_destroy(dp->gpu, &f->bufs.elem[i]);
+            PL_ARRAY_REMOVE_AT(f->bufs, i);
+        }
+    }
+
+    f->idx = 0;
+    f->offset = 0;
+}
+
+static bool update_pass_ubo(pl_dispatch dp, struct pass *pass)
+{
+    if (!pass->ubo_data)
+        return true;
+
+    // Re-use the previous upload if it's still valid
+    struct pl_desc_binding *db = &pass->run_params.desc_bindings[pass->ubo_index];
+    if (!pass->ubo_dirty && pass->ubo_gen == dp->ubo_gen) {
+        *db = pass->ubo_binding;
+        return true;
+    }
+
+    if (dp->ubo_align && ubo_ring_alloc(dp, pass->ubo_size, &pass->ubo_binding)) {
+        pl_buf buf = pass->ubo_binding.object;
+        memcpy(buf->data + pass->ubo_binding.buf_offset, pass->ubo_data,
+               pass->ubo_size);
+    } else {
+        if (dp->ubo_align) {
+            // Existing ring buffers may still be referenced by other passes,
+            // so leave them alone and just stop allocating new ones
+            PL_WARN(dp, "Failed allocating UBO ring buffer, falling back to "
+                    "per-pass uniform buffers");
+            dp->ubo_align = 0;
+        }
+
+        if (!pass->ubo) {
+            pass->ubo = pl_buf_create(dp->gpu, pl_buf_params(
+                .size = pass->ubo_size,
+                .uniform = true,
+                .host_writable = true,
+            ));
+
+            if (!pass->ubo) {
+                PL_ERR(dp, "Failed creating uniform buffer for dispatch");
+                return false;
+            }
+        }
+
+        pl_buf_write(dp->gpu, pass->ubo, 0, pass->ubo_data, pass->ubo_size);
+        pass->ubo_binding = (struct pl_desc_binding) { .object = pass->ubo };
+    }
+
+    pass->ubo_dirty = false;
+    pass->ubo_gen = dp->ubo_gen;
+    *db = pass->ubo_binding;
+    return true;
+}
+
 static void compute_vertex_attribs(pl_dispatch dp, pl_shader sh,
                                    int width, int height, ident_t *out_scale)
 {
@@ -1110,7 +1799,8 @@ static void translate_compute_shader(pl_dispatch dp, pl_shader sh,
 static void run_pass(pl_dispatch dp, pl_shader sh, struct pass *pass)
 {
     const struct pl_shader_res *res = &sh->res;
-    pl_pass_run(dp->gpu, &pass->run_params);
+    if (!dp->defer)
+        pl_pass_run(dp->gpu, &pass->run_params);
 
     for (uint64_t ts; (ts = pl_timer_query(dp->gpu, pass->timer));) {
         PL_TRACE(dp, "Spent %.3f ms on shader: %s", ts / 1e6, res->description);
@@ -1264,6 +1954,13 @@ bool pl_dispatch_finish(pl_dispatch dp, const struct pl_dispatch_params *params)
     struct pass *pass = finalize_pass(dp, sh, params->target, vert_idx,
                                       params->blend_params, load, NULL, proj);
 
+    if (pass && dp->defer) {
+        // Only report the generated shader, without executing it
+        run_pass(dp, sh, pass);
+        ret = true;
+        goto error;
+    }
+
     // Silently return on failed passes
     if (!pass || !pass->pass)
         goto error;
@@ -1278,6 +1975,8 @@ bool pl_dispatch_finish(pl_dispatch dp, const struct pl_dispatch_params *params)
     rparams->num_var_updates = 0;
     for (int i = 0; i < sh->vars.num; i++)
         update_pass_var(dp, pass, &sh->vars.elem[i], &pass->vars[i]);
+    if (!update_pass_ubo(dp, pass))
+        goto error;
 
     // Update the vertex data
     if (rparams->vertex_data) {
@@ -1374,6 +2073,13 @@ bool pl_dispatch_compute(pl_dispatch dp, const struct pl_dispatch_compute_params
 
     struct pass *pass = finalize_pass(dp, sh, NULL, -1, NULL, false, NULL, NULL);
 
+    if (pass && dp->defer) {
+        // Only report the generated shader, without executing it
+        run_pass(dp, sh, pass);
+        ret = true;
+        goto error;
+    }
+
     // Silently return on failed passes
     if (!pass || !pass->pass)
         goto error;
@@ -1388,6 +2094,8 @@ bool pl_dispatch_compute(pl_dispatch dp, const struct pl_dispatch_compute_params
     rparams->num_var_updates = 0;
     for (int i = 0; i < sh->vars.num; i++)
         update_pass_var(dp, pass, &sh->vars.elem[i], &pass->vars[i]);
+    if (!update_pass_ubo(dp, pass))
+        goto error;
 
     // Update the dispatch size
     int groups = 1;
@@ -1410,7 +2118,9 @@ bool pl_dispatch_compute(pl_dispatch dp, const struct pl_dispatch_compute_params
 
     // Dispatch the actual shader
     rparams->timer = PL_DEF(params->timer, pass->timer);
+    rparams->async_compute = params->async_compute;
     run_pass(dp, sh, pass);
+    rparams->async_compute = false;
 
     ret = true;
     // fall through
@@ -1508,6 +2218,13 @@ bool pl_dispatch_vertex(pl_dispatch dp, const struct pl_dispatch_vertex_params *
     struct pass *pass = finalize_pass(dp, sh, params->target, pos_idx,
                                       params->blend_params, true, params, &proj);
 
+    if (pass && dp->defer) {
+        // Only report the generated shader, without executing it
+        run_pass(dp, sh, pass);
+        ret = true;
+        goto error;
+    }
+
     // Silently return on failed passes
     if (!pass || !pass->pass)
         goto error;
@@ -1522,6 +2239,8 @@ bool pl_dispatch_vertex(pl_dispatch dp, const struct pl_dispatch_vertex_params *
     rparams->num_var_updates = 0;
     for (int i = 0; i < sh->vars.num; i++)
         update_pass_var(dp, pass, &sh->vars.elem[i], &pass->vars[i]);
+    if (!update_pass_ubo(dp, pass))
+        goto error;
 
     // Update the scissors
     rparams->scissors = params->scissors;
@@ -1579,7 +2298,9 @@ void pl_dispatch_reset_frame(pl_dispatch dp)
 
     dp->current_ident = 0;
     dp->current_index++;
+    dp->frame++;
     garbage_collect_passes(dp);
+    ubo_ring_advance(dp);
 
     pl_mutex_unlock(&dp->lock);
 }
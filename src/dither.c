@@ -30,6 +30,9 @@
 #include <math.h>
 
 #include "common.h"
+#include "blue_noise.h"
+#include "blue_noise_tables.h"
+#include "pl_thread.h"
 
 #include <libplacebo/dither.h>
 
@@ -54,122 +57,162 @@ void pl_generate_bayer_matrix(float *data, int size)
     }
 }
 
-#define MAX_SIZEB 8
-#define MAX_SIZE (1 << MAX_SIZEB)
-#define MAX_SIZE2 (MAX_SIZE * MAX_SIZE)
-
-typedef uint_fast32_t index_t;
-
-#define WRAP_SIZE2(k, x) ((index_t)((index_t)(x) & ((k)->size2 - 1)))
-#define XY(k, x, y) ((index_t)(((x) | ((y) << (k)->sizeb))))
+// Blue noise matrices are generated using the void-and-cluster algorithm,
+// see `blue_noise.c`. The common sizes are precomputed at build time, while
+// larger sizes are generated at runtime, split across multiple threads, and
+// cached for the lifetime of the process.
+
+// Minimum number of entries per thread, and maximum number of threads
+#define NOISE_SLICE   (1 << 14)
+#define NOISE_THREADS 8
+
+struct noise_pool {
+    pl_mutex lock;
+    pl_cond wakeup, done;
+    struct blue_noise_work *work; // current iteration, or NULL
+    int num_slices;
+    int next;    // next slice of the current iteration to process
+    int pending; // number of slices still being processed
+    bool quit;
+
+    // Matrix being generated
+    uint16_t *data;
+    int shift;
+    void *scratch;
+};
 
-struct ctx {
-    unsigned int sizeb, size, size2;
-    unsigned int gauss_radius;
-    unsigned int gauss_middle;
-    uint64_t gauss[MAX_SIZE2];
-    index_t randomat[MAX_SIZE2];
-    bool calcmat[MAX_SIZE2];
-    uint64_t gaussmat[MAX_SIZE2];
-    index_t unimat[MAX_SIZE2];
+struct noise_worker {
+    struct noise_pool *pool;
+    int index;
 };
 
-static void makegauss(struct ctx *k, unsigned int sizeb)
+// Processes slices of the current iteration until none are left to take.
+// Must be called with the lock held.
+static void noise_work(struct noise_pool *pool)
 {
-    pl_assert(sizeb >= 1 && sizeb <= MAX_SIZEB);
-
-    k->sizeb = sizeb;
-    k->size = 1 << k->sizeb;
-    k->size2 = k->size * k->size;
-
-    k->gauss_radius = k->size / 2 - 1;
-    k->gauss_middle = XY(k, k->gauss_radius, k->gauss_radius);
-
-    unsigned int gauss_size = k->gauss_radius * 2 + 1;
-    unsigned int gauss_size2 = gauss_size * gauss_size;
-
-    for (index_t c = 0; c < k->size2; c++)
-        k->gauss[c] = 0;
-
-    double sigma = -log(1.5 / (double) UINT64_MAX * gauss_size2) / k->gauss_radius;
-
-    for (index_t gy = 0; gy <= k->gauss_radius; gy++) {
-        for (index_t gx = 0; gx <= gy; gx++) {
-            int cx = (int)gx - k->gauss_radius;
-            int cy = (int)gy - k->gauss_radius;
-            int sq = cx * cx + cy * cy;
-            double e = exp(-sqrt(sq) * sigma);
-            uint64_t v = e / gauss_size2 * (double) UINT64_MAX;
-            k->gauss[XY(k, gx, gy)] =
-                k->gauss[XY(k, gy, gx)] =
-                k->gauss[XY(k, gx, gauss_size - 1 - gy)] =
-                k->gauss[XY(k, gy, gauss_size - 1 - gx)] =
-                k->gauss[XY(k, gauss_size - 1 - gx, gy)] =
-                k->gauss[XY(k, gauss_size - 1 - gy, gx)] =
-                k->gauss[XY(k, gauss_size - 1 - gx, gauss_size - 1 - gy)] =
-                k->gauss[XY(k, gauss_size - 1 - gy, gauss_size - 1 - gx)] = v;
-        }
+    while (pool->work && pool->next < pool->num_slices) {
+        struct blue_noise_work *work = pool->work;
+        int slice = pool->next++;
+        pl_mutex_unlock(&pool->lock);
+        blue_noise_slice(work, slice);
+        pl_mutex_lock(&pool->lock);
+        if (--pool->pending == 0)
+            pl_cond_signal(&pool->done);
     }
-
-#ifndef NDEBUG
-    uint64_t total = 0;
-    for (index_t c = 0; c < k->size2; c++) {
-        uint64_t oldtotal = total;
-        total += k->gauss[c];
-        assert(total >= oldtotal);
-    }
-#endif
 }
 
-static void setbit(struct ctx *k, index_t c)
+static void noise_run(void *priv, struct blue_noise_work *work, int num_slices)
 {
-    if (k->calcmat[c])
-        return;
-    k->calcmat[c] = true;
-    uint64_t *m = k->gaussmat;
-    uint64_t *me = k->gaussmat + k->size2;
-    uint64_t *g = k->gauss + WRAP_SIZE2(k, k->gauss_middle + k->size2 - c);
-    uint64_t *ge = k->gauss + k->size2;
-    while (g < ge)
-        *m++ += *g++;
-    g = k->gauss;
-    while (m < me)
-        *m++ += *g++;
+    struct noise_pool *pool = priv;
+    pl_mutex_lock(&pool->lock);
+    pool->work = work;
+    pool->num_slices = num_slices;
+    pool->next = 0;
+    pool->pending = num_slices;
+    pl_cond_broadcast(&pool->wakeup);
+
+    // The calling thread takes slices as well, so this completes even if some
+    // of the worker threads failed to spawn
+    noise_work(pool);
+    while (pool->pending)
+        pl_cond_wait(&pool->done, &pool->lock);
+    pool->work = NULL;
+    pl_mutex_unlock(&pool->lock);
 }
 
-static index_t getmin(struct ctx *k)
+static PL_THREAD_VOID noise_thread(void *arg)
 {
-    uint64_t min = UINT64_MAX;
-    index_t resnum = 0;
-    unsigned int size2 = k->size2;
-    for (index_t c = 0; c < size2; c++) {
-        if (k->calcmat[c])
-            continue;
-        uint64_t total = k->gaussmat[c];
-        if (total <= min) {
-            if (total != min) {
-                min = total;
-                resnum = 0;
-            }
-            k->randomat[resnum++] = c;
-        }
+    struct noise_worker *worker = arg;
+    struct noise_pool *pool = worker->pool;
+
+    if (worker->index == 0) {
+        // Drives the generation, handing out the iterations to the others
+        blue_noise_generate(pool->data, pool->shift, pool->num_slices,
+                            noise_run, pool, pool->scratch);
+        pl_mutex_lock(&pool->lock);
+        pool->quit = true;
+        pl_cond_broadcast(&pool->wakeup);
+        pl_mutex_unlock(&pool->lock);
+        PL_THREAD_RETURN();
     }
-    assert(resnum > 0);
-    if (resnum == 1)
-        return k->randomat[0];
-    if (resnum == size2)
-        return size2 / 2;
-    return k->randomat[rand() % resnum];
+
+    pl_mutex_lock(&pool->lock);
+    while (!pool->quit) {
+        noise_work(pool);
+        if (!pool->quit)
+            pl_cond_wait(&pool->wakeup, &pool->lock);
+    }
+    pl_mutex_unlock(&pool->lock);
+    PL_THREAD_RETURN();
 }
 
-static void makeuniform(struct ctx *k)
+static void generate_threaded(uint16_t *data, int shift)
 {
-    unsigned int size2 = k->size2;
-    for (index_t c = 0; c < size2; c++) {
-        index_t r = getmin(k);
-        setbit(k, r);
-        k->unimat[r] = c;
+    int num_slices = PL_CLAMP((1 << 2 * shift) / NOISE_SLICE, 1, NOISE_THREADS);
+    void *scratch = pl_alloc(NULL, blue_noise_scratch_size(shift, num_slices));
+    if (num_slices == 1) {
+        blue_noise_generate(data, shift, 1, NULL, NULL, scratch);
+        pl_free(scratch);
+        return;
     }
+
+    struct noise_pool pool = {
+        .num_slices = num_slices,
+        .data       = data,
+        .shift      = shift,
+        .scratch    = scratch,
+    };
+
+    pl_mutex_init(&pool.lock);
+    pl_cond_init(&pool.wakeup);
+    pl_cond_init(&pool.done);
+
+    struct noise_worker workers[NOISE_THREADS];
+    for (int i = 0; i < num_slices; i++)
+        workers[i] = (struct noise_worker) { &pool, i };
+    pl_thread_fan_out(noise_thread, workers, sizeof(workers[0]), num_slices);
+
+    pl_cond_destroy(&pool.wakeup);
+    pl_cond_destroy(&pool.done);
+    pl_mutex_destroy(&pool.lock);
+    pl_free(scratch);
+}
+
+// Matrices generated at runtime are kept around for the lifetime of the
+// process, same as the precomputed tables. They are deliberately never freed,
+// since there is no point at which they are known to be unused.
+static pl_static_mutex noise_lock = PL_STATIC_MUTEX_INITIALIZER;
+static pl_static_cond noise_done = PL_STATIC_COND_INITIALIZER;
+static uint16_t *noise_cache[BLUE_NOISE_MAX_SHIFT + 1];
+static bool noise_generating[BLUE_NOISE_MAX_SHIFT + 1];
+
+static const uint16_t *get_blue_noise(int shift)
+{
+    if (shift <= BLUE_NOISE_TABLE_SHIFT)
+        return blue_noise_tables[shift];
+
+    pl_static_mutex_lock(&noise_lock);
+    while (!noise_cache[shift] && noise_generating[shift])
+        pl_static_cond_wait(&noise_done, &noise_lock);
+    const uint16_t *data = noise_cache[shift];
+    if (!data)
+        noise_generating[shift] = true;
+    pl_static_mutex_unlock(&noise_lock);
+    if (data)
+        return data;
+
+    // Generate without holding the lock, so requests for other sizes are not
+    // stalled behind this one. Requests for the same size wait for us instead
+    // of generating their own copy.
+    uint16_t *noise = pl_alloc(NULL, sizeof(uint16_t) << 2 * shift);
+    generate_threaded(noise, shift);
+
+    pl_static_mutex_lock(&noise_lock);
+    noise_cache[shift] = noise;
+    noise_generating[shift] = false;
+    pl_static_cond_broadcast(&noise_done);
+    pl_static_mutex_unlock(&noise_lock);
+    return noise;
 }
 
 void pl_generate_blue_noise(float *data, int size)
@@ -178,15 +221,11 @@ void pl_generate_blue_noise(float *data, int size)
     int shift = PL_LOG2(size);
 
     pl_assert((1 << shift) == size);
-    struct ctx *k = pl_zalloc_ptr(NULL, k);
-    makegauss(k, shift);
-    makeuniform(k);
-    float invscale = k->size2;
-    for(index_t y = 0; y < k->size; y++) {
-        for(index_t x = 0; x < k->size; x++)
-            data[x + y * k->size] = k->unimat[XY(k, x, y)] / invscale;
-    }
-    pl_free(k);
+    pl_assert(shift <= BLUE_NOISE_MAX_SHIFT);
+    const uint16_t *noise = get_blue_noise(shift);
+    const float scale = 1.0f / (size * size);
+    for (int i = 0; i < size * size; i++)
+        data[i] = noise[i] * scale;
 }
 
 const struct pl_error_diffusion_kernel pl_error_diffusion_simple = {
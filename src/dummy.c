@@ -132,6 +132,7 @@ void pl_gpu_dummy_destroy(pl_gpu *gpu)
 
 struct buf_priv {
     uint8_t *data;
+    atomic_bool busy;
 };
 
 static pl_buf dumb_buf_create(pl_gpu gpu, const struct pl_buf_params *params)
@@ -169,6 +170,20 @@ uint8_t *pl_buf_dummy_data(pl_buf buf)
     return p->data;
 }
 
+void pl_buf_dummy_set_busy(pl_buf buf, bool busy)
+{
+    struct buf_priv *p = PL_PRIV(buf);
+    atomic_store(&p->busy, busy);
+}
+
+static bool dumb_buf_poll(pl_gpu gpu, pl_buf buf, uint64_t timeout)
+{
+    struct buf_priv *p = PL_PRIV(buf);
+    if (timeout)
+        atomic_store(&p->busy, false); // waiting "finishes" the GPU work
+    return atomic_load(&p->busy);
+}
+
 static void dumb_buf_write(pl_gpu gpu, pl_buf buf, size_t buf_offset,
                            const void *data, size_t size)
 {
@@ -338,6 +353,7 @@ static const struct pl_gpu_fns pl_fns_dummy = {
     .buf_write = dumb_buf_write,
     .buf_read = dumb_buf_read,
     .buf_copy = dumb_buf_copy,
+    .buf_poll = dumb_buf_poll,
     .tex_create = dumb_tex_create,
     .tex_destroy = dumb_tex_destroy,
     .tex_upload = dumb_tex_upload,
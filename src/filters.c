@@ -40,6 +40,7 @@
 #include "common.h"
 #include "filters.h"
 #include "log.h"
+#include "pl_thread.h"
 
 bool pl_filter_function_eq(const struct pl_filter_function *a,
                            const struct pl_filter_function *b)
@@ -101,54 +102,103 @@ double pl_filter_sample(const struct pl_filter_config *c, double x)
     return k < 0 ? (1 - c->clamp) * k : k;
 }
 
+static void sample_batch(const struct pl_filter_config *c, const double *x,
+                         double *out, int n);
+
 // Compute a single row of weights for a given filter in one dimension, indexed
 // by the indicated subpixel offset. Writes `f->row_size` values to `out`.
-static void compute_row(struct pl_filter_t *f, double offset, float *out)
+// `tmp` must have room for `2 * f->row_size` values.
+static void compute_row(struct pl_filter_t *f, double offset, float *out,
+                        double *tmp)
 {
-    double wsum = 0.0;
+    // For the example of a filter with row size 4 and offset 0.3, we have:
+    //
+    // 0    1 *  2    3
+    //
+    // * indicates the sampled position. What we want to compute is the
+    // distance from each index to that sampled position.
+    pl_assert(f->row_size % 2 == 0);
+    const int base = f->row_size / 2 - 1; // index to the left of the center
+    const double center = base + offset; // offset of center relative to idx 0
+    const double stretch = f->params.config.kernel->radius / f->radius;
+
+    double *x = tmp, *w = tmp + f->row_size;
     for (int i = 0; i < f->row_size; i++) {
-        // For the example of a filter with row size 4 and offset 0.3, we have:
-        //
-        // 0    1 *  2    3
-        //
-        // * indicates the sampled position. What we want to compute is the
-        // distance from each index to that sampled position.
-        pl_assert(f->row_size % 2 == 0);
-        const int base = f->row_size / 2 - 1; // index to the left of the center
-        const double center = base + offset; // offset of center relative to idx 0
-        double x = i - center;
-
         // Stretch/squish the kernel by readjusting the value range
-        x *= f->params.config.kernel->radius / f->radius;
-        double w = pl_filter_sample(&f->params.config, x);
-        out[i] = w;
-        wsum += w;
+        x[i] = (i - center) * stretch;
     }
 
+    sample_batch(&f->params.config, x, w, f->row_size);
+
+    double wsum = 0.0;
+    for (int i = 0; i < f->row_size; i++)
+        wsum += w[i];
+
     // Readjust weights to preserve energy
     pl_assert(wsum > 0);
     for (int i = 0; i < f->row_size; i++)
-        out[i] /= wsum;
+        out[i] = w[i] / wsum;
 }
 
 static struct pl_filter_function *dupfilter(void *alloc,
                                             const struct pl_filter_function *f)
 {
-    return f ? pl_memdup(alloc, (void *)f, sizeof(*f)) : NULL;
+    if (!f)
+        return NULL;
+
+    // Also copy the name, since cached filters may outlive the caller's copy
+    struct pl_filter_function *ret = pl_memdup(alloc, (void *)f, sizeof(*f));
+    if (f->name)
+        ret->name = pl_strdup0(alloc, pl_str0(f->name));
+    return ret;
 }
 
-pl_filter pl_filter_generate(pl_log log, const struct pl_filter_params *params)
+// Generated filters are cached process-wide and shared between all users
+// requesting the same parameters, since they are immutable once generated.
+struct filter_entry {
+    struct pl_filter_t filter; // must be the first member
+    int refcount;
+};
+
+static pl_static_mutex cache_lock = PL_STATIC_MUTEX_INITIALIZER;
+static PL_ARRAY(struct filter_entry *) cache_entries;
+static struct pl_filter_cache_stats cache_stats;
+
+static bool filter_params_eq(const struct pl_filter_params *a,
+                             const struct pl_filter_params *b)
 {
-    pl_assert(params);
-    if (params->lut_entries <= 0 || !params->config.kernel) {
-        pl_fatal(log, "Invalid params: missing lut_entries or config.kernel");
-        return NULL;
+    return pl_filter_config_eq(&a->config, &b->config) &&
+           a->lut_entries       == b->lut_entries &&
+           a->filter_scale      == b->filter_scale &&
+           a->cutoff            == b->cutoff &&
+           a->max_row_size      == b->max_row_size &&
+           a->row_stride_align  == b->row_stride_align;
+}
+
+// Must be called with `cache_lock` held
+static struct filter_entry *cache_find(const struct pl_filter_params *params)
+{
+    for (int i = 0; i < cache_entries.num; i++) {
+        struct filter_entry *e = cache_entries.elem[i];
+        if (filter_params_eq(&e->filter.params, params)) {
+            e->refcount++;
+            cache_stats.hits++;
+            return e;
+        }
     }
 
-    struct pl_filter_t *f = pl_zalloc_ptr(NULL, f);
+    return NULL;
+}
+
+static struct filter_entry *filter_compute(const struct pl_filter_params *params)
+{
+    struct filter_entry *e = pl_zalloc_ptr(NULL, e);
+    struct pl_filter_t *f = &e->filter;
     f->params = *params;
-    f->params.config.kernel = dupfilter(f, params->config.kernel);
-    f->params.config.window = dupfilter(f, params->config.window);
+    f->params.config.kernel = dupfilter(e, params->config.kernel);
+    f->params.config.window = dupfilter(e, params->config.window);
+    if (params->config.name)
+        f->params.config.name = pl_strdup0(e, pl_str0(params->config.name));
 
     // Compute the required filter radius
     float radius = f->params.config.kernel->radius;
@@ -159,41 +209,114 @@ pl_filter pl_filter_generate(pl_log log, const struct pl_filter_params *params)
     float *weights;
     if (params->config.polar) {
         // Compute a 1D array indexed by radius
-        weights = pl_alloc(f, params->lut_entries * sizeof(float));
+        weights = pl_alloc(e, params->lut_entries * sizeof(float));
+        double *x = pl_calloc(NULL, 2 * params->lut_entries, sizeof(double));
+        double *w = x + params->lut_entries;
+        for (int i = 0; i < params->lut_entries; i++)
+            x[i] = radius * i / (params->lut_entries - 1);
+        sample_batch(&f->params.config, x, w, params->lut_entries);
+
         f->radius_cutoff = 0.0;
         for (int i = 0; i < params->lut_entries; i++) {
-            double x = radius * i / (params->lut_entries - 1);
-            weights[i] = pl_filter_sample(&f->params.config, x);
+            weights[i] = w[i];
             if (fabs(weights[i]) > params->cutoff)
-                f->radius_cutoff = x;
+                f->radius_cutoff = x[i];
         }
+        pl_free(x);
     } else {
         // Pick the most appropriate row size
         f->row_size = ceil(f->radius) * 2;
         if (params->max_row_size && f->row_size > params->max_row_size) {
-            pl_info(log, "Required filter size %d exceeds the maximum allowed "
-                    "size of %d. This may result in adverse effects (aliasing, "
-                    "or moiré artifacts).", f->row_size, params->max_row_size);
             f->row_size = params->max_row_size;
             f->insufficient = true;
         }
         f->row_stride = PL_ALIGN(f->row_size, params->row_stride_align);
 
         // Compute a 2D array indexed by the subpixel position
-        weights = pl_calloc(f, params->lut_entries * f->row_stride, sizeof(float));
+        weights = pl_calloc(e, params->lut_entries * f->row_stride, sizeof(float));
+        double *tmp = pl_calloc(NULL, 2 * f->row_size, sizeof(double));
         for (int i = 0; i < params->lut_entries; i++) {
             compute_row(f, i / (double)(params->lut_entries - 1),
-                        weights + f->row_stride * i);
+                        weights + f->row_stride * i, tmp);
         }
+        pl_free(tmp);
     }
 
     f->weights = weights;
+    e->refcount = 1;
+    return e;
+}
+
+pl_filter pl_filter_generate(pl_log log, const struct pl_filter_params *params)
+{
+    pl_assert(params);
+    if (params->lut_entries <= 0 || !params->config.kernel) {
+        pl_fatal(log, "Invalid params: missing lut_entries or config.kernel");
+        return NULL;
+    }
+
+    pl_static_mutex_lock(&cache_lock);
+    struct filter_entry *e = cache_find(params);
+    pl_static_mutex_unlock(&cache_lock);
+
+    if (!e) {
+        // Compute the filter without holding the lock, and only insert it
+        // afterwards, unless another thread beat us to it in the meantime
+        struct filter_entry *new = filter_compute(params);
+        pl_static_mutex_lock(&cache_lock);
+        e = cache_find(params);
+        if (e) {
+            pl_free(new);
+        } else {
+            PL_ARRAY_APPEND(NULL, cache_entries, new);
+            cache_stats.misses++;
+            e = new;
+        }
+        pl_static_mutex_unlock(&cache_lock);
+    }
+
+    pl_filter f = &e->filter;
+    if (f->insufficient) {
+        pl_info(log, "Required filter size %d exceeds the maximum allowed "
+                "size of %d. This may result in adverse effects (aliasing, "
+                "or moiré artifacts).", (int) ceil(f->radius) * 2,
+                params->max_row_size);
+    }
+
     return f;
 }
 
 void pl_filter_free(pl_filter *filter)
 {
-    pl_free_ptr((void **) filter);
+    if (!*filter)
+        return;
+
+    struct filter_entry *e = (struct filter_entry *) *filter;
+    pl_static_mutex_lock(&cache_lock);
+    pl_assert(e->refcount > 0);
+    if (--e->refcount == 0) {
+        for (int i = 0; i < cache_entries.num; i++) {
+            if (cache_entries.elem[i] == e) {
+                PL_ARRAY_REMOVE_AT(cache_entries, i);
+                break;
+            }
+        }
+
+        if (!cache_entries.num)
+            pl_free_ptr(&cache_entries.elem); // avoid leak checker noise
+        pl_free(e);
+    }
+    pl_static_mutex_unlock(&cache_lock);
+    *filter = NULL;
+}
+
+struct pl_filter_cache_stats pl_filter_cache_stats(void)
+{
+    pl_static_mutex_lock(&cache_lock);
+    struct pl_filter_cache_stats stats = cache_stats;
+    stats.entries = cache_entries.num;
+    pl_static_mutex_unlock(&cache_lock);
+    return stats;
 }
 
 const struct pl_filter_function_preset *pl_find_filter_function_preset(const char *name)
@@ -305,12 +428,37 @@ static double bessel_i0(double x)
     return s;
 }
 
+// Polynomial approximation of bessel_i0, from Abramowitz & Stegun 9.8.1 and
+// 9.8.2. The relative error is bounded by 1.9e-7, which is below the
+// precision of the (single precision) LUTs generated from it.
+static inline double bessel_i0_approx(double x)
+{
+    x = fabs(x);
+    if (x < 3.75) {
+        double y = PL_SQUARE(x / 3.75);
+        return 1.0 + y * (3.5156229 + y * (3.0899424 + y * (1.2067492 +
+                     y * (0.2659732 + y * (0.0360768 + y * 0.0045813)))));
+    }
+
+    double y = 3.75 / x;
+    return exp(x) / sqrt(x) *
+           (0.39894228 + y * (0.01328592 + y * (0.00225319 + y * (-0.00157565 +
+            y * (0.00916281 + y * (-0.02057706 + y * (0.02635537 +
+            y * (-0.01647633 + y * 0.00392377))))))));
+}
+
 static double kaiser(const struct pl_filter_function *f, double x)
 {
     double alpha = fmax(f->params[0], 0.0);
     return bessel_i0(alpha * sqrt(1.0 - x * x)) / alpha;
 }
 
+static inline double kaiser_approx(const struct pl_filter_function *f, double x)
+{
+    double alpha = fmax(f->params[0], 0.0);
+    return bessel_i0_approx(alpha * sqrt(1.0 - x * x)) / alpha;
+}
+
 const struct pl_filter_function pl_filter_function_kaiser = {
     .tunable = {true},
     .weight  = kaiser,
@@ -399,6 +547,31 @@ static double jinc(const struct pl_filter_function *f, double x)
     return 2.0 * j1(x) / x;
 }
 
+// Rational approximation of jinc, based on Hart's approximation of the bessel
+// function J1 (as also found in Numerical Recipes). The absolute error is
+// bounded by 1e-8. For small arguments, the division by `x` cancels out
+// exactly, so this also avoids the special case around 0.
+static inline double jinc_approx(const struct pl_filter_function *f, double x)
+{
+    x = fabs(x) * M_PI;
+    if (x < 8.0) {
+        double y = x * x;
+        double p = 72362614232.0 + y * (-7895059235.0 + y * (242396853.1 +
+                   y * (-2972611.439 + y * (15704.48260 + y * -30.16036606))));
+        double q = 144725228442.0 + y * (2300535178.0 + y * (18583304.74 +
+                   y * (99447.43394 + y * (376.9991397 + y))));
+        return 2.0 * p / q;
+    }
+
+    double z = 8.0 / x, y = z * z, xx = x - 0.75 * M_PI;
+    double p = 1.0 + y * (0.183105e-2 + y * (-0.3516396496e-4 +
+               y * (0.2457520174e-5 + y * -0.240337019e-6)));
+    double q = 0.04687499995 + y * (-0.2002690873e-3 + y * (0.8449199096e-5 +
+               y * (-0.88228987e-6 + y * 0.105787412e-6)));
+    double j1 = sqrt(M_2_PI / x) * (cos(xx) * p - z * sin(xx) * q);
+    return 2.0 * j1 / x;
+}
+
 const struct pl_filter_function pl_filter_function_jinc = {
     .resizable = true,
     .weight    = jinc,
@@ -549,6 +722,125 @@ const struct pl_filter_function pl_filter_function_spline64 = {
     .radius = 4.0,
 };
 
+// Batched versions of the weight functions, evaluating `n` samples at once.
+// These are simple loops over the (inlined) scalar code, which allows the
+// compiler to vectorize them where possible. For `jinc` and `kaiser`, these
+// use polynomial approximations instead of the exact bessel functions.
+typedef void (*weight_batch_fn)(const struct pl_filter_function *f,
+                                const double *x, double *out, int n);
+
+#define BATCH_FN(name, fn)                                                      \
+    static void name##_batch(const struct pl_filter_function *f,                \
+                             const double *x, double *out, int n)               \
+    {                                                                           \
+        for (int i = 0; i < n; i++)                                             \
+            out[i] = fn(f, x[i]);                                               \
+    }
+
+BATCH_FN(box,       box)
+BATCH_FN(triangle,  triangle)
+BATCH_FN(cosine,    cosine)
+BATCH_FN(hann,      hann)
+BATCH_FN(hamming,   hamming)
+BATCH_FN(welch,     welch)
+BATCH_FN(kaiser,    kaiser_approx)
+BATCH_FN(blackman,  blackman)
+BATCH_FN(bohman,    bohman)
+BATCH_FN(gaussian,  gaussian)
+BATCH_FN(quadratic, quadratic)
+BATCH_FN(sinc,      sinc)
+BATCH_FN(jinc,      jinc_approx)
+BATCH_FN(sphinx,    sphinx)
+BATCH_FN(bcspline,  bcspline)
+BATCH_FN(bicubic,   bicubic)
+BATCH_FN(spline16,  spline16)
+BATCH_FN(spline36,  spline36)
+BATCH_FN(spline64,  spline64)
+#undef BATCH_FN
+
+static const struct {
+    double (*weight)(const struct pl_filter_function *f, double x);
+    weight_batch_fn batch;
+} batch_fns[] = {
+    { box,          box_batch },
+    { triangle,     triangle_batch },
+    { cosine,       cosine_batch },
+    { hann,         hann_batch },
+    { hamming,      hamming_batch },
+    { welch,        welch_batch },
+    { kaiser,       kaiser_batch },
+    { blackman,     blackman_batch },
+    { bohman,       bohman_batch },
+    { gaussian,     gaussian_batch },
+    { quadratic,    quadratic_batch },
+    { sinc,         sinc_batch },
+    { jinc,         jinc_batch },
+    { sphinx,       sphinx_batch },
+    { bcspline,     bcspline_batch },
+    { bicubic,      bicubic_batch },
+    { spline16,     spline16_batch },
+    { spline36,     spline36_batch },
+    { spline64,     spline64_batch },
+};
+
+static void weight_batch(const struct pl_filter_function *f, const double *x,
+                         double *out, int n)
+{
+    for (int i = 0; i < PL_ARRAY_SIZE(batch_fns); i++) {
+        if (batch_fns[i].weight == f->weight) {
+            batch_fns[i].batch(f, x, out, n);
+            return;
+        }
+    }
+
+    // User-provided weight function, fall back to the scalar version
+    for (int i = 0; i < n; i++)
+        out[i] = f->weight(f, x[i]);
+}
+
+#define BATCH_SIZE 256
+
+// Batched equivalent of `pl_filter_sample`
+static void sample_batch(const struct pl_filter_config *c, const double *x,
+                         double *out, int n)
+{
+    const struct pl_filter_function *kernel = c->kernel, *window = c->window;
+    const double radius = kernel->radius;
+    double kx[BATCH_SIZE], wx[BATCH_SIZE], w[BATCH_SIZE];
+
+    for (int base = 0; base < n; base += BATCH_SIZE) {
+        const int num = PL_MIN(n - base, BATCH_SIZE);
+        const double *xb = x + base;
+        double *outb = out + base;
+
+        // Apply the blur and taper coefficients as needed. Values outside of
+        // the kernel radius are clamped here and discarded below, since the
+        // kernel functions are not necessarily valid outside of this interval.
+        for (int i = 0; i < num; i++) {
+            double ax = fabs(xb[i]);
+            double k = c->blur > 0.0 ? ax / c->blur : ax;
+            k = k <= c->taper ? 0.0 : (k - c->taper) / (1.0 - c->taper / radius);
+            kx[i] = k;
+            wx[i] = window ? ax / radius * window->radius : 0.0;
+        }
+
+        for (int i = 0; i < num; i++)
+            w[i] = fmin(kx[i], radius);
+        weight_batch(kernel, w, outb, num);
+
+        if (window) {
+            weight_batch(window, wx, w, num);
+            for (int i = 0; i < num; i++)
+                outb[i] *= w[i];
+        }
+
+        for (int i = 0; i < num; i++) {
+            double k = kx[i] > radius ? 0.0 : outb[i];
+            outb[i] = k < 0 ? (1 - c->clamp) * k : k;
+        }
+    }
+}
+
 // Named filter functions
 const struct pl_filter_function_preset pl_filter_function_presets[] = {
     {"none",            NULL},
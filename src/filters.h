@@ -19,6 +19,16 @@
 
 #include <libplacebo/filters.h>
 
+// Statistics about the process-wide cache of generated filters, which is
+// shared by all callers of `pl_filter_generate`.
+struct pl_filter_cache_stats {
+    uint64_t hits;      // number of filters returned from the cache
+    uint64_t misses;    // number of filters actually computed
+    int entries;        // number of distinct filters currently alive
+};
+
+struct pl_filter_cache_stats pl_filter_cache_stats(void);
+
 #define COMMON_FILTER_PRESETS                                                   \
     /* Highest priority / recommended filters */                                \
     {"bilinear",            &pl_filter_bilinear,    "Bilinear"},                \
@@ -24,7 +24,7 @@ static int ccStrPrintInt32( char *str, int32_t n );
 static int ccStrPrintUint32( char *str, uint32_t n );
 static int ccStrPrintInt64( char *str, int64_t n );
 static int ccStrPrintUint64( char *str, uint64_t n );
-static int ccStrPrintDouble( char *str, int bufsize, int decimals, double value );
+static int print_double(char *buf, double value);
 static int ccSeqParseInt64( char *seq, int seqlength, int64_t *retint );
 static int ccSeqParseUint64( char *seq, int seqlength, uint64_t *retint );
 static int ccSeqParseDouble( char *seq, int seqlength, double *retdouble );
@@ -100,7 +100,7 @@ void pl_str_append_vasprintf_c(void *alloc, pl_str *str, const char *fmt,
             c++;
             break;
         case 'f':
-            len = ccStrPrintDouble(buf, sizeof(buf), 20, va_arg(ap, double));
+            len = print_double(buf, va_arg(ap, double));
             break;
         default:
             fprintf(stderr, "Invalid conversion character: '%c'!\n", c[0]);
@@ -199,7 +199,7 @@ size_t pl_str_append_memprintf_c(void *alloc, pl_str *str, const char *fmt,
         case 'f': ;
             double f;
             LOAD(f);
-            len = ccStrPrintDouble(buf, sizeof(buf), 20, f);
+            len = print_double(buf, f);
             break;
         default:
             fprintf(stderr, "Invalid conversion character: '%c'!\n", c[0]);
@@ -251,6 +251,344 @@ static int print_hex(char *buf, unsigned int x)
     pl_unreachable();
 }
 
+/*
+ * Shortest round-trip formatting of floating point numbers, based on the
+ * Grisu2 algorithm from Florian Loitsch, "Printing Floating-Point Numbers
+ * Quickly and Accurately with Integers" (PLDI 2010).
+ *
+ * Values which are exactly representable in single precision are printed
+ * with the shortest digits that round-trip as a `float`, since this is the
+ * precision the shader compiler will be parsing them at. Everything else
+ * round-trips as a `double`. Grisu2 always produces a correctly round-tripping
+ * result, which is the shortest possible in all but a handful of cases.
+ */
+
+struct diyfp {
+    uint64_t f;
+    int e;
+};
+
+static inline struct diyfp diyfp_normalize(struct diyfp x)
+{
+    const int shift = __builtin_clzll(x.f);
+    return (struct diyfp) { x.f << shift, x.e - shift };
+}
+
+// Multiplication with rounding, keeping the upper 64 bits of the result
+static inline struct diyfp diyfp_mul(struct diyfp x, struct diyfp y)
+{
+    const uint64_t a = x.f >> 32, b = x.f & 0xFFFFFFFF;
+    const uint64_t c = y.f >> 32, d = y.f & 0xFFFFFFFF;
+    const uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t mid = (bd >> 32) + (ad & 0xFFFFFFFF) + (bc & 0xFFFFFFFF);
+    mid += 1U << 31; // round
+    return (struct diyfp) {
+        .f = ac + (ad >> 32) + (bc >> 32) + (mid >> 32),
+        .e = x.e + y.e + 64,
+    };
+}
+
+// Normalized approximations of 10^k for k = -348, -340, ..., 340
+static const struct diyfp cached_pow10[] = {
+    { 0xfa8fd5a0081c0288, -1220 }, // 1e-348
+    { 0xbaaee17fa23ebf76, -1193 }, // 1e-340
+    { 0x8b16fb203055ac76, -1166 }, // 1e-332
+    { 0xcf42894a5dce35ea, -1140 }, // 1e-324
+    { 0x9a6bb0aa55653b2d, -1113 }, // 1e-316
+    { 0xe61acf033d1a45df, -1087 }, // 1e-308
+    { 0xab70fe17c79ac6ca, -1060 }, // 1e-300
+    { 0xff77b1fcbebcdc4f, -1034 }, // 1e-292
+    { 0xbe5691ef416bd60c, -1007 }, // 1e-284
+    { 0x8dd01fad907ffc3c,  -980 }, // 1e-276
+    { 0xd3515c2831559a83,  -954 }, // 1e-268
+    { 0x9d71ac8fada6c9b5,  -927 }, // 1e-260
+    { 0xea9c227723ee8bcb,  -901 }, // 1e-252
+    { 0xaecc49914078536d,  -874 }, // 1e-244
+    { 0x823c12795db6ce57,  -847 }, // 1e-236
+    { 0xc21094364dfb5637,  -821 }, // 1e-228
+    { 0x9096ea6f3848984f,  -794 }, // 1e-220
+    { 0xd77485cb25823ac7,  -768 }, // 1e-212
+    { 0xa086cfcd97bf97f4,  -741 }, // 1e-204
+    { 0xef340a98172aace5,  -715 }, // 1e-196
+    { 0xb23867fb2a35b28e,  -688 }, // 1e-188
+    { 0x84c8d4dfd2c63f3b,  -661 }, // 1e-180
+    { 0xc5dd44271ad3cdba,  -635 }, // 1e-172
+    { 0x936b9fcebb25c996,  -608 }, // 1e-164
+    { 0xdbac6c247d62a584,  -582 }, // 1e-156
+    { 0xa3ab66580d5fdaf6,  -555 }, // 1e-148
+    { 0xf3e2f893dec3f126,  -529 }, // 1e-140
+    { 0xb5b5ada8aaff80b8,  -502 }, // 1e-132
+    { 0x87625f056c7c4a8b,  -475 }, // 1e-124
+    { 0xc9bcff6034c13053,  -449 }, // 1e-116
+    { 0x964e858c91ba2655,  -422 }, // 1e-108
+    { 0xdff9772470297ebd,  -396 }, // 1e-100
+    { 0xa6dfbd9fb8e5b88f,  -369 }, // 1e-92
+    { 0xf8a95fcf88747d94,  -343 }, // 1e-84
+    { 0xb94470938fa89bcf,  -316 }, // 1e-76
+    { 0x8a08f0f8bf0f156b,  -289 }, // 1e-68
+    { 0xcdb02555653131b6,  -263 }, // 1e-60
+    { 0x993fe2c6d07b7fac,  -236 }, // 1e-52
+    { 0xe45c10c42a2b3b06,  -210 }, // 1e-44
+    { 0xaa242499697392d3,  -183 }, // 1e-36
+    { 0xfd87b5f28300ca0e,  -157 }, // 1e-28
+    { 0xbce5086492111aeb,  -130 }, // 1e-20
+    { 0x8cbccc096f5088cc,  -103 }, // 1e-12
+    { 0xd1b71758e219652c,   -77 }, // 1e-4
+    { 0x9c40000000000000,   -50 }, // 1e4
+    { 0xe8d4a51000000000,   -24 }, // 1e12
+    { 0xad78ebc5ac620000,     3 }, // 1e20
+    { 0x813f3978f8940984,    30 }, // 1e28
+    { 0xc097ce7bc90715b3,    56 }, // 1e36
+    { 0x8f7e32ce7bea5c70,    83 }, // 1e44
+    { 0xd5d238a4abe98068,   109 }, // 1e52
+    { 0x9f4f2726179a2245,   136 }, // 1e60
+    { 0xed63a231d4c4fb27,   162 }, // 1e68
+    { 0xb0de65388cc8ada8,   189 }, // 1e76
+    { 0x83c7088e1aab65db,   216 }, // 1e84
+    { 0xc45d1df942711d9a,   242 }, // 1e92
+    { 0x924d692ca61be758,   269 }, // 1e100
+    { 0xda01ee641a708dea,   295 }, // 1e108
+    { 0xa26da3999aef774a,   322 }, // 1e116
+    { 0xf209787bb47d6b85,   348 }, // 1e124
+    { 0xb454e4a179dd1877,   375 }, // 1e132
+    { 0x865b86925b9bc5c2,   402 }, // 1e140
+    { 0xc83553c5c8965d3d,   428 }, // 1e148
+    { 0x952ab45cfa97a0b3,   455 }, // 1e156
+    { 0xde469fbd99a05fe3,   481 }, // 1e164
+    { 0xa59bc234db398c25,   508 }, // 1e172
+    { 0xf6c69a72a3989f5c,   534 }, // 1e180
+    { 0xb7dcbf5354e9bece,   561 }, // 1e188
+    { 0x88fcf317f22241e2,   588 }, // 1e196
+    { 0xcc20ce9bd35c78a5,   614 }, // 1e204
+    { 0x98165af37b2153df,   641 }, // 1e212
+    { 0xe2a0b5dc971f303a,   667 }, // 1e220
+    { 0xa8d9d1535ce3b396,   694 }, // 1e228
+    { 0xfb9b7cd9a4a7443c,   720 }, // 1e236
+    { 0xbb764c4ca7a44410,   747 }, // 1e244
+    { 0x8bab8eefb6409c1a,   774 }, // 1e252
+    { 0xd01fef10a657842c,   800 }, // 1e260
+    { 0x9b10a4e5e9913129,   827 }, // 1e268
+    { 0xe7109bfba19c0c9d,   853 }, // 1e276
+    { 0xac2820d9623bf429,   880 }, // 1e284
+    { 0x80444b5e7aa7cf85,   907 }, // 1e292
+    { 0xbf21e44003acdd2d,   933 }, // 1e300
+    { 0x8e679c2f5e44ff8f,   960 }, // 1e308
+    { 0xd433179d9c8cb841,   986 }, // 1e316
+    { 0x9e19db92b4e31ba9,  1013 }, // 1e324
+    { 0xeb96bf6ebadf77d9,  1039 }, // 1e332
+    { 0xaf87023b9bf0ee6b,  1066 }, // 1e340
+};
+
+static inline struct diyfp cached_power(int e, int *K)
+{
+    // Pick the power such that the product's exponent falls into [-60, -32]
+    const double dk = (-61 - e) * 0.30102999566398114 + 347; // 1/log2(10)
+    int k = (int) dk;
+    if (dk - k > 0.0)
+        k++;
+    const int index = (k >> 3) + 1;
+    *K = -(-348 + index * 8);
+    assert(index >= 0 && index < PL_ARRAY_SIZE(cached_pow10));
+    return cached_pow10[index];
+}
+
+static const uint64_t pow10_u64[20] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+    10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+    100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL,
+};
+
+static inline void grisu_round(char *digits, int len, uint64_t delta,
+                               uint64_t rest, uint64_t ten_kappa, uint64_t wp_w)
+{
+    // Move the last digit towards the true value as long as the result stays
+    // inside the rounding interval
+    while (rest < wp_w && delta - rest >= ten_kappa &&
+           (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w))
+    {
+        digits[len - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+static int grisu_digits(struct diyfp w, struct diyfp mp, uint64_t delta,
+                        char *digits, int *K)
+{
+    const int shift = -mp.e;
+    const uint64_t one = 1ULL << shift;
+    const uint64_t wp_w = mp.f - w.f;
+    uint32_t p1 = mp.f >> shift;
+    uint64_t p2 = mp.f & (one - 1);
+
+    int kappa = 1;
+    while (kappa < 10 && p1 >= pow10_u64[kappa])
+        kappa++;
+
+    int len = 0;
+    while (kappa > 0) {
+        uint32_t d;
+        // Constant divisors, so the compiler can avoid the actual division
+        switch (kappa--) {
+#define DIGIT(n, div) case n: d = p1 / div; p1 %= div; break;
+        DIGIT(10, 1000000000)
+        DIGIT(9, 100000000)
+        DIGIT(8, 10000000)
+        DIGIT(7, 1000000)
+        DIGIT(6, 100000)
+        DIGIT(5, 10000)
+        DIGIT(4, 1000)
+        DIGIT(3, 100)
+        DIGIT(2, 10)
+        DIGIT(1, 1)
+#undef DIGIT
+        default: pl_unreachable();
+        }
+        if (d || len)
+            digits[len++] = '0' + d;
+        const uint64_t rest = ((uint64_t) p1 << shift) + p2;
+        if (rest <= delta) {
+            *K += kappa;
+            grisu_round(digits, len, delta, rest, pow10_u64[kappa] << shift, wp_w);
+            return len;
+        }
+    }
+
+    for (;;) {
+        p2 *= 10;
+        delta *= 10;
+        const char d = p2 >> shift;
+        if (d || len)
+            digits[len++] = '0' + d;
+        p2 &= one - 1;
+        kappa--;
+        if (p2 < delta) {
+            *K += kappa;
+            const int idx = -kappa;
+            grisu_round(digits, len, delta, p2, one,
+                        idx < PL_ARRAY_SIZE(pow10_u64) ? wp_w * pow10_u64[idx] : 0);
+            return len;
+        }
+    }
+}
+
+// Writes the shortest digits of `value` (finite, positive) to `digits`, such
+// that value ~= digits * 10^K. Returns the number of digits written (<= 17).
+static int grisu2(double value, bool single, char *digits, int *K)
+{
+    uint64_t mant;
+    int exp, bits, bias;
+    bool lower_closer;
+    if (single) {
+        union { float f; uint32_t u; } v = { .f = value };
+        mant = v.u & ((1U << 23) - 1);
+        exp = v.u >> 23;
+        bits = 23;
+        bias = 127 + 23;
+    } else {
+        union { double f; uint64_t u; } v = { .f = value };
+        mant = v.u & ((1ULL << 52) - 1);
+        exp = v.u >> 52;
+        bits = 52;
+        bias = 1023 + 52;
+    }
+
+    lower_closer = !mant && exp > 1;
+    struct diyfp w;
+    if (exp) {
+        w = (struct diyfp) { mant | (1ULL << bits), exp - bias };
+    } else {
+        w = (struct diyfp) { mant, 1 - bias };
+    }
+
+    // Boundaries of the rounding interval around `w`
+    struct diyfp mp = diyfp_normalize((struct diyfp) { (w.f << 1) + 1, w.e - 1 });
+    struct diyfp mm = lower_closer ? (struct diyfp) { (w.f << 2) - 1, w.e - 2 }
+                                   : (struct diyfp) { (w.f << 1) - 1, w.e - 1 };
+    mm.f <<= mm.e - mp.e;
+    mm.e = mp.e;
+    w = diyfp_normalize(w);
+
+    const struct diyfp c_mk = cached_power(mp.e, K);
+    const struct diyfp W  = diyfp_mul(w,  c_mk);
+    struct diyfp Wp = diyfp_mul(mp, c_mk);
+    struct diyfp Wm = diyfp_mul(mm, c_mk);
+    Wm.f++;
+    Wp.f--;
+    return grisu_digits(W, Wp, Wp.f - Wm.f, digits, K);
+}
+
+// Prints a double in the shortest form that round-trips, always producing a
+// valid GLSL floating point literal (e.g. "1.0", "0.25", "1.5e-07")
+static int print_double(char *buf, double value)
+{
+    if (!isfinite(value))
+        return 0;
+
+    char *p = buf;
+    if (signbit(value)) {
+        *p++ = '-';
+        value = -value;
+    }
+
+    // Fast path for small integers (including zero), which are exact in
+    // single precision and therefore always print all of their digits
+    if (value < 16777216.0 && value == (uint32_t) value) {
+        p += ccStrPrintUint32(p, value);
+        memcpy(p, ".0", 2);
+        return p - buf + 2;
+    }
+
+    char digits[20];
+    int K = 0;
+    const bool single = (double) (float) value == value;
+    const int len = grisu2(value, single, digits, &K);
+    const int n = len + K; // value = 0.digits * 10^n
+
+    if (len <= n && n <= 15) {
+        // Integer: 123000.0
+        memcpy(p, digits, len);
+        p += len;
+        memset(p, '0', n - len);
+        p += n - len;
+        memcpy(p, ".0", 2);
+        p += 2;
+    } else if (0 < n && n <= 15) {
+        // Decimal: 123.456
+        memcpy(p, digits, n);
+        p += n;
+        *p++ = '.';
+        memcpy(p, digits + n, len - n);
+        p += len - n;
+    } else if (-4 < n && n <= 0) {
+        // Small decimal: 0.00123
+        memcpy(p, "0.", 2);
+        p += 2;
+        memset(p, '0', -n);
+        p += -n;
+        memcpy(p, digits, len);
+        p += len;
+    } else {
+        // Exponential notation: 1.23e-10
+        *p++ = digits[0];
+        if (len > 1) {
+            *p++ = '.';
+            memcpy(p, digits + 1, len - 1);
+            p += len - 1;
+        }
+        *p++ = 'e';
+        int exp10 = n - 1;
+        if (exp10 < 0) {
+            *p++ = '-';
+            exp10 = -exp10;
+        }
+        p += ccStrPrintUint32(p, exp10);
+    }
+
+    return p - buf;
+}
+
 /* *****************************************************************************
  *
  * Copyright (c) 2007-2016 Alexis Naveros.
@@ -260,6 +598,7 @@ static int print_hex(char *buf, unsigned int x)
  *  - Removed CC_ALWAYSINLINE
  *  - Fixed (!seq) check to (!seqlength)
  *  - Added support for scientific notation (e.g. 1.0e10) in ccSeqParseDouble
+ *  - Removed ccStrPrintDouble in favor of print_double (shortest round-trip)
  *
  * Permission is granted to anyone to use this software for any purpose,
  * including commercial applications, and to alter it and redistribute it
@@ -558,104 +897,6 @@ static int ccStrPrintUint64( char *str, uint64_t n )
     return retsize;
 }
 
-#define CC_STR_PRINT_BUFSIZE_INT32 (12)
-#define CC_STR_PRINT_BUFSIZE_UINT32 (11)
-#define CC_STR_PRINT_BUFSIZE_INT64 (21)
-#define CC_STR_PRINT_BUFSIZE_UINT64 (20)
-#define CC_STR_PRINT_DOUBLE_MAX_DECIMAL (24)
-
-static const double ccStrPrintBiasTable[CC_STR_PRINT_DOUBLE_MAX_DECIMAL+1] =
-{ 0.5, 0.05, 0.005, 0.0005, 0.00005, 0.000005, 0.0000005, 0.00000005, 0.000000005, 0.0000000005, 0.00000000005, 0.000000000005, 0.0000000000005, 0.00000000000005, 0.000000000000005, 0.0000000000000005, 0.00000000000000005, 0.000000000000000005, 0.0000000000000000005, 0.00000000000000000005, 0.000000000000000000005, 0.0000000000000000000005, 0.00000000000000000000005, 0.000000000000000000000005, 0.0000000000000000000000005 };
-
-static int ccStrPrintDouble( char *str, int bufsize, int decimals, double value )
-{
-    int size, offset, index;
-    int32_t frac, accumsub;
-    double muldec;
-    uint32_t u32;
-    uint64_t u64;
-
-    size = 0;
-    if( value < 0.0 )
-    {
-        size = 1;
-        *str++ = '-';
-        bufsize--;
-        value = -value;
-    }
-
-    /* Add bias matching the count of desired decimals in order to round the right way */
-    if( decimals > CC_STR_PRINT_DOUBLE_MAX_DECIMAL )
-        decimals = CC_STR_PRINT_DOUBLE_MAX_DECIMAL;
-    value += ccStrPrintBiasTable[decimals];
-
-    if( value < 4294967296.0 )
-    {
-        if( bufsize < CC_STR_PRINT_BUFSIZE_UINT32 )
-            goto error;
-        u32 = (int32_t)value;
-        offset = ccStrPrintUint32( str, u32 );
-        size += offset;
-        bufsize -= size;
-        value -= (double)u32;
-    }
-    else if( value < 18446744073709551616.0 )
-    {
-        if( bufsize < CC_STR_PRINT_BUFSIZE_UINT64 )
-            goto error;
-        u64 = (int64_t)value;
-        offset = ccStrPrintUint64( str, u64 );
-        size += offset;
-        bufsize -= size;
-        value -= (double)u64;
-    }
-    else
-        goto error;
-
-    if (decimals > bufsize - 2)
-        decimals = bufsize - 2;
-    if( decimals <= 0 )
-        return size;
-
-    str[offset] = '.';
-    muldec = 10.0;
-    accumsub = 0;
-    str += offset + 1;
-
-    for( index = 0 ; index < decimals ; index++ )
-    {
-        frac = (int32_t)( value * muldec ) - accumsub;
-        frac = PL_CLAMP(frac, 0, 9); // FIXME: why is this needed?
-        str[index] = '0' + (char)frac;
-        accumsub += frac;
-        accumsub = ( accumsub << 3 ) + ( accumsub << 1 );
-        if( muldec < 10000000 )
-            muldec *= 10.0;
-        else
-        {
-            value *= 10000000.0;
-            value -= (int32_t)value;
-            muldec = 10.0;
-            accumsub = 0;
-        }
-    }
-    str[ index ] = 0;
-    size += index + 1;
-    return size;
-
-error:
-    if( bufsize < 4 )
-        *str = 0;
-    else
-    {
-        str[0] = 'E';
-        str[1] = 'R';
-        str[2] = 'R';
-        str[3] = 0;
-    }
-    return 0;
-}
-
 #define CC_CHAR_IS_DELIMITER(c) ((c)<=' ')
 
 static int ccSeqParseInt64( char *seq, int seqlength, int64_t *retint )
@@ -18,6 +18,7 @@
 #include "config_internal.h"
 
 #include <assert.h>
+#include <atomic>
 
 extern "C" {
 #include "pl_alloc.h"
@@ -37,8 +38,10 @@ extern "C" {
 
 using namespace glslang;
 
+// Serializes process (de)initialization. The refcount itself is atomic, since
+// `pl_glslang_compile` checks it from arbitrary threads without the lock
 static pl_static_mutex pl_glslang_mutex = PL_STATIC_MUTEX_INITIALIZER;
-static int pl_glslang_refcount;
+static std::atomic<int> pl_glslang_refcount;
 
 bool pl_glslang_init(void)
 {
@@ -65,7 +68,7 @@ struct pl_glslang_res *pl_glslang_compile(const struct pl_glsl_version *glsl,
                                           enum glsl_shader_stage stage,
                                           const char *text)
 {
-    assert(pl_glslang_refcount);
+    assert(pl_glslang_refcount.load() > 0);
     struct pl_glslang_res *res = pl_zalloc_ptr(NULL, res);
 
     EShLanguage lang;
@@ -76,11 +79,15 @@ struct pl_glslang_res *pl_glslang_compile(const struct pl_glsl_version *glsl,
     default: abort();
     }
 
-    TShader *shader = new TShader(lang);
-
-    shader->setEnvClient(EShClientVulkan, (EShTargetClientVersion) spirv_ver->env_version);
-    shader->setEnvTarget(EShTargetSpv, (EShTargetLanguageVersion) spirv_ver->spv_version);
-    shader->setStrings(&text, 1);
+    // glslang keeps its current pool allocator in thread-local storage, and
+    // TShader/TProgram install their own while parsing and linking. So these
+    // are always created, used and destroyed by the calling thread, never
+    // shared. The program references the shader, so it must be destroyed
+    // first, which declaring it afterwards takes care of.
+    TShader shader(lang);
+    shader.setEnvClient(EShClientVulkan, (EShTargetClientVersion) spirv_ver->env_version);
+    shader.setEnvTarget(EShTargetSpv, (EShTargetLanguageVersion) spirv_ver->spv_version);
+    shader.setStrings(&text, 1);
 
     TBuiltInResource limits = DefaultTBuiltInResource;
     limits.maxComputeWorkGroupSizeX = glsl->max_group_size[0];
@@ -89,28 +96,23 @@ struct pl_glslang_res *pl_glslang_compile(const struct pl_glsl_version *glsl,
     limits.minProgramTexelOffset = glsl->min_gather_offset;
     limits.maxProgramTexelOffset = glsl->max_gather_offset;
 
-    if (!shader->parse(&limits, 0, true, EShMsgDefault)) {
-        res->error_msg = pl_str0dup0(res, shader->getInfoLog());
-        delete shader;
+    if (!shader.parse(&limits, 0, true, EShMsgDefault)) {
+        res->error_msg = pl_str0dup0(res, shader.getInfoLog());
         return res;
     }
 
-    TProgram *prog = new TProgram();
-    prog->addShader(shader);
-    if (!prog->link(EShMsgDefault)) {
-        res->error_msg = pl_str0dup0(res, prog->getInfoLog());
-        delete shader;
-        delete prog;
+    TProgram prog;
+    prog.addShader(&shader);
+    if (!prog.link(EShMsgDefault)) {
+        res->error_msg = pl_str0dup0(res, prog.getInfoLog());
         return res;
     }
 
     std::vector<unsigned int> spirv;
-    GlslangToSpv(*prog->getIntermediate(lang), spirv);
+    GlslangToSpv(*prog.getIntermediate(lang), spirv);
 
     res->success = true;
     res->size = spirv.size() * sizeof(unsigned int);
-    res->data = pl_memdup(res, spirv.data(), res->size),
-    delete shader;
-    delete prog;
+    res->data = pl_memdup(res, spirv.data(), res->size);
     return res;
 }
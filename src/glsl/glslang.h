@@ -44,7 +44,8 @@ struct pl_glslang_res {
 };
 
 // Compile GLSL into a SPIRV stream, if possible. The resulting
-// pl_glslang_res can simply be freed with pl_free() when done.
+// pl_glslang_res can simply be freed with pl_free() when done. This may be
+// called concurrently from multiple threads, after `pl_glslang_init`.
 struct pl_glslang_res *pl_glslang_compile(const struct pl_glsl_version *glsl,
                                           const struct pl_spirv_version *spirv_ver,
                                           enum glsl_shader_stage stage,
@@ -15,7 +15,18 @@
  * License along with libplacebo. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdio.h>
+
+#include "os.h"
+#ifdef PL_HAVE_WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
 #include "spirv.h"
+#include "pl_thread.h"
 
 extern const struct spirv_compiler_impl pl_spirv_shaderc;
 extern const struct spirv_compiler_impl pl_spirv_glslang;
@@ -54,10 +65,215 @@ void spirv_compiler_destroy(struct spirv_compiler **spirv)
     (*spirv)->impl->destroy(*spirv);
 }
 
+// Process-wide cache of compiled SPIR-V, keyed by the hash of the GLSL source
+// and everything else affecting its compilation. Entries are evicted in FIFO
+// order once the total size exceeds SPIRV_CACHE_MAX_SIZE.
+#define SPIRV_CACHE_MAX_SIZE (16 << 20)
+
+struct spirv_cache_entry {
+    uint64_t key;
+    pl_str spirv;
+};
+
+// Only protects the state below, cache files are accessed without holding it
+static pl_static_mutex cache_lock = PL_STATIC_MUTEX_INITIALIZER;
+static PL_ARRAY(struct spirv_cache_entry) cache_entries;
+static size_t cache_size;
+static char *cache_dir;
+static atomic_uint cache_tmp_idx; // for unique temporary file names
+
+static const char cache_magic[4] = {'P', 'L', 'S', 'C'};
+static const uint32_t cache_version = 1;
+static const uint32_t spirv_magic = 0x07230203;
+
+struct cache_header {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint64_t size;
+};
+
+void pl_spirv_cache_dir(const char *path)
+{
+    pl_static_mutex_lock(&cache_lock);
+    pl_free(cache_dir);
+    cache_dir = path ? pl_strdup0(NULL, pl_str0(path)) : NULL;
+    pl_static_mutex_unlock(&cache_lock);
+}
+
+static uint64_t cache_key(const struct spirv_compiler *spirv,
+                          const struct pl_glsl_version *glsl,
+                          enum glsl_shader_stage stage, const char *shader)
+{
+    uint64_t key = spirv->signature;
+    pl_hash_merge(&key, pl_str0_hash(shader));
+    pl_hash_merge(&key, (uint64_t) stage << 32 | glsl->version);
+    pl_hash_merge(&key, (uint64_t) glsl->gles << 2 | glsl->vulkan << 1 | glsl->compute);
+    pl_hash_merge(&key, glsl->max_shmem_size);
+    pl_hash_merge(&key, glsl->max_group_threads);
+    for (int i = 0; i < PL_ARRAY_SIZE(glsl->max_group_size); i++)
+        pl_hash_merge(&key, glsl->max_group_size[i]);
+    pl_hash_merge(&key, glsl->subgroup_size);
+    pl_hash_merge(&key, (uint64_t) (uint16_t) glsl->min_gather_offset << 16 |
+                                   (uint16_t) glsl->max_gather_offset);
+    return key;
+}
+
+// Must be called with `cache_lock` held
+static void cache_insert(uint64_t key, pl_str spirv)
+{
+    for (int i = 0; i < cache_entries.num; i++) {
+        if (cache_entries.elem[i].key == key)
+            return; // raced with another thread
+    }
+
+    while (cache_entries.num && cache_size + spirv.len > SPIRV_CACHE_MAX_SIZE) {
+        cache_size -= cache_entries.elem[0].spirv.len;
+        pl_free(cache_entries.elem[0].spirv.buf);
+        PL_ARRAY_REMOVE_AT(cache_entries, 0);
+    }
+
+    PL_ARRAY_APPEND(NULL, cache_entries, (struct spirv_cache_entry) {
+        .key = key,
+        .spirv = pl_strdup(NULL, spirv),
+    });
+    cache_size += spirv.len;
+}
+
+void spirv_cache_flush(void)
+{
+    pl_static_mutex_lock(&cache_lock);
+    for (int i = 0; i < cache_entries.num; i++)
+        pl_free(cache_entries.elem[i].spirv.buf);
+    cache_entries.num = 0;
+    cache_size = 0;
+    pl_static_mutex_unlock(&cache_lock);
+}
+
+static char *cache_file(void *alloc, const char *dir, uint64_t key)
+{
+    return pl_asprintf(alloc, "%s/%016"PRIx64".spv", dir, key);
+}
+
+static pl_str cache_load_file(struct spirv_compiler *spirv, void *alloc,
+                              const char *dir, uint64_t key)
+{
+    pl_str ret = {0};
+    void *tmp = pl_tmp(NULL);
+    char *path = cache_file(tmp, dir, key);
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        goto done;
+
+    struct cache_header header;
+    if (fread(&header, sizeof(header), 1, file) != 1)
+        goto done;
+    if (memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0 ||
+        header.version != cache_version || header.key != key ||
+        !header.size || header.size % sizeof(uint32_t) ||
+        header.size > SPIRV_CACHE_MAX_SIZE)
+    {
+        PL_DEBUG(spirv, "Ignoring invalid SPIR-V cache file '%s'", path);
+        goto done;
+    }
+
+    ret.buf = pl_alloc(alloc, header.size);
+    ret.len = header.size;
+    if (fread(ret.buf, ret.len, 1, file) != 1 ||
+        memcmp(ret.buf, &spirv_magic, sizeof(spirv_magic)) != 0)
+    {
+        PL_DEBUG(spirv, "Ignoring truncated SPIR-V cache file '%s'", path);
+        pl_free(ret.buf);
+        ret = (pl_str) {0};
+    }
+
+done:
+    if (file)
+        fclose(file);
+    pl_free(tmp);
+    return ret;
+}
+
+static void cache_save_file(struct spirv_compiler *spirv, const char *dir,
+                            uint64_t key, pl_str data)
+{
+    void *alloc = pl_tmp(NULL);
+    char *path = cache_file(alloc, dir, key);
+    char *tmp = pl_asprintf(alloc, "%s.%d.%u.tmp", path, (int) getpid(),
+                            atomic_fetch_add(&cache_tmp_idx, 1));
+    FILE *file = fopen(tmp, "wb");
+    if (!file) {
+        PL_DEBUG(spirv, "Failed opening SPIR-V cache file '%s' for writing", tmp);
+        goto done;
+    }
+
+    struct cache_header header = {
+        .version = cache_version,
+        .key = key,
+        .size = data.len,
+    };
+    memcpy(header.magic, cache_magic, sizeof(cache_magic));
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(data.buf, data.len, 1, file) == 1;
+    ok &= fclose(file) == 0;
+
+    // Write to a temporary file first to avoid exposing partial files to
+    // other processes sharing the same cache directory
+    if (!ok || rename(tmp, path) != 0) {
+        PL_DEBUG(spirv, "Failed writing SPIR-V cache file '%s'", path);
+        remove(tmp);
+    }
+
+done:
+    pl_free(alloc);
+}
+
 pl_str spirv_compile_glsl(struct spirv_compiler *spirv, void *alloc,
                           const struct pl_glsl_version *glsl,
                           enum glsl_shader_stage stage,
                           const char *shader)
 {
-    return spirv->impl->compile(spirv, alloc, glsl, stage, shader);
+    const uint64_t key = cache_key(spirv, glsl, stage, shader);
+    pl_str ret = {0};
+    char *dir = NULL;
+
+    pl_static_mutex_lock(&cache_lock);
+    for (int i = 0; i < cache_entries.num; i++) {
+        if (cache_entries.elem[i].key == key) {
+            ret = pl_strdup(alloc, cache_entries.elem[i].spirv);
+            break;
+        }
+    }
+    if (!ret.len && cache_dir)
+        dir = pl_strdup0(NULL, pl_str0(cache_dir));
+    pl_static_mutex_unlock(&cache_lock);
+
+    if (!ret.len && dir) {
+        ret = cache_load_file(spirv, alloc, dir, key);
+        if (ret.len) {
+            pl_static_mutex_lock(&cache_lock);
+            cache_insert(key, ret);
+            pl_static_mutex_unlock(&cache_lock);
+        }
+    }
+
+    if (ret.len) {
+        PL_DEBUG(spirv, "Re-using cached SPIR-V with hash 0x%"PRIx64, key);
+        goto done;
+    }
+
+    ret = spirv->impl->compile(spirv, alloc, glsl, stage, shader);
+    if (!ret.len)
+        goto done;
+
+    pl_static_mutex_lock(&cache_lock);
+    cache_insert(key, ret);
+    pl_static_mutex_unlock(&cache_lock);
+    if (dir)
+        cache_save_file(spirv, dir, key, ret);
+
+done:
+    pl_free(dir);
+    return ret;
 }
@@ -41,6 +41,9 @@ pl_str spirv_compile_glsl(struct spirv_compiler *spirv, void *alloc,
                           enum glsl_shader_stage stage,
                           const char *shader);
 
+// Drops all SPIR-V cached in memory, but not on disk. (Mainly for testing)
+void spirv_cache_flush(void);
+
 struct spirv_compiler_impl {
     const char *name;
     void (*destroy)(struct spirv_compiler *spirv);
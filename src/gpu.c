@@ -27,6 +27,13 @@ void pl_gpu_destroy(pl_gpu gpu)
 
     struct pl_gpu_fns *impl = PL_PRIV(gpu);
     pl_dispatch_destroy(&impl->dp);
+
+    // Any remaining shared textures were leaked by their users
+    for (int i = 0; i < impl->shared_texs.num; i++)
+        impl->tex_destroy(gpu, impl->shared_texs.elem[i].tex);
+    pl_free(impl->shared_texs.elem);
+    pl_cond_destroy(&impl->shared_done);
+    pl_mutex_destroy(&impl->shared_lock);
     impl->destroy(gpu);
 }
 
@@ -255,6 +262,86 @@ void pl_tex_destroy(pl_gpu gpu, pl_tex *tex)
     *tex = NULL;
 }
 
+pl_tex pl_tex_shared_create(pl_gpu gpu, uint64_t key,
+                            const struct pl_tex_params *params, size_t size,
+                            void (*fill)(void *data, void *priv), void *priv)
+{
+    struct pl_gpu_fns *impl = PL_PRIV(gpu);
+    pl_tex tex = NULL;
+
+    pl_mutex_lock(&impl->shared_lock);
+retry:
+    for (int i = 0; i < impl->shared_texs.num; i++) {
+        struct pl_tex_shared *shared = &impl->shared_texs.elem[i];
+        if (shared->key != key)
+            continue;
+        if (shared->generating) {
+            pl_cond_wait(&impl->shared_done, &impl->shared_lock);
+            goto retry; // entry may have moved or been removed
+        }
+        shared->refcount++;
+        tex = shared->tex;
+        goto done;
+    }
+
+    // Reserve the key, so other users wait for the contents to be generated
+    // instead of duplicating the work
+    PL_ARRAY_APPEND(NULL, impl->shared_texs, (struct pl_tex_shared) {
+        .key = key,
+        .generating = true,
+    });
+    pl_mutex_unlock(&impl->shared_lock);
+
+    void *data = pl_zalloc(NULL, size);
+    fill(data, priv);
+    struct pl_tex_params fixed = *params;
+    fixed.initial_data = data;
+    tex = pl_tex_create(gpu, &fixed);
+    pl_free(data);
+
+    pl_mutex_lock(&impl->shared_lock);
+    for (int i = 0; i < impl->shared_texs.num; i++) {
+        struct pl_tex_shared *shared = &impl->shared_texs.elem[i];
+        if (shared->key != key || !shared->generating)
+            continue;
+        if (tex) {
+            shared->tex = tex;
+            shared->refcount = 1;
+            shared->generating = false;
+        } else {
+            PL_ARRAY_REMOVE_AT(impl->shared_texs, i);
+        }
+        break;
+    }
+    pl_cond_broadcast(&impl->shared_done);
+
+done:
+    pl_mutex_unlock(&impl->shared_lock);
+    return tex;
+}
+
+void pl_tex_shared_release(pl_gpu gpu, pl_tex *tex)
+{
+    if (!*tex)
+        return;
+
+    struct pl_gpu_fns *impl = PL_PRIV(gpu);
+    pl_mutex_lock(&impl->shared_lock);
+    for (int i = 0; i < impl->shared_texs.num; i++) {
+        struct pl_tex_shared *shared = &impl->shared_texs.elem[i];
+        if (shared->tex != *tex)
+            continue;
+
+        if (--shared->refcount == 0) {
+            pl_tex_destroy(gpu, &shared->tex);
+            PL_ARRAY_REMOVE_AT(impl->shared_texs, i);
+        }
+        break;
+    }
+    pl_mutex_unlock(&impl->shared_lock);
+    *tex = NULL;
+}
+
 static bool pl_tex_params_superset(struct pl_tex_params a, struct pl_tex_params b)
 {
     return a.w == b.w && a.h == b.h && a.d == b.d &&
@@ -281,7 +368,10 @@ bool pl_tex_recreate(pl_gpu gpu, pl_tex *tex, const struct pl_tex_params *params
     }
 
     if (*tex && pl_tex_params_superset((*tex)->params, *params)) {
+        const struct pl_gpu_fns *impl = PL_PRIV(gpu);
         pl_tex_invalidate(gpu, *tex);
+        if (impl->tex_relocate)
+            impl->tex_relocate(gpu, *tex);
         return true;
     }
 
@@ -997,7 +1087,7 @@ static void log_spec_constants(pl_log log, enum pl_log_level lev,
     }
 }
 
-pl_pass pl_pass_create(pl_gpu gpu, const struct pl_pass_params *params)
+pl_pass pl_pass_create_async(pl_gpu gpu, const struct pl_pass_params *params)
 {
     require(params->glsl_shader);
     switch(params->type) {
@@ -1069,6 +1159,24 @@ error:
     return NULL;
 }
 
+bool pl_pass_wait(pl_gpu gpu, pl_pass pass)
+{
+    const struct pl_gpu_fns *impl = PL_PRIV(gpu);
+    if (!impl->pass_wait || impl->pass_wait(gpu, pass))
+        return true;
+
+    log_shader_sources(gpu->log, PL_LOG_ERR, &pass->params);
+    return false;
+}
+
+pl_pass pl_pass_create(pl_gpu gpu, const struct pl_pass_params *params)
+{
+    pl_pass pass = pl_pass_create_async(gpu, params);
+    if (pass && !pl_pass_wait(gpu, pass))
+        pl_pass_destroy(gpu, &pass);
+    return pass;
+}
+
 void pl_pass_destroy(pl_gpu gpu, pl_pass *pass)
 {
     if (!*pass)
@@ -1105,7 +1213,11 @@ void pl_pass_run(pl_gpu gpu, const struct pl_pass_run_params *params)
         }
         case PL_DESC_BUF_UNIFORM: {
             pl_buf buf = db.object;
+            size_t align = gpu->limits.align_ubo_offset;
             require(buf->params.uniform);
+            require(!db.buf_offset || (align && db.buf_offset % align == 0));
+            require(db.buf_offset < buf->params.size);
+            require(db.buf_offset + db.buf_size <= buf->params.size);
             break;
         }
         case PL_DESC_BUF_STORAGE: {
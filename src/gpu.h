@@ -19,6 +19,7 @@
 
 #include "common.h"
 #include "log.h"
+#include "pl_thread.h"
 
 #include <libplacebo/gpu.h>
 #include <libplacebo/dispatch.h>
@@ -29,6 +30,13 @@
 #define DRM_FORMAT_MOD_INVALID  ((UINT64_C(1) << 56) - 1)
 #endif
 
+struct pl_tex_shared {
+    uint64_t key;
+    pl_tex tex; // NULL while `generating`
+    int refcount;
+    bool generating;
+};
+
 // This struct must be the first member of the gpu's priv struct. The `pl_gpu`
 // helpers will cast the priv struct to this struct!
 
@@ -41,6 +49,11 @@ struct pl_gpu_fns {
     // Warning: Care must be taken to avoid recursive calls.
     pl_dispatch dp;
 
+    // Shared immutable textures, see `pl_tex_shared_create`
+    pl_mutex shared_lock;
+    pl_cond shared_done;
+    PL_ARRAY(struct pl_tex_shared) shared_texs;
+
     // Destructors: These also free the corresponding objects, but they
     // must not be called on NULL. (The NULL checks are done by the pl_*_destroy
     // wrappers)
@@ -51,6 +64,15 @@ struct pl_gpu_fns {
     void (*sync_destroy)(pl_gpu, pl_sync);
     void (*timer_destroy)(pl_gpu, pl_timer);
 
+    // Optional: Waits for the compilation of a pass to complete, for backends
+    // which compile passes asynchronously. Returns false if it failed.
+    bool (*pass_wait)(pl_gpu, pl_pass);
+
+    // Optional: Called by `pl_tex_recreate` when re-using a texture, whose
+    // contents are discarded anyway. Backends may use this opportunity to
+    // move the texture to different backing memory, e.g. to compact it.
+    void (*tex_relocate)(pl_gpu, pl_tex);
+
     GPU_PFN(tex_create);
     GPU_PFN(tex_invalidate); // optional
     GPU_PFN(tex_clear_ex); // optional if no blittable formats
@@ -96,6 +118,29 @@ static inline bool pl_gpu_supports_interop(pl_gpu gpu)
 // Returns the GPU-internal `pl_dispatch` object.
 pl_dispatch pl_gpu_dispatch(pl_gpu gpu);
 
+// Returns a reference to an immutable texture shared between all users of
+// this `pl_gpu` with the same `key`, creating it from `params` if needed. The
+// `key` must uniquely identify both the texture parameters and the contents.
+// The contents are only generated if the texture does not exist yet, by
+// calling `fill` on a zero-initialized buffer of `size` bytes, which then
+// becomes `params->initial_data`. Concurrent callers with the same `key` wait
+// for this instead of generating the contents again. Must be released with
+// `pl_tex_shared_release`.
+pl_tex pl_tex_shared_create(pl_gpu gpu, uint64_t key,
+                            const struct pl_tex_params *params, size_t size,
+                            void (*fill)(void *data, void *priv), void *priv);
+void pl_tex_shared_release(pl_gpu gpu, pl_tex *tex);
+
+// Like `pl_pass_create`, but backends which compile passes asynchronously may
+// return before compilation has finished (or failed). Creating several passes
+// before waiting on any of them allows compiling them in parallel. The result
+// must be waited on with `pl_pass_wait` before it can be used.
+pl_pass pl_pass_create_async(pl_gpu gpu, const struct pl_pass_params *params);
+
+// Waits for any pending compilation of `pass` to complete. Returns false if
+// the pass failed to compile, in which case it must be destroyed.
+bool pl_pass_wait(pl_gpu gpu, pl_pass pass);
+
 // GPU-internal helpers: these should not be used outside of GPU implementations
 
 // This performs several tasks. It sorts the format list, logs GPU metadata,
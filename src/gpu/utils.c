@@ -215,6 +215,7 @@ pl_gpu pl_gpu_finalize(struct pl_gpu_t *gpu)
     LOG("zu", max_mapped_size);
     LOG(PRIu64, max_buffer_texels);
     LOG("zu", align_host_ptr);
+    LOG("zu", align_ubo_offset);
     LOG("d", host_cached);
     // pl_tex
     LOG(PRIu32, max_tex_1d_dim);
@@ -236,6 +237,7 @@ pl_gpu pl_gpu_finalize(struct pl_gpu_t *gpu)
     }
     LOG(PRIu32, fragment_queues);
     LOG(PRIu32, compute_queues);
+    LOG("d", async_compute);
 #undef LOG_STRUCT
 #undef LOG
 
@@ -261,8 +263,11 @@ pl_gpu pl_gpu_finalize(struct pl_gpu_t *gpu)
 
     print_formats(gpu);
 
-    // Finally, create a `pl_dispatch` object for internal operations
     struct pl_gpu_fns *impl = PL_PRIV(gpu);
+    pl_mutex_init(&impl->shared_lock);
+    pl_cond_init(&impl->shared_done);
+
+    // Finally, create a `pl_dispatch` object for internal operations
     impl->dp = pl_dispatch_create(gpu->log, gpu);
     return gpu;
 }
@@ -0,0 +1,120 @@
+/*
+   wyhash (final version 4), https://github.com/wangyi-fudan/wyhash
+   Modified for use by libplacebo:
+    - Hard-coded the default secret and a zero seed
+    - Always read input in little-endian byte order
+
+   Originally written by Wang Yi <godspeed_china@yeah.net>
+
+   This is free and unencumbered software released into the public domain
+   (The Unlicense). <http://unlicense.org/>
+ */
+
+#include <string.h>
+
+#include "common.h"
+
+// This is not a cryptographic hash, and offers no protection against inputs
+// deliberately crafted to collide. It's only used to deduplicate/identify
+// internally generated data (shader text, parameter structs, LUTs, ...)
+
+static const uint64_t secret[4] = {
+    0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+    0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL,
+};
+
+// 64x64 -> 128 bit multiplication, returning the low and high halves in-place
+static inline void mum(uint64_t *a, uint64_t *b)
+{
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t) *a * *b;
+    *a = (uint64_t) r;
+    *b = (uint64_t) (r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t) *a, lb = (uint32_t) *b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t mix(uint64_t a, uint64_t b)
+{
+    mum(&a, &b);
+    return a ^ b;
+}
+
+static inline uint64_t read8(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+static inline uint64_t read4(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+static inline uint64_t read3(const uint8_t *p, size_t k)
+{
+    return ((uint64_t) p[0] << 16) | ((uint64_t) p[k >> 1] << 8) | p[k - 1];
+}
+
+uint64_t pl_mem_hash(const void *mem, size_t size)
+{
+    const uint8_t *p = mem;
+    uint64_t seed = mix(secret[0], secret[1]);
+    uint64_t a, b;
+
+    if (size <= 16) {
+        if (size >= 4) {
+            a = (read4(p) << 32) | read4(p + ((size >> 3) << 2));
+            b = (read4(p + size - 4) << 32) | read4(p + size - 4 - ((size >> 3) << 2));
+        } else if (size > 0) {
+            a = read3(p, size);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = size;
+        if (i > 48) {
+            // Three independent lanes, to hide the multiplication latency
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = mix(read8(p)      ^ secret[1], read8(p +  8) ^ seed);
+                see1 = mix(read8(p + 16) ^ secret[2], read8(p + 24) ^ see1);
+                see2 = mix(read8(p + 32) ^ secret[3], read8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+
+        while (i > 16) {
+            seed = mix(read8(p) ^ secret[1], read8(p + 8) ^ seed);
+            i -= 16;
+            p += 16;
+        }
+
+        a = read8(p + i - 16);
+        b = read8(p + i - 8);
+    }
+
+    a ^= secret[1];
+    b ^= seed;
+    mum(&a, &b);
+    return mix(a ^ secret[0] ^ size, b ^ secret[1]);
+}
@@ -46,6 +46,47 @@ void pl_dispatch_reset_frame(pl_dispatch dp);
 // For more information, see the header documentation in `shaders/*.h`.
 pl_shader pl_dispatch_begin(pl_dispatch dp);
 
+// Enables adaptive specialization of shaders. If `frames` is nonzero, scalar
+// shader variables which have not changed their value for at least this many
+// frames (as counted by `pl_dispatch_reset_frame`) get baked into a separate
+// version of the shader as specialization constants, allowing the compiler to
+// constant-fold them. As soon as one of these values changes again, the
+// generic version of the shader is used instead, until the values have been
+// stable for `frames` frames again.
+//
+// Specialized shaders are never compiled on demand. Instead, the generic
+// version of the shader keeps being used until the specialized version has
+// been compiled. If the GPU is thread-safe (see `pl_gpu_limits.thread_safe`),
+// this happens on a background thread owned by `dp`. Otherwise, they are
+// queued up for the next call to `pl_dispatch_compile`, which applications
+// should then call regularly, e.g. once per frame. `pl_dispatch_compile` also
+// finishes compiling any specialized shaders still pending in the background.
+//
+// Variables marked as `dynamic` are never specialized. This has no effect on
+// GPUs without support for specialization constants. Defaults to 0, which
+// disables this behavior.
+void pl_dispatch_specialize(pl_dispatch dp, int frames);
+
+// Enables deferred compilation. While enabled, `pl_dispatch_finish`,
+// `pl_dispatch_compute` and `pl_dispatch_vertex` only generate the shaders
+// (and invoke the dispatch callback), without executing anything. Any new
+// passes are queued up for compilation by `pl_dispatch_compile`, which allows
+// compiling many shaders in parallel. Defaults to false.
+//
+// Note: Deferred passes which are dispatched again after disabling this mode
+// are compiled on demand.
+void pl_dispatch_defer(pl_dispatch dp, bool defer);
+
+// Compiles all queued passes (see `pl_dispatch_defer`), using up to
+// `num_threads` threads in parallel. If the GPU is not thread-safe (see
+// `pl_gpu_limits.thread_safe`), this happens on the calling thread only.
+// Returns false if any of the passes failed to compile.
+//
+// If the GPU is thread-safe, this may be called from a separate thread while
+// `dp` keeps being used for dispatching shaders. Dispatching a shader that is
+// currently being compiled waits for its compilation to finish.
+bool pl_dispatch_compile(pl_dispatch dp, int num_threads);
+
 // Struct passed to `info_callback`. Only valid until that function returns.
 struct pl_dispatch_info {
     // The finalized/generated shader for this shader execution, as well
@@ -136,6 +177,10 @@ struct pl_dispatch_compute_params {
     // execution time of the shader, which means `pl_dispatch_info.samples` may
     // be empty as a result.
     pl_timer timer;
+
+    // If set, allows running this shader asynchronously on a dedicated compute
+    // queue. See `pl_pass_run_params.async_compute`.
+    bool async_compute;
 };
 
 #define pl_dispatch_compute_params(...) (&(struct pl_dispatch_compute_params) { __VA_ARGS__ })
@@ -107,6 +107,12 @@ void pl_gpu_dummy_destroy(pl_gpu *gpu);
 uint8_t *pl_buf_dummy_data(pl_buf buf);
 uint8_t *pl_tex_dummy_data(pl_tex tex);
 
+// Simulates a buffer still being in use by the GPU, for testing code that
+// polls buffers. While set, `pl_buf_poll` with a timeout of 0 reports the
+// buffer as busy. Polling with a nonzero timeout clears this again, as if the
+// GPU had just finished with it.
+void pl_buf_dummy_set_busy(pl_buf buf, bool busy);
+
 // Skeleton of `pl_tex_params` containing only the fields relevant to
 // `pl_tex_dummy_create`, plus the extra `sampler_type` field.
 struct pl_tex_dummy_params {
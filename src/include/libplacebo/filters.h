@@ -345,6 +345,10 @@ typedef const struct pl_filter_t {
 // The resulting pl_filter must be freed with `pl_filter_free` when no longer
 // needed. Returns NULL if filter generation fails due to invalid parameters
 // (i.e. missing a required parameter).
+//
+// Note: Generated filters are immutable, and internally cached and shared
+// between all callers requesting identical parameters. This function is
+// thread-safe.
 pl_filter pl_filter_generate(pl_log log, const struct pl_filter_params *params);
 void pl_filter_free(pl_filter *filter);
 
@@ -110,6 +110,11 @@ struct pl_gpu_limits {
     // misaligned, libplacebo will internally round (over-map) the region.
     size_t align_host_ptr;
 
+    // Required alignment for `pl_desc_binding.buf_offset` when binding
+    // sub-ranges of uniform buffers. If this is 0, only entire uniform
+    // buffers may be bound.
+    size_t align_ubo_offset;
+
     // --- pl_tex
     uint32_t max_tex_1d_dim;    // maximum width for a 1D texture
     uint32_t max_tex_2d_dim;    // maximum width/height for a 2D texture (required)
@@ -140,6 +145,11 @@ struct pl_gpu_limits {
     // this information to decide the appropriate type of shader to dispatch.
     uint32_t fragment_queues;
     uint32_t compute_queues;
+
+    // If true, the GPU can execute compute passes on a dedicated queue,
+    // concurrently with other rendering work. See
+    // `pl_pass_run_params.async_compute`.
+    bool async_compute;
 };
 
 // Backwards compatibility aliases
@@ -1268,6 +1278,14 @@ struct pl_desc_binding {
     // For PL_DESC_SAMPLED_TEX, this can be used to configure the sampler.
     enum pl_tex_address_mode address_mode;
     enum pl_tex_sample_mode sample_mode;
+
+    // For PL_DESC_BUF_UNIFORM, this can be used to bind only a sub-range of
+    // the buffer, starting at `buf_offset` and spanning `buf_size` bytes. If
+    // `buf_size` is left as 0, the rest of the buffer is bound. A nonzero
+    // `buf_offset` requires `pl_gpu_limits.align_ubo_offset`, and must be a
+    // multiple of it.
+    size_t buf_offset;
+    size_t buf_size;
 };
 
 struct pl_var_update {
@@ -1352,6 +1370,12 @@ struct pl_pass_run_params {
     // Number of work groups to dispatch per dimension (X/Y/Z). Must be <= the
     // corresponding index of limits.max_dispatch
     int compute_groups[3];
+
+    // Hint that this pass is independent of the surrounding work and may be
+    // executed on a dedicated compute queue, overlapping with other passes.
+    // Dependencies on the resources bound to this pass are still respected.
+    // Ignored unless `limits.async_compute` is set.
+    bool async_compute;
 };
 
 #define pl_pass_run_params(...) (&(struct pl_pass_run_params) { __VA_ARGS__ })
@@ -1402,6 +1426,13 @@ void pl_gpu_finish(pl_gpu gpu);
 // including all associated resources, via the appropriate mechanism.
 bool pl_gpu_is_failed(pl_gpu gpu);
 
+// All GLSL shaders compiled to SPIR-V (e.g. by the vulkan and d3d11 backends)
+// are cached in memory, and shared between all `pl_gpu` instances in the
+// process. This function additionally enables persisting the compiled SPIR-V
+// in the given directory, which must already exist, so that it can be re-used
+// across restarts. Pass NULL to disable. (Default)
+void pl_spirv_cache_dir(const char *path);
+
 
 // Deprecated objects and functions:
 
@@ -341,6 +341,15 @@ struct pl_render_params {
     // user, but it should be set to false once those values are "dialed in".
     bool dynamic_constants;
 
+    // If nonzero, shader variables which have remained unchanged for this
+    // many frames are automatically baked into the shaders as constants,
+    // which can be combined with `dynamic_constants` to get most of the
+    // performance back on long-running streams. The specialized shaders are
+    // compiled in the background (or, for GPUs which are not thread-safe, at
+    // the end of the frame they were first needed in), with the generic
+    // shaders being used until then. See `pl_dispatch_specialize`.
+    int specialize_frames;
+
     // This callback is invoked for every pass successfully executed in the
     // process of rendering a frame. Optional.
     //
@@ -704,6 +713,26 @@ bool pl_render_image(pl_renderer rr, const struct pl_frame *image,
                      const struct pl_frame *target,
                      const struct pl_render_params *params);
 
+// Prepares all of the shaders `pl_render_image` would need to render `image`
+// to `target` using the given parameters, without actually rendering anything.
+// This can be used to avoid stalling the first frames of a new stream on
+// shader compilation. The textures referenced by `image` and `target` need
+// to be representative of the real frames (format, size, etc.), but their
+// contents are irrelevant and not modified.
+//
+// This does not affect the state carried over between frames (e.g. HDR peak
+// detection), but it does allocate the same intermediate textures and LUTs
+// as `pl_render_image` would, and invokes any `params->hooks` as usual.
+//
+// The progress of this operation can be tracked using
+// `params->info_callback`, which is invoked for every pass as soon as it has
+// been generated. The actual compilation happens in parallel (if supported by
+// the GPU) before this function returns. Returns whether all shaders were
+// successfully generated and compiled.
+bool pl_renderer_prewarm(pl_renderer rr, const struct pl_frame *image,
+                         const struct pl_frame *target,
+                         const struct pl_render_params *params);
+
 // Flushes the internal state of this renderer. This is normally not needed,
 // even if the image parameters, colorspace or target configuration change,
 // since libplacebo will internally detect such circumstances and recreate
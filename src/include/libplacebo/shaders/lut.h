@@ -57,6 +57,10 @@ struct pl_custom_lut {
 };
 
 // Parse a 3DLUT in .cube format. Returns NULL if the file fails parsing.
+//
+// `str` does not need to be NUL-terminated, so it may point directly at the
+// contents of a memory-mapped file. Large files are parsed in parallel, using
+// several internal threads.
 struct pl_custom_lut *pl_lut_parse_cube(pl_log log, const char *str, size_t str_len);
 
 // Frees a LUT created by `pl_lut_parse_*`.
@@ -102,6 +102,31 @@ PL_DAV1D_API bool pl_upload_dav1dpicture(pl_gpu gpu,
 PL_DAV1D_API int pl_allocate_dav1dpicture(Dav1dPicture *picture, void *gpu);
 PL_DAV1D_API void pl_release_dav1dpicture(Dav1dPicture *picture, void *gpu);
 
+// Pool of recycled picture buffers, as an alternative to the above. Rather
+// than creating and destroying a buffer for every picture, released buffers
+// are kept around and handed out again to later pictures with the same size
+// and layout, once the GPU is no longer using them.
+typedef struct pl_dav1d_pool_t *pl_dav1d_pool;
+
+// Create a picture pool for `gpu`. The pool owns at most `max_buffers`
+// buffers at a time, including those currently attached to pictures. Once
+// this limit is reached, allocations wait for an idle buffer to be released
+// by the GPU, or fail with DAV1D_ERR(ENOMEM) if every buffer is attached to a
+// picture. If 0, a default suitable for typical dav1d frame/reference counts
+// is used. Idle buffers are freed whenever the picture size or layout changes.
+PL_DAV1D_API pl_dav1d_pool pl_dav1d_pool_create(pl_gpu gpu, int max_buffers);
+
+// Destroy a pool and all of its idle buffers. All pictures allocated from
+// this pool must have been released before calling this.
+PL_DAV1D_API void pl_dav1d_pool_destroy(pl_dav1d_pool *pool);
+
+// Equivalent to `pl_allocate_dav1dpicture` and `pl_release_dav1dpicture`, but
+// taking a `pl_dav1d_pool` as the value of `cookie`. The same thread safety
+// notes apply. Pictures allocated this way are also recognized by
+// `pl_dav1d_upload_params.gpu_allocated`.
+PL_DAV1D_API int pl_allocate_dav1dpicture_pooled(Dav1dPicture *picture, void *pool);
+PL_DAV1D_API void pl_release_dav1dpicture_pooled(Dav1dPicture *picture, void *pool);
+
 // Mapping functions for the various Dav1dColor* enums. Note that these are not
 // quite 1:1, and even for values that exist in both, the semantics sometimes
 // differ. Some special cases (e.g. ICtCp, or XYZ) are handled differently in
@@ -22,9 +22,12 @@
 #else
 
 #include <assert.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <libplacebo/utils/spinlock_internal.h>
+
 PL_DAV1D_API enum pl_color_system pl_system_from_dav1d(enum Dav1dMatrixCoefficients mc)
 {
     switch (mc) {
@@ -395,10 +398,31 @@ PL_DAV1D_API void pl_swapchain_colors_from_dav1dpicture(struct pl_swapchain_colo
 #define PL_MAGIC0 0x2c2a1269
 #define PL_MAGIC1 0xc6d02577
 
+// Size and plane layout of a picture buffer
+struct pl_dav1dlayout {
+    ptrdiff_t stride[2];
+    size_t y_sz, uv_sz;
+    size_t size;
+};
+
 struct pl_dav1dalloc {
     uint32_t magic[2];
     pl_gpu gpu;
     pl_buf buf;
+
+    // Only for pooled allocations
+    struct pl_dav1d_pool_t *pool;
+    struct pl_dav1dalloc *next;
+    struct pl_dav1dlayout layout;
+};
+
+struct pl_dav1d_pool_t {
+    pl_gpu gpu;
+    pl_spinlock lock;
+    struct pl_dav1dlayout layout; // of the most recent allocation
+    struct pl_dav1dalloc *idle;   // singly linked list, most recent first
+    int num_buffers;              // total buffers, both idle and in use
+    int max_buffers;
 };
 
 struct pl_dav1dref {
@@ -520,9 +544,9 @@ PL_DAV1D_API bool pl_upload_dav1dpicture(pl_gpu gpu,
     return true;
 }
 
-PL_DAV1D_API int pl_allocate_dav1dpicture(Dav1dPicture *p, void *cookie)
+static inline int pl_dav1dpicture_layout(pl_gpu gpu, const Dav1dPicture *p,
+                                         struct pl_dav1dlayout *out)
 {
-    pl_gpu gpu = cookie;
     if (!gpu->limits.max_mapped_size || !gpu->limits.host_cached ||
         !gpu->limits.buf_transfer)
     {
@@ -536,58 +560,94 @@ PL_DAV1D_API int pl_allocate_dav1dpicture(Dav1dPicture *p, void *cookie)
     const int has_chroma = p->p.layout != DAV1D_PIXEL_LAYOUT_I400;
     const int ss_ver = p->p.layout == DAV1D_PIXEL_LAYOUT_I420;
     const int ss_hor = p->p.layout != DAV1D_PIXEL_LAYOUT_I444;
-    p->stride[0] = aligned_w << hbd;
-    p->stride[1] = has_chroma ? (aligned_w >> ss_hor) << hbd : 0;
+    out->stride[0] = aligned_w << hbd;
+    out->stride[1] = has_chroma ? (aligned_w >> ss_hor) << hbd : 0;
 
     // Align strides up to multiples of the GPU performance hints
-    p->stride[0] = PL_ALIGN2(p->stride[0], gpu->limits.align_tex_xfer_pitch);
-    p->stride[1] = PL_ALIGN2(p->stride[1], gpu->limits.align_tex_xfer_pitch);
+    out->stride[0] = PL_ALIGN2(out->stride[0], gpu->limits.align_tex_xfer_pitch);
+    out->stride[1] = PL_ALIGN2(out->stride[1], gpu->limits.align_tex_xfer_pitch);
 
     // Aligning offsets to 4 also implicitly aligns to the texel alignment (1 or 2)
     size_t off_align = PL_ALIGN2(gpu->limits.align_tex_xfer_offset, 4);
-    const size_t y_sz = PL_ALIGN2(p->stride[0] * aligned_h, off_align);
-    const size_t uv_sz = PL_ALIGN2(p->stride[1] * (aligned_h >> ss_ver), off_align);
+    out->y_sz = PL_ALIGN2(out->stride[0] * aligned_h, off_align);
+    out->uv_sz = PL_ALIGN2(out->stride[1] * (aligned_h >> ss_ver), off_align);
 
     // The extra DAV1D_PICTURE_ALIGNMENTs are to brute force plane alignment,
     // even in the case that the driver gives us insane alignments
-    const size_t pic_size = y_sz + 2 * uv_sz;
-    const size_t total_size = pic_size + DAV1D_PICTURE_ALIGNMENT * 4;
+    const size_t pic_size = out->y_sz + 2 * out->uv_sz;
+    out->size = pic_size + DAV1D_PICTURE_ALIGNMENT * 4;
 
     // Validate size limitations
-    if (total_size > gpu->limits.max_mapped_size)
+    if (out->size > gpu->limits.max_mapped_size)
         return DAV1D_ERR(ENOMEM);
 
+    return 0;
+}
+
+static inline struct pl_dav1dalloc *
+pl_dav1dalloc_create(pl_gpu gpu, const struct pl_dav1dlayout *layout)
+{
     pl_buf buf = pl_buf_create(gpu, pl_buf_params(
-        .size = total_size,
+        .size = layout->size,
         .host_mapped = true,
         .memory_type = PL_BUF_MEM_HOST,
     ));
 
     if (!buf)
-        return DAV1D_ERR(ENOMEM);
+        return NULL;
 
     struct pl_dav1dalloc *alloc = malloc(sizeof(struct pl_dav1dalloc));
     if (!alloc) {
         pl_buf_destroy(gpu, &buf);
-        return DAV1D_ERR(ENOMEM);
+        return NULL;
     }
 
     *alloc = (struct pl_dav1dalloc) {
         .magic = { PL_MAGIC0, PL_MAGIC1 },
         .gpu = gpu,
         .buf = buf,
+        .layout = *layout,
     };
 
     assert(buf->data);
-    uintptr_t base = (uintptr_t) buf->data, data[3];
+    return alloc;
+}
+
+static inline void pl_dav1dalloc_destroy(struct pl_dav1dalloc *alloc)
+{
+    pl_buf_destroy(alloc->gpu, &alloc->buf);
+    free(alloc);
+}
+
+static inline void pl_dav1dpicture_attach(Dav1dPicture *p, struct pl_dav1dalloc *alloc)
+{
+    const struct pl_dav1dlayout *layout = &alloc->layout;
+    uintptr_t base = (uintptr_t) alloc->buf->data, data[3];
     data[0] = PL_ALIGN2(base, DAV1D_PICTURE_ALIGNMENT);
-    data[1] = PL_ALIGN2(data[0] + y_sz, DAV1D_PICTURE_ALIGNMENT);
-    data[2] = PL_ALIGN2(data[1] + uv_sz, DAV1D_PICTURE_ALIGNMENT);
+    data[1] = PL_ALIGN2(data[0] + layout->y_sz, DAV1D_PICTURE_ALIGNMENT);
+    data[2] = PL_ALIGN2(data[1] + layout->uv_sz, DAV1D_PICTURE_ALIGNMENT);
 
     p->allocator_data = alloc;
+    p->stride[0] = layout->stride[0];
+    p->stride[1] = layout->stride[1];
     p->data[0] = (void *) data[0];
     p->data[1] = (void *) data[1];
     p->data[2] = (void *) data[2];
+}
+
+PL_DAV1D_API int pl_allocate_dav1dpicture(Dav1dPicture *p, void *cookie)
+{
+    pl_gpu gpu = cookie;
+    struct pl_dav1dlayout layout;
+    int ret = pl_dav1dpicture_layout(gpu, p, &layout);
+    if (ret < 0)
+        return ret;
+
+    struct pl_dav1dalloc *alloc = pl_dav1dalloc_create(gpu, &layout);
+    if (!alloc)
+        return DAV1D_ERR(ENOMEM);
+
+    pl_dav1dpicture_attach(p, alloc);
     return 0;
 }
 
@@ -600,12 +660,178 @@ PL_DAV1D_API void pl_release_dav1dpicture(Dav1dPicture *p, void *cookie)
     assert(alloc->magic[0] == PL_MAGIC0);
     assert(alloc->magic[1] == PL_MAGIC1);
     assert(alloc->gpu == cookie);
-    pl_buf_destroy(alloc->gpu, &alloc->buf);
-    free(alloc);
+    assert(!alloc->pool);
+    pl_dav1dalloc_destroy(alloc);
+
+    p->data[0] = p->data[1] = p->data[2] = p->allocator_data = NULL;
+}
+
+// Roughly enough for dav1d's reference frames plus frame threading delay
+#define PL_DAV1D_POOL_SIZE 32
+
+PL_DAV1D_API pl_dav1d_pool pl_dav1d_pool_create(pl_gpu gpu, int max_buffers)
+{
+    struct pl_dav1d_pool_t *pool = malloc(sizeof(*pool));
+    if (!pool)
+        return NULL;
+
+    *pool = (struct pl_dav1d_pool_t) {
+        .gpu = gpu,
+        .lock = PL_SPINLOCK_INIT,
+        .max_buffers = max_buffers > 0 ? max_buffers : PL_DAV1D_POOL_SIZE,
+    };
+
+    return pool;
+}
+
+PL_DAV1D_API void pl_dav1d_pool_destroy(pl_dav1d_pool *ppool)
+{
+    struct pl_dav1d_pool_t *pool = *ppool;
+    if (!pool)
+        return;
+
+    while (pool->idle) {
+        struct pl_dav1dalloc *alloc = pool->idle;
+        pool->idle = alloc->next;
+        pl_dav1dalloc_destroy(alloc);
+        pool->num_buffers--;
+    }
+
+    assert(pool->num_buffers == 0);
+    free(pool);
+    *ppool = NULL;
+}
+
+static inline bool pl_dav1dlayout_equal(const struct pl_dav1dlayout *a,
+                                        const struct pl_dav1dlayout *b)
+{
+    return a->size == b->size && a->y_sz == b->y_sz && a->uv_sz == b->uv_sz &&
+           a->stride[0] == b->stride[0] && a->stride[1] == b->stride[1];
+}
+
+PL_DAV1D_API int pl_allocate_dav1dpicture_pooled(Dav1dPicture *p, void *cookie)
+{
+    struct pl_dav1d_pool_t *pool = cookie;
+    struct pl_dav1dlayout layout;
+    int ret = pl_dav1dpicture_layout(pool->gpu, p, &layout);
+    if (ret < 0)
+        return ret;
+
+    struct pl_dav1dalloc *alloc = NULL, *stale = NULL, *busy = NULL;
+    bool wait = false, create = false;
+    int num_stale = 0;
+
+    pl_spinlock_lock(&pool->lock);
+    if (!pl_dav1dlayout_equal(&pool->layout, &layout)) {
+        // None of the idle buffers can be reused anymore, so evict them all
+        for (struct pl_dav1dalloc *cur = pool->idle; cur; cur = cur->next)
+            num_stale++;
+        stale = pool->idle;
+        pool->idle = NULL;
+        pool->layout = layout;
+    }
+
+    while (!alloc && pool->idle) {
+        // Take the buffer out before polling it, to avoid calling into the
+        // GPU while holding the lock
+        struct pl_dav1dalloc *cur = pool->idle;
+        pool->idle = cur->next;
+        pl_spinlock_unlock(&pool->lock);
+
+        bool equal = pl_dav1dlayout_equal(&cur->layout, &layout);
+        bool in_use = equal && pl_buf_poll(pool->gpu, cur->buf, 0);
+        pl_spinlock_lock(&pool->lock);
+        if (!equal) {
+            // The layout changed concurrently
+            cur->next = stale;
+            stale = cur;
+            num_stale++;
+        } else if (in_use) {
+            // Still in use by an asynchronous upload
+            cur->next = busy;
+            busy = cur;
+        } else {
+            alloc = cur;
+        }
+    }
+
+    pool->num_buffers -= num_stale;
+    if (!alloc && pool->num_buffers < pool->max_buffers) {
+        pool->num_buffers++;
+        create = true;
+    } else if (!alloc && busy) {
+        // Out of buffers, so wait for the least recently used busy one
+        alloc = busy;
+        busy = busy->next;
+        wait = true;
+    }
+
+    // Put back the remaining busy buffers, in their original order
+    while (busy) {
+        struct pl_dav1dalloc *cur = busy;
+        busy = cur->next;
+        cur->next = pool->idle;
+        pool->idle = cur;
+    }
+    pl_spinlock_unlock(&pool->lock);
+
+    while (stale) {
+        struct pl_dav1dalloc *cur = stale;
+        stale = cur->next;
+        pl_dav1dalloc_destroy(cur);
+    }
+
+    if (create) {
+        alloc = pl_dav1dalloc_create(pool->gpu, &layout);
+        if (!alloc) {
+            pl_spinlock_lock(&pool->lock);
+            pool->num_buffers--;
+            pl_spinlock_unlock(&pool->lock);
+            return DAV1D_ERR(ENOMEM);
+        }
+        alloc->pool = pool;
+    } else if (!alloc) {
+        // All buffers are attached to pictures
+        return DAV1D_ERR(ENOMEM);
+    }
+
+    while (wait && pl_buf_poll(pool->gpu, alloc->buf, UINT64_MAX))
+        ; // do nothing
+
+    alloc->next = NULL;
+    pl_dav1dpicture_attach(p, alloc);
+    return 0;
+}
+
+PL_DAV1D_API void pl_release_dav1dpicture_pooled(Dav1dPicture *p, void *cookie)
+{
+    struct pl_dav1dalloc *alloc = p->allocator_data;
+    if (!alloc)
+        return;
+
+    struct pl_dav1d_pool_t *pool = cookie;
+    assert(alloc->magic[0] == PL_MAGIC0);
+    assert(alloc->magic[1] == PL_MAGIC1);
+    assert(alloc->pool == pool);
+
+    // Return the buffer to the pool, unless its layout is outdated
+    bool keep;
+    pl_spinlock_lock(&pool->lock);
+    if ((keep = pl_dav1dlayout_equal(&alloc->layout, &pool->layout))) {
+        alloc->next = pool->idle;
+        pool->idle = alloc;
+    } else {
+        pool->num_buffers--;
+    }
+    pl_spinlock_unlock(&pool->lock);
+
+    if (!keep)
+        pl_dav1dalloc_destroy(alloc);
 
     p->data[0] = p->data[1] = p->data[2] = p->allocator_data = NULL;
 }
 
+#undef PL_DAV1D_POOL_SIZE
 #undef PL_ALIGN2
 #undef PL_MAGIC0
 #undef PL_MAGIC1
@@ -138,18 +138,50 @@ PL_LIBAV_API bool pl_test_pixfmt(pl_gpu gpu, enum AVPixelFormat pixfmt);
 PL_LIBAV_API bool pl_frame_recreate_from_avframe(pl_gpu gpu, struct pl_frame *out_frame,
                                                  pl_tex tex[4], const AVFrame *frame);
 
+// Pool of textures and mapped buffers owned by libplacebo, which frames
+// borrow from while mapped. Unlike a single `tex` array, this keeps textures
+// of several different sizes and formats around, so texture creation stays
+// out of the steady state even when interleaving multiple streams or when
+// the resolution changes back and forth.
+typedef struct pl_avpool_t *pl_avpool;
+
+// Create a pool for `gpu`. At most `max_idle` textures (and, separately,
+// buffers) are kept around while not in use; beyond that, the least recently
+// returned ones are destroyed. If 0, a reasonable default is used.
+PL_LIBAV_API pl_avpool pl_avpool_create(pl_gpu gpu, int max_idle);
+
+// Destroy a pool. All frames mapped using this pool must have been unmapped,
+// and all AVFrames allocated with `pl_get_buffer2_pooled` freed, beforehand.
+PL_LIBAV_API void pl_avpool_destroy(pl_avpool *pool);
+
+struct pl_avpool_stats {
+    int num_textures;       // number of textures owned by the pool
+    int num_buffers;        // number of buffers owned by the pool
+    uint64_t tex_hits;      // planes mapped to a recycled texture
+    uint64_t tex_misses;    // planes which required creating a new texture
+    uint64_t buf_hits;      // planes allocated from a recycled buffer
+    uint64_t buf_misses;    // planes which required creating a new buffer
+};
+
+PL_LIBAV_API void pl_avpool_get_stats(pl_avpool pool, struct pl_avpool_stats *out_stats);
+
 struct pl_avframe_params {
     // The AVFrame to map. Required.
     const AVFrame *frame;
 
-    // Backing textures for frame data. Required for all non-hwdec formats.
-    // This must point to an array of four valid textures (or NULL entries).
+    // Backing textures for frame data. Required for all non-hwdec formats,
+    // unless `pool` is set. This must point to an array of four valid
+    // textures (or NULL entries).
     //
     // Note: Not cleaned up by `pl_unmap_avframe`. The intent is for users to
     // re-use this texture array for subsequent frames, to avoid texture
     // creation/destruction overhead.
     pl_tex *tex;
 
+    // If set, backing textures are instead borrowed from this pool, and
+    // returned to it by `pl_unmap_avframe`. Takes precedence over `tex`.
+    pl_avpool pool;
+
     // Also map Dolby Vision metadata (if supported). Note that this also
     // overrides the colorimetry metadata (forces BT.2020+PQ).
     bool map_dovi;
@@ -223,6 +255,13 @@ PL_LIBAV_API int pl_plane_data_from_pixfmt(struct pl_plane_data data[4],
 // That is, it should have type `pl_gpu *`.
 PL_LIBAV_API int pl_get_buffer2(AVCodecContext *avctx, AVFrame *pic, int flags);
 
+// Like `pl_get_buffer2`, but recycles buffers from a `pl_avpool` instead of
+// creating a new buffer for every frame.
+//
+// Note: `avctx->opaque` must be a pointer that *points* to the pool. That is,
+// it should have type `pl_avpool *`.
+PL_LIBAV_API int pl_get_buffer2_pooled(AVCodecContext *avctx, AVFrame *pic, int flags);
+
 // Mapping functions for the various libavutil enums. Note that these are not
 // quite 1:1, and even for values that exist in both, the semantics sometimes
 // differ. Some special cases (e.g. ICtCp, or XYZ) are handled differently in
@@ -24,6 +24,7 @@
 #include <assert.h>
 
 #include <libplacebo/utils/dolbyvision.h>
+#include <libplacebo/utils/spinlock_internal.h>
 
 #include <libavutil/hwcontext.h>
 #include <libavutil/hwcontext_drm.h>
@@ -915,8 +916,278 @@ struct pl_avalloc {
     uint32_t magic[2];
     pl_gpu gpu;
     pl_buf buf;
+    struct pl_avpool_t *pool; // or NULL
+    struct pl_avalloc *next;  // while busy, see `pl_avpool_get_buf`
 };
 
+// Default value for `max_idle`
+#define PL_AVPOOL_SIZE 16
+
+struct pl_avpool_t {
+    // Textures created by the pool point both their `user_data` and their
+    // `debug_tag` here, see `pl_avpool_from_tex`. Must be the first field.
+    char tag[16];
+
+    pl_gpu gpu;
+    pl_spinlock lock;
+    struct pl_avpool_stats stats;
+
+    // Idle objects, least recently returned first
+    int max_idle;
+    pl_tex *tex;
+    int num_tex;
+    struct pl_avalloc **bufs;
+    int num_bufs;
+
+    // Textures currently borrowed by mapped frames
+    pl_tex *lent;
+    int num_lent;
+    int size_lent;
+};
+
+PL_LIBAV_API pl_avpool pl_avpool_create(pl_gpu gpu, int max_idle)
+{
+    struct pl_avpool_t *pool = malloc(sizeof(*pool));
+    if (!pool)
+        return NULL;
+
+    max_idle = max_idle > 0 ? max_idle : PL_AVPOOL_SIZE;
+    *pool = (struct pl_avpool_t) {
+        .tag = "pl_avpool",
+        .gpu = gpu,
+        .lock = PL_SPINLOCK_INIT,
+        .max_idle = max_idle,
+        .tex = calloc(max_idle, sizeof(pl_tex)),
+        .bufs = calloc(max_idle, sizeof(struct pl_avalloc *)),
+    };
+
+    if (!pool->tex || !pool->bufs) {
+        free(pool->tex);
+        free(pool->bufs);
+        free(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+PL_LIBAV_API void pl_avpool_destroy(pl_avpool *ppool)
+{
+    struct pl_avpool_t *pool = *ppool;
+    if (!pool)
+        return;
+
+    for (int i = 0; i < pool->num_tex; i++)
+        pl_tex_destroy(pool->gpu, &pool->tex[i]);
+    for (int i = 0; i < pool->num_bufs; i++) {
+        pl_buf_destroy(pool->gpu, &pool->bufs[i]->buf);
+        free(pool->bufs[i]);
+    }
+
+    assert(!pool->num_lent);
+    assert(pool->stats.num_textures == pool->num_tex);
+    assert(pool->stats.num_buffers == pool->num_bufs);
+    free(pool->tex);
+    free(pool->bufs);
+    free(pool->lent);
+    free(pool);
+    *ppool = NULL;
+}
+
+PL_LIBAV_API void pl_avpool_get_stats(pl_avpool pool, struct pl_avpool_stats *out)
+{
+    pl_spinlock_lock(&pool->lock);
+    *out = pool->stats;
+    pl_spinlock_unlock(&pool->lock);
+}
+
+// Borrow a texture suitable for uploading `data` to
+static inline pl_tex pl_avpool_get_tex(struct pl_avpool_t *pool,
+                                       const struct pl_plane_data *data)
+{
+    int out_map[4];
+    pl_fmt fmt = pl_plane_find_fmt(pool->gpu, out_map, data);
+    if (!fmt)
+        return NULL;
+
+    pl_tex tex = NULL;
+    pl_spinlock_lock(&pool->lock);
+    for (int i = pool->num_tex - 1; i >= 0; i--) {
+        const struct pl_tex_params *params = &pool->tex[i]->params;
+        if (params->w == data->width && params->h == data->height &&
+            params->format == fmt)
+        {
+            tex = pool->tex[i];
+            memmove(&pool->tex[i], &pool->tex[i + 1],
+                    (pool->num_tex - i - 1) * sizeof(pl_tex));
+            pool->num_tex--;
+            break;
+        }
+    }
+
+    if (tex) {
+        pool->stats.tex_hits++;
+    } else {
+        pool->stats.tex_misses++;
+        pool->stats.num_textures++;
+    }
+    pl_spinlock_unlock(&pool->lock);
+
+    if (!tex) {
+        // Matches the parameters used by `pl_upload_plane`, so the texture
+        // does not get recreated there
+        tex = pl_tex_create(pool->gpu, pl_tex_params(
+            .w = data->width,
+            .h = data->height,
+            .format = fmt,
+            .sampleable = true,
+            .host_writable = true,
+            .blit_src = fmt->caps & PL_FMT_CAP_BLITTABLE,
+            .user_data = pool,
+            .debug_tag = pool->tag,
+        ));
+
+        if (!tex) {
+            pl_spinlock_lock(&pool->lock);
+            pool->stats.num_textures--;
+            pl_spinlock_unlock(&pool->lock);
+            return NULL;
+        }
+    }
+
+    // Keep track of the texture while it is lent out
+    pl_spinlock_lock(&pool->lock);
+    if (pool->num_lent == pool->size_lent) {
+        int size = pool->size_lent ? 2 * pool->size_lent : pool->max_idle;
+        pl_tex *lent = realloc(pool->lent, size * sizeof(pl_tex));
+        if (!lent) {
+            pool->stats.num_textures--;
+            pl_spinlock_unlock(&pool->lock);
+            pl_tex_destroy(pool->gpu, &tex);
+            return NULL;
+        }
+        pool->lent = lent;
+        pool->size_lent = size;
+    }
+    pool->lent[pool->num_lent++] = tex;
+    pl_spinlock_unlock(&pool->lock);
+    return tex;
+}
+
+// Returns the pool `tex` was borrowed from, or NULL. This never dereferences
+// `user_data` unless it matches the `debug_tag`, since the `user_data` of
+// textures not created by a pool belongs to the user.
+static inline struct pl_avpool_t *pl_avpool_from_tex(pl_tex tex)
+{
+    void *pool = tex ? tex->params.user_data : NULL;
+    if (pool && (const void *) tex->params.debug_tag == pool)
+        return pool;
+    return NULL;
+}
+
+static inline void pl_avpool_put_tex(struct pl_avpool_t *pool, pl_tex tex)
+{
+    pl_tex evict = NULL;
+    pl_spinlock_lock(&pool->lock);
+    int idx = -1;
+    for (int i = 0; i < pool->num_lent; i++) {
+        if (pool->lent[i] == tex) {
+            idx = i;
+            break;
+        }
+    }
+
+    if (idx < 0) {
+        // Not currently borrowed from this pool, leave it alone
+        pl_spinlock_unlock(&pool->lock);
+        return;
+    }
+
+    pool->lent[idx] = pool->lent[--pool->num_lent];
+
+    if (pool->num_tex == pool->max_idle) {
+        evict = pool->tex[0];
+        memmove(&pool->tex[0], &pool->tex[1], (pool->num_tex - 1) * sizeof(pl_tex));
+        pool->num_tex--;
+        pool->stats.num_textures--;
+    }
+    pool->tex[pool->num_tex++] = tex;
+    pl_spinlock_unlock(&pool->lock);
+
+    pl_tex_destroy(pool->gpu, &evict);
+}
+
+static inline void pl_avpool_put_buf(struct pl_avpool_t *pool,
+                                     struct pl_avalloc *alloc)
+{
+    struct pl_avalloc *evict = NULL;
+    pl_spinlock_lock(&pool->lock);
+    if (pool->num_bufs == pool->max_idle) {
+        evict = pool->bufs[0];
+        memmove(&pool->bufs[0], &pool->bufs[1],
+                (pool->num_bufs - 1) * sizeof(struct pl_avalloc *));
+        pool->num_bufs--;
+        pool->stats.num_buffers--;
+    }
+    pool->bufs[pool->num_bufs++] = alloc;
+    pl_spinlock_unlock(&pool->lock);
+
+    if (evict) {
+        pl_buf_destroy(evict->gpu, &evict->buf);
+        free(evict);
+    }
+}
+
+// Borrow an idle buffer matching `params`, if any
+static inline struct pl_avalloc *pl_avpool_get_buf(struct pl_avpool_t *pool,
+                                                   const struct pl_buf_params *params)
+{
+    struct pl_avalloc *alloc = NULL, *busy = NULL;
+    pl_spinlock_lock(&pool->lock);
+    for (int i = pool->num_bufs - 1; i >= 0; i--) {
+        struct pl_avalloc *cur = pool->bufs[i];
+        if (cur->buf->params.size != params->size ||
+            cur->buf->params.storable != params->storable)
+        {
+            continue;
+        }
+
+        // Take the buffer out before polling it, to avoid calling into the
+        // GPU while holding the lock
+        memmove(&pool->bufs[i], &pool->bufs[i + 1],
+                (pool->num_bufs - i - 1) * sizeof(struct pl_avalloc *));
+        pool->num_bufs--;
+        pl_spinlock_unlock(&pool->lock);
+        bool in_use = pl_buf_poll(pool->gpu, cur->buf, 0);
+        pl_spinlock_lock(&pool->lock);
+        if (!in_use) {
+            alloc = cur;
+            break;
+        }
+
+        // Still in use by an asynchronous upload. Set it aside, and start
+        // over, since the list may have changed in the meantime
+        cur->next = busy;
+        busy = cur;
+        i = pool->num_bufs;
+    }
+
+    if (alloc) {
+        pool->stats.buf_hits++;
+    } else {
+        pool->stats.buf_misses++;
+    }
+    pl_spinlock_unlock(&pool->lock);
+
+    while (busy) {
+        struct pl_avalloc *cur = busy;
+        busy = cur->next;
+        pl_avpool_put_buf(pool, cur);
+    }
+
+    return alloc;
+}
+
 static void pl_fix_hwframe_sample_depth(struct pl_frame *out, const AVFrame *frame)
 {
     const AVHWFramesContext *hwfc = (AVHWFramesContext *) frame->hw_frames_ctx->data;
@@ -1091,7 +1362,7 @@ PL_LIBAV_API bool pl_map_avframe_ex(pl_gpu gpu, struct pl_frame *out,
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
     struct pl_plane_data data[4] = {0};
     struct pl_avalloc *alloc;
-    pl_tex *tex = params->tex;
+    pl_tex *tex = params->tex, pool_tex[4] = {0};
     int planes;
 
     pl_frame_from_avframe(out, frame);
@@ -1144,6 +1415,8 @@ PL_LIBAV_API bool pl_map_avframe_ex(pl_gpu gpu, struct pl_frame *out,
     }
 
     // Backing textures are required from this point onwards
+    if (params->pool)
+        tex = pool_tex;
     if (!tex)
         goto error;
 
@@ -1176,8 +1449,14 @@ PL_LIBAV_API bool pl_map_avframe_ex(pl_gpu gpu, struct pl_frame *out,
             data[p].priv = av_frame_clone(frame);
         }
 
+        if (params->pool && !(tex[p] = pl_avpool_get_tex(params->pool, &data[p]))) {
+            av_frame_free((AVFrame **) &data[p].priv);
+            goto error;
+        }
+
         if (!pl_upload_plane(gpu, &out->planes[p], &tex[p], &data[p])) {
             av_frame_free((AVFrame **) &data[p].priv);
+            out->planes[p].texture = tex[p]; // so it gets returned to the pool
             goto error;
         }
 
@@ -1217,6 +1496,13 @@ PL_LIBAV_API void pl_unmap_avframe(pl_gpu gpu, struct pl_frame *frame)
     if (desc->flags & AV_PIX_FMT_FLAG_HWACCEL) {
         for (int i = 0; i < 4; i++)
             pl_tex_destroy(gpu, &frame->planes[i].texture);
+    } else {
+        // Return textures borrowed from a `pl_avpool`
+        for (int i = 0; i < 4; i++) {
+            struct pl_avpool_t *pool = pl_avpool_from_tex(frame->planes[i].texture);
+            if (pool)
+                pl_avpool_put_tex(pool, frame->planes[i].texture);
+        }
     }
 
     av_frame_free(&avframe);
@@ -1270,11 +1556,18 @@ static inline void pl_avalloc_free(void *opaque, uint8_t *data)
     assert(alloc->magic[0] == PL_MAGIC0);
     assert(alloc->magic[1] == PL_MAGIC1);
     assert(alloc->buf->data == data);
+    if (alloc->pool) {
+        pl_avpool_put_buf(alloc->pool, alloc);
+        return;
+    }
+
     pl_buf_destroy(alloc->gpu, &alloc->buf);
     free(alloc);
 }
 
-PL_LIBAV_API int pl_get_buffer2(AVCodecContext *avctx, AVFrame *pic, int flags)
+static inline int pl_get_buffer2_internal(AVCodecContext *avctx, AVFrame *pic,
+                                          int flags, pl_gpu gpu,
+                                          struct pl_avpool_t *pool)
 {
     int alignment[AV_NUM_DATA_POINTERS];
     int width = pic->width;
@@ -1282,8 +1575,6 @@ PL_LIBAV_API int pl_get_buffer2(AVCodecContext *avctx, AVFrame *pic, int flags)
     size_t planesize[4];
     int ret = 0;
 
-    pl_gpu *pgpu = avctx->opaque;
-    pl_gpu gpu = pgpu ? *pgpu : NULL;
     struct pl_plane_data data[4];
     struct pl_avalloc *alloc;
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(pic->format);
@@ -1336,34 +1627,45 @@ PL_LIBAV_API int pl_get_buffer2(AVCodecContext *avctx, AVFrame *pic, int flags)
             goto fallback;
         }
 
-        alloc = malloc(sizeof(*alloc));
+        const struct pl_buf_params *buf_params = pl_buf_params(
+            .size = buf_size,
+            .memory_type = PL_BUF_MEM_HOST,
+            .host_mapped = true,
+            .storable = desc->flags & AV_PIX_FMT_FLAG_BE,
+        );
+
+        alloc = pool ? pl_avpool_get_buf(pool, buf_params) : NULL;
         if (!alloc) {
-            av_frame_unref(pic);
-            return AVERROR(ENOMEM);
-        }
+            alloc = malloc(sizeof(*alloc));
+            if (!alloc) {
+                av_frame_unref(pic);
+                return AVERROR(ENOMEM);
+            }
 
-        *alloc = (struct pl_avalloc) {
-            .magic = { PL_MAGIC0, PL_MAGIC1 },
-            .gpu = gpu,
-            .buf = pl_buf_create(gpu, pl_buf_params(
-                .size = buf_size,
-                .memory_type = PL_BUF_MEM_HOST,
-                .host_mapped = true,
-                .storable = desc->flags & AV_PIX_FMT_FLAG_BE,
-            )),
-        };
+            *alloc = (struct pl_avalloc) {
+                .magic = { PL_MAGIC0, PL_MAGIC1 },
+                .gpu = gpu,
+                .buf = pl_buf_create(gpu, buf_params),
+                .pool = pool,
+            };
 
-        if (!alloc->buf) {
-            free(alloc);
-            av_frame_unref(pic);
-            return AVERROR(ENOMEM);
+            if (!alloc->buf) {
+                free(alloc);
+                av_frame_unref(pic);
+                return AVERROR(ENOMEM);
+            }
+
+            if (pool) {
+                pl_spinlock_lock(&pool->lock);
+                pool->stats.num_buffers++;
+                pl_spinlock_unlock(&pool->lock);
+            }
         }
 
         pic->data[p] = (uint8_t *) PL_ALIGN2((uintptr_t) alloc->buf->data, alignment[p]);
         pic->buf[p] = av_buffer_create(alloc->buf->data, buf_size, pl_avalloc_free, alloc, 0);
         if (!pic->buf[p]) {
-            pl_buf_destroy(gpu, &alloc->buf);
-            free(alloc);
+            pl_avalloc_free(alloc, alloc->buf->data);
             av_frame_unref(pic);
             return AVERROR(ENOMEM);
         }
@@ -1375,8 +1677,23 @@ fallback:
     return avcodec_default_get_buffer2(avctx, pic, flags);
 }
 
+PL_LIBAV_API int pl_get_buffer2(AVCodecContext *avctx, AVFrame *pic, int flags)
+{
+    pl_gpu *pgpu = avctx->opaque;
+    pl_gpu gpu = pgpu ? *pgpu : NULL;
+    return pl_get_buffer2_internal(avctx, pic, flags, gpu, NULL);
+}
+
+PL_LIBAV_API int pl_get_buffer2_pooled(AVCodecContext *avctx, AVFrame *pic, int flags)
+{
+    pl_avpool *ppool = avctx->opaque;
+    pl_avpool pool = ppool ? *ppool : NULL;
+    return pl_get_buffer2_internal(avctx, pic, flags, pool ? pool->gpu : NULL, pool);
+}
+
 #undef PL_MAGIC0
 #undef PL_MAGIC1
+#undef PL_AVPOOL_SIZE
 #undef PL_ALIGN
 #undef PL_MAX
 
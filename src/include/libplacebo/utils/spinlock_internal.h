@@ -0,0 +1,44 @@
+/*
+ * This file is part of libplacebo.
+ *
+ * libplacebo is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * libplacebo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with libplacebo. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if !defined(LIBPLACEBO_DAV1D_H_) && !defined(LIBPLACEBO_LIBAV_H_)
+#error This header should only be included as part of the header-only utils
+#endif
+
+#ifndef LIBPLACEBO_SPINLOCK_INTERNAL_H_
+#define LIBPLACEBO_SPINLOCK_INTERNAL_H_
+
+#include <stdatomic.h>
+
+// Trivial lock for the object pools of the header-only utils, which can't use
+// libplacebo's internal threading primitives. Must only be held for short
+// list operations, and never across calls into the `pl_gpu`.
+typedef atomic_flag pl_spinlock;
+#define PL_SPINLOCK_INIT ATOMIC_FLAG_INIT
+
+static inline void pl_spinlock_lock(pl_spinlock *lock)
+{
+    while (atomic_flag_test_and_set_explicit(lock, memory_order_acquire))
+        ;
+}
+
+static inline void pl_spinlock_unlock(pl_spinlock *lock)
+{
+    atomic_flag_clear_explicit(lock, memory_order_release);
+}
+
+#endif // LIBPLACEBO_SPINLOCK_INTERNAL_H_
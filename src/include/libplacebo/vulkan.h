@@ -237,6 +237,26 @@ struct pl_vulkan_params {
     // VkPhysicalDeviceVulkan11Features is not allowed.
     const VkPhysicalDeviceFeatures2 *features;
 
+    // If enabled, libplacebo spawns a dedicated thread that waits for GPU
+    // commands to complete and then runs their associated callbacks, such as
+    // resource releases and `pl_tex_transfer_params.callback`. This takes
+    // work off the threads using the `pl_gpu`, and makes resources available
+    // again sooner. Callbacks are still run in submission order, and never
+    // concurrently with each other.
+    //
+    // User callbacks then run on the completion thread. No internal locks of
+    // the `pl_gpu` are held while they run, except for the (recursive) one
+    // serializing callbacks. So they may call any thread-safe `pl_gpu`
+    // function, including ones that record new work, or that poll or wait on
+    // objects, e.g. `pl_buf_poll`, `pl_tex_poll` and `pl_gpu_finish`.
+    //
+    // However, no other callbacks can run until a callback returns, and other
+    // threads blocking on the `pl_gpu` (e.g. `pl_buf_poll` with a timeout)
+    // wait for it as well. So callbacks must not block on other threads that
+    // may themselves be waiting on this `pl_gpu`, and must never destroy the
+    // `pl_gpu` or `pl_vulkan`, which joins the completion thread.
+    bool completion_thread;
+
     // --- Misc/debugging options
 
     // Restrict specific features to e.g. work around driver bugs, or simply
@@ -279,6 +299,88 @@ void pl_vulkan_destroy(pl_vulkan *vk);
 // the underlying `pl_vulkan`. Returns NULL for any other type of `gpu`.
 pl_vulkan pl_vulkan_get(pl_gpu gpu);
 
+// Serialize the device-wide VkPipelineCache, which the pipeline state of all
+// passes (and hence all renderers and dispatch objects) created on this
+// device gets merged into. Each pass also keeps its own pipeline state as part
+// of `pl_pass_params.cached_program` (and hence `pl_dispatch_save`). Writes at
+// most `size` bytes to `out_cache`, and returns the number of bytes written,
+// or the total size of the cache data if `out_cache` is NULL.
+//
+// Thread-safety: Safe
+size_t pl_vulkan_save_pipeline_cache(pl_vulkan vk, uint8_t *out_cache,
+                                     size_t size);
+
+// Merge the result of a previous `pl_vulkan_save_pipeline_cache` call into
+// the device-wide pipeline cache. Data from a different driver or device is
+// silently ignored, so this function never fails. Should be called before
+// creating any passes, to be most effective.
+//
+// Once this has been called, passes without pipeline state of their own
+// (i.e. not created from a `cached_program` containing it) are created
+// directly against the device-wide cache, so they can share state with all
+// other pipelines in it. Their pipeline state is then only persisted by
+// `pl_vulkan_save_pipeline_cache`, not as part of their `cached_program`.
+//
+// Note: See the security warnings on `pl_pass_params.cached_program`.
+//
+// Thread-safety: Safe
+void pl_vulkan_load_pipeline_cache(pl_vulkan vk, const uint8_t *cache,
+                                   size_t size);
+
+// Statistics about the command submissions made by a `pl_vulkan`. Commands
+// recorded in between two flush points (e.g. `pl_gpu_flush`, `pl_tex_poll` or
+// `pl_swapchain_submit_frame`) are batched together into as few calls to
+// `vkQueueSubmit` as possible.
+struct pl_vulkan_stats {
+    // Totals over the lifetime of the `pl_vulkan`.
+    uint64_t submissions;   // number of `vkQueueSubmit` calls
+    uint64_t cmd_buffers;   // number of command buffers submitted
+
+    // The same counts, but only for the most recently completed frame. Frames
+    // are delimited by calls to `pl_gpu_flush` or `pl_swapchain_submit_frame`.
+    int frame_submissions;
+    int frame_cmd_buffers;
+};
+
+// Retrieve the current submission statistics.
+//
+// Thread-safety: Safe
+void pl_vulkan_get_stats(pl_vulkan vk, struct pl_vulkan_stats *out_stats);
+
+// Statistics about the device memory allocated by a `pl_vulkan`. Most objects
+// are suballocated from larger slabs of device memory, which can only be
+// released once all of their pages are free. Sparsely used slabs are drained
+// over time: new allocations avoid them, and textures are transparently moved
+// out of them whenever they are re-used by `pl_tex_recreate` (as done for the
+// renderer's FBOs and LUTs). Textures that were exported, or whose VkImage was
+// retrieved with `pl_vulkan_unwrap`, are never moved.
+struct pl_vulkan_memory_stats {
+    // Totals over all slabs. Dedicated allocations are not included.
+    uint64_t allocated;     // size of all slabs
+    uint64_t used;          // bytes actually in use by objects
+    uint64_t fragmented;    // free bytes inside slabs that are still in use
+    int num_slabs;
+    int num_draining;       // number of slabs currently being drained
+
+    // Per-heap memory budget and usage. If VK_EXT_memory_budget is enabled,
+    // these are the values reported by the driver for the entire process, as
+    // of the last call to `pl_gpu_flush` or `pl_swapchain_submit_frame`.
+    // Otherwise, `budget` is the size of the heap and `usage` only counts
+    // memory allocated by this `pl_vulkan`.
+    struct {
+        uint64_t size;
+        uint64_t budget;
+        uint64_t usage;
+    } heaps[VK_MAX_MEMORY_HEAPS];
+    int num_heaps;
+};
+
+// Retrieve the current memory statistics.
+//
+// Thread-safety: Safe
+void pl_vulkan_get_memory_stats(pl_vulkan vk,
+                                struct pl_vulkan_memory_stats *out_stats);
+
 struct pl_vulkan_device_params {
     // The instance to use. Required!
     //
@@ -401,6 +503,9 @@ struct pl_vulkan_import_params {
     void (*unlock_queue)(void *ctx, int qf, int qidx);
     void *queue_ctx;
 
+    // Mirrored from `pl_vulkan_params.completion_thread`.
+    bool completion_thread;
+
     // --- Misc/debugging options
 
     // Restrict specific features to e.g. work around driver bugs, or simply
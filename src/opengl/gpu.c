@@ -31,6 +31,8 @@
 
 static const struct pl_gpu_fns pl_fns_gl;
 
+static void ring_destroy(pl_gpu gpu);
+
 static void gl_gpu_destroy(pl_gpu gpu)
 {
     struct pl_gl *p = PL_PRIV(gpu);
@@ -39,6 +41,7 @@ static void gl_gpu_destroy(pl_gpu gpu)
     while (p->callbacks.num > 0)
         gl_poll_callbacks(gpu);
 
+    ring_destroy(gpu);
     pl_free((void *) gpu);
 }
 
@@ -167,8 +170,10 @@ pl_gpu pl_gpu_create_gl(pl_log log, pl_opengl pl_gl, const struct pl_opengl_para
     limits->callbacks = gl_test_ext(gpu, "GL_ARB_sync", 32, 30);
     if (gl_test_ext(gpu, "GL_ARB_pixel_buffer_object", 31, 0))
         limits->max_buf_size = SIZE_MAX; // no restriction imposed by GL
-    if (gl_test_ext(gpu, "GL_ARB_uniform_buffer_object", 31, 0))
+    if (gl_test_ext(gpu, "GL_ARB_uniform_buffer_object", 31, 0)) {
         get(GL_MAX_UNIFORM_BLOCK_SIZE, &limits->max_ubo_size);
+        get(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &limits->align_ubo_offset);
+    }
     if (gl_test_ext(gpu, "GL_ARB_shader_storage_buffer_object", 43, 0))
         get(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &limits->max_ssbo_size);
     limits->max_vbo_size = limits->max_buf_size; // No additional restrictions
@@ -226,6 +231,11 @@ pl_gpu pl_gpu_create_gl(pl_log log, pl_opengl pl_gl, const struct pl_opengl_para
     p->has_invalidate_tex = gl_test_ext(gpu, "GL_ARB_invalidate_subdata", 43, 0);
     p->has_queries = gl_test_ext(gpu, "GL_ARB_timer_query", 33, 0);
     p->has_storage = gl_test_ext(gpu, "GL_ARB_shader_image_load_store", 42, 0);
+    p->has_ring = gl_test_ext(gpu, "GL_ARB_buffer_storage", 44, 0) &&
+                  gl_test_ext(gpu, "GL_ARB_sync", 32, 30) &&
+                  gl_test_ext(gpu, "GL_ARB_copy_buffer", 31, 30);
+    p->has_parallel_compile = gl_test_ext(gpu, "GL_KHR_parallel_shader_compile", 0, 0) ||
+                              gl_test_ext(gpu, "GL_ARB_parallel_shader_compile", 0, 0);
     p->has_readback = true;
 
     if (p->has_readback && p->gles_ver) {
@@ -447,6 +457,139 @@ bool gl_buf_poll(pl_gpu gpu, pl_buf buf, uint64_t timeout)
     return !!buf_gl->fence;
 }
 
+#define RING_SIZE  (8 << 20) // 8 MiB
+#define RING_ALIGN 256
+#define RING_TIMEOUT 1000000000 // 1 second
+
+static bool ring_init(pl_gpu gpu)
+{
+    const gl_funcs *gl = gl_funcs_get(gpu);
+    struct pl_gl *p = PL_PRIV(gpu);
+    struct gl_ring *ring = &p->ring;
+    if (ring->data)
+        return true;
+    if (!p->has_ring)
+        return false;
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+                             GL_MAP_COHERENT_BIT;
+
+    gl->GenBuffers(1, &ring->buffer);
+    gl->BindBuffer(GL_COPY_WRITE_BUFFER, ring->buffer);
+    gl->BufferStorage(GL_COPY_WRITE_BUFFER, RING_SIZE, NULL, flags);
+    ring->data = gl->MapBufferRange(GL_COPY_WRITE_BUFFER, 0, RING_SIZE, flags);
+    gl->BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    if (!ring->data) {
+        // Not fatal, so swallow the error instead of failing the pl_gpu
+        while (gl->GetError() != GL_NO_ERROR)
+            ;
+        PL_WARN(gpu, "Failed mapping upload ring buffer, falling back to "
+                "regular uploads");
+        gl->DeleteBuffers(1, &ring->buffer);
+        ring->buffer = 0;
+        p->has_ring = false;
+        return false;
+    }
+
+    ring->size = RING_SIZE;
+    return true;
+}
+
+static bool ring_fence(pl_gpu gpu)
+{
+    const gl_funcs *gl = gl_funcs_get(gpu);
+    struct pl_gl *p = PL_PRIV(gpu);
+    struct gl_ring *ring = &p->ring;
+
+    GLsync sync = gl->FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    if (!sync)
+        return false;
+
+    PL_ARRAY_APPEND(gpu, ring->fences, (struct gl_ring_fence) {
+        .sync = sync,
+        .head = ring->head,
+    });
+    ring->fenced = ring->head;
+    return true;
+}
+
+static void ring_destroy(pl_gpu gpu)
+{
+    const gl_funcs *gl = gl_funcs_get(gpu);
+    struct pl_gl *p = PL_PRIV(gpu);
+    struct gl_ring *ring = &p->ring;
+    if (!ring->buffer || !MAKE_CURRENT())
+        return;
+
+    for (int i = 0; i < ring->fences.num; i++)
+        gl->DeleteSync(ring->fences.elem[i].sync);
+    gl->BindBuffer(GL_COPY_WRITE_BUFFER, ring->buffer);
+    gl->UnmapBuffer(GL_COPY_WRITE_BUFFER);
+    gl->BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    gl->DeleteBuffers(1, &ring->buffer);
+    gl_check_err(gpu, "ring_destroy");
+    RELEASE_CURRENT();
+}
+
+void *gl_ring_alloc(pl_gpu gpu, size_t size, size_t *out_offset)
+{
+    const gl_funcs *gl = gl_funcs_get(gpu);
+    struct pl_gl *p = PL_PRIV(gpu);
+    struct gl_ring *ring = &p->ring;
+    if (!size || size > RING_SIZE / 4 || !ring_init(gpu))
+        return NULL;
+
+    // Fence off the previous allocations every so often, so that wrapping
+    // around only has to wait for the oldest part of the ring
+    if (ring->head - ring->fenced >= ring->size / 8 && !ring_fence(gpu))
+        return NULL;
+
+    uint64_t start = PL_ALIGN2(ring->head, RING_ALIGN);
+    size_t pos = start % ring->size;
+    if (pos + size > ring->size) {
+        start += ring->size - pos;
+        pos = 0;
+    }
+
+    // Wait until the region we're about to overwrite is no longer in use
+    uint64_t end = start + size;
+    while (end > ring->done + ring->size) {
+        if (!ring->fences.num && !ring_fence(gpu))
+            return NULL;
+
+        struct gl_ring_fence *fence = &ring->fences.elem[0];
+        GLenum res = gl->ClientWaitSync(fence->sync, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                        RING_TIMEOUT);
+        switch (res) {
+        case GL_ALREADY_SIGNALED:
+        case GL_CONDITION_SATISFIED:
+            ring->done = fence->head;
+            gl->DeleteSync(fence->sync);
+            PL_ARRAY_REMOVE_AT(ring->fences, 0);
+            continue;
+
+        case GL_TIMEOUT_EXPIRED:
+            // Don't block indefinitely on a stuck (or very slow) GPU, the
+            // caller can just as well do a regular upload instead
+            PL_WARN(gpu, "Timed out waiting for the upload ring, falling back "
+                    "to a direct upload");
+            return NULL;
+
+        case GL_WAIT_FAILED:
+            gl_check_err(gpu, "gl_ring_alloc");
+            return NULL;
+
+        default:
+            pl_unreachable();
+        }
+    }
+
+    ring->head = end;
+    *out_offset = pos;
+    return ring->data + pos;
+}
+
 void gl_buf_write(pl_gpu gpu, pl_buf buf, size_t offset,
                   const void *data, size_t size)
 {
@@ -454,10 +597,29 @@ void gl_buf_write(pl_gpu gpu, pl_buf buf, size_t offset,
     if (!MAKE_CURRENT())
         return;
 
+    struct pl_gl *p = PL_PRIV(gpu);
     struct pl_buf_gl *buf_gl = PL_PRIV(buf);
-    gl->BindBuffer(GL_ARRAY_BUFFER, buf_gl->buffer);
-    gl->BufferSubData(GL_ARRAY_BUFFER, buf_gl->offset + offset, size, data);
-    gl->BindBuffer(GL_ARRAY_BUFFER, 0);
+    size_t ring_offset;
+    void *ring_ptr = NULL;
+    if (!buf_gl->mapped)
+        ring_ptr = gl_ring_alloc(gpu, size, &ring_offset);
+
+    if (ring_ptr) {
+        // Copy via the upload ring, which avoids the driver having to either
+        // stall or shadow the buffer contents if it's still in use
+        memcpy(ring_ptr, data, size);
+        gl->BindBuffer(GL_COPY_READ_BUFFER, p->ring.buffer);
+        gl->BindBuffer(GL_COPY_WRITE_BUFFER, buf_gl->buffer);
+        gl->CopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                              ring_offset, buf_gl->offset + offset, size);
+        gl->BindBuffer(GL_COPY_READ_BUFFER, 0);
+        gl->BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    } else {
+        gl->BindBuffer(GL_ARRAY_BUFFER, buf_gl->buffer);
+        gl->BufferSubData(GL_ARRAY_BUFFER, buf_gl->offset + offset, size, data);
+        gl->BindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
     gl_check_err(gpu, "gl_buf_write");
     RELEASE_CURRENT();
 }
@@ -627,6 +789,7 @@ static const struct pl_gpu_fns pl_fns_gl = {
     .pass_create            = gl_pass_create,
     .pass_destroy           = gl_pass_destroy,
     .pass_run               = gl_pass_run,
+    .pass_wait              = gl_pass_wait,
     .timer_create           = gl_timer_create,
     .timer_destroy          = gl_timer_destroy,
     .timer_query            = gl_timer_query,
@@ -25,6 +25,23 @@ pl_gpu pl_gpu_create_gl(pl_log log, pl_opengl gl, const struct pl_opengl_params
 
 // --- pl_gpu internal structs and functions
 
+// Persistently mapped, coherent buffer used to stream host data into buffers
+// and textures, recycled based on fences. Requires ARB_buffer_storage.
+struct gl_ring_fence {
+    GLsync sync;
+    uint64_t head; // value of `gl_ring.head` when this fence was inserted
+};
+
+struct gl_ring {
+    GLuint buffer;
+    uint8_t *data;
+    size_t size;
+    uint64_t head;   // total number of bytes allocated so far
+    uint64_t fenced; // value of `head` as of the most recent fence
+    uint64_t done;   // all bytes before this are no longer in use by GL
+    PL_ARRAY(struct gl_ring_fence) fences;
+};
+
 struct pl_gl {
     struct pl_gpu_fns impl;
     pl_opengl gl;
@@ -42,6 +59,8 @@ struct pl_gl {
     // Sync objects and associated callbacks
     PL_ARRAY(struct gl_cb) callbacks;
 
+    // Upload ring, lazily created on first use
+    struct gl_ring ring;
 
     // Incrementing counters to keep track of object uniqueness
     int buf_id;
@@ -58,6 +77,8 @@ struct pl_gl {
     bool has_readback;
     bool has_egl_storage;
     bool has_egl_import;
+    bool has_ring;
+    bool has_parallel_compile;
     int gather_comps;
 };
 
@@ -134,8 +155,19 @@ void gl_buf_copy(pl_gpu, pl_buf dst, size_t dst_offset,
                  pl_buf src, size_t src_offset, size_t size);
 bool gl_buf_poll(pl_gpu, pl_buf, uint64_t timeout);
 
+// Allocates `size` bytes from the upload ring, blocking until the memory is
+// no longer in use by GL. The returned memory is located at `*out_offset`
+// inside `p->ring.buffer`, and must be consumed by GL commands before the next
+// call to this function. Returns NULL if the ring is unavailable, `size` is
+// too large, or the GPU did not release the required space in time, in which
+// case the caller should fall back to a regular upload.
+//
+// Note: Must be called with the context current.
+void *gl_ring_alloc(pl_gpu, size_t size, size_t *out_offset);
+
 struct pl_pass_gl;
 int gl_desc_namespace(pl_gpu, enum pl_desc_type type);
 pl_pass gl_pass_create(pl_gpu, const struct pl_pass_params *);
 void gl_pass_destroy(pl_gpu, pl_pass);
 void gl_pass_run(pl_gpu, const struct pl_pass_run_params *);
+bool gl_pass_wait(pl_gpu, pl_pass);
@@ -84,13 +84,20 @@ static enum pl_log_level gl_log_level(GLint status, GLint log_length)
     }
 }
 
-static bool gl_attach_shader(pl_gpu gpu, GLuint program, GLenum type, const char *src)
+// Only starts compiling the shader, the result is checked by gl_check_shader
+static GLuint gl_attach_shader(pl_gpu gpu, GLuint program, GLenum type, const char *src)
 {
     const gl_funcs *gl = gl_funcs_get(gpu);
     GLuint shader = gl->CreateShader(type);
     gl->ShaderSource(shader, 1, &src, NULL);
     gl->CompileShader(shader);
+    gl->AttachShader(program, shader);
+    return shader;
+}
 
+static bool gl_check_shader(pl_gpu gpu, GLuint shader)
+{
+    const gl_funcs *gl = gl_funcs_get(gpu);
     GLint status = 0;
     gl->GetShaderiv(shader, GL_COMPILE_STATUS, &status);
     GLint log_length = 0;
@@ -104,31 +111,25 @@ static bool gl_attach_shader(pl_gpu gpu, GLuint program, GLenum type, const char
         pl_free(logstr);
     }
 
-    if (!status || !gl_check_err(gpu, "gl_attach_shader"))
-        goto error;
-
-    gl->AttachShader(program, shader);
-    gl->DeleteShader(shader);
-    return true;
-
-error:
-    gl->DeleteShader(shader);
-    return false;
+    return status;
 }
 
-static GLuint gl_compile_program(pl_gpu gpu, const struct pl_pass_params *params)
+// Starts compiling and linking the program. With *_parallel_shader_compile,
+// this happens asynchronously, until the result is queried by
+// gl_check_program. The shader objects are returned in `shaders`.
+static GLuint gl_compile_program(pl_gpu gpu, const struct pl_pass_params *params,
+                                 GLuint shaders[2])
 {
     const gl_funcs *gl = gl_funcs_get(gpu);
     GLuint prog = gl->CreateProgram();
-    bool ok = true;
 
     switch (params->type) {
     case PL_PASS_COMPUTE:
-        ok &= gl_attach_shader(gpu, prog, GL_COMPUTE_SHADER, params->glsl_shader);
+        shaders[0] = gl_attach_shader(gpu, prog, GL_COMPUTE_SHADER, params->glsl_shader);
         break;
     case PL_PASS_RASTER:
-        ok &= gl_attach_shader(gpu, prog, GL_VERTEX_SHADER, params->vertex_shader);
-        ok &= gl_attach_shader(gpu, prog, GL_FRAGMENT_SHADER, params->glsl_shader);
+        shaders[0] = gl_attach_shader(gpu, prog, GL_VERTEX_SHADER, params->vertex_shader);
+        shaders[1] = gl_attach_shader(gpu, prog, GL_FRAGMENT_SHADER, params->glsl_shader);
         for (int i = 0; i < params->num_vertex_attribs; i++)
             gl->BindAttribLocation(prog, i, params->vertex_attribs[i].name);
         break;
@@ -137,10 +138,35 @@ static GLuint gl_compile_program(pl_gpu gpu, const struct pl_pass_params *params
         pl_unreachable();
     }
 
-    if (!ok || !gl_check_err(gpu, "gl_compile_program: attach shader"))
+    if (!gl_check_err(gpu, "gl_compile_program: attach shader"))
         goto error;
 
     gl->LinkProgram(prog);
+    return prog;
+
+error:
+    for (int i = 0; i < 2; i++) {
+        gl->DeleteShader(shaders[i]);
+        shaders[i] = 0;
+    }
+    gl->DeleteProgram(prog);
+    PL_ERR(gpu, "Failed compiling/linking GLSL program");
+    return 0;
+}
+
+// Blocks until the program is linked, and releases the shader objects
+static bool gl_check_program(pl_gpu gpu, GLuint prog, GLuint shaders[2])
+{
+    const gl_funcs *gl = gl_funcs_get(gpu);
+    bool ok = true;
+    for (int i = 0; i < 2; i++) {
+        if (!shaders[i])
+            continue;
+        ok &= gl_check_shader(gpu, shaders[i]);
+        gl->DeleteShader(shaders[i]);
+        shaders[i] = 0;
+    }
+
     GLint status = 0;
     gl->GetProgramiv(prog, GL_LINK_STATUS, &status);
     GLint log_length = 0;
@@ -154,20 +180,19 @@ static GLuint gl_compile_program(pl_gpu gpu, const struct pl_pass_params *params
         pl_free(logstr);
     }
 
-    if (!gl_check_err(gpu, "gl_compile_program: link program"))
-        goto error;
-
-    return prog;
+    if (!ok || !status || !gl_check_err(gpu, "gl_check_program: link program")) {
+        PL_ERR(gpu, "Failed compiling/linking GLSL program");
+        return false;
+    }
 
-error:
-    gl->DeleteProgram(prog);
-    PL_ERR(gpu, "Failed compiling/linking GLSL program");
-    return 0;
+    return true;
 }
 
 // For pl_pass.priv
 struct pl_pass_gl {
     GLuint program;
+    GLuint shaders[2];  // while compiling
+    bool pending;       // program not yet checked, see `gl_pass_finalize`
     GLuint vao;         // the VAO object
     uint64_t vao_id;    // buf_gl.id of VAO
     size_t vao_offset;  // VBO offset of VAO
@@ -185,6 +210,8 @@ void gl_pass_destroy(pl_gpu gpu, pl_pass pass)
     }
 
     struct pl_pass_gl *pass_gl = PL_PRIV(pass);
+    for (int i = 0; i < PL_ARRAY_SIZE(pass_gl->shaders); i++)
+        gl->DeleteShader(pass_gl->shaders[i]);
     if (pass_gl->vao)
         gl->DeleteVertexArrays(1, &pass_gl->vao);
     gl->DeleteBuffers(1, &pass_gl->index_buffer);
@@ -227,29 +254,25 @@ static void gl_update_va(pl_gpu gpu, pl_pass pass, size_t vbo_offset)
     }
 }
 
-pl_pass gl_pass_create(pl_gpu gpu, const struct pl_pass_params *params)
+// Waits for the program to finish linking, and finishes initializing the pass
+// accordingly. Must be called with the context current. On failure, the
+// program is released, so the pass can no longer be used.
+static bool gl_pass_finalize(pl_gpu gpu, pl_pass pass)
 {
     const gl_funcs *gl = gl_funcs_get(gpu);
-    if (!MAKE_CURRENT())
-        return NULL;
-
-    struct pl_gl *p = PL_PRIV(gpu);
-    struct pl_pass_t *pass = pl_zalloc_obj(NULL, pass, struct pl_pass_gl);
     struct pl_pass_gl *pass_gl = PL_PRIV(pass);
-    pass->params = pl_pass_params_copy(pass, params);
+    const struct pl_pass_params *params = &pass->params;
+    pl_assert(pass_gl->pending);
+    pass_gl->pending = false;
 
-    // Load/Compile program
-    if ((pass_gl->program = load_cached_program(gpu, params))) {
-        PL_DEBUG(gpu, "Using cached GL program");
-    } else {
+    if (pass_gl->shaders[0]) {
         clock_t start = clock();
-        pass_gl->program = gl_compile_program(gpu, params);
+        bool ok = gl_check_program(gpu, pass_gl->program, pass_gl->shaders);
         pl_log_cpu_time(gpu->log, start, clock(), "compiling shader");
+        if (!ok)
+            goto error;
     }
 
-    if (!pass_gl->program)
-        goto error;
-
     // Update program cache if possible
     if (gl_test_ext(gpu, "GL_ARB_get_program_binary", 41, 30)) {
         GLint size = 0;
@@ -337,6 +360,34 @@ pl_pass gl_pass_create(pl_gpu gpu, const struct pl_pass_params *params)
     }
 
     gl->UseProgram(0);
+    return true;
+
+error:
+    gl->DeleteProgram(pass_gl->program);
+    pass_gl->program = 0;
+    return false;
+}
+
+pl_pass gl_pass_create(pl_gpu gpu, const struct pl_pass_params *params)
+{
+    const gl_funcs *gl = gl_funcs_get(gpu);
+    if (!MAKE_CURRENT())
+        return NULL;
+
+    struct pl_gl *p = PL_PRIV(gpu);
+    struct pl_pass_t *pass = pl_zalloc_obj(NULL, pass, struct pl_pass_gl);
+    struct pl_pass_gl *pass_gl = PL_PRIV(pass);
+    pass->params = pl_pass_params_copy(pass, params);
+
+    // Load/Compile program
+    if ((pass_gl->program = load_cached_program(gpu, params))) {
+        PL_DEBUG(gpu, "Using cached GL program");
+    } else {
+        pass_gl->program = gl_compile_program(gpu, params, pass_gl->shaders);
+    }
+
+    if (!pass_gl->program)
+        goto error;
 
     // Initialize the VAO and single vertex buffer
     gl->GenBuffers(1, &pass_gl->buffer);
@@ -352,6 +403,12 @@ pl_pass gl_pass_create(pl_gpu gpu, const struct pl_pass_params *params)
     if (!gl_check_err(gpu, "gl_pass_create"))
         goto error;
 
+    // If the driver compiles programs in parallel, avoid blocking on the
+    // result until `gl_pass_wait`, see `pl_pass_create_async`
+    pass_gl->pending = true;
+    if (!p->has_parallel_compile && !gl_pass_finalize(gpu, pass))
+        goto error;
+
     RELEASE_CURRENT();
     return pass;
 
@@ -362,6 +419,19 @@ error:
     return NULL;
 }
 
+bool gl_pass_wait(pl_gpu gpu, pl_pass pass)
+{
+    struct pl_pass_gl *pass_gl = PL_PRIV(pass);
+    if (!pass_gl->pending)
+        return pass_gl->program;
+    if (!MAKE_CURRENT())
+        return false;
+
+    bool ok = gl_pass_finalize(gpu, pass);
+    RELEASE_CURRENT();
+    return ok;
+}
+
 static void update_var(pl_gpu gpu, pl_pass pass,
                        const struct pl_var_update *vu)
 {
@@ -489,7 +559,8 @@ static void update_desc(pl_gpu gpu, pl_pass pass, int index,
         pl_buf buf = db->object;
         struct pl_buf_gl *buf_gl = PL_PRIV(buf);
         gl->BindBufferRange(GL_UNIFORM_BUFFER, desc->binding, buf_gl->buffer,
-                            buf_gl->offset, buf->params.size);
+                            buf_gl->offset + db->buf_offset,
+                            PL_DEF(db->buf_size, buf->params.size - db->buf_offset));
         return;
     }
     case PL_DESC_BUF_STORAGE: {
@@ -534,9 +605,18 @@ static void unbind_desc(pl_gpu gpu, pl_pass pass, int index,
             gl->MemoryBarrier(tex_gl->barrier);
         return;
     }
-    case PL_DESC_BUF_UNIFORM:
+    case PL_DESC_BUF_UNIFORM: {
+        pl_buf buf = db->object;
+        struct pl_buf_gl *buf_gl = PL_PRIV(buf);
         gl->BindBufferBase(GL_UNIFORM_BUFFER, desc->binding, 0);
+        if (buf->params.host_mapped) {
+            // Make sure persistently mapped UBOs are not rewritten until GL
+            // is done reading from them, same as for PBOs
+            gl->DeleteSync(buf_gl->fence);
+            buf_gl->fence = gl->FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
         return;
+    }
     case PL_DESC_BUF_STORAGE: {
         pl_buf buf = db->object;
         struct pl_buf_gl *buf_gl = PL_PRIV(buf);
@@ -566,6 +646,13 @@ void gl_pass_run(pl_gpu gpu, const struct pl_pass_run_params *params)
     struct pl_pass_gl *pass_gl = PL_PRIV(pass);
     struct pl_gl *p = PL_PRIV(gpu);
 
+    if (pass_gl->pending && !gl_pass_finalize(gpu, pass))
+        PL_ERR(gpu, "Failed compiling pass, skipping");
+    if (!pass_gl->program) {
+        RELEASE_CURRENT();
+        return;
+    }
+
     gl->UseProgram(pass_gl->program);
 
     for (int i = 0; i < params->num_var_updates; i++)
@@ -876,23 +876,34 @@ bool gl_tex_upload(pl_gpu gpu, const struct pl_tex_transfer_params *params)
     struct pl_tex_gl *tex_gl = PL_PRIV(tex);
     struct pl_buf_gl *buf_gl = buf ? PL_PRIV(buf) : NULL;
 
-    // If the user requests asynchronous uploads, it's more efficient to do
-    // them via a PBO - this allows us to skip blocking the caller, especially
-    // when the host pointer can be imported directly.
-    if (params->callback && !buf) {
-        size_t buf_size = pl_tex_transfer_size(params);
-        const size_t min_size = 32*1024; // 32 KiB
-        if (buf_size >= min_size && buf_size <= gpu->limits.max_buf_size)
-            return pl_tex_upload_pbo(gpu, params);
-    }
-
     if (!MAKE_CURRENT())
         return false;
 
     uintptr_t src = (uintptr_t) params->ptr;
+    bool use_ring = false;
     if (buf) {
         gl->BindBuffer(GL_PIXEL_UNPACK_BUFFER, buf_gl->buffer);
         src = buf_gl->offset + params->buf_offset;
+    } else {
+        // Prefer staging the data in the upload ring if possible, which
+        // avoids both a driver-side copy and creating a new PBO
+        size_t buf_size = pl_tex_transfer_size(params), ring_offset;
+        void *ring_ptr = gl_ring_alloc(gpu, buf_size, &ring_offset);
+        if (ring_ptr) {
+            memcpy(ring_ptr, params->ptr, buf_size);
+            gl->BindBuffer(GL_PIXEL_UNPACK_BUFFER, p->ring.buffer);
+            src = ring_offset;
+            use_ring = true;
+        } else if (params->callback) {
+            // If the user requests asynchronous uploads, it's more efficient
+            // to do them via a PBO - this allows us to skip blocking the
+            // caller, especially when the host pointer can be imported
+            const size_t min_size = 32*1024; // 32 KiB
+            if (buf_size >= min_size && buf_size <= gpu->limits.max_buf_size) {
+                RELEASE_CURRENT();
+                return pl_tex_upload_pbo(gpu, params);
+            }
+        }
     }
 
     bool misaligned = params->row_pitch % fmt->texel_size;
@@ -950,6 +961,9 @@ bool gl_tex_upload(pl_gpu gpu, const struct pl_tex_transfer_params *params)
     gl->PixelStorei(GL_UNPACK_ROW_LENGTH, 0);
     gl->PixelStorei(GL_UNPACK_IMAGE_HEIGHT, 0);
 
+    if (use_ring)
+        gl->BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
     if (buf) {
         gl->BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
         if (buf->params.host_mapped) {
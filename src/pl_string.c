@@ -240,11 +240,23 @@ struct pl_str_builder_t {
     PL_ARRAY(pl_str_template) templates;
     pl_str args;
     pl_str output;
+
+    // Running hash over all templates up to `num_hashed`, and their arguments
+    // up to `args_hashed`. This is a polynomial hash over the hashes of the
+    // individual templates, so hashes of concatenated builders can be combined
+    // in constant time: H(a + b) = H(a) * pow(b) + H(b)
+    uint64_t hash;
+    uint64_t pow; // HASH_BASE ^ (number of hashed templates)
+    int num_hashed;
+    size_t args_hashed;
 };
 
+#define HASH_BASE 0x9e3779b97f4a7c15ULL
+
 pl_str_builder pl_str_builder_alloc(void *alloc)
 {
     pl_str_builder b = pl_zalloc_ptr(alloc, b);
+    b->pow = 1;
     return b;
 }
 
@@ -260,27 +272,48 @@ void pl_str_builder_reset(pl_str_builder b)
         .templates.elem = b->templates.elem,
         .args.buf       = b->args.buf,
         .output.buf     = b->output.buf,
+        .pow            = 1,
     };
 }
 
+// Fold the most recently appended template (if any) into the running hash
+static void update_hash(pl_str_builder b)
+{
+    if (b->num_hashed == b->templates.num)
+        return;
+
+    // Templates are hashed on every append, so at most one can be pending
+    pl_assert(b->num_hashed == b->templates.num - 1);
+    pl_str args = pl_str_drop(b->args, b->args_hashed);
+    uint64_t hash = pl_str_hash(args);
+    pl_hash_merge(&hash, (uintptr_t) b->templates.elem[b->num_hashed]);
+
+    b->hash = b->hash * HASH_BASE + hash;
+    b->pow *= HASH_BASE;
+    b->num_hashed = b->templates.num;
+    b->args_hashed = b->args.len;
+}
+
 uint64_t pl_str_builder_hash(const pl_str_builder b)
 {
-    size_t size = b->templates.num * sizeof(b->templates.elem[0]);
-    uint64_t hash = pl_mem_hash(b->templates.elem, size);
-    pl_hash_merge(&hash, pl_str_hash(b->args));
-    return hash;
+    update_hash(b);
+    return b->hash;
 }
 
-pl_str pl_str_builder_exec(pl_str_builder b)
+static void exec_templates(const pl_str_builder b, void *alloc, pl_str *out)
 {
     pl_str args = b->args;
-
-    b->output.len = 0;
     for (int i = 0; i < b->templates.num; i++) {
-        size_t consumed = b->templates.elem[i](b, &b->output, args.buf);
+        size_t consumed = b->templates.elem[i](alloc, out, args.buf);
         pl_assert(consumed <= args.len);
         args = pl_str_drop(args, consumed);
     }
+}
+
+pl_str pl_str_builder_exec(pl_str_builder b)
+{
+    b->output.len = 0;
+    exec_templates(b, b, &b->output);
 
     // Terminate with an extra \0 byte for convenience
     grow_str(b, &b->output, b->output.len + 1);
@@ -291,14 +324,43 @@ pl_str pl_str_builder_exec(pl_str_builder b)
 void pl_str_builder_append(pl_str_builder b, pl_str_template tmpl,
                            const void *args, size_t size)
 {
+    update_hash(b);
     PL_ARRAY_APPEND(b, b->templates, tmpl);
     pl_str_append_raw(b, &b->args, args, size);
 }
 
+// Combine the hash of `append` into `b`, after appending its contents
+static void concat_hash(pl_str_builder b, const pl_str_builder append)
+{
+    update_hash(append);
+    b->hash = b->hash * append->pow + append->hash;
+    b->pow *= append->pow;
+    b->num_hashed = b->templates.num;
+    b->args_hashed = b->args.len;
+}
+
 void pl_str_builder_concat(pl_str_builder b, const pl_str_builder append)
 {
+    update_hash(b);
     PL_ARRAY_CONCAT(b, b->templates, append->templates);
     pl_str_append_raw(b, &b->args, append->args.buf, append->args.len);
+    concat_hash(b, append);
+}
+
+static size_t template_builder(void *alloc, pl_str *buf, const uint8_t *args)
+{
+    pl_str_builder ref;
+    memcpy(&ref, args, sizeof(ref));
+    exec_templates(ref, alloc, buf);
+    return sizeof(ref);
+}
+
+void pl_str_builder_concat_ref(pl_str_builder b, const pl_str_builder ref)
+{
+    update_hash(b);
+    PL_ARRAY_APPEND(b, b->templates, template_builder);
+    pl_str_append_raw(b, &b->args, &ref, sizeof(ref));
+    concat_hash(b, ref);
 }
 
 static size_t template_str_ptr(void *alloc, pl_str *buf, const uint8_t *args)
@@ -73,6 +73,9 @@ int pl_str_sscanf(pl_str str, const char *fmt, ...);
 //
 // NOTE: These only support a small handful of modifiers. Check `format.c`
 // for a list. Calling them on an invalid string will abort!
+//
+// Unlike printf, `%f` prints the shortest representation that round-trips,
+// always formatted as a valid GLSL float literal (e.g. "1.0", "1e-7").
 void pl_str_append_asprintf_c(void *alloc, pl_str *str, const char *fmt, ...)
     PL_PRINTF(3, 4);
 void pl_str_append_vasprintf_c(void *alloc, pl_str *str, const char *fmt, va_list va)
@@ -167,7 +170,7 @@ static inline pl_str pl_str_getline(pl_str str, pl_str *out_rest)
 // ignored. When successful, this allocates a new array to store the output.
 bool pl_str_decode_hex(void *alloc, pl_str hex, pl_str *out);
 
-// Compute a fast 64-bit hash
+// Compute a fast (non-cryptographic) 64-bit hash
 uint64_t pl_mem_hash(const void *mem, size_t size);
 static inline void pl_hash_merge(uint64_t *accum, uint64_t hash) {
     *accum ^= hash + 0x9e3779b9 + (*accum << 6) + (*accum >> 2);
@@ -279,7 +282,8 @@ void pl_str_builder_reset(pl_str_builder builder);
 
 // Returns a representative hash of the string builder's output, without
 // actually executing it. Note that this is *not* the same as a pl_str_hash of
-// the string builder's output.
+// the string builder's output. This is maintained incrementally, so the cost
+// of this function does not depend on the size of the builder.
 //
 // Note also that the output of this may not survive a process restart because
 // of position-independent code and address randomization moving around the
@@ -301,6 +305,11 @@ void pl_str_builder_append(pl_str_builder builder, pl_str_template tmpl,
 // Append an entire other `pl_str_builder` onto `builder`
 void pl_str_builder_concat(pl_str_builder builder, const pl_str_builder append);
 
+// Append a reference to another `pl_str_builder` onto `builder`, without
+// copying its contents. `ref` must outlive `builder` and must not be modified
+// for as long as `builder` is still being used.
+void pl_str_builder_concat_ref(pl_str_builder builder, const pl_str_builder ref);
+
 // Append a constant string. This will only record &str into the buffer, which
 // may have a number of unwanted consequences if the memory pointed at by
 // `str` mutates at any point in time in the future, or if `str` is not
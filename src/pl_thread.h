@@ -37,6 +37,11 @@ int pl_mutex_destroy(pl_mutex *mutex);
 int pl_mutex_lock(pl_mutex *mutex);
 int pl_mutex_unlock(pl_mutex *mutex);
 
+// Returns 0 if the mutex was acquired, or nonzero if it is held by another
+// thread. Like `pl_mutex_lock`, this succeeds for recursive mutexes already
+// held by the calling thread.
+int pl_mutex_trylock(pl_mutex *mutex);
+
 typedef void pl_cond;
 int pl_cond_init(pl_cond *cond);
 int pl_cond_destroy(pl_cond *cond);
@@ -52,6 +57,12 @@ typedef void pl_static_mutex;
 int pl_static_mutex_lock(pl_static_mutex *mutex);
 int pl_static_mutex_unlock(pl_static_mutex *mutex);
 
+typedef void pl_thread;
+#define PL_THREAD_VOID void
+#define PL_THREAD_RETURN() return
+int pl_thread_create(pl_thread *thread, PL_THREAD_VOID (*fun)(void *), void *arg);
+int pl_thread_join(pl_thread thread);
+
 #endif
 
 // Actual platform-specific implementation
@@ -62,3 +73,35 @@ int pl_static_mutex_unlock(pl_static_mutex *mutex);
 #else
 #error No threading implementation available!
 #endif
+
+#include <stdbool.h>
+
+#include "pl_alloc.h"
+
+// Runs `fun` on each of the `num` elements of the array `args`, which are
+// `stride` bytes apart (0 to pass the same argument to every call). The first
+// element is run on the calling thread, and every other one on a new thread,
+// or on the calling thread after the first if spawning a thread failed.
+// Returns once all of them have completed.
+static inline void pl_thread_fan_out(PL_THREAD_VOID (*fun)(void *), void *args,
+                                     size_t stride, int num)
+{
+    if (num <= 0)
+        return;
+
+    pl_thread *threads = (pl_thread *) pl_calloc(NULL, num, sizeof(pl_thread));
+    bool *spawned = (bool *) pl_calloc(threads, num, sizeof(bool));
+    for (int i = 1; i < num; i++)
+        spawned[i] = pl_thread_create(&threads[i], fun, (char *) args + i * stride) == 0;
+
+    fun(args);
+    for (int i = 1; i < num; i++) {
+        if (spawned[i]) {
+            pl_thread_join(threads[i]);
+        } else {
+            fun((char *) args + i * stride);
+        }
+    }
+
+    pl_free(threads);
+}
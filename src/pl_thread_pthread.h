@@ -27,7 +27,9 @@
 typedef pthread_mutex_t pl_mutex;
 typedef pthread_cond_t  pl_cond;
 typedef pthread_mutex_t pl_static_mutex;
+typedef pthread_cond_t  pl_static_cond;
 #define PL_STATIC_MUTEX_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+#define PL_STATIC_COND_INITIALIZER  PTHREAD_COND_INITIALIZER
 
 static inline int pl_mutex_init_type_internal(pl_mutex *mutex, enum pl_mutex_type mtype)
 {
@@ -64,6 +66,7 @@ static inline int pl_mutex_init_type_internal(pl_mutex *mutex, enum pl_mutex_typ
 #define pl_mutex_destroy    pthread_mutex_destroy
 #define pl_mutex_lock       pthread_mutex_lock
 #define pl_mutex_unlock     pthread_mutex_unlock
+#define pl_mutex_trylock    pthread_mutex_trylock
 
 static inline int pl_cond_init(pl_cond *cond)
 {
@@ -116,3 +119,11 @@ static inline int pl_cond_timedwait(pl_cond *cond, pl_mutex *mutex, uint64_t tim
 
 #define pl_static_mutex_lock    pthread_mutex_lock
 #define pl_static_mutex_unlock  pthread_mutex_unlock
+#define pl_static_cond_broadcast pthread_cond_broadcast
+#define pl_static_cond_wait     pthread_cond_wait
+
+typedef pthread_t pl_thread;
+#define PL_THREAD_VOID void *
+#define PL_THREAD_RETURN() return NULL
+#define pl_thread_create(t, f, a) pthread_create(t, NULL, f, a)
+#define pl_thread_join(t) pthread_join(t, NULL)
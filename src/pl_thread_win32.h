@@ -18,6 +18,7 @@
 #pragma once
 
 #include <windows.h>
+#include <process.h>
 #include <stdint.h>
 #include <errno.h>
 
@@ -53,6 +54,11 @@ static inline int pl_mutex_unlock(pl_mutex *mutex)
     return 0;
 }
 
+static inline int pl_mutex_trylock(pl_mutex *mutex)
+{
+    return TryEnterCriticalSection(mutex) ? 0 : EBUSY;
+}
+
 static inline int pl_cond_init(pl_cond *cond)
 {
     InitializeConditionVariable(cond);
@@ -117,3 +123,38 @@ static inline int pl_static_mutex_unlock(pl_static_mutex *mutex)
     ReleaseSRWLockExclusive(mutex);
     return 0;
 }
+
+typedef CONDITION_VARIABLE pl_static_cond;
+#define PL_STATIC_COND_INITIALIZER CONDITION_VARIABLE_INIT
+
+static inline int pl_static_cond_broadcast(pl_static_cond *cond)
+{
+    WakeAllConditionVariable(cond);
+    return 0;
+}
+
+static inline int pl_static_cond_wait(pl_static_cond *cond, pl_static_mutex *mutex)
+{
+    return !SleepConditionVariableSRW(cond, mutex, INFINITE, 0);
+}
+
+typedef HANDLE pl_thread;
+#define PL_THREAD_VOID unsigned __stdcall
+#define PL_THREAD_RETURN() return 0
+
+static inline int pl_thread_create(pl_thread *thread,
+                                   PL_THREAD_VOID (*fun)(void *),
+                                   void *arg)
+{
+    *thread = (HANDLE) _beginthreadex(NULL, 0, fun, arg, 0, NULL);
+    return *thread ? 0 : -1;
+}
+
+static inline int pl_thread_join(pl_thread thread)
+{
+    DWORD ret = WaitForSingleObject(thread, INFINITE);
+    if (ret != WAIT_OBJECT_0)
+        return ret == WAIT_ABANDONED ? EINVAL : EDEADLK;
+    CloseHandle(thread);
+    return 0;
+}
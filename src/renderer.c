@@ -78,6 +78,9 @@ struct pl_renderer_t {
     bool peak_detect_active;
     struct icc_state icc[2];
 
+    // Set while only generating shaders, see `pl_renderer_prewarm`
+    bool prewarm;
+
     // Temporary storage for vertex/index data
     PL_ARRAY(struct osd_vertex) osd_vertices;
     PL_ARRAY(uint16_t) osd_indices;
@@ -1158,8 +1161,33 @@ static void hdr_update_peak(struct pass_state *pass)
         goto cleanup;
     }
 
-    bool ok = pl_shader_detect_peak(img_sh(pass, &pass->img), pass->img.color,
-                                    &rr->tone_map_state, params->peak_detect_params);
+    bool ok;
+    if (rr->gpu->limits.async_compute && pass->fbofmt[4] &&
+        !params->peak_detect_params->allow_delayed)
+    {
+        // The image needs to be materialized before the main scaler in this
+        // case anyway, so run peak detection as a separate pass over the
+        // resulting texture, allowing it to overlap with the scaling pass
+        pl_tex tex = img_tex(pass, &pass->img);
+        if (!tex)
+            goto cleanup;
+
+        pl_shader sh = pl_dispatch_begin(rr->dp);
+        pl_shader_sample_direct(sh, pl_sample_src( .tex = tex ));
+        ok = pl_shader_detect_peak(sh, pass->img.color, &rr->tone_map_state,
+                                   params->peak_detect_params);
+        ok = ok && pl_dispatch_compute(rr->dp, pl_dispatch_compute_params(
+            .shader         = &sh,
+            .width          = tex->params.w,
+            .height         = tex->params.h,
+            .async_compute  = true,
+        ));
+        pl_dispatch_abort(rr->dp, &sh);
+    } else {
+        ok = pl_shader_detect_peak(img_sh(pass, &pass->img), pass->img.color,
+                                   &rr->tone_map_state, params->peak_detect_params);
+    }
+
     if (!ok) {
         PL_WARN(rr, "Failed creating HDR peak detection shader.. disabling");
         rr->errors |= PL_RENDER_ERR_PEAK_DETECT;
@@ -2205,7 +2233,8 @@ static bool pass_output_target(struct pass_state *pass)
     bool flipped_x = dst_rect.x1 < dst_rect.x0,
          flipped_y = dst_rect.y1 < dst_rect.y0;
 
-    if (!params->skip_target_clearing && pl_frame_is_cropped(target))
+    bool clear = !params->skip_target_clearing && !rr->prewarm;
+    if (clear && pl_frame_is_cropped(target))
         pl_frame_clear_rgba(rr->gpu, target, CLEAR_COL(params));
 
     for (int p = 0; p < target->num_planes; p++) {
@@ -2608,10 +2637,20 @@ static bool acquire_frame(struct pass_state *pass, struct pl_frame *frame)
     return frame->acquire(pass->rr->gpu, frame);
 }
 
+// Maximum number of threads to use for compiling shaders in parallel
+#define PREWARM_THREADS 8
+
 static void pass_uninit(struct pass_state *pass)
 {
     pl_renderer rr = pass->rr;
     pl_dispatch_abort(rr->dp, &pass->img.sh);
+
+    // Thread-safe GPUs compile specialized shaders in the background. For
+    // all others, compile any queued up during this frame, only after all of
+    // the frame's work has already been submitted
+    if (pass->params->specialize_frames && !rr->prewarm && !rr->gpu->limits.thread_safe)
+        pl_dispatch_compile(rr->dp, 1);
+
     if (pass->next.release)
         pass->next.release(rr->gpu, &pass->next);
     if (pass->prev.release)
@@ -2779,7 +2818,7 @@ static bool draw_empty_overlays(pl_renderer rr,
                                 const struct pl_frame *ptarget,
                                 const struct pl_render_params *params)
 {
-    if (!params->skip_target_clearing)
+    if (!params->skip_target_clearing && !rr->prewarm)
         pl_frame_clear_rgba(rr->gpu, ptarget, CLEAR_COL(params));
 
     if (!ptarget->num_overlays)
@@ -2835,6 +2874,7 @@ bool pl_render_image(pl_renderer rr, const struct pl_frame *pimage,
 {
     params = PL_DEF(params, &pl_render_default_params);
     pl_dispatch_mark_dynamic(rr->dp, params->dynamic_constants);
+    pl_dispatch_specialize(rr->dp, params->specialize_frames);
     if (!pimage)
         return draw_empty_overlays(rr, ptarget, params);
 
@@ -2867,6 +2907,30 @@ error:
     return false;
 }
 
+bool pl_renderer_prewarm(pl_renderer rr, const struct pl_frame *image,
+                         const struct pl_frame *target,
+                         const struct pl_render_params *params)
+{
+    // Peak detection state is carried over between frames, so generate the
+    // peak detection shaders against a throwaway state object instead
+    pl_shader_obj tone_map_state = rr->tone_map_state;
+    bool peak_detect_active = rr->peak_detect_active;
+    rr->tone_map_state = NULL;
+
+    rr->prewarm = true;
+    pl_dispatch_defer(rr->dp, true);
+    bool ok = pl_render_image(rr, image, target, params);
+    pl_dispatch_defer(rr->dp, false);
+    rr->prewarm = false;
+
+    pl_shader_obj_destroy(&rr->tone_map_state);
+    rr->tone_map_state = tone_map_state;
+    rr->peak_detect_active = peak_detect_active;
+
+    ok &= pl_dispatch_compile(rr->dp, PREWARM_THREADS);
+    return ok;
+}
+
 struct params_info {
     uint64_t hash;
     bool trivial;
@@ -2956,6 +3020,7 @@ static struct params_info render_params_info(const struct pl_render_params *para
 
     // Clear out other irrelevant fields
     CLEAR(params.dynamic_constants);
+    CLEAR(params.specialize_frames);
     CLEAR(params.info_callback);
     CLEAR(params.info_priv);
 
@@ -2975,6 +3040,7 @@ bool pl_render_image_mix(pl_renderer rr, const struct pl_frame_mix *images,
     params = PL_DEF(params, &pl_render_default_params);
     struct params_info par_info = render_params_info(params);
     pl_dispatch_mark_dynamic(rr->dp, params->dynamic_constants);
+    pl_dispatch_specialize(rr->dp, params->specialize_frames);
 
     require(images->num_frames >= 1);
     for (int i = 0; i < images->num_frames - 1; i++)
@@ -63,6 +63,7 @@ pl_shader pl_shader_alloc(pl_log log, const struct pl_shader_params *params)
 
     for (int i = 0; i < PL_ARRAY_SIZE(sh->buffers); i++)
         sh->buffers[i] = pl_str_builder_alloc(sh);
+    sh->description = pl_str_builder_alloc(sh);
 
     // Ensure there's always at least one `tmp` object
     PL_ARRAY_APPEND(sh, sh->tmp, pl_ref_new(NULL));
@@ -111,6 +112,8 @@ void pl_shader_reset(pl_shader sh, const struct pl_shader_params *params)
     memcpy(new.buffers, sh->buffers, sizeof(new.buffers));
     for (int i = 0; i < PL_ARRAY_SIZE(new.buffers); i++)
         pl_str_builder_reset(new.buffers[i]);
+    new.description = sh->description;
+    pl_str_builder_reset(new.description);
 
     *sh = new;
     PL_ARRAY_APPEND(sh, sh->tmp, pl_ref_new(NULL));
@@ -553,6 +556,7 @@ static const char *samplers2D[] = {
 ident_t sh_subpass(pl_shader sh, const pl_shader sub)
 {
     pl_assert(sh->mutable);
+    pl_assert(sub->mutable); // finalized shaders reference their own buffers
 
     if (sh->prefix == sub->prefix) {
         PL_TRACE(sh, "Can't merge shaders: conflicting identifiers!");
@@ -625,8 +629,9 @@ pl_str_builder sh_finalize_internal(pl_shader sh)
     // Padding for readability
     GLSLP("\n");
 
-    // Concatenate everything onto the prelude to form the final output
-    pl_str_builder_concat(sh->buffers[SH_BUF_PRELUDE], sh->buffers[SH_BUF_HEADER]);
+    // Concatenate everything onto the prelude to form the final output. These
+    // are all owned by `sh`, so they can be referenced instead of copied
+    pl_str_builder_concat_ref(sh->buffers[SH_BUF_PRELUDE], sh->buffers[SH_BUF_HEADER]);
 
     sh->res.name = "main";
     ident_t id = sh_fresh_name(sh, &sh->res.name);
@@ -641,16 +646,16 @@ pl_str_builder sh_finalize_internal(pl_shader sh)
               outsigs[sh->res.output], id, insigs[sh->res.input]);
     }
 
-    pl_str_builder_concat(sh->buffers[SH_BUF_PRELUDE], sh->buffers[SH_BUF_BODY]);
-    pl_str_builder_concat(sh->buffers[SH_BUF_PRELUDE], sh->buffers[SH_BUF_FOOTER]);
+    pl_str_builder_concat_ref(sh->buffers[SH_BUF_PRELUDE], sh->buffers[SH_BUF_BODY]);
+    pl_str_builder_concat_ref(sh->buffers[SH_BUF_PRELUDE], sh->buffers[SH_BUF_FOOTER]);
     GLSLP("%s\n}\n\n", retvals[sh->res.output]);
 
     // Generate the pretty description
     sh->res.description = "(unknown shader)";
     if (sh->steps.num) {
-        // Reuse this builder
-        pl_str_builder desc = sh->buffers[SH_BUF_BODY];
-        pl_str_builder_reset(desc);
+        // Can't reuse any of the GLSL buffers, since those are referenced by
+        // the final output
+        pl_str_builder desc = sh->description;
 
         for (int i = 0; i < sh->steps.num; i++) {
             const char *step = sh->steps.elem[i];
@@ -77,6 +77,7 @@ struct pl_shader_t {
     int output_h;
     bool transpose;
     pl_str_builder buffers[SH_BUF_COUNT];
+    pl_str_builder description; // see `sh_finalize_internal`
     enum pl_shader_type type;
     bool flexible_work_groups;
     enum pl_sampler_type sampler_type;
@@ -289,6 +290,11 @@ struct sh_lut_params {
     // rather than being treated as read-only.
     bool dynamic;
 
+    // If set to true, texture LUTs may be shared with all other LUTs on the
+    // same `pl_gpu` that have the same `signature`, which must then uniquely
+    // identify the LUT contents. Incompatible with `dynamic`.
+    bool shared;
+
     // Will be called with a zero-initialized buffer whenever the data needs to
     // be computed, which happens whenever the size is changed, the shader
     // object is invalidated, or `update` is set to true.
@@ -51,6 +51,13 @@ enum shexp_tag {
     SHEXP_VAR, // Arbitrary variable (e.g. shader parameters)
 };
 
+// Special values of `shexp.idx` for SHEXP_TEX_W/H
+enum {
+    SHEXP_TEX_HOOKED = -1,
+    SHEXP_TEX_NATIVE_CROPPED = -2,
+    SHEXP_TEX_OUTPUT = -3,
+};
+
 struct shexp {
     enum shexp_tag tag;
     union {
@@ -58,6 +65,19 @@ struct shexp {
         pl_str varname;
         enum shexp_op op;
     } val;
+
+    // Resolved by `compile_shexpr`. For SHEXP_TEX_W/H, this is either one of
+    // the special SHEXP_TEX_* values or an index into `hook_priv.shexp_tex`.
+    // For SHEXP_VAR, this is an index into `hook_priv.hook_params`, or -1 if
+    // no such parameter exists.
+    int idx;
+};
+
+// A compiled RPN expression
+struct shexp_prog {
+    struct shexp code[MAX_SHEXP_SIZE];
+    int num;
+    const char *err; // static error message, if the expression is malformed
 };
 
 struct custom_shader_hook {
@@ -74,9 +94,9 @@ struct custom_shader_hook {
     int comps;
 
     // Special expressions governing the output size and execution conditions
-    struct shexp width[MAX_SHEXP_SIZE];
-    struct shexp height[MAX_SHEXP_SIZE];
-    struct shexp cond[MAX_SHEXP_SIZE];
+    struct shexp_prog width;
+    struct shexp_prog height;
+    struct shexp_prog cond;
 
     // Special metadata for compute shaders
     bool is_compute;
@@ -84,9 +104,11 @@ struct custom_shader_hook {
     int threads_w, threads_h;   // How many threads form a WG
 };
 
-static bool parse_rpn_shexpr(pl_str line, struct shexp out[MAX_SHEXP_SIZE])
+static bool parse_rpn_shexpr(pl_str line, struct shexp_prog *prog)
 {
+    struct shexp *out = prog->code;
     int pos = 0;
+    *prog = (struct shexp_prog) {0};
 
     while (line.len > 0) {
         pl_str word = pl_str_split_char(line, ' ', &line);
@@ -134,6 +156,7 @@ static bool parse_rpn_shexpr(pl_str line, struct shexp out[MAX_SHEXP_SIZE])
         exp->val.varname = word;
     }
 
+    prog->num = pos;
     return true;
 }
 
@@ -153,9 +176,9 @@ static bool parse_hook(pl_log log, pl_str *body, struct custom_shader_hook *out)
 {
     *out = (struct custom_shader_hook){
         .pass_desc = pl_str0("unknown user shader"),
-        .width = {{ SHEXP_TEX_W, { .varname = pl_str0("HOOKED") }}},
-        .height = {{ SHEXP_TEX_H, { .varname = pl_str0("HOOKED") }}},
-        .cond = {{ SHEXP_CONST, { .cval = 1.0 }}},
+        .width = { .num = 1, .code = {{ SHEXP_TEX_W, { .varname = pl_str0("HOOKED") }}}},
+        .height = { .num = 1, .code = {{ SHEXP_TEX_H, { .varname = pl_str0("HOOKED") }}}},
+        .cond = { .num = 1, .code = {{ SHEXP_CONST, { .cval = 1.0 }}}},
     };
 
     int hook_idx = 0;
@@ -231,7 +254,7 @@ static bool parse_hook(pl_log log, pl_str *body, struct custom_shader_hook *out)
         }
 
         if (pl_str_eatstart0(&line, "WIDTH")) {
-            if (!parse_rpn_shexpr(line, out->width)) {
+            if (!parse_rpn_shexpr(line, &out->width)) {
                 pl_err(log, "Error while parsing WIDTH!");
                 return false;
             }
@@ -239,7 +262,7 @@ static bool parse_hook(pl_log log, pl_str *body, struct custom_shader_hook *out)
         }
 
         if (pl_str_eatstart0(&line, "HEIGHT")) {
-            if (!parse_rpn_shexpr(line, out->height)) {
+            if (!parse_rpn_shexpr(line, &out->height)) {
                 pl_err(log, "Error while parsing HEIGHT!");
                 return false;
             }
@@ -247,7 +270,7 @@ static bool parse_hook(pl_log log, pl_str *body, struct custom_shader_hook *out)
         }
 
         if (pl_str_eatstart0(&line, "WHEN")) {
-            if (!parse_rpn_shexpr(line, out->cond)) {
+            if (!parse_rpn_shexpr(line, &out->cond)) {
                 pl_err(log, "Error while parsing WHEN!");
                 return false;
             }
@@ -890,6 +913,12 @@ struct pass_tex {
     int comps;
 };
 
+// Texture referenced by name in an RPN expression
+struct shexp_tex {
+    pl_str name;
+    pl_tex tex; // current texture with this name, or NULL
+};
+
 struct hook_priv {
     pl_log log;
     pl_gpu gpu;
@@ -904,6 +933,7 @@ struct hook_priv {
     // Dynamic per pass
     enum pl_hook_stage save_stages;
     PL_ARRAY(struct pass_tex) pass_textures;
+    PL_ARRAY(struct shexp_tex) shexp_tex;
     pl_shader trc_helper;
 
     // State for PRNG/frame count
@@ -915,6 +945,8 @@ static void hook_reset(void *priv)
 {
     struct hook_priv *p = priv;
     p->pass_textures.num = 0;
+    for (int i = 0; i < p->shexp_tex.num; i++)
+        p->shexp_tex.elem[i].tex = NULL;
 }
 
 // Context during execution of a hook
@@ -924,53 +956,124 @@ struct hook_ctx {
     struct pass_tex hooked;
 };
 
-static bool lookup_tex(struct hook_ctx *ctx, pl_str var, float size[2])
+// Resolves all texture and variable names in an expression to indices, and
+// statically validates the stack layout. Must be called after all parameters
+// have been parsed, since expressions may refer to parameters defined later.
+static void compile_shexpr(struct hook_priv *p, struct shexp_prog *prog)
 {
-    struct hook_priv *p = ctx->priv;
-    const struct pl_hook_params *params = ctx->params;
+    int depth = 0;
 
-    if (pl_str_equals0(var, "HOOKED")) {
-        pl_assert(ctx->hooked.tex);
-        size[0] = ctx->hooked.tex->params.w;
-        size[1] = ctx->hooked.tex->params.h;
-        return true;
-    }
+    for (int i = 0; i < prog->num; i++) {
+        struct shexp *exp = &prog->code[i];
+        switch (exp->tag) {
+        case SHEXP_CONST:
+            depth++;
+            continue;
 
-    if (pl_str_equals0(var, "NATIVE_CROPPED")) {
-        size[0] = fabs(pl_rect_w(params->src_rect));
-        size[1] = fabs(pl_rect_h(params->src_rect));
-        return true;
-    }
+        case SHEXP_OP1:
+        case SHEXP_OP2: {
+            int args = exp->tag == SHEXP_OP2 ? 2 : 1;
+            if (depth < args) {
+                prog->err = "Stack underflow in RPN expression!";
+                return;
+            }
+            depth -= args - 1;
+            continue;
+        }
 
-    if (pl_str_equals0(var, "OUTPUT")) {
-        size[0] = abs(pl_rect_w(params->dst_rect));
-        size[1] = abs(pl_rect_h(params->dst_rect));
-        return true;
-    }
+        case SHEXP_TEX_W:
+        case SHEXP_TEX_H: {
+            depth++;
+            pl_str name = exp->val.varname;
+            if (pl_str_equals0(name, "HOOKED")) {
+                exp->idx = SHEXP_TEX_HOOKED;
+                continue;
+            } else if (pl_str_equals0(name, "NATIVE_CROPPED")) {
+                exp->idx = SHEXP_TEX_NATIVE_CROPPED;
+                continue;
+            } else if (pl_str_equals0(name, "OUTPUT")) {
+                exp->idx = SHEXP_TEX_OUTPUT;
+                continue;
+            } else if (pl_str_equals0(name, "MAIN")) {
+                name = pl_str0("MAINPRESUB");
+            }
+
+            for (exp->idx = 0; exp->idx < p->shexp_tex.num; exp->idx++) {
+                if (pl_str_equals(name, p->shexp_tex.elem[exp->idx].name))
+                    break;
+            }
 
-    if (pl_str_equals0(var, "MAIN"))
-        var = pl_str0("MAINPRESUB");
+            if (exp->idx == p->shexp_tex.num) {
+                PL_ARRAY_APPEND(p->alloc, p->shexp_tex, (struct shexp_tex) {
+                    .name = name,
+                });
+            }
+            continue;
+        }
 
-    for (int i = 0; i < p->pass_textures.num; i++) {
-        if (pl_str_equals(var, p->pass_textures.elem[i].name)) {
-            pl_tex tex = p->pass_textures.elem[i].tex;
-            size[0] = tex->params.w;
-            size[1] = tex->params.h;
-            return true;
+        case SHEXP_VAR:
+            depth++;
+            exp->idx = -1;
+            for (int j = 0; j < p->hook_params.num; j++) {
+                if (pl_str_equals0(exp->val.varname, p->hook_params.elem[j].name)) {
+                    exp->idx = j;
+                    break;
+                }
+            }
+            continue;
+
+        case SHEXP_END:
+            break;
         }
+
+        pl_unreachable();
     }
 
-    return false;
+    if (depth != 1)
+        prog->err = "Malformed stack after RPN expression!";
 }
 
-static bool lookup_var(struct hook_ctx *ctx, pl_str var, float *val)
+static bool load_input(struct hook_ctx *ctx, const struct shexp *exp,
+                       float *val)
 {
     struct hook_priv *p = ctx->priv;
-    for (int i = 0; i < p->hook_params.num; i++) {
-        const struct pl_hook_par *hp = &p->hook_params.elem[i];
-        if (!pl_str_equals0(var, hp->name))
-            continue;
+    const struct pl_hook_params *params = ctx->params;
+    const bool w = exp->tag == SHEXP_TEX_W;
+
+    switch (exp->tag) {
+    case SHEXP_TEX_W:
+    case SHEXP_TEX_H:
+        switch (exp->idx) {
+        case SHEXP_TEX_HOOKED:
+            pl_assert(ctx->hooked.tex);
+            *val = w ? ctx->hooked.tex->params.w : ctx->hooked.tex->params.h;
+            return true;
+        case SHEXP_TEX_NATIVE_CROPPED:
+            *val = fabs(w ? pl_rect_w(params->src_rect) : pl_rect_h(params->src_rect));
+            return true;
+        case SHEXP_TEX_OUTPUT:
+            *val = abs(w ? pl_rect_w(params->dst_rect) : pl_rect_h(params->dst_rect));
+            return true;
+        }
+
+        pl_tex tex = p->shexp_tex.elem[exp->idx].tex;
+        if (!tex) {
+            PL_WARN(p, "Variable '%.*s' not found in RPN expression!",
+                    PL_STR_FMT(exp->val.varname));
+            return false;
+        }
 
+        *val = w ? tex->params.w : tex->params.h;
+        return true;
+
+    case SHEXP_VAR:
+        if (exp->idx < 0) {
+            PL_WARN(p, "Variable '%.*s' not found in RPN expression!",
+                    PL_STR_FMT(exp->val.varname));
+            return false;
+        }
+
+        const struct pl_hook_par *hp = &p->hook_params.elem[exp->idx];
         switch (hp->type) {
         case PL_VAR_SINT:  *val = hp->data->i; return true;
         case PL_VAR_UINT:  *val = hp->data->u; return true;
@@ -981,56 +1084,59 @@ static bool lookup_var(struct hook_ctx *ctx, pl_str var, float *val)
         }
 
         pl_unreachable();
+
+    case SHEXP_END:
+    case SHEXP_CONST:
+    case SHEXP_OP1:
+    case SHEXP_OP2:
+        break;
     }
 
-    PL_WARN(p, "Variable '%.*s' not found in RPN expression!", PL_STR_FMT(var));
-    return false;
+    pl_unreachable();
 }
 
 // Returns whether successful. 'result' is left untouched on failure
-static bool eval_shexpr(struct hook_ctx *ctx,
-                        const struct shexp expr[MAX_SHEXP_SIZE],
+static bool eval_shexpr(struct hook_ctx *ctx, const struct shexp_prog *prog,
                         float *result)
 {
     struct hook_priv *p = ctx->priv;
-    float stack[MAX_SHEXP_SIZE] = {0};
-    int idx = 0; // points to next element to push
+    if (prog->err) {
+        PL_WARN(p, "%s", prog->err);
+        return false;
+    }
 
-    for (int i = 0; i < MAX_SHEXP_SIZE; i++) {
-        switch (expr[i].tag) {
-        case SHEXP_END:
-            goto done;
+    // The stack layout was already validated by `compile_shexpr`, so
+    // underflow/overflow is impossible here
+    float stack[MAX_SHEXP_SIZE];
+    int idx = 0; // points to next element to push
 
+    for (int i = 0; i < prog->num; i++) {
+        const struct shexp *exp = &prog->code[i];
+        switch (exp->tag) {
         case SHEXP_CONST:
-            // Since our SHEXPs are bound by MAX_SHEXP_SIZE, it should be
-            // impossible to overflow the stack
-            assert(idx < MAX_SHEXP_SIZE);
-            stack[idx++] = expr[i].val.cval;
+            stack[idx++] = exp->val.cval;
             continue;
 
-        case SHEXP_OP1:
-            if (idx < 1) {
-                PL_WARN(p, "Stack underflow in RPN expression!");
+        case SHEXP_TEX_W:
+        case SHEXP_TEX_H:
+        case SHEXP_VAR:
+            if (!load_input(ctx, exp, &stack[idx++]))
                 return false;
-            }
+            continue;
 
-            switch (expr[i].val.op) {
+        case SHEXP_OP1:
+            switch (exp->val.op) {
             case SHEXP_OP_NOT: stack[idx-1] = !stack[idx-1]; break;
             default: pl_unreachable();
             }
             continue;
 
-        case SHEXP_OP2:
-            if (idx < 2) {
-                PL_WARN(p, "Stack underflow in RPN expression!");
-                return false;
-            }
-
+        case SHEXP_OP2: {
             // Pop the operands in reverse order
             float op2 = stack[--idx];
             float op1 = stack[--idx];
             float res = 0.0;
-            switch (expr[i].val.op) {
+            switch (exp->val.op) {
             case SHEXP_OP_ADD: res = op1 + op2; break;
             case SHEXP_OP_SUB: res = op1 - op2; break;
             case SHEXP_OP_MUL: res = op1 * op2; break;
@@ -1049,40 +1155,16 @@ static bool eval_shexpr(struct hook_ctx *ctx,
 
             stack[idx++] = res;
             continue;
-
-        case SHEXP_TEX_W:
-        case SHEXP_TEX_H: {
-            pl_str name = expr[i].val.varname;
-            float size[2];
-
-            if (!lookup_tex(ctx, name, size)) {
-                PL_WARN(p, "Variable '%.*s' not found in RPN expression!",
-                        PL_STR_FMT(name));
-                return false;
-            }
-
-            stack[idx++] = (expr[i].tag == SHEXP_TEX_W) ? size[0] : size[1];
-            continue;
         }
 
-        case SHEXP_VAR: {
-            pl_str name = expr[i].val.varname;
-            float val;
-            if (!lookup_var(ctx, name, &val))
-                return false;
-            stack[idx++] = val;
-            continue;
-        }
+        case SHEXP_END:
+            break;
         }
-    }
 
-done:
-    // Return the single stack element
-    if (idx != 1) {
-        PL_WARN(p, "Malformed stack after RPN expression!");
-        return false;
+        pl_unreachable();
     }
 
+    pl_assert(idx == 1);
     *result = stack[0];
     return true;
 }
@@ -1182,6 +1264,12 @@ static bool bind_pass_tex(pl_shader sh, pl_str name,
 
 static void save_pass_tex(struct hook_priv *p, struct pass_tex ptex)
 {
+    for (int i = 0; i < p->shexp_tex.num; i++) {
+        if (pl_str_equals(p->shexp_tex.elem[i].name, ptex.name)) {
+            p->shexp_tex.elem[i].tex = ptex.tex;
+            break;
+        }
+    }
 
     for (int i = 0; i < p->pass_textures.num; i++) {
         if (!pl_str_equals(p->pass_textures.elem[i].name, ptex.name))
@@ -1223,17 +1311,17 @@ static struct pl_hook_res hook_hook(void *priv, const struct pl_hook_params *par
     }
 
     for (int n = 0; n < p->hook_passes.num; n++) {
-        const struct hook_pass *pass = &p->hook_passes.elem[n];
+        struct hook_pass *pass = &p->hook_passes.elem[n];
         if (!(pass->exec_stages & params->stage))
             continue;
 
-        const struct custom_shader_hook *hook = &pass->hook;
+        struct custom_shader_hook *hook = &pass->hook;
         PL_TRACE(p, "Executing hook pass %d on stage '%.*s': %.*s",
                  n, PL_STR_FMT(stage), PL_STR_FMT(hook->pass_desc));
 
         // Test for execution condition
         float run = 0;
-        if (!eval_shexpr(&ctx, hook->cond, &run))
+        if (!eval_shexpr(&ctx, &hook->cond, &run))
             goto error;
 
         if (!run) {
@@ -1418,8 +1506,8 @@ static struct pl_hook_res hook_hook(void *priv, const struct pl_hook_params *par
 
         // Resolve output size and create framebuffer
         float out_size[2] = {0};
-        if (!eval_shexpr(&ctx, hook->width,  &out_size[0]) ||
-            !eval_shexpr(&ctx, hook->height, &out_size[1]))
+        if (!eval_shexpr(&ctx, &hook->width,  &out_size[0]) ||
+            !eval_shexpr(&ctx, &hook->height, &out_size[1]))
         {
             goto error;
         }
@@ -1650,17 +1738,17 @@ const struct pl_hook *pl_mpv_user_shader_parse(pl_gpu gpu,
         // dst_rect even before it was hooked. (This is an apparently
         // undocumented mpv quirk, but shaders rely on it in practice)
         enum pl_hook_stage rpn_stages = 0;
-        for (int i = 0; i < PL_ARRAY_SIZE(h.width); i++) {
-            if (h.width[i].tag == SHEXP_TEX_W || h.width[i].tag == SHEXP_TEX_H)
-                rpn_stages |= mp_stage_to_pl(h.width[i].val.varname);
+        for (int i = 0; i < h.width.num; i++) {
+            if (h.width.code[i].tag == SHEXP_TEX_W || h.width.code[i].tag == SHEXP_TEX_H)
+                rpn_stages |= mp_stage_to_pl(h.width.code[i].val.varname);
         }
-        for (int i = 0; i < PL_ARRAY_SIZE(h.height); i++) {
-            if (h.height[i].tag == SHEXP_TEX_W || h.height[i].tag == SHEXP_TEX_H)
-                rpn_stages |= mp_stage_to_pl(h.height[i].val.varname);
+        for (int i = 0; i < h.height.num; i++) {
+            if (h.height.code[i].tag == SHEXP_TEX_W || h.height.code[i].tag == SHEXP_TEX_H)
+                rpn_stages |= mp_stage_to_pl(h.height.code[i].val.varname);
         }
-        for (int i = 0; i < PL_ARRAY_SIZE(h.cond); i++) {
-            if (h.cond[i].tag == SHEXP_TEX_W || h.cond[i].tag == SHEXP_TEX_H)
-                rpn_stages |= mp_stage_to_pl(h.cond[i].val.varname);
+        for (int i = 0; i < h.cond.num; i++) {
+            if (h.cond.code[i].tag == SHEXP_TEX_W || h.cond.code[i].tag == SHEXP_TEX_H)
+                rpn_stages |= mp_stage_to_pl(h.cond.code[i].val.varname);
         }
 
         p->save_stages |= rpn_stages & ~PL_HOOK_OUTPUT;
@@ -1669,6 +1757,15 @@ const struct pl_hook *pl_mpv_user_shader_parse(pl_gpu gpu,
         PL_ARRAY_APPEND(hook, p->hook_passes, pass);
     }
 
+    // Resolve all names referenced by RPN expressions, now that all
+    // parameters are known
+    for (int i = 0; i < p->hook_passes.num; i++) {
+        struct custom_shader_hook *h = &p->hook_passes.elem[i].hook;
+        compile_shexpr(p, &h->width);
+        compile_shexpr(p, &h->height);
+        compile_shexpr(p, &h->cond);
+    }
+
     // We need to hook on both the exec and save stages, so that we can keep
     // track of any textures we might need
     hook->stages |= p->save_stages;
@@ -150,6 +150,11 @@ void pl_shader_dither(pl_shader sh, int new_depth,
         bool changed = obj->method != method;
         obj->method = method;
 
+        // The dither matrices are fixed, so the LUT textures can be shared
+        // between all dither objects on the same GPU
+        uint64_t signature = pl_str0_hash("pl_shader_dither");
+        pl_hash_merge(&signature, method);
+
         lut_size = 1 << PL_DEF(params->lut_size, 6);
         lut = sh_lut(sh, sh_lut_params(
             .object     = &obj->lut,
@@ -158,6 +163,8 @@ void pl_shader_dither(pl_shader sh, int new_depth,
             .height     = lut_size,
             .comps      = 1,
             .update     = changed,
+            .signature  = signature,
+            .shared     = true,
             .fill       = fill_dither_matrix,
             .priv       = obj,
         ));
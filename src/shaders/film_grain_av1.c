@@ -299,56 +299,119 @@ static struct grain_scale get_grain_scale(const struct pl_film_grain_params *par
     return ret;
 }
 
-// Generates the basic grain table (LumaGrain in the spec).
-static void generate_grain_y(float out[GRAIN_HEIGHT_LUT][GRAIN_WIDTH_LUT],
-                             int16_t buf[GRAIN_HEIGHT][GRAIN_WIDTH],
-                             const struct pl_film_grain_params *params)
+// Fills the top-left `w` x `h` entries of `buf` with the gaussian sequence,
+// rounded to the grain precision. The LFSR is advanced four bits at a time,
+// which is as far as its feedback taps (the latest of which is bit 12) allow.
+static void generate_gaussian(int buf[GRAIN_HEIGHT][GRAIN_WIDTH],
+                              int w, int h, uint16_t seed, int shift)
 {
-    const struct pl_av1_grain_data *data = &params->data.params.av1;
-    struct grain_scale scale = get_grain_scale(params);
-    uint16_t seed = (uint16_t) params->data.seed;
-    int bits = bit_depth(params->repr);
-    int shift = 12 - bits + data->grain_scale_shift;
-    pl_assert(shift >= 0);
-
-    for (int y = 0; y < GRAIN_HEIGHT; y++) {
-        for (int x = 0; x < GRAIN_WIDTH; x++) {
-            int16_t value = gaussian_sequence[ get_random_number(11, &seed) ];
-            buf[y][x] = round2(value, shift);
+    int *out = &buf[0][0];
+    const int num = w * h;
+    uint32_t state = seed;
+    for (int i = 0; i < num; i += 4) {
+        uint32_t bits = (state ^ (state >> 1) ^ (state >> 3) ^ (state >> 12)) & 0xF;
+        state |= bits << 16;
+        for (int j = 0; j < PL_MIN(4, num - i); j++) {
+            int16_t value = gaussian_sequence[(state >> (j + 6)) & 0x7FF];
+            out[i + j] = round2(value, shift);
         }
+        state >>= 4;
     }
 
+    // Spread out the rows to the stride of `buf`, back to front
+    if (w < GRAIN_WIDTH) {
+        for (int y = h - 1; y > 0; y--)
+            memmove(buf[y], &out[y * w], w * sizeof(int));
+    }
+}
+
+// Applies the auto-regressive filter to the grain template, in place. Only
+// the taps to the left of the current entry depend on the results of the
+// same row, so the contributions of all other taps (including the luma
+// grain, if `luma` is set) are accumulated for the entire row at once.
+static void apply_ar_filter(int buf[GRAIN_HEIGHT][GRAIN_WIDTH],
+                            const int luma[GRAIN_HEIGHT][GRAIN_WIDTH],
+                            const int8_t *coeffs, int w, int h,
+                            int sub_x, int sub_y,
+                            const struct pl_av1_grain_data *data,
+                            const struct grain_scale *scale)
+{
     const int ar_pad = 3;
-    int ar_lag = data->ar_coeff_lag;
-
-    for (int y = ar_pad; y < GRAIN_HEIGHT; y++) {
-        for (int x = ar_pad; x < GRAIN_WIDTH - ar_pad; x++) {
-            const int8_t *coeff = data->ar_coeffs_y;
-            int sum = 0;
-            for (int dy = -ar_lag; dy <= 0; dy++) {
-                for (int dx = -ar_lag; dx <= ar_lag; dx++) {
-                    if (!dx && !dy)
-                        break;
-                    sum += *(coeff++) * buf[y + dy][x + dx];
-                }
+    const int lag = data->ar_coeff_lag;
+    const int row_taps = 2 * lag + 1;
+    const int8_t *cur = &coeffs[lag * row_taps];
+    const int x0 = ar_pad, x1 = w - ar_pad;
+    int sum[GRAIN_WIDTH];
+
+    for (int y = ar_pad; y < h; y++) {
+        // Always process the full width, since fixed bounds vectorize better
+        for (int x = ar_pad; x < GRAIN_WIDTH - ar_pad; x++)
+            sum[x] = 0;
+
+        for (int dy = -lag; dy < 0; dy++) {
+            const int8_t *coeff = &coeffs[(dy + lag) * row_taps];
+            const int *row = buf[y + dy];
+            for (int dx = -lag; dx <= lag; dx++) {
+                const int c = coeff[dx + lag];
+                for (int x = ar_pad; x < GRAIN_WIDTH - ar_pad; x++)
+                    sum[x] += c * row[x + dx];
             }
+        }
+
+        if (luma) {
+            const int c = cur[lag];
+            const int *row0 = luma[((y - ar_pad) << sub_y) + ar_pad];
+            const int *row1 = luma[((y - ar_pad) << sub_y) + ar_pad + sub_y];
+            for (int x = x0; x < x1; x++) {
+                int lx = ((x - ar_pad) << sub_x) + ar_pad;
+                int val = row0[lx];
+                if (sub_x)
+                    val += row0[lx + 1];
+                if (sub_y)
+                    val += sub_x ? row1[lx] + row1[lx + 1] : row1[lx];
+                sum[x] += c * round2(val, sub_x + sub_y);
+            }
+        }
 
-            int16_t grain = buf[y][x] + round2(sum, data->ar_coeff_shift);
-            grain = PL_CLAMP(grain, scale.grain_min, scale.grain_max);
-            buf[y][x] = grain;
+        int *row = buf[y];
+        for (int x = x0; x < x1; x++) {
+            int acc = sum[x];
+            for (int dx = -lag; dx < 0; dx++)
+                acc += cur[dx + lag] * row[x + dx];
+
+            int16_t grain = row[x] + round2(acc, data->ar_coeff_shift);
+            row[x] = PL_CLAMP(grain, scale->grain_min, scale->grain_max);
         }
     }
+}
+
+// Generates the basic grain table (LumaGrain in the spec), and crops it to
+// the section needed on the GPU.
+static void generate_grain_y(int16_t out[GRAIN_HEIGHT_LUT * GRAIN_WIDTH_LUT],
+                             int buf[GRAIN_HEIGHT][GRAIN_WIDTH],
+                             const struct pl_film_grain_params *params)
+{
+    const struct pl_av1_grain_data *data = &params->data.params.av1;
+    struct grain_scale scale = get_grain_scale(params);
+    int bits = bit_depth(params->repr);
+    int shift = 12 - bits + data->grain_scale_shift;
+    pl_assert(shift >= 0);
+
+    generate_gaussian(buf, GRAIN_WIDTH, GRAIN_HEIGHT, params->data.seed, shift);
+    apply_ar_filter(buf, NULL, data->ar_coeffs_y, GRAIN_WIDTH, GRAIN_HEIGHT,
+                    0, 0, data, &scale);
+
+    if (!out)
+        return;
 
     for (int y = 0; y < GRAIN_HEIGHT_LUT; y++) {
-        for (int x = 0; x < GRAIN_WIDTH_LUT; x++) {
-            int16_t grain = buf[y + GRAIN_PAD_LUT][x + GRAIN_PAD_LUT];
-            out[y][x] = grain * scale.grain_scale;
-        }
+        for (int x = 0; x < GRAIN_WIDTH_LUT; x++)
+            out[y * GRAIN_WIDTH_LUT + x] = buf[y + GRAIN_PAD_LUT][x + GRAIN_PAD_LUT];
     }
 }
 
-static void generate_grain_uv(float *out, int16_t buf[GRAIN_HEIGHT][GRAIN_WIDTH],
-                              const int16_t buf_y[GRAIN_HEIGHT][GRAIN_WIDTH],
+static void generate_grain_uv(int16_t *out, int buf[GRAIN_HEIGHT][GRAIN_WIDTH],
+                              const int buf_y[GRAIN_HEIGHT][GRAIN_WIDTH],
                               enum pl_channel channel, int sub_x, int sub_y,
                               const struct pl_film_grain_params *params)
 {
@@ -373,50 +436,11 @@ static void generate_grain_uv(float *out, int16_t buf[GRAIN_HEIGHT][GRAIN_WIDTH]
         [PL_CHANNEL_CR] = data->ar_coeffs_uv[1],
     };
 
-    for (int y = 0; y < chromaH; y++) {
-        for (int x = 0; x < chromaW; x++) {
-            int16_t value = gaussian_sequence[ get_random_number(11, &seed) ];
-            buf[y][x] = round2(value, shift);
-        }
-    }
-
-    const int ar_pad = 3;
-    int ar_lag = data->ar_coeff_lag;
-
-    for (int y = ar_pad; y < chromaH; y++) {
-        for (int x = ar_pad; x < chromaW - ar_pad; x++) {
-            const int8_t *coeff = coeffs[channel];
-            pl_assert(coeff);
-            int sum = 0;
-            for (int dy = -ar_lag; dy <= 0; dy++) {
-                for (int dx = -ar_lag; dx <= ar_lag; dx++) {
-                    // For the final (current) pixel, we need to add in the
-                    // contribution from the luma grain texture
-                    if (!dx && !dy) {
-                        if (!data->num_points_y)
-                            break;
-                        int luma = 0;
-                        int lumaX = ((x - ar_pad) << sub_x) + ar_pad;
-                        int lumaY = ((y - ar_pad) << sub_y) + ar_pad;
-                        for (int i = 0; i <= sub_y; i++) {
-                            for (int j = 0; j <= sub_x; j++) {
-                                luma += buf_y[lumaY + i][lumaX + j];
-                            }
-                        }
-                        luma = round2(luma, sub_x + sub_y);
-                        sum += luma * (*coeff);
-                        break;
-                    }
-
-                    sum += *(coeff++) * buf[y + dy][x + dx];
-                }
-            }
-
-            int16_t grain = buf[y][x] + round2(sum, data->ar_coeff_shift);
-            grain = PL_CLAMP(grain, scale.grain_min, scale.grain_max);
-            buf[y][x] = grain;
-        }
-    }
+    // For the final (current) entry, we need to add in the contribution
+    // from the luma grain texture
+    generate_gaussian(buf, chromaW, chromaH, seed, shift);
+    apply_ar_filter(buf, data->num_points_y ? buf_y : NULL, coeffs[channel],
+                    chromaW, chromaH, sub_x, sub_y, data, &scale);
 
     int lutW = GRAIN_WIDTH_LUT >> sub_x;
     int lutH = GRAIN_HEIGHT_LUT >> sub_y;
@@ -424,10 +448,8 @@ static void generate_grain_uv(float *out, int16_t buf[GRAIN_HEIGHT][GRAIN_WIDTH]
     int padY = sub_y ? SUB_GRAIN_PAD_LUT : GRAIN_PAD_LUT;
 
     for (int y = 0; y < lutH; y++) {
-        for (int x = 0; x < lutW; x++) {
-            int16_t grain = buf[y + padY][x + padX];
-            out[y * lutW + x] = grain * scale.grain_scale;
-        }
+        for (int x = 0; x < lutW; x++)
+            out[y * lutW + x] = buf[y + padY][x + padX];
     }
 }
 
@@ -517,6 +539,17 @@ static void sample(pl_shader sh, enum offset off, ident_t lut, int idx,
          lut, idx >= 0 ? index_strs[idx] : "");
 }
 
+// Number of recently generated grain templates to keep around, so that
+// alternating between the grain of a few frames (e.g. when re-rendering
+// frames for interpolation) doesn't require regenerating them every time
+#define GRAIN_CACHE_SIZE 4
+
+struct grain_template {
+    uint64_t key;
+    int16_t y[GRAIN_HEIGHT_LUT * GRAIN_WIDTH_LUT];
+    int16_t uv[2][GRAIN_HEIGHT_LUT * GRAIN_WIDTH_LUT];
+};
+
 struct grain_obj_av1 {
     // LUT objects for the offsets, grain and scaling luts
     pl_shader_obj lut_offsets;
@@ -529,12 +562,16 @@ struct grain_obj_av1 {
     bool fg_has_y;
     bool fg_has_u;
     bool fg_has_v;
+    int sub_x, sub_y;
+
+    // Cache of grain templates, replaced in round-robin order
+    struct grain_template cache[GRAIN_CACHE_SIZE];
+    int num_cached;
+    int cache_idx;
 
     // Space to store the temporary arrays, reused
-    uint32_t *offsets;
-    float grain[2][GRAIN_HEIGHT_LUT][GRAIN_WIDTH_LUT];
-    int16_t grain_tmp_y[GRAIN_HEIGHT][GRAIN_WIDTH];
-    int16_t grain_tmp_uv[GRAIN_HEIGHT][GRAIN_WIDTH];
+    int grain_tmp_y[GRAIN_HEIGHT][GRAIN_WIDTH];
+    int grain_tmp_uv[GRAIN_HEIGHT][GRAIN_WIDTH];
 };
 
 static void av1_grain_uninit(pl_gpu gpu, void *ptr)
@@ -584,11 +621,100 @@ static inline bool av1_grain_data_eq(const struct pl_film_grain_data *da,
            !memcmp(a->ar_coeffs_uv, b->ar_coeffs_uv, sizeof(a->ar_coeffs_uv));
 }
 
-static void fill_grain_lut(void *data, const struct sh_lut_params *params)
+// Uniquely identifies the grain templates generated for the given parameters
+static uint64_t grain_key(const struct pl_film_grain_params *params,
+                          int sub_x, int sub_y,
+                          bool has_y, bool has_u, bool has_v)
+{
+    const struct pl_av1_grain_data *data = &params->data.params.av1;
+    const uint64_t fields[] = {
+        (uint16_t) params->data.seed,
+        bit_depth(params->repr),
+        data->num_points_y > 0,
+        data->ar_coeff_lag,
+        data->ar_coeff_shift,
+        data->grain_scale_shift,
+        sub_x, sub_y,
+        has_y, has_u, has_v,
+    };
+
+    uint64_t key = pl_mem_hash(fields, sizeof(fields));
+    pl_hash_merge(&key, pl_mem_hash(data->ar_coeffs_y, sizeof(data->ar_coeffs_y)));
+    pl_hash_merge(&key, pl_mem_hash(data->ar_coeffs_uv, sizeof(data->ar_coeffs_uv)));
+    return key;
+}
+
+static const struct grain_template *
+get_grain(struct grain_obj_av1 *obj, const struct pl_film_grain_params *params,
+          int sub_x, int sub_y, bool has_y, bool has_u, bool has_v)
+{
+    uint64_t key = grain_key(params, sub_x, sub_y, has_y, has_u, has_v);
+    for (int i = 0; i < obj->num_cached; i++) {
+        if (obj->cache[i].key == key)
+            return &obj->cache[i];
+    }
+
+    struct grain_template *grain = &obj->cache[obj->cache_idx];
+    obj->cache_idx = (obj->cache_idx + 1) % GRAIN_CACHE_SIZE;
+    obj->num_cached = PL_MIN(obj->num_cached + 1, GRAIN_CACHE_SIZE);
+    grain->key = key;
+
+    // The luma grain is also needed for the chroma grain, unless unused
+    const struct pl_av1_grain_data *data = &params->data.params.av1;
+    if (has_y || ((has_u || has_v) && data->num_points_y))
+        generate_grain_y(has_y ? grain->y : NULL, obj->grain_tmp_y, params);
+
+    int chroma_comps = 0;
+    if (has_u) {
+        generate_grain_uv(grain->uv[chroma_comps++], obj->grain_tmp_uv,
+                          obj->grain_tmp_y, PL_CHANNEL_CB, sub_x, sub_y,
+                          params);
+    }
+    if (has_v) {
+        generate_grain_uv(grain->uv[chroma_comps++], obj->grain_tmp_uv,
+                          obj->grain_tmp_y, PL_CHANNEL_CR, sub_x, sub_y,
+                          params);
+    }
+
+    return grain;
+}
+
+struct grain_ctx {
+    struct grain_obj_av1 *obj;
+    const struct pl_film_grain_params *params;
+    int sub_x, sub_y;
+    bool has_y, has_u, has_v;
+};
+
+static void fill_grain(float *out, const int16_t *planes[], int comps,
+                       int entries, const struct pl_film_grain_params *params)
 {
-    struct grain_obj_av1 *obj = params->priv;
-    size_t entries = params->width * params->height * params->comps;
-    memcpy(data, obj->grain, entries * sizeof(float));
+    const float scale = get_grain_scale(params).grain_scale;
+    for (int c = 0; c < comps; c++) {
+        const int16_t *src = planes[c];
+        for (int i = 0; i < entries; i++)
+            out[i * comps + c] = src[i] * scale;
+    }
+}
+
+static void fill_grain_y(void *data, const struct sh_lut_params *params)
+{
+    const struct grain_ctx *ctx = params->priv;
+    const struct grain_template *grain;
+    grain = get_grain(ctx->obj, ctx->params, ctx->sub_x, ctx->sub_y,
+                      ctx->has_y, ctx->has_u, ctx->has_v);
+    fill_grain(data, (const int16_t *[]) { grain->y }, params->comps,
+               params->width * params->height, ctx->params);
+}
+
+static void fill_grain_uv(void *data, const struct sh_lut_params *params)
+{
+    const struct grain_ctx *ctx = params->priv;
+    const struct grain_template *grain;
+    grain = get_grain(ctx->obj, ctx->params, ctx->sub_x, ctx->sub_y,
+                      ctx->has_y, ctx->has_u, ctx->has_v);
+    fill_grain(data, (const int16_t *[]) { grain->uv[0], grain->uv[1] },
+               params->comps, params->width * params->height, ctx->params);
 }
 
 bool pl_shader_fg_av1(pl_shader sh, pl_shader_obj *grain_state,
@@ -656,12 +782,21 @@ bool pl_shader_fg_av1(pl_shader sh, pl_shader_obj *grain_state,
                         !pl_color_repr_equal(params->repr, &obj->repr) ||
                         fg_has_y != obj->fg_has_y ||
                         fg_has_u != obj->fg_has_u ||
-                        fg_has_v != obj->fg_has_v;
-
-    if (needs_update) {
-        // This is needed even for chroma, so statically generate it
-        generate_grain_y(obj->grain[0], obj->grain_tmp_y, params);
-    }
+                        fg_has_v != obj->fg_has_v ||
+                        sub_x != obj->sub_x ||
+                        sub_y != obj->sub_y;
+
+    // The grain templates depend on the seed, so they can't be reused across
+    // frames in general, only if the same frame's grain is needed again
+    struct grain_ctx grain = {
+        .obj = obj,
+        .params = params,
+        .sub_x = sub_x,
+        .sub_y = sub_y,
+        .has_y = fg_has_y,
+        .has_u = fg_has_u,
+        .has_v = fg_has_v,
+    };
 
     ident_t lut[3];
     int idx[3] = {-1};
@@ -676,8 +811,8 @@ bool pl_shader_fg_av1(pl_shader sh, pl_shader_obj *grain_state,
             .comps      = 1,
             .update     = needs_update,
             .dynamic    = true,
-            .fill       = fill_grain_lut,
-            .priv       = obj,
+            .fill       = fill_grain_y,
+            .priv       = &grain,
         ));
 
         if (!lut[0]) {
@@ -688,18 +823,10 @@ bool pl_shader_fg_av1(pl_shader sh, pl_shader_obj *grain_state,
 
     // Try merging the chroma LUTs into a single texture
     int chroma_comps = 0;
-    if (fg_has_u) {
-        generate_grain_uv(&obj->grain[chroma_comps][0][0], obj->grain_tmp_uv,
-                          obj->grain_tmp_y, PL_CHANNEL_CB, sub_x, sub_y,
-                          params);
+    if (fg_has_u)
         idx[1] = chroma_comps++;
-    }
-    if (fg_has_v) {
-        generate_grain_uv(&obj->grain[chroma_comps][0][0], obj->grain_tmp_uv,
-                          obj->grain_tmp_y, PL_CHANNEL_CR, sub_x, sub_y,
-                          params);
+    if (fg_has_v)
         idx[2] = chroma_comps++;
-    }
 
     if (chroma_comps > 0) {
         lut[1] = lut[2] = sh_lut(sh, sh_lut_params(
@@ -711,8 +838,8 @@ bool pl_shader_fg_av1(pl_shader sh, pl_shader_obj *grain_state,
             .comps      = chroma_comps,
             .update     = needs_update,
             .dynamic    = true,
-            .fill       = fill_grain_lut,
-            .priv       = obj,
+            .fill       = fill_grain_uv,
+            .priv       = &grain,
         ));
 
         if (!lut[1]) {
@@ -812,6 +939,8 @@ bool pl_shader_fg_av1(pl_shader sh, pl_shader_obj *grain_state,
     obj->fg_has_y = fg_has_y;
     obj->fg_has_u = fg_has_u;
     obj->fg_has_v = fg_has_v;
+    obj->sub_x = sub_x;
+    obj->sub_y = sub_y;
 
     sh_describe(sh, "AV1 film grain");
     GLSL("vec4 color;                   \n"
@@ -17,6 +17,7 @@
 
 #include "shaders.h"
 #include "film_grain.h"
+#include "pl_thread.h"
 
 static const int8_t Gaussian_LUT[2048+4];
 static const uint32_t Seed_LUT[256];
@@ -31,18 +32,48 @@ static void prng_shift(uint32_t *state)
 }
 
 
-static void generate_slice(float *out, size_t out_width, uint8_t h, uint8_t v,
-                           int8_t grain[64][64], int16_t tmp[64][64])
+// Computes `out[k] = sum_j R64T[k][j] * in[j]` for all `k < 64 / step`, over
+// all `j < n` that are multiples of `step`. The even and odd basis functions
+// are respectively symmetric and antisymmetric around the center, so this is
+// split into an (even) transform of half the size, and the odd terms of only
+// half of the outputs. Since this is integer arithmetic, the result is
+// identical to that of a direct matrix multiplication.
+static void idct_part(int32_t *out, const int32_t *in, int n, int step)
+{
+    const int size = 64 / step;
+    if (size == 1) {
+        out[0] = R64T[0][0] * in[0];
+        return;
+    }
+
+    int32_t even[32];
+    idct_part(even, in, n, step * 2);
+    for (int k = 0; k < size / 2; k++) {
+        int32_t odd = 0;
+        for (int j = step; j < n; j += 2 * step)
+            odd += R64T[k][j] * in[j];
+        out[k] = even[k] + odd;
+        out[size - 1 - k] = even[k] - odd;
+    }
+}
+
+// 64-point inverse integer transform of the first `n` coefficients in `in`
+static inline void idct64(int32_t out[64], const int32_t in[64], int n)
+{
+    idct_part(out, in, n, 1);
+}
+
+static void generate_slice(int8_t *out, size_t out_width, uint8_t h, uint8_t v)
 {
     const uint8_t freq_h = ((h + 3) << 2) - 1;
     const uint8_t freq_v = ((v + 3) << 2) - 1;
     uint32_t seed = Seed_LUT[h + v * 13];
 
-    // Initialize with random gaussian values, using the output array as a
-    // temporary buffer for these intermediate values.
+    // Initialize with random gaussian values.
     //
-    // Note: To make the subsequent matrix multiplication cache friendlier, we
-    // store each *column* of the starting image in a *row* of `grain`
+    // Note: To make the subsequent transforms cache friendlier, we store
+    // each *column* of the starting image in a *row* of `grain`
+    int32_t grain[64][64];
     for (int y = 0; y <= freq_v; y++) {
         for (int x = 0; x <= freq_h; x += 4) {
             uint16_t offset = seed % 2048;
@@ -56,73 +87,85 @@ static void generate_slice(float *out, size_t out_width, uint8_t h, uint8_t v,
 
     grain[0][0] = 0;
 
-    // 64x64 inverse integer transform
-    for (int y = 0; y < 64; y++) {
-        for (int x = 0; x <= freq_h; x++) {
-            int32_t sum = 0;
-            for (int p = 0; p <= freq_v; p++)
-                sum += R64T[y][p] * grain[x][p];
-            tmp[y][x] = (sum + 128) >> 8;
-        }
-    }
-
-    for (int y = 0; y < 64; y++) {
-        for (int x = 0; x < 64; x++) {
-            int32_t sum = 0;
-            for (int p = 0; p <= freq_h; p++)
-                sum += tmp[y][p] * R64T[x][p]; // R64T^T = R64
-            sum = (sum + 128) >> 8;
-            grain[y][x] = PL_CLAMP(sum, -127, 127);
-        }
+    // 64x64 inverse integer transform, first along the columns
+    int32_t tmp[64][64], col[64];
+    for (int x = 0; x <= freq_h; x++) {
+        idct64(col, grain[x], freq_v + 1);
+        for (int y = 0; y < 64; y++)
+            tmp[y][x] = (col[y] + 128) >> 8;
     }
 
     static const uint8_t deblock_factors[13] = {
         64, 71, 77, 84, 90, 96, 103, 109, 116, 122, 128, 128, 128
     };
 
-    // Deblock horizontal edges by simple attentuation of values
+    // Then along the rows, deblocking horizontal edges by simple
+    // attenuation of values
     const uint8_t deblock_coeff = deblock_factors[v];
     for (int y = 0; y < 64; y++) {
-        switch (y % 8) {
-        case 0: case 7:
-            // Deblock
-            for (int x = 0; x < 64; x++)
-                out[x] = ((grain[y][x] * deblock_coeff) >> 7) / 255.0;
-            break;
-
-        case 1: case 2:
-        case 3: case 4:
-        case 5: case 6:
-            // No deblock
-            for (int x = 0; x < 64; x++)
-                out[x] = grain[y][x] / 255.0;
-            break;
-
-        default: pl_unreachable();
+        int32_t row[64];
+        idct64(row, tmp[y], freq_h + 1);
+        for (int x = 0; x < 64; x++) {
+            int val = PL_CLAMP((row[x] + 128) >> 8, -127, 127);
+            if (y % 8 == 0 || y % 8 == 7)
+                val = (val * deblock_coeff) >> 7;
+            out[x] = val;
         }
 
         out += out_width;
     }
 }
 
-static void fill_grain_lut(void *data, const struct sh_lut_params *params)
+// The grain database is independent of the film grain parameters, so it's
+// generated only once, and shared by all shader objects
+static pl_static_mutex grain_lock = PL_STATIC_MUTEX_INITIALIZER;
+static int8_t (*grain_db)[13 * 64];
+
+// Number of threads to generate the 13x13 slices of the database on
+#define GRAIN_THREADS 4
+
+struct grain_worker {
+    int8_t (*db)[13 * 64];
+    int index;
+};
+
+static PL_THREAD_VOID generate_slices(void *arg)
+{
+    const struct grain_worker *worker = arg;
+    for (int i = worker->index; i < 13 * 13; i += GRAIN_THREADS) {
+        const int h = i / 13, v = i % 13;
+        generate_slice(&worker->db[h * 64][v * 64], 13 * 64, h, v);
+    }
+
+    PL_THREAD_RETURN();
+}
+
+static const int8_t (*get_grain_db(void))[13 * 64]
 {
-    struct {
-        int8_t grain[64][64];
-        int16_t tmp[64][64];
-    } *tmp = pl_alloc_ptr(NULL, tmp);
+    pl_static_mutex_lock(&grain_lock);
+    if (!grain_db) {
+        int8_t (*db)[13 * 64] = pl_alloc(NULL, sizeof(int8_t[13 * 64][13 * 64]));
+        struct grain_worker workers[GRAIN_THREADS];
+        for (int i = 0; i < GRAIN_THREADS; i++)
+            workers[i] = (struct grain_worker) { db, i };
+        pl_thread_fan_out(generate_slices, workers, sizeof(workers[0]), GRAIN_THREADS);
+        grain_db = db;
+    }
+    pl_static_mutex_unlock(&grain_lock);
+    return (const int8_t (*)[13 * 64]) grain_db;
+}
 
+static void fill_grain_lut(void *data, const struct sh_lut_params *params)
+{
     float *out = data;
     assert(params->var_type == PL_VAR_FLOAT);
+    pl_assert(params->width == 13 * 64 && params->height == 13 * 64);
 
-    for (int h = 0; h < 13; h++) {
-        for (int v = 0; v < 13; v++) {
-            float *slice = out + (h * 64) * params->width + (v * 64);
-            generate_slice(slice, params->width, h, v, tmp->grain, tmp->tmp);
-        }
+    const int8_t (*db)[13 * 64] = get_grain_db();
+    for (int y = 0; y < params->height; y++) {
+        for (int x = 0; x < params->width; x++)
+            out[y * params->width + x] = db[y][x] / 255.0;
     }
-
-    pl_free(tmp);
 }
 
 bool pl_needs_fg_h274(const struct pl_film_grain_params *params)
@@ -171,6 +214,8 @@ bool pl_shader_fg_h274(pl_shader sh, pl_shader_obj *grain_state,
         .width      = 13 * 64,
         .height     = 13 * 64,
         .comps      = 1,
+        .signature  = pl_str0_hash("pl_shader_fg_h274"),
+        .shared     = true,
         .fill       = fill_grain_lut,
     ));
 
@@ -19,6 +19,7 @@
 #include <ctype.h>
 
 #include "shaders.h"
+#include "pl_thread.h"
 
 #include <libplacebo/shaders/lut.h>
 
@@ -32,6 +33,169 @@ void pl_lut_free(struct pl_custom_lut **lut)
     pl_free_ptr(lut);
 }
 
+// Treat all control characters as whitespace, which makes this trivial to
+// evaluate for many characters at once (see `count_values`)
+static inline bool is_space(uint8_t c)
+{
+    return c <= ' ';
+}
+
+static inline uint64_t read8(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+static const double pow10_tab[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static const uint64_t lsb = 0x0101010101010101ULL, msb = lsb << 7;
+static const uint32_t pow10_int[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+};
+
+// Parses a run of decimal digits into `mant`, eight at a time where possible
+static inline const uint8_t *eat_digits(const uint8_t *p, const uint8_t *end,
+                                        uint64_t *mant, int *digits)
+{
+    while (end - p >= 8) {
+        // Mask of all characters outside '0' - '9'
+        const uint64_t d = read8(p) ^ (0x30 * lsb);
+        const uint64_t mask = (d | (d + 0x06 * lsb)) & (0xF0 * lsb);
+        const int n = mask ? __builtin_ctzll(mask) >> 3 : 8;
+        if (!n)
+            return p;
+
+        // Combine the digits pairwise, shifted up to add leading zeros
+        uint64_t v = d << (8 * (8 - n));
+        v = (v * 10 + (v >> 8)) & 0x00FF00FF00FF00FFULL;
+        v = (v * 100 + (v >> 16)) & 0x0000FFFF0000FFFFULL;
+        v = (v * 10000 + (v >> 32)) & 0xFFFFFFFFULL;
+        *mant = *mant * pow10_int[n] + v;
+        *digits += n;
+        p += n;
+        if (n < 8 || *digits > 19)
+            return p;
+    }
+
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        *mant = *mant * 10 + (*p - '0');
+        ++*digits;
+    }
+    return p;
+}
+
+// Fast path for plain decimals like "0.123456", which is what the body of
+// virtually every .cube file consists of. Anything else (exponents, excessive
+// digits, invalid characters) is deferred to the generic parser. Advances `*pp`
+// to the end of the token.
+static inline bool parse_value(const uint8_t **pp, const uint8_t *end, float *out)
+{
+    const uint8_t *p = *pp, *start = p;
+    bool neg = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        neg = *p++ == '-';
+
+    uint64_t mant = 0;
+    int digits = 0, frac = 0;
+    p = eat_digits(p, end, &mant, &digits);
+    if (p < end && *p == '.') {
+        const int int_digits = digits;
+        p = eat_digits(p + 1, end, &mant, &digits);
+        frac = digits - int_digits;
+    }
+
+    if ((p < end && !is_space(*p)) || !digits || digits > 19 ||
+        frac >= PL_ARRAY_SIZE(pow10_tab) || mant >> 53)
+    {
+        while (p < end && !is_space(*p))
+            p++;
+        *pp = p;
+        return pl_str_parse_float((pl_str) { (uint8_t *) start, p - start }, out);
+    }
+
+    // Both operands are exact, so this is correctly rounded
+    const double num = mant / pow10_tab[frac];
+    *out = neg ? -num : num;
+    *pp = p;
+    return true;
+}
+
+// Minimum number of bytes per thread, and maximum number of threads
+#define PARSE_CHUNK   (1 << 18)
+#define PARSE_THREADS 8
+
+struct parse_chunk {
+    pl_str str;
+    int first;      // index of the first value in this chunk
+    int count;      // number of values in this chunk
+    int total;      // total number of values to parse
+    float *data;
+    const float *min, *max;
+    pl_str error;   // token which failed parsing, if any
+    pl_str extra;   // data past the end of the LUT, if any
+};
+
+static PL_THREAD_VOID count_values(void *arg)
+{
+    struct parse_chunk *chunk = arg;
+    const uint8_t *p = chunk->str.buf, *end = p + chunk->str.len;
+    int count = 0;
+    bool space = true;
+
+    // Process 8 characters at a time, using bit tricks to compute a mask of
+    // all non-whitespace characters (c > ' '), then counting token starts
+    for (; end - p >= 8; p += 8) {
+        const uint64_t x = read8(p);
+        uint64_t word = (((x & ~msb) + (0x80 - 0x21) * lsb) | x) & msb;
+        uint64_t prev = (~word & msb) << 8 | (uint64_t) space << 7;
+        count += (((word & prev) >> 7) * lsb) >> 56; // horizontal sum
+        space = !(word >> 63);
+    }
+
+    for (; p < end; p++) {
+        const bool cur = is_space(*p);
+        count += space && !cur;
+        space = cur;
+    }
+
+    chunk->count = count;
+    PL_THREAD_RETURN();
+}
+
+static PL_THREAD_VOID parse_values(void *arg)
+{
+    struct parse_chunk *chunk = arg;
+    const uint8_t *p = chunk->str.buf, *end = p + chunk->str.len;
+    for (int n = chunk->first; n < chunk->first + chunk->count; n++) {
+        while (p < end && is_space(*p))
+            p++;
+        if (n >= chunk->total) {
+            chunk->extra = (pl_str) { (uint8_t *) p, end - p };
+            break;
+        }
+
+        float num;
+        const uint8_t *tok = p;
+        if (!parse_value(&p, end, &num)) {
+            chunk->error = (pl_str) { (uint8_t *) tok, p - tok };
+            break;
+        }
+
+        // Rescale to range 0.0 - 1.0
+        const int c = n % 3;
+        chunk->data[n] = (num - chunk->min[c]) / (chunk->max[c] - chunk->min[c]);
+    }
+
+    PL_THREAD_RETURN();
+}
+
 struct pl_custom_lut *pl_lut_parse_cube(pl_log log, const char *cstr, size_t cstr_len)
 {
     struct pl_custom_lut *lut = pl_zalloc_ptr(NULL, lut);
@@ -136,46 +300,55 @@ struct pl_custom_lut *pl_lut_parse_cube(pl_log log, const char *cstr, size_t cst
     float *data = pl_alloc(lut, sizeof(float[3]) * entries);
     lut->data = data;
 
-    // Parse LUT body
+    // Parse LUT body, split into whitespace-aligned chunks
     clock_t start = clock();
-    for (int n = 0; n < entries; n++) {
-        for (int c = 0; c < 3; c++) {
-            static const char * const digits = "0123456789.-+e";
-
-            // Extract valid digit sequence
-            size_t len = pl_strspn(str, digits);
-            pl_str entry = (pl_str) { str.buf, len };
-            str.buf += len;
-            str.len -= len;
-
-            if (!entry.len) {
-                if (!str.len) {
-                    pl_err(log, "Failed parsing LUT: Unexpected EOF, expected "
-                           "%d entries, got %d", entries * 3, n * 3 + c + 1);
-                } else {
-                    pl_err(log, "Failed parsing LUT: Unexpected '%c', expected "
-                           "digit", str.buf[0]);
-                }
-                goto error;
-            }
+    struct parse_chunk chunks[PARSE_THREADS];
+    const int num_chunks = PL_CLAMP(str.len / PARSE_CHUNK, 1, PARSE_THREADS);
+    for (int i = 0; i < num_chunks; i++) {
+        size_t pos = str.len * i / num_chunks, end = str.len * (i + 1) / num_chunks;
+        if (i > 0)
+            pos = chunks[i - 1].str.buf + chunks[i - 1].str.len - str.buf;
+        end = PL_MAX(end, pos);
+        while (end < str.len && !is_space(str.buf[end]))
+            end++;
+        chunks[i] = (struct parse_chunk) {
+            .str    = { str.buf + pos, end - pos },
+            .total  = entries * 3,
+            .data   = data,
+            .min    = min,
+            .max    = max,
+        };
+    }
 
-            float num;
-            if (!pl_str_parse_float(entry, &num)) {
-                pl_err(log, "Failed parsing float value '%.*s'", PL_STR_FMT(entry));
-                goto error;
-            }
+    pl_thread_fan_out(count_values, chunks, sizeof(chunks[0]), num_chunks);
+    int total = 0;
+    for (int i = 0; i < num_chunks; i++) {
+        chunks[i].first = total;
+        total += chunks[i].count;
+    }
 
-            // Rescale to range 0.0 - 1.0
-            *data++ = (num - min[c]) / (max[c] - min[c]);
+    if (total < entries * 3) {
+        pl_err(log, "Failed parsing LUT: Unexpected EOF, expected %d entries, "
+               "got %d", entries * 3, total);
+        goto error;
+    }
 
-            // Skip whitespace between digits
-            str = pl_str_strip(str);
+    pl_thread_fan_out(parse_values, chunks, sizeof(chunks[0]), num_chunks);
+    for (int i = 0; i < num_chunks; i++) {
+        if (chunks[i].error.buf) {
+            pl_err(log, "Failed parsing float value '%.*s'",
+                   PL_STR_FMT(chunks[i].error));
+            goto error;
         }
     }
 
-    str = pl_str_strip(str);
-    if (str.len)
-        pl_warn(log, "Extra data after LUT?... ignoring '%c'", str.buf[0]);
+    for (int i = 0; i < num_chunks; i++) {
+        if (chunks[i].extra.buf) {
+            pl_warn(log, "Extra data after LUT?... ignoring '%c'",
+                    chunks[i].extra.buf[0]);
+            break;
+        }
+    }
 
     pl_log_cpu_time(log, start, clock(), "parsing .cube LUT");
     return lut;
@@ -305,6 +478,7 @@ struct sh_lut_obj {
 
     // weights, depending on the lut type
     pl_tex tex;
+    bool shared_tex; // `tex` is owned by `pl_tex_shared_create`
     pl_str str;
     void *data;
 };
@@ -312,13 +486,23 @@ struct sh_lut_obj {
 static void sh_lut_uninit(pl_gpu gpu, void *ptr)
 {
     struct sh_lut_obj *lut = ptr;
-    pl_tex_destroy(gpu, &lut->tex);
+    if (lut->shared_tex) {
+        pl_tex_shared_release(gpu, &lut->tex);
+    } else {
+        pl_tex_destroy(gpu, &lut->tex);
+    }
     pl_free(lut->str.buf);
     pl_free(lut->data);
 
     *lut = (struct sh_lut_obj) {0};
 }
 
+static void fill_shared(void *data, void *priv)
+{
+    const struct sh_lut_params *params = priv;
+    params->fill(data, params);
+}
+
 // Maximum number of floats to embed as a literal array (when using SH_LUT_AUTO)
 #define SH_LUT_MAX_LITERAL_SOFT 64
 #define SH_LUT_MAX_LITERAL_HARD 256
@@ -466,9 +650,13 @@ next_dim: ; // `continue` out of the inner loop
         PL_MSG(sh, params->dynamic ? PL_LOG_TRACE : PL_LOG_DEBUG,
                "LUT cache invalidated, regenerating..");
 
+        // Shared textures are only generated if they don't already exist
+        bool shared = type == SH_LUT_TEXTURE && params->shared && !params->dynamic;
         size_t buf_size = size * params->comps * pl_var_type_size(vartype);
-        tmp = pl_zalloc(NULL, buf_size);
-        params->fill(tmp, params);
+        if (!shared) {
+            tmp = pl_zalloc(NULL, buf_size);
+            params->fill(tmp, params);
+        }
 
         switch (type) {
         case SH_LUT_TEXTURE: {
@@ -493,8 +681,22 @@ next_dim: ; // `continue` out of the inner loop
                 .debug_tag      = PL_DEBUG_TAG,
             };
 
+            if (lut->shared_tex) {
+                pl_tex_shared_release(gpu, &lut->tex);
+                lut->shared_tex = false;
+            }
+
             bool ok;
-            if (params->dynamic) {
+            if (shared) {
+                uint64_t key = params->signature;
+                pl_hash_merge(&key, (uintptr_t) texfmt);
+                pl_hash_merge(&key, tex_params.w);
+                pl_hash_merge(&key, tex_params.h);
+                pl_hash_merge(&key, tex_params.d);
+                lut->tex = pl_tex_shared_create(gpu, key, &tex_params, buf_size,
+                                                fill_shared, (void *) params);
+                lut->shared_tex = ok = lut->tex;
+            } else if (params->dynamic) {
                 ok = pl_tex_recreate(gpu, &lut->tex, &tex_params);
                 if (ok) {
                     ok = pl_tex_upload(gpu, pl_tex_transfer_params(
@@ -520,6 +520,7 @@ static void polar_sample(pl_shader sh, pl_filter filter,
 
 struct sh_sampler_obj {
     pl_filter filter;
+    uint64_t signature; // hash of `filter->weights`, for sharing LUTs
     pl_shader_obj lut;
     pl_shader_obj pass2; // for pl_shader_sample_ortho
 };
@@ -589,6 +590,9 @@ bool pl_shader_sample_polar(pl_shader sh, const struct pl_sample_src *src,
             SH_FAIL(sh, "Failed initializing polar filter!");
             return false;
         }
+
+        obj->signature = pl_mem_hash(obj->filter->weights,
+                                     lut_entries * sizeof(float));
     }
 
     describe_filter(sh, &params->filter, "polar", rx, ry);
@@ -645,6 +649,8 @@ bool pl_shader_sample_polar(pl_shader sh, const struct pl_sample_src *src,
         .width      = lut_entries,
         .comps      = 1,
         .update     = update,
+        .signature  = obj->signature,
+        .shared     = true,
         .fill       = fill_polar_lut,
         .priv       = obj,
     ));
@@ -931,6 +937,9 @@ bool pl_shader_sample_ortho2(pl_shader sh, const struct pl_sample_src *src,
             SH_FAIL(sh, "Failed initializing separated filter!");
             return false;
         }
+
+        obj->signature = pl_mem_hash(obj->filter->weights, lut_entries *
+                                     obj->filter->row_stride * sizeof(float));
     }
 
     int N = obj->filter->row_size; // number of samples to convolve
@@ -943,6 +952,8 @@ bool pl_shader_sample_ortho2(pl_shader sh, const struct pl_sample_src *src,
         .height     = lut_entries,
         .comps      = 4,
         .update     = update,
+        .signature  = obj->signature,
+        .shared     = true,
         .fill       = fill_ortho_lut,
         .priv       = obj,
     ));
@@ -2,9 +2,12 @@
 #include <sys/time.h>
 
 #include <libplacebo/dispatch.h>
+#include <libplacebo/dummy.h>
+#include <libplacebo/filters.h>
 #include <libplacebo/vulkan.h>
 #include <libplacebo/shaders/colorspace.h>
 #include <libplacebo/shaders/deinterlacing.h>
+#include <libplacebo/shaders/lut.h>
 #include <libplacebo/shaders/sampling.h>
 
 #define TEX_SIZE 2048
@@ -166,6 +169,252 @@ static void benchmark(pl_gpu gpu, const char *name,
         pl_tex_destroy(gpu, &fbos[i]);
 }
 
+// Measures the throughput of many tiny passes, which is dominated by the
+// per-pass CPU overhead (descriptor updates, barriers etc.)
+static void benchmark_passes(pl_gpu gpu, const char *name)
+{
+    pl_dispatch dp = pl_dispatch_create(gpu->log, gpu);
+    REQUIRE(dp);
+
+    pl_fmt fmt = pl_find_fmt(gpu, PL_FMT_UNORM, 4, 8, 8,
+                             PL_FMT_CAP_SAMPLEABLE | PL_FMT_CAP_RENDERABLE);
+    REQUIRE(fmt);
+
+    pl_tex src = pl_tex_create(gpu, pl_tex_params(
+        .format     = fmt,
+        .w          = 16,
+        .h          = 16,
+        .sampleable = true,
+    ));
+
+    pl_tex fbo = pl_tex_create(gpu, pl_tex_params(
+        .format     = fmt,
+        .w          = 16,
+        .h          = 16,
+        .renderable = true,
+    ));
+    REQUIRE(src && fbo);
+
+    struct timeval start = {0}, stop = {0};
+    unsigned long passes = 0;
+    gettimeofday(&start, NULL);
+    do {
+        pl_shader sh = pl_dispatch_begin(dp);
+        REQUIRE(pl_shader_sample_direct(sh, pl_sample_src( .tex = src )));
+        REQUIRE(pl_dispatch_finish(dp, pl_dispatch_params(
+            .shader = &sh,
+            .target = fbo,
+        )));
+
+        if (++passes % NUM_FBOS == 0) {
+            pl_gpu_flush(gpu);
+            gettimeofday(&stop, NULL);
+        }
+    } while (stop.tv_sec - start.tv_sec < BENCH_DUR);
+
+    pl_gpu_finish(gpu);
+    gettimeofday(&stop, NULL);
+
+    float secs = (float) (stop.tv_sec - start.tv_sec) +
+                 1e-6 * (stop.tv_usec - start.tv_usec);
+    printf("'%s':\t%4lu passes in %1.6f seconds => %2.6f ms/pass (%5.2f passes/s)\n",
+           name, passes, secs, 1000 * secs / passes, passes / secs);
+
+    pl_dispatch_destroy(&dp);
+    pl_tex_destroy(gpu, &src);
+    pl_tex_destroy(gpu, &fbo);
+}
+
+// Measures a peak detection compute pass running alongside a scaling pass,
+// optionally allowing the former to overlap on an async compute queue
+static void benchmark_async_compute(pl_gpu gpu, const char *name, bool async)
+{
+    pl_dispatch dp = pl_dispatch_create(gpu->log, gpu);
+    REQUIRE(dp);
+    pl_shader_obj peak = NULL, lut = NULL;
+    pl_tex src = create_test_img(gpu);
+
+    pl_fmt fmt = pl_find_fmt(gpu, PL_FMT_FLOAT, 4, 16, 32, PL_FMT_CAP_RENDERABLE);
+    REQUIRE(fmt);
+
+    pl_tex fbo = pl_tex_create(gpu, pl_tex_params(
+        .format     = fmt,
+        .w          = TEX_SIZE,
+        .h          = TEX_SIZE,
+        .renderable = true,
+    ));
+    REQUIRE(fbo);
+
+    struct timeval start = {0}, stop = {0};
+    unsigned long frames = 0;
+    gettimeofday(&start, NULL);
+    do {
+        pl_shader sh = pl_dispatch_begin(dp);
+        REQUIRE(pl_shader_sample_direct(sh, pl_sample_src( .tex = src )));
+        REQUIRE(pl_shader_detect_peak(sh, pl_color_space_hdr10, &peak, NULL));
+        REQUIRE(pl_dispatch_compute(dp, pl_dispatch_compute_params(
+            .shader         = &sh,
+            .width          = src->params.w,
+            .height         = src->params.h,
+            .async_compute  = async,
+        )));
+
+        sh = pl_dispatch_begin(dp);
+        REQUIRE(pl_shader_sample_ortho2(sh, pl_sample_src( .tex = src ),
+            pl_sample_filter_params(
+                .filter = pl_filter_spline36,
+                .lut    = &lut,
+            )));
+        REQUIRE(pl_dispatch_finish(dp, pl_dispatch_params(
+            .shader = &sh,
+            .target = fbo,
+        )));
+
+        if (++frames % NUM_FBOS == 0) {
+            pl_gpu_flush(gpu);
+            gettimeofday(&stop, NULL);
+        }
+    } while (stop.tv_sec - start.tv_sec < BENCH_DUR);
+
+    pl_gpu_finish(gpu);
+    gettimeofday(&stop, NULL);
+
+    float secs = (float) (stop.tv_sec - start.tv_sec) +
+                 1e-6 * (stop.tv_usec - start.tv_usec);
+    printf("'%s':\t%4lu frames in %1.6f seconds => %2.6f ms/frame (%5.2f FPS)%s\n",
+           name, frames, secs, 1000 * secs / frames, frames / secs,
+           async && !gpu->limits.async_compute ? " (no async queue)" : "");
+
+    pl_shader_obj_destroy(&peak);
+    pl_shader_obj_destroy(&lut);
+    pl_dispatch_destroy(&dp);
+    pl_tex_destroy(gpu, &src);
+    pl_tex_destroy(gpu, &fbo);
+}
+
+// Benchmarks of CPU-side code, which don't require a GPU
+static void benchmark_cpu(const char *name, void (*run)(void *priv), void *priv)
+{
+    run(priv); // warm up caches etc.
+
+    struct timeval start = {0}, stop = {0};
+    unsigned long iters = 0;
+    gettimeofday(&start, NULL);
+    do {
+        iters++;
+        run(priv);
+        gettimeofday(&stop, NULL);
+    } while (stop.tv_sec - start.tv_sec < BENCH_DUR);
+
+    float secs = (float) (stop.tv_sec - start.tv_sec) +
+                 1e-6 * (stop.tv_usec - start.tv_usec);
+    printf("'%s':\t%4lu iterations in %1.6f seconds => %2.6f ms/iter\n",
+           name, iters, secs, 1000 * secs / iters);
+}
+
+#define FILTER_LUT_SIZE 1024
+static float filter_weights[FILTER_LUT_SIZE];
+
+static void bench_filter_generate(void *priv)
+{
+    // The filter is not otherwise referenced, so this bypasses the cache
+    pl_filter filter = pl_filter_generate(NULL, priv);
+    REQUIRE(filter);
+    pl_filter_free(&filter);
+}
+
+static void bench_filter_sample(void *priv)
+{
+    // Reference implementation: evaluate the polar LUT one sample at a time
+    const struct pl_filter_params *params = priv;
+    const double radius = params->config.kernel->radius;
+    for (int i = 0; i < params->lut_entries; i++) {
+        double x = radius * i / (params->lut_entries - 1);
+        filter_weights[i] = pl_filter_sample(&params->config, x);
+    }
+}
+
+#define NUM_FLOATS 4096
+static float format_floats[NUM_FLOATS];
+
+static pl_str format_buf;
+
+static void bench_format_float(void *alloc)
+{
+    format_buf.len = 0;
+    for (int i = 0; i < NUM_FLOATS; i++)
+        pl_str_append_asprintf_c(alloc, &format_buf, "%f,", format_floats[i]);
+}
+
+struct cube_bench {
+    pl_log log;
+    pl_str data;
+};
+
+static void bench_parse_cube(void *priv)
+{
+    const struct cube_bench *cube = priv;
+    struct pl_custom_lut *lut;
+    lut = pl_lut_parse_cube(cube->log, (char *) cube->data.buf, cube->data.len);
+    REQUIRE(lut);
+    pl_lut_free(&lut);
+}
+
+struct grain_bench {
+    pl_log log;
+    pl_gpu gpu;
+    pl_tex luma, chroma;
+    pl_shader_obj state[2];
+};
+
+// Per-frame grain synthesis for a 4:2:0 frame, with a new seed every frame
+static void bench_av1_grain_synth(void *priv)
+{
+    struct grain_bench *gb = priv;
+    struct pl_color_repr repr = pl_color_repr_sdtv;
+    const int seed = rand();
+    for (int i = 0; i < 2; i++) {
+        pl_tex tex = i ? gb->chroma : gb->luma;
+        pl_shader sh = pl_shader_alloc(gb->log, pl_shader_params(
+            .gpu = gb->gpu,
+        ));
+
+        struct pl_film_grain_params params = {
+            .data = {
+                .type = PL_FILM_GRAIN_AV1,
+                .params.av1 = av1_grain_data,
+                .seed = seed,
+            },
+            .tex = tex,
+            .luma_tex = i ? gb->luma : NULL,
+            .components = i ? 2 : 1,
+            .component_mapping = { i ? 1 : 0, 2 },
+            .repr = &repr,
+        };
+
+        REQUIRE(pl_shader_film_grain(sh, &gb->state[i], &params));
+        pl_shader_free(&sh);
+    }
+}
+
+static void filter_error(const struct pl_filter_params *params)
+{
+    pl_filter filter = pl_filter_generate(NULL, params);
+    REQUIRE(filter);
+
+    double max_err = 0.0;
+    const double radius = params->config.kernel->radius;
+    for (int i = 0; i < params->lut_entries; i++) {
+        double x = radius * i / (params->lut_entries - 1);
+        double ref = pl_filter_sample(&params->config, x);
+        max_err = fmax(max_err, fabs(filter->weights[i] - ref));
+    }
+
+    printf("'%s':\tmax error vs pl_filter_sample: %g\n",
+           params->config.name, max_err);
+    pl_filter_free(&filter);
+}
+
 // List of benchmarks
 static void bench_deband(pl_shader sh, pl_shader_obj *state, pl_tex src)
 {
@@ -446,6 +695,70 @@ int main()
         .log_level  = PL_LOG_WARN,
     ));
 
+    struct pl_filter_params filter_polar = {
+        .config       = pl_filter_ewa_lanczos,
+        .lut_entries  = FILTER_LUT_SIZE,
+        .filter_scale = 4.0,
+        .cutoff       = 0.001,
+    };
+
+    struct pl_filter_params filter_ortho = {
+        .config             = pl_filter_lanczos,
+        .lut_entries        = FILTER_LUT_SIZE,
+        .filter_scale       = 4.0,
+        .row_stride_align   = 4,
+    };
+
+    printf("= Running CPU benchmarks =\n");
+    benchmark_cpu("filter_generate polar", bench_filter_generate, &filter_polar);
+    benchmark_cpu("filter_sample polar", bench_filter_sample, &filter_polar);
+    benchmark_cpu("filter_generate ortho", bench_filter_generate, &filter_ortho);
+    filter_error(&filter_polar);
+
+    // Typical shader constants: small values with few significant digits,
+    // and arbitrary single precision values
+    for (int i = 0; i < NUM_FLOATS; i++) {
+        format_floats[i] = (i % 2) ? (rand() % 1000) / 100.0f
+                                   : (RANDOM - 0.5f) * 1000.0f;
+    }
+    void *tmp = pl_tmp(NULL);
+    benchmark_cpu("format %f", bench_format_float, tmp);
+    printf("'format %%f':\t%.2f bytes/value\n",
+           (format_buf.len - NUM_FLOATS) / (float) NUM_FLOATS);
+
+    // Typical 65^3 .cube file, as produced by most grading software
+    const int cube_size = 65;
+    struct cube_bench cube = { .log = log };
+    pl_str_append_asprintf(tmp, &cube.data, "TITLE \"bench\"\nLUT_3D_SIZE %d\n", cube_size);
+    for (int i = 0; i < cube_size * cube_size * cube_size; i++) {
+        pl_str_append_asprintf(tmp, &cube.data, "%.6f %.6f %.6f\n",
+                               (i % cube_size) / (cube_size - 1.0),
+                               (i / cube_size % cube_size) / (cube_size - 1.0),
+                               RANDOM);
+    }
+    benchmark_cpu("lut_parse_cube 65^3", bench_parse_cube, &cube);
+    printf("'lut_parse_cube 65^3':\t%.2f MB\n", cube.data.len / 1e6);
+    pl_free(tmp);
+
+    pl_gpu dummy = pl_gpu_dummy_create(log, NULL);
+    pl_fmt fmt = pl_find_fmt(dummy, PL_FMT_UNORM, 1, 8, 8, PL_FMT_CAP_SAMPLEABLE);
+    struct grain_bench grain = {
+        .log = log,
+        .gpu = dummy,
+        .luma = pl_tex_create(dummy, pl_tex_params(
+            .w = 1920, .h = 1080, .format = fmt, .sampleable = true,
+        )),
+        .chroma = pl_tex_create(dummy, pl_tex_params(
+            .w = 960, .h = 540, .format = fmt, .sampleable = true,
+        )),
+    };
+    benchmark_cpu("av1_grain synthesis", bench_av1_grain_synth, &grain);
+    for (int i = 0; i < 2; i++)
+        pl_shader_obj_destroy(&grain.state[i]);
+    pl_tex_destroy(dummy, &grain.luma);
+    pl_tex_destroy(dummy, &grain.chroma);
+    pl_gpu_dummy_destroy(&dummy);
+
     pl_vulkan vk = pl_vulkan_create(log, pl_vulkan_params(
         .allow_software = true,
         .async_transfer = false,
@@ -467,6 +780,7 @@ int main()
     benchmark(vk->gpu, "bicubic", BENCH_SH(bench_bicubic));
     benchmark(vk->gpu, "deband", BENCH_SH(bench_deband));
     benchmark(vk->gpu, "deband_heavy", BENCH_SH(bench_deband_heavy));
+    benchmark_passes(vk->gpu, "trivial passes");
 
     // Deinterlacing
     benchmark(vk->gpu, "weave", BENCH_SH(bench_weave));
@@ -484,8 +798,11 @@ int main()
     benchmark(vk->gpu, "dither_ordered_fixed", BENCH_SH(bench_dither_ordered_fix));
 
     // HDR peak detection
-    if (vk->gpu->glsl.compute)
+    if (vk->gpu->glsl.compute) {
         benchmark(vk->gpu, "hdr_peakdetect", BENCH_SH(bench_hdr_peak));
+        benchmark_async_compute(vk->gpu, "hdr_peakdetect+scale", false);
+        benchmark_async_compute(vk->gpu, "hdr_peakdetect+scale async", true);
+    }
 
     // Tone mapping
     benchmark(vk->gpu, "hdr_lut", BENCH_SH(bench_hdr_lut));
@@ -1,6 +1,20 @@
 #include "tests.h"
+#include "libplacebo/dummy.h"
 #include "libplacebo/utils/dav1d.h"
 
+#define PIC(width) (Dav1dPicture) {         \
+    .seq_hdr = &seq_hdr,                    \
+    .frame_hdr = &frame_hdr,                \
+    .p = {                                  \
+        .w = (width),                       \
+        .h = 240,                           \
+        .layout = DAV1D_PIXEL_LAYOUT_I420,  \
+        .bpc = 8,                           \
+    },                                      \
+}
+
+#define BUF(pic) (((const struct pl_dav1dalloc *) (pic).allocator_data)->buf)
+
 int main()
 {
     // Test enum functions
@@ -42,4 +56,105 @@ int main()
         if (loc2)
             REQUIRE_CMP(loc, ==, loc2, "u");
     }
+
+    // Test the picture pool
+    pl_log log = pl_test_logger();
+    struct pl_gpu_dummy_params params = pl_gpu_dummy_default_params;
+    params.limits.host_cached = true;
+    pl_gpu gpu = pl_gpu_dummy_create(log, &params);
+
+    enum { MAX_BUFS = 4 };
+    pl_dav1d_pool pool = pl_dav1d_pool_create(gpu, MAX_BUFS);
+    REQUIRE(pool);
+
+    Dav1dSequenceHeader seq_hdr = { .mtrx = DAV1D_MC_BT709 };
+    Dav1dFrameHeader frame_hdr = {0};
+    Dav1dPicture pics[MAX_BUFS + 1];
+    for (int i = 0; i < MAX_BUFS; i++) {
+        pics[i] = PIC(320);
+        REQUIRE_CMP(pl_allocate_dav1dpicture_pooled(&pics[i], pool), ==, 0, "d");
+        for (int j = 0; j < i; j++)
+            REQUIRE(BUF(pics[i]) != BUF(pics[j]));
+    }
+
+    // Every buffer is attached to a picture
+    pics[MAX_BUFS] = PIC(320);
+    REQUIRE_CMP(pl_allocate_dav1dpicture_pooled(&pics[MAX_BUFS], pool), ==,
+                DAV1D_ERR(ENOMEM), "d");
+    REQUIRE_CMP(pool->num_buffers, ==, MAX_BUFS, "d");
+
+    // Busy buffers are skipped in favor of idle ones
+    pl_buf buf0 = BUF(pics[0]), buf1 = BUF(pics[1]);
+    pl_release_dav1dpicture_pooled(&pics[0], pool);
+    pl_release_dav1dpicture_pooled(&pics[1], pool);
+    pl_buf_dummy_set_busy(buf1, true);
+    pics[0] = PIC(320);
+    REQUIRE_CMP(pl_allocate_dav1dpicture_pooled(&pics[0], pool), ==, 0, "d");
+    REQUIRE(BUF(pics[0]) == buf0);
+
+    // ... unless there is nothing else left, in which case they are waited on
+    pics[1] = PIC(320);
+    REQUIRE_CMP(pl_allocate_dav1dpicture_pooled(&pics[1], pool), ==, 0, "d");
+    REQUIRE(BUF(pics[1]) == buf1);
+    REQUIRE_CMP(pool->num_buffers, ==, MAX_BUFS, "d");
+
+    // Pooled pictures are uploaded without a copy
+    pl_tex tex[3] = {0};
+    struct pl_frame frame;
+    memset(pics[0].data[0], 0x42, pics[0].stride[0] * pics[0].p.h);
+    REQUIRE(pl_upload_dav1dpicture(gpu, &frame, tex, pl_dav1d_upload_params(
+        .picture = &pics[0],
+        .gpu_allocated = true,
+    )));
+    for (int i = 0; i < 3; i++)
+        pl_tex_destroy(gpu, &tex[i]);
+
+    // Changing the layout evicts idle buffers, and outdated buffers are
+    // freed rather than recycled once released
+    pl_release_dav1dpicture_pooled(&pics[0], pool);
+    pl_release_dav1dpicture_pooled(&pics[1], pool);
+    pics[0] = PIC(640);
+    REQUIRE_CMP(pl_allocate_dav1dpicture_pooled(&pics[0], pool), ==, 0, "d");
+    REQUIRE_CMP(pool->num_buffers, ==, MAX_BUFS - 1, "d");
+    pl_release_dav1dpicture_pooled(&pics[2], pool);
+    pl_release_dav1dpicture_pooled(&pics[3], pool);
+    REQUIRE_CMP(pool->num_buffers, ==, 1, "d");
+    REQUIRE(!pool->idle);
+
+    pl_buf buf = BUF(pics[0]);
+    pl_release_dav1dpicture_pooled(&pics[0], pool);
+    pics[0] = PIC(640);
+    REQUIRE_CMP(pl_allocate_dav1dpicture_pooled(&pics[0], pool), ==, 0, "d");
+    REQUIRE(BUF(pics[0]) == buf);
+    pl_release_dav1dpicture_pooled(&pics[0], pool);
+
+    // Decoding with a fixed number of pictures in flight keeps cycling through
+    // the same buffers, without allocating any new ones
+    pl_buf bufs[MAX_BUFS];
+    for (int i = 0; i < MAX_BUFS; i++) {
+        pics[i] = PIC(640);
+        REQUIRE_CMP(pl_allocate_dav1dpicture_pooled(&pics[i], pool), ==, 0, "d");
+        bufs[i] = BUF(pics[i]);
+    }
+
+    for (int n = 0; n < 100; n++) {
+        const int idx = n % MAX_BUFS;
+        pl_buf_dummy_set_busy(BUF(pics[idx]), n % 3 == 0); // still uploading
+        pl_release_dav1dpicture_pooled(&pics[idx], pool);
+        pics[idx] = PIC(640);
+        REQUIRE_CMP(pl_allocate_dav1dpicture_pooled(&pics[idx], pool), ==, 0, "d");
+        bool known = false;
+        for (int i = 0; i < MAX_BUFS; i++)
+            known |= BUF(pics[idx]) == bufs[i];
+        REQUIRE(known);
+        REQUIRE_CMP(pool->num_buffers, ==, MAX_BUFS, "d");
+    }
+
+    for (int i = 0; i < MAX_BUFS; i++)
+        pl_release_dav1dpicture_pooled(&pics[i], pool);
+
+    pl_dav1d_pool_destroy(&pool);
+    REQUIRE(!pool);
+    pl_gpu_dummy_destroy(&gpu);
+    pl_log_destroy(&log);
 }
@@ -1,4 +1,6 @@
 #include "tests.h"
+#include "blue_noise.h"
+#include "blue_noise_tables.h"
 
 #include <libplacebo/dither.h>
 #include <libplacebo/shaders/dithering.h>
@@ -18,13 +20,44 @@ int main()
     }
 
     printf("Blue noise dither matrix:\n");
-    pl_generate_blue_noise(&data[0][0], SHIFT);
+    pl_generate_blue_noise(&data[0][0], SIZE);
     for (int y = 0; y < SIZE; y++) {
         for (int x = 0; x < SIZE; x++)
             printf(" %3d", (int)(data[y][x] * SIZE * SIZE));
         printf("\n");
     }
 
+    // Make sure every precomputed matrix is a permutation, and matches the
+    // (sliced) runtime generator
+    static float noise[1 << 2 * BLUE_NOISE_TABLE_SHIFT];
+    static uint16_t ref[1 << 2 * BLUE_NOISE_TABLE_SHIFT];
+    static uint16_t sliced[1 << 2 * BLUE_NOISE_TABLE_SHIFT];
+    static bool seen[1 << 2 * BLUE_NOISE_TABLE_SHIFT];
+    for (int shift = 0; shift <= BLUE_NOISE_TABLE_SHIFT; shift++) {
+        const int size2 = 1 << 2 * shift;
+        pl_generate_blue_noise(noise, 1 << shift);
+        memset(seen, 0, sizeof(seen));
+        for (int i = 0; i < size2; i++) {
+            int idx = lrintf(noise[i] * size2);
+            REQUIRE_CMP(idx, >=, 0, "d");
+            REQUIRE_CMP(idx, <, size2, "d");
+            REQUIRE(!seen[idx]);
+            seen[idx] = true;
+        }
+
+        if (shift > 5)
+            continue; // runtime generation is too slow for the larger sizes
+
+        void *scratch = malloc(blue_noise_scratch_size(shift, 7));
+        REQUIRE(scratch);
+        blue_noise_generate(ref, shift, 1, NULL, NULL, scratch);
+        blue_noise_generate(sliced, shift, 7, NULL, NULL, scratch);
+        free(scratch);
+        REQUIRE_MEMEQ(ref, sliced, size2 * sizeof(uint16_t));
+        for (int i = 0; i < size2; i++)
+            REQUIRE_CMP(ref[i], ==, lrintf(noise[i] * size2), "d");
+    }
+
     // Generate an example of a dither shader
     pl_log log = pl_test_logger();
     pl_shader sh = pl_shader_alloc(log, NULL);
@@ -35,6 +68,11 @@ int main()
     REQUIRE(res);
     printf("Generated dither shader:\n%s\n", res->glsl);
 
+    // The body must survive finalization, separately from the description
+    REQUIRE(strstr(res->glsl, "color = floor(color) * (1.0 / scale);"));
+    REQUIRE(strstr(res->description, "dither"));
+    REQUIRE(!strstr(res->glsl, res->description));
+
     pl_shader_obj_destroy(&obj);
     pl_shader_free(&sh);
     pl_log_destroy(&log);
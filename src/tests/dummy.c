@@ -2,6 +2,264 @@
 
 #include <libplacebo/dummy.h>
 
+// Generates an AV1 film grain shader for the given plane, and returns a copy
+// of its chroma grain LUT
+static void *get_grain_lut(pl_log log, pl_gpu gpu, pl_shader_obj *state,
+                           struct pl_film_grain_params *params, size_t *size)
+{
+    pl_shader sh = pl_shader_alloc(log, pl_shader_params( .gpu = gpu ));
+    REQUIRE(pl_shader_film_grain(sh, state, params));
+    const struct pl_shader_res *res = pl_shader_finalize(sh);
+    REQUIRE(res);
+
+    void *data = NULL;
+    for (int n = 0; n < res->num_descriptors; n++) {
+        const struct pl_shader_desc *sd = &res->descriptors[n];
+        pl_tex tex = sd->binding.object;
+        if (sd->desc.type != PL_DESC_SAMPLED_TEX || tex == params->tex)
+            continue;
+        if (tex->params.format->num_components != params->components)
+            continue;
+        if (tex->params.w != 32 || tex->params.h != 32)
+            continue;
+
+        REQUIRE(!data);
+        *size = tex->params.w * tex->params.h * tex->params.format->texel_size;
+        data = malloc(*size);
+        REQUIRE(data);
+        memcpy(data, pl_tex_dummy_data(tex), *size);
+    }
+
+    REQUIRE(data);
+    pl_shader_free(&sh);
+    return data;
+}
+
+static void grain_tests(pl_log log, pl_gpu gpu)
+{
+    pl_tex luma = pl_tex_dummy_create(gpu, pl_tex_dummy_params(
+        .w = 200,
+        .h = 200,
+        .format = pl_find_named_fmt(gpu, "r8"),
+    ));
+
+    pl_tex chroma = pl_tex_dummy_create(gpu, pl_tex_dummy_params(
+        .w = 100,
+        .h = 100,
+        .format = pl_find_named_fmt(gpu, "rg8"),
+    ));
+
+    struct pl_film_grain_params params = {
+        .data = {
+            .type = PL_FILM_GRAIN_AV1,
+            .params.av1 = av1_grain_data,
+            .seed = 1,
+        },
+        .tex = chroma,
+        .luma_tex = luma,
+        .components = 2,
+        .component_mapping = { 1, 2 },
+        .repr = &(struct pl_color_repr) {
+            .sys = PL_COLOR_SYSTEM_BT_709,
+        },
+    };
+
+    // Both chroma planes share a single LUT, and the grain depends on the seed
+    pl_shader_obj state = NULL;
+    size_t size, size2;
+    uint8_t *lut = get_grain_lut(log, gpu, &state, &params, &size);
+    params.data.seed = 2;
+    uint8_t *lut2 = get_grain_lut(log, gpu, &state, &params, &size2);
+    REQUIRE_CMP(size, ==, size2, "zu");
+    REQUIRE(memcmp(lut, lut2, size));
+    free(lut2);
+
+    // Going back to a previous seed should reproduce the same grain
+    params.data.seed = 1;
+    lut2 = get_grain_lut(log, gpu, &state, &params, &size2);
+    REQUIRE_MEMEQ(lut, lut2, size);
+    free(lut2);
+
+    // The chroma grain must not depend on which other planes are present
+    const size_t texel = size / (32 * 32);
+    params.components = 1;
+    for (int c = 0; c < 2; c++) {
+        pl_shader_obj state2 = NULL;
+        params.component_mapping[0] = c + 1;
+        lut2 = get_grain_lut(log, gpu, &state2, &params, &size2);
+        REQUIRE_CMP(size2, ==, size / 2, "zu");
+        for (int i = 0; i < 32 * 32; i++)
+            REQUIRE_MEMEQ(&lut[i * texel + c * texel / 2], &lut2[i * texel / 2], texel / 2);
+        free(lut2);
+        pl_shader_obj_destroy(&state2);
+    }
+
+    free(lut);
+    pl_shader_obj_destroy(&state);
+    pl_tex_destroy(gpu, &luma);
+    pl_tex_destroy(gpu, &chroma);
+}
+
+static pl_tex get_h274_lut(pl_log log, pl_gpu gpu, pl_shader_obj *state,
+                           const struct pl_film_grain_params *params)
+{
+    pl_shader sh = pl_shader_alloc(log, pl_shader_params( .gpu = gpu ));
+    REQUIRE(pl_shader_film_grain(sh, state, params));
+    const struct pl_shader_res *res = pl_shader_finalize(sh);
+    REQUIRE(res);
+
+    pl_tex lut = NULL;
+    for (int n = 0; n < res->num_descriptors; n++) {
+        pl_tex tex = res->descriptors[n].binding.object;
+        if (res->descriptors[n].desc.type == PL_DESC_SAMPLED_TEX &&
+            tex != params->tex)
+        {
+            REQUIRE(!lut);
+            lut = tex;
+        }
+    }
+
+    REQUIRE(lut);
+    pl_shader_free(&sh);
+    return lut;
+}
+
+static void h274_grain_tests(pl_log log, pl_gpu gpu)
+{
+    pl_tex tex = pl_tex_dummy_create(gpu, pl_tex_dummy_params(
+        .w = 64,
+        .h = 64,
+        .format = pl_find_named_fmt(gpu, "rgba8"),
+    ));
+
+    const struct pl_film_grain_params params = {
+        .data = {
+            .type = PL_FILM_GRAIN_H274,
+            .params.h274 = h274_grain_data,
+        },
+        .tex = tex,
+        .components = 3,
+        .component_mapping = { 0, 1, 2 },
+        .repr = &(struct pl_color_repr) {
+            .sys = PL_COLOR_SYSTEM_BT_709,
+        },
+    };
+
+    pl_shader_obj state = NULL;
+    pl_tex lut = get_h274_lut(log, gpu, &state, &params);
+    REQUIRE_CMP(lut->params.w, ==, 13 * 64, "d");
+    REQUIRE_CMP(lut->params.h, ==, 13 * 64, "d");
+    REQUIRE_CMP(lut->params.format->texel_size, ==, sizeof(float), "zu");
+
+    // Checksum of the grain database generated by the reference
+    // implementation (a direct matrix multiplication per block)
+    const size_t size = lut->params.w * lut->params.h * sizeof(float);
+    const uint64_t hash = pl_mem_hash(pl_tex_dummy_data(lut), size);
+    REQUIRE_CMP(hash, ==, UINT64_C(0x5d9e4fcb04c807b1), PRIx64);
+
+    // All shader objects on the same GPU share the same grain database
+    pl_shader_obj state2 = NULL;
+    REQUIRE(get_h274_lut(log, gpu, &state2, &params) == lut);
+    pl_shader_obj_destroy(&state2);
+
+    pl_shader_obj_destroy(&state);
+    pl_tex_destroy(gpu, &tex);
+}
+
+// Records the size requested by a user shader pass, without rendering it
+static pl_tex record_size(void *priv, int width, int height)
+{
+    int *size = priv;
+    size[0] = width;
+    size[1] = height;
+    return NULL;
+}
+
+// Evaluates the WHEN/WIDTH/HEIGHT expressions of a user shader, which happens
+// entirely on the CPU before the pass is dispatched
+static void user_shader_expr_tests(pl_log log, pl_gpu gpu)
+{
+    static const char *shader =
+        "//!HOOK MAIN                                   \n"
+        "//!BIND HOOKED                                 \n"
+        "//!WIDTH HOOKED.w scale *                      \n"
+        "//!HEIGHT HOOKED.h 2 / OUTPUT.h +              \n"
+        "//!WHEN scale 1 > !                            \n"
+        "vec4 hook()                                    \n"
+        "{                                              \n"
+        "    return HOOKED_tex(HOOKED_pos);             \n"
+        "}                                              \n"
+        "                                               \n"
+        "//!PARAM scale                                 \n"
+        "//!TYPE float                                  \n"
+        "0.5                                            \n";
+
+    const struct pl_hook *hook = pl_mpv_user_shader_parse(gpu, shader, strlen(shader));
+    REQUIRE(hook);
+    REQUIRE_CMP(hook->num_parameters, ==, 1, "d");
+    pl_var_data *scale = hook->parameters[0].data;
+
+    pl_dispatch dp = pl_dispatch_create(log, gpu);
+    pl_tex tex = NULL;
+    int size[2];
+    struct pl_hook_params params = {
+        .gpu        = gpu,
+        .dispatch   = dp,
+        .get_tex    = record_size,
+        .priv       = size,
+        .stage      = PL_HOOK_RGB,
+        .repr       = pl_color_repr_rgb,
+        .color      = pl_color_space_srgb,
+        .components = 3,
+        .orig_repr  = &pl_color_repr_rgb,
+        .orig_color = &pl_color_space_srgb,
+        .dst_rect   = { 0, 0, 100, 0 },
+    };
+
+    // Every input change must be picked up by the next evaluation
+    static const struct {
+        float scale;
+        int tex_w, tex_h, dst_h;
+        int out_w, out_h; // 0 if the pass is skipped
+    } tests[] = {
+        { 0.5,  64, 48, 200,   32, 224 },
+        { 0.5,  64, 48, 200,   32, 224 },
+        { 0.25, 64, 48, 200,   16, 224 },
+        { 0.25, 64, 48, 100,   16, 124 },
+        { 0.25, 80, 60, 100,   20, 130 },
+        { 2.0,  80, 60, 100,    0,   0 },
+        { 0.5,  80, 60, 100,   40, 130 },
+    };
+
+    for (int i = 0; i < PL_ARRAY_SIZE(tests); i++) {
+        scale->f = tests[i].scale;
+        pl_tex_destroy(gpu, &tex);
+        tex = pl_tex_dummy_create(gpu, pl_tex_dummy_params(
+            .w = tests[i].tex_w,
+            .h = tests[i].tex_h,
+            .format = pl_find_named_fmt(gpu, "rgba8"),
+        ));
+
+        params.tex = tex;
+        params.rect = params.src_rect = (struct pl_rect2df) {
+            0, 0, tests[i].tex_w, tests[i].tex_h,
+        };
+        params.dst_rect.y1 = tests[i].dst_h;
+
+        // `record_size` makes the pass fail right after evaluating its size
+        size[0] = size[1] = 0;
+        struct pl_hook_res res = hook->hook(hook->priv, &params);
+        REQUIRE_CMP(res.failed, ==, tests[i].out_w > 0, "d");
+        REQUIRE_CMP(size[0], ==, tests[i].out_w, "d");
+        REQUIRE_CMP(size[1], ==, tests[i].out_h, "d");
+        hook->reset(hook->priv);
+    }
+
+    pl_dispatch_destroy(&dp);
+    pl_tex_destroy(gpu, &tex);
+    pl_mpv_user_shader_destroy(&hook);
+}
+
 int main()
 {
     pl_log log = pl_test_logger();
@@ -49,6 +307,27 @@ int main()
 #endif
     }
 
+    // A second sampler object with the same filter should share the LUT
+    pl_tex lut_tex = NULL;
+    for (int n = 0; n < res->num_descriptors; n++) {
+        if (res->descriptors[n].desc.type == PL_DESC_SAMPLED_TEX &&
+            res->descriptors[n].binding.object != dummy)
+            lut_tex = res->descriptors[n].binding.object;
+    }
+    REQUIRE(lut_tex);
+
+    pl_shader_obj lut2 = NULL;
+    filter_params.lut = &lut2;
+    pl_shader_reset(sh, pl_shader_params( .gpu = gpu ));
+    REQUIRE(pl_shader_sample_polar(sh, &src, &filter_params));
+    REQUIRE((res = pl_shader_finalize(sh)));
+    bool shared = false;
+    for (int n = 0; n < res->num_descriptors; n++)
+        shared |= res->descriptors[n].binding.object == lut_tex;
+    REQUIRE(shared);
+    pl_shader_obj_destroy(&lut2);
+    filter_params.lut = &lut;
+
     // Try out generation of the sampler2D interface
     src.tex = NULL;
     src.tex_w = 100;
@@ -65,6 +344,11 @@ int main()
     pl_shader_free(&sh);
     pl_shader_obj_destroy(&lut);
     pl_tex_destroy(gpu, &dummy);
+
+    grain_tests(log, gpu);
+    h274_grain_tests(log, gpu);
+    user_shader_expr_tests(log, gpu);
+
     pl_gpu_dummy_destroy(&gpu);
     pl_log_destroy(&log);
 }
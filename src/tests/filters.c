@@ -1,6 +1,6 @@
 #include "tests.h"
 
-#include <libplacebo/filters.h>
+#include "filters.h"
 
 int main()
 {
@@ -22,6 +22,13 @@ int main()
             // Ensure the kernel seems sanely scaled
             REQUIRE_FEQ(flt->weights[0], 1.0, 1e-7);
             REQUIRE_FEQ(flt->weights[params.lut_entries - 1], 0.0, 1e-7);
+
+            // Ensure the (batched) LUT matches the reference implementation
+            const double radius = params.config.kernel->radius;
+            for (int i = 0; i < params.lut_entries; i++) {
+                double x = radius * i / (params.lut_entries - 1);
+                REQUIRE_FEQ(flt->weights[i], pl_filter_sample(&params.config, x), 1e-6);
+            }
         } else {
             // Ensure the weights for each row add up to unity
             for (int i = 0; i < params.lut_entries; i++) {
@@ -38,5 +45,32 @@ int main()
 
         pl_filter_free(&flt);
     }
+
+    // Identical filters should be shared via the filter cache
+    struct pl_filter_params params = {
+        .config      = pl_filter_ewa_lanczos,
+        .lut_entries = 64,
+        .cutoff      = 0.001,
+    };
+
+    struct pl_filter_cache_stats stats = pl_filter_cache_stats();
+    pl_filter a = pl_filter_generate(log, &params);
+    pl_filter b = pl_filter_generate(log, &params);
+    REQUIRE(a && a == b);
+    params.lut_entries = 128;
+    pl_filter c = pl_filter_generate(log, &params);
+    REQUIRE(c && c != a);
+    REQUIRE_CMP(c->params.lut_entries, ==, 128, "d");
+
+    struct pl_filter_cache_stats stats2 = pl_filter_cache_stats();
+    REQUIRE_CMP(stats2.hits, ==, stats.hits + 1, PRIu64);
+    REQUIRE_CMP(stats2.misses, ==, stats.misses + 2, PRIu64);
+    REQUIRE_CMP(stats2.entries, ==, stats.entries + 2, "d");
+
+    pl_filter_free(&a);
+    REQUIRE_CMP(b->params.lut_entries, ==, 64, "d"); // still alive
+    pl_filter_free(&b);
+    pl_filter_free(&c);
+    REQUIRE_CMP(pl_filter_cache_stats().entries, ==, stats.entries, "d");
     pl_log_destroy(&log);
 }
@@ -1,5 +1,6 @@
 #include "tests.h"
 #include "shaders.h"
+#include "pl_thread.h"
 
 #include <libplacebo/renderer.h>
 #include <libplacebo/utils/frame_queue.h>
@@ -134,6 +135,43 @@ static void test_cb(void *priv)
     *flag = true;
 }
 
+static void spec_info_cb(void *priv, const struct pl_dispatch_info *info)
+{
+    uint64_t *signature = priv;
+    *signature = info->signature;
+}
+
+struct compile_job {
+    pl_dispatch dp;
+    bool ok;
+};
+
+static PL_THREAD_VOID compile_deferred(void *priv)
+{
+    struct compile_job *job = priv;
+    job->ok = pl_dispatch_compile(job->dp, 4);
+    PL_THREAD_RETURN();
+}
+
+// Dispatches one of a set of distinct shaders, which all sample `src` as-is
+static void dispatch_deferred(pl_dispatch dp, pl_tex src, pl_tex fbo, int idx)
+{
+    char body[64];
+    snprintf(body, sizeof(body), "color.rgb *= %d.0 / %d.0;", idx + 1, idx + 1);
+
+    pl_shader sh = pl_dispatch_begin(dp);
+    pl_shader_sample_nearest(sh, pl_sample_src( .tex = src ));
+    REQUIRE(pl_shader_custom(sh, &(struct pl_custom_shader) {
+        .body       = body,
+        .input      = PL_SHADER_SIG_COLOR,
+        .output     = PL_SHADER_SIG_COLOR,
+    }));
+    REQUIRE(pl_dispatch_finish(dp, pl_dispatch_params(
+        .shader = &sh,
+        .target = fbo,
+    )));
+}
+
 static void pl_test_roundtrip(pl_gpu gpu, pl_tex tex[2],
                               uint8_t *src, uint8_t *dst)
 {
@@ -583,6 +621,119 @@ static void pl_shader_tests(pl_gpu gpu)
         TEST_FBO_PATTERN(epsilon, "color system %d", (int) sys);
     }
 
+    // Test specialization of stable shader variables, including switching
+    // back to the generic shader when the value changes
+    uint64_t spec_sigs[10] = {0};
+    pl_dispatch_specialize(dp, 2);
+    for (int i = 0; i < PL_ARRAY_SIZE(spec_sigs); i++) {
+        pl_dispatch_callback(dp, &spec_sigs[i], spec_info_cb);
+        pl_dispatch_reset_frame(dp);
+        sh = pl_dispatch_begin(dp);
+        pl_shader_sample_nearest(sh, pl_sample_src( .tex = src ));
+        REQUIRE(pl_shader_custom(sh, &(struct pl_custom_shader) {
+            .body       = "color.rgb = (color.rgb * scale) / scale;",
+            .input      = PL_SHADER_SIG_COLOR,
+            .output     = PL_SHADER_SIG_COLOR,
+            .num_variables = 1,
+            .variables  = &(struct pl_shader_var) {
+                .var  = pl_var_float("scale"),
+                .data = &(float) { i < 5 ? 2.0 : 4.0 },
+            },
+        }));
+        REQUIRE(pl_dispatch_finish(dp, pl_dispatch_params(
+            .shader = &sh,
+            .target = fbo,
+        )));
+
+        TEST_FBO_PATTERN(1e-6, "specialized shader, frame %d", i);
+
+        // Wait for the specialized variants, which would otherwise be
+        // compiled in the background, to get deterministic results
+        REQUIRE(pl_dispatch_compile(dp, 1));
+    }
+    pl_dispatch_specialize(dp, 0);
+    pl_dispatch_callback(dp, NULL, NULL);
+
+    // The generic shader is used until the value has been stable for two
+    // frames, and the specialized one after it was compiled at the end of
+    // the frame in which it was first needed
+    if (gpu->limits.max_constants) {
+        REQUIRE_CMP(spec_sigs[1], ==, spec_sigs[0], PRIx64);
+        REQUIRE_CMP(spec_sigs[2], ==, spec_sigs[0], PRIx64);
+        REQUIRE_CMP(spec_sigs[3], !=, spec_sigs[0], PRIx64);
+        REQUIRE_CMP(spec_sigs[4], ==, spec_sigs[3], PRIx64);
+        REQUIRE_CMP(spec_sigs[5], ==, spec_sigs[0], PRIx64);
+        REQUIRE_CMP(spec_sigs[6], ==, spec_sigs[0], PRIx64);
+        REQUIRE_CMP(spec_sigs[7], ==, spec_sigs[3], PRIx64);
+    } else {
+        for (int i = 1; i < PL_ARRAY_SIZE(spec_sigs); i++)
+            REQUIRE_CMP(spec_sigs[i], ==, spec_sigs[0], PRIx64);
+    }
+
+    // Test deferred compilation of a batch of distinct shaders, while the
+    // same dispatch object keeps being used from this thread meanwhile
+    const int num_deferred = 16;
+    pl_dispatch_defer(dp, true);
+    for (int i = 0; i < num_deferred; i++)
+        dispatch_deferred(dp, src, fbo, i);
+    pl_dispatch_defer(dp, false);
+
+    struct compile_job job = { .dp = dp };
+    pl_thread thread;
+    bool threaded = gpu->limits.thread_safe &&
+                    pl_thread_create(&thread, compile_deferred, &job) == 0;
+    if (!threaded)
+        compile_deferred(&job);
+
+    // Either waits for pl_dispatch_compile, or compiles the shader on demand
+    for (int i = num_deferred - 1; i >= 0; i--) {
+        dispatch_deferred(dp, src, fbo, i);
+        TEST_FBO_PATTERN(1e-6, "deferred shader %d", i);
+    }
+
+    if (threaded)
+        pl_thread_join(thread);
+    REQUIRE(job.ok);
+
+    // Test the frame-wide UBO ring, using enough passes per frame to spill
+    // into more than one buffer and enough frames to wrap around and reuse them
+    if (gpu->glsl.version >= 440 && gpu->limits.max_ubo_size >= 4096) {
+        static float weights[256];
+        struct pl_var weights_var = pl_var_float("weights");
+        weights_var.dim_a = PL_ARRAY_SIZE(weights);
+
+        for (int f = 0; f < 12; f++) {
+            pl_dispatch_reset_frame(dp);
+            for (int i = 0; i < 20; i++) {
+                float val = f * 20 + i;
+                for (int n = 0; n < PL_ARRAY_SIZE(weights); n++)
+                    weights[n] = val;
+
+                // `expected` is dynamic, so it never lives in the UBO itself
+                sh = pl_dispatch_begin(dp);
+                pl_shader_sample_nearest(sh, pl_sample_src( .tex = src ));
+                REQUIRE(pl_shader_custom(sh, &(struct pl_custom_shader) {
+                    .body       = "color.rg *= 1.0 + weights[0] + weights[255] "
+                                  "           - 2.0 * expected;",
+                    .input      = PL_SHADER_SIG_COLOR,
+                    .output     = PL_SHADER_SIG_COLOR,
+                    .num_variables = 2,
+                    .variables  = (struct pl_shader_var[]) {
+                        { .var = weights_var, .data = weights },
+                        { .var = pl_var_float("expected"), .data = &val,
+                          .dynamic = true },
+                    },
+                }));
+                REQUIRE(pl_dispatch_finish(dp, pl_dispatch_params(
+                    .shader = &sh,
+                    .target = fbo,
+                )));
+
+                TEST_FBO_PATTERN(1e-6, "UBO ring, frame %d pass %d", f, i);
+            }
+        }
+    }
+
     // Repeat this a few times to test the caching
     for (int i = 0; i < 10; i++) {
         if (i == 5) {
@@ -974,6 +1125,24 @@ static const char *user_shader_tests[] = {
     "//!HOOK MAIN                                                           \n"
     "//!WHEN testconst 30 >                                                 \n"
     "#error should not be run                                               \n",
+
+    // Test parameters referenced before their definition
+    "//!HOOK MAIN                                                           \n"
+    "//!DESC scale by a parameter                                           \n"
+    "//!BIND HOOKED                                                         \n"
+    "//!WIDTH HOOKED.w scale *                                              \n"
+    "//!HEIGHT HOOKED.h scale *                                             \n"
+    "//!WHEN scale 1 > OUTPUT.w 0 > *                                       \n"
+    "                                                                       \n"
+    "vec4 hook()                                                            \n"
+    "{                                                                      \n"
+    "    return HOOKED_texOff(0);                                           \n"
+    "}                                                                      \n"
+    "                                                                       \n"
+    "//!PARAM scale                                                         \n"
+    "//!TYPE CONSTANT float                                                 \n"
+    "//!MINIMUM 1.0                                                         \n"
+    "2.0                                                                    \n",
 };
 
 static const char *test_luts[] = {
@@ -1082,8 +1251,39 @@ static void pl_render_tests(pl_gpu gpu)
         .color          = pl_color_space_srgb,
     };
 
-    REQUIRE(pl_render_image(rr, &image, &target, NULL));
+    // Compile all shaders ahead of time, without touching the target
+    struct pl_render_params prewarm_params = pl_render_default_params;
+    prewarm_params.info_callback = render_info_cb;
+    pl_tex_clear(gpu, fbo, (float[4]) { 0.25 });
+    REQUIRE(pl_renderer_prewarm(rr, &image, &target, &prewarm_params));
+    REQUIRE(pl_renderer_get_errors(rr).errors == PL_RENDER_ERR_NONE);
+    size_t prewarm_size = pl_renderer_save(rr, NULL);
+    if (fbo->params.host_readable) {
+        float fbo_data[5][5];
+        REQUIRE(pl_tex_download(gpu, pl_tex_transfer_params(
+            .tex = fbo,
+            .ptr = fbo_data,
+        )));
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++)
+                REQUIRE_FEQ(fbo_data[y][x], 0.25, 1e-6);
+        }
+    }
+
+    REQUIRE(pl_render_image(rr, &image, &target, &prewarm_params));
     REQUIRE(pl_renderer_get_errors(rr).errors == PL_RENDER_ERR_NONE);
+    REQUIRE_CMP(pl_renderer_save(rr, NULL), ==, prewarm_size, "zu");
+
+    // Same for a frame that needs tone mapping and peak detection
+    pl_renderer hdr_rr = pl_renderer_create(gpu->log, gpu);
+    struct pl_frame hdr_image = image;
+    hdr_image.color = pl_color_space_hdr10;
+    REQUIRE(pl_renderer_prewarm(hdr_rr, &hdr_image, &target, &prewarm_params));
+    prewarm_size = pl_renderer_save(hdr_rr, NULL);
+    REQUIRE(pl_render_image(hdr_rr, &hdr_image, &target, &prewarm_params));
+    REQUIRE(pl_renderer_get_errors(hdr_rr).errors == PL_RENDER_ERR_NONE);
+    REQUIRE_CMP(pl_renderer_save(hdr_rr, NULL), ==, prewarm_size, "zu");
+    pl_renderer_destroy(&hdr_rr);
 
     // TODO: embed a reference texture and ensure it matches
 
@@ -1,6 +1,18 @@
 #include "tests.h"
+#include "libplacebo/dummy.h"
 #include "libplacebo/utils/libav.h"
 
+static void get_buffer(AVCodecContext *avctx, AVFrame *pic, int w, int h)
+{
+    av_frame_unref(pic);
+    pic->format = AV_PIX_FMT_YUV420P;
+    pic->width = w;
+    pic->height = h;
+    REQUIRE_CMP(pl_get_buffer2_pooled(avctx, pic, 0), ==, 0, "d");
+}
+
+#define BUF(pic, p) (((struct pl_avalloc *) av_buffer_get_opaque((pic)->buf[p]))->buf)
+
 int main()
 {
     struct pl_plane_data data[4] = {0};
@@ -390,4 +402,146 @@ int main()
         enum pl_chroma_location loc2 = pl_chroma_from_av(avloc);
         REQUIRE_CMP(loc, ==, loc2, "u");
     }
+
+    // Test pl_avpool, alternating between frames of two different sizes as a
+    // transcoder handling multiple streams would
+    pl_log log = pl_test_logger();
+    struct pl_gpu_dummy_params params = pl_gpu_dummy_default_params;
+    params.limits.host_cached = true;
+    pl_gpu gpu = pl_gpu_dummy_create(log, &params);
+
+    enum { MAX_IDLE = 8, FRAMES = 16 };
+    pl_avpool pool = pl_avpool_create(gpu, MAX_IDLE);
+    REQUIRE(pool);
+
+    static const int sizes[3][2] = {{ 320, 240 }, { 640, 360 }, { 1280, 720 }};
+    AVFrame *frames[3];
+    for (int i = 0; i < 3; i++) {
+        frames[i] = av_frame_alloc();
+        REQUIRE(frames[i]);
+        frames[i]->format = AV_PIX_FMT_YUV420P;
+        frames[i]->width = sizes[i][0];
+        frames[i]->height = sizes[i][1];
+        REQUIRE_CMP(av_frame_get_buffer(frames[i], 0), ==, 0, "d");
+    }
+
+    struct pl_avpool_stats stats;
+    for (int n = 0; n < FRAMES; n++) {
+        struct pl_frame image;
+        REQUIRE(pl_map_avframe_ex(gpu, &image, pl_avframe_params(
+            .frame = frames[n % 2],
+            .pool = pool,
+        )));
+        REQUIRE_CMP(image.num_planes, ==, 3, "d");
+        const AVFrame *avframe = image.user_data;
+        REQUIRE(avframe->width == sizes[n % 2][0]);
+        pl_unmap_avframe(gpu, &image);
+    }
+
+    // Only the first frame of each size should need new textures
+    pl_avpool_get_stats(pool, &stats);
+    REQUIRE_CMP(stats.num_textures, ==, 6, "d");
+    REQUIRE_CMP((int) stats.tex_misses, ==, 6, "d");
+    REQUIRE_CMP((int) stats.tex_hits, ==, (FRAMES - 2) * 3, "d");
+
+    // Textures beyond `max_idle` get evicted once returned
+    struct pl_frame image;
+    REQUIRE(pl_map_avframe_ex(gpu, &image, pl_avframe_params(
+        .frame = frames[2],
+        .pool = pool,
+    )));
+    pl_unmap_avframe(gpu, &image);
+    pl_avpool_get_stats(pool, &stats);
+    REQUIRE_CMP(stats.num_textures, ==, MAX_IDLE, "d");
+    REQUIRE_CMP((int) stats.tex_misses, ==, 9, "d");
+
+    // Caller-owned textures are left alone, even if their `user_data`
+    // happens to point to a pool
+    pl_tex tex[4] = {0};
+    REQUIRE(pl_map_avframe_ex(gpu, &image, pl_avframe_params(
+        .frame = frames[0],
+        .tex = tex,
+    )));
+    pl_unmap_avframe(gpu, &image);
+    for (int i = 0; i < 3; i++) {
+        REQUIRE(tex[i]);
+        struct pl_tex_params tex_params = tex[i]->params;
+        tex_params.user_data = pool;
+        pl_tex_destroy(gpu, &tex[i]);
+        tex[i] = pl_tex_create(gpu, &tex_params);
+        REQUIRE(tex[i]);
+    }
+
+    pl_tex old_tex[4];
+    memcpy(old_tex, tex, sizeof(old_tex));
+    REQUIRE(pl_map_avframe_ex(gpu, &image, pl_avframe_params(
+        .frame = frames[0],
+        .tex = tex,
+    )));
+    REQUIRE(!memcmp(old_tex, tex, sizeof(old_tex)));
+    pl_unmap_avframe(gpu, &image);
+    pl_avpool_get_stats(pool, &stats);
+    REQUIRE_CMP(stats.num_textures, ==, MAX_IDLE, "d");
+    REQUIRE_CMP((int) stats.tex_hits, ==, (FRAMES - 2) * 3, "d");
+    for (int i = 0; i < 4; i++)
+        pl_tex_destroy(gpu, &tex[i]);
+
+    // Test pl_get_buffer2_pooled, using any decoder supporting direct rendering
+    const AVCodec *codec = avcodec_find_decoder(AV_CODEC_ID_MJPEG);
+    if (codec && (codec->capabilities & AV_CODEC_CAP_DR1)) {
+        AVCodecContext *avctx = avcodec_alloc_context3(codec);
+        AVFrame *pic = av_frame_alloc();
+        REQUIRE(avctx && pic);
+        avctx->opaque = &pool;
+        avctx->pix_fmt = AV_PIX_FMT_YUV420P;
+
+        get_buffer(avctx, pic, 320, 240);
+        pl_avpool_get_stats(pool, &stats);
+        REQUIRE_CMP(stats.num_buffers, ==, 3, "d");
+        REQUIRE_CMP((int) stats.buf_misses, ==, 3, "d");
+
+        // Frames allocated this way are uploaded without a copy
+        REQUIRE(pl_map_avframe_ex(gpu, &image, pl_avframe_params(
+            .frame = pic,
+            .pool = pool,
+        )));
+        pl_unmap_avframe(gpu, &image);
+
+        pl_buf bufs[3] = { BUF(pic, 0), BUF(pic, 1), BUF(pic, 2) };
+        get_buffer(avctx, pic, 320, 240);
+        REQUIRE(BUF(pic, 0) == bufs[0]);
+        pl_avpool_get_stats(pool, &stats);
+        REQUIRE_CMP(stats.num_buffers, ==, 3, "d");
+        REQUIRE_CMP((int) stats.buf_hits, ==, 3, "d");
+
+        // Busy buffers are skipped, and stay in the pool
+        pl_buf busy_buf = BUF(pic, 2);
+        pl_buf_dummy_set_busy(busy_buf, true);
+        get_buffer(avctx, pic, 320, 240);
+        for (int p = 0; p < 3; p++)
+            REQUIRE(BUF(pic, p) != busy_buf);
+        pl_avpool_get_stats(pool, &stats);
+        REQUIRE_CMP(stats.num_buffers, ==, 4, "d");
+        REQUIRE_CMP((int) stats.buf_hits, ==, 5, "d");
+        REQUIRE_CMP((int) stats.buf_misses, ==, 4, "d");
+        pl_buf_dummy_set_busy(busy_buf, false);
+
+        // Buffers of different sizes are kept around, up to `max_idle`
+        get_buffer(avctx, pic, 1280, 720);
+        get_buffer(avctx, pic, 640, 360);
+        av_frame_unref(pic);
+        pl_avpool_get_stats(pool, &stats);
+        REQUIRE_CMP(stats.num_buffers, ==, MAX_IDLE, "d");
+        REQUIRE_CMP((int) stats.buf_misses, ==, 10, "d");
+
+        av_frame_free(&pic);
+        avcodec_free_context(&avctx);
+    }
+
+    for (int i = 0; i < 3; i++)
+        av_frame_free(&frames[i]);
+    pl_avpool_destroy(&pool);
+    REQUIRE(!pool);
+    pl_gpu_dummy_destroy(&gpu);
+    pl_log_destroy(&log);
 }
@@ -59,6 +59,49 @@ static const char *luts[] = {
 
 };
 
+static void test_parse_large(pl_log log)
+{
+    // Large enough to be split into several chunks, with a mix of formats
+    // exercising both the fast path and the fallback
+    const int size = 33, num = size * size * size * 3;
+    void *tmp = pl_tmp(NULL);
+    float *ref = pl_calloc_ptr(tmp, num, ref);
+    pl_str str = {0};
+    pl_str_append_asprintf(tmp, &str, "LUT_3D_SIZE %d\nDOMAIN_MAX 2 2 2\n", size);
+    for (int i = 0; i < num; i++) {
+        static const char *seps[] = { " ", "\t", "\r\n", "  \n" };
+        const double x = 2.0 * ((i * 7919) % 10007) / 10006.0;
+        size_t start = str.len;
+        switch (i % 5) {
+        case 0: pl_str_append_asprintf(tmp, &str, "%.6f", x); break;
+        case 1: pl_str_append_asprintf(tmp, &str, "%d", (int) x); break;
+        case 2: pl_str_append_asprintf(tmp, &str, "%.3e", x); break;
+        case 3: pl_str_append_asprintf(tmp, &str, "%.25f", x); break;
+        case 4: pl_str_append_asprintf(tmp, &str, "+%.9f", x); break;
+        }
+        ref[i] = strtod((char *) str.buf + start, NULL) / 2.0;
+        pl_str_append_asprintf(tmp, &str, "%s", seps[i % PL_ARRAY_SIZE(seps)]);
+    }
+
+    struct pl_custom_lut *lut = pl_lut_parse_cube(log, (char *) str.buf, str.len);
+    REQUIRE(lut);
+    for (int i = 0; i < num; i++)
+        REQUIRE_FEQ(lut->data[i], ref[i], 1e-6);
+    pl_lut_free(&lut);
+
+    // Extra data at the end is ignored
+    pl_str_append_asprintf(tmp, &str, "0.5 0.5 0.5\n");
+    lut = pl_lut_parse_cube(log, (char *) str.buf, str.len);
+    REQUIRE(lut);
+    pl_lut_free(&lut);
+
+    // Truncated or invalid data fails parsing
+    REQUIRE(!pl_lut_parse_cube(log, (char *) str.buf, str.len / 2));
+    str.buf[str.len / 2] = 'x';
+    REQUIRE(!pl_lut_parse_cube(log, (char *) str.buf, str.len));
+    pl_free(tmp);
+}
+
 int main()
 {
     pl_log log = pl_test_logger();
@@ -79,6 +122,8 @@ int main()
         pl_lut_free(&lut);
     }
 
+    test_parse_large(log);
+
     pl_shader_obj_destroy(&obj);
     pl_shader_free(&sh);
     pl_gpu_dummy_destroy(&gpu);
@@ -1,4 +1,5 @@
 #include "gpu_tests.h"
+#include "opengl/gpu.h"
 #include "opengl/utils.h"
 
 #include <libplacebo/opengl.h>
@@ -39,6 +40,130 @@ static void opengl_interop_tests(pl_gpu gpu)
     pl_tex_destroy(gpu, &export);
 }
 
+static void opengl_pass_tests(pl_gpu gpu)
+{
+    pl_fmt fbo_fmt = pl_find_fmt(gpu, PL_FMT_UNORM, 4, 8, 8, PL_FMT_CAP_RENDERABLE);
+    pl_fmt vert_fmt = pl_find_vertex_fmt(gpu, PL_FMT_FLOAT, 2);
+    if (!fbo_fmt || !vert_fmt)
+        return;
+
+    char header[64];
+    snprintf(header, sizeof(header), "#version %d%s\n", gpu->glsl.version,
+             gpu->glsl.gles ? " es\nprecision mediump float;" : "");
+
+    char vert_shader[256], frag_shader[256];
+    snprintf(vert_shader, sizeof(vert_shader), "%s"
+             "in vec2 pos;                               \n"
+             "void main() {                              \n"
+             "    gl_Position = vec4(pos, 0.0, 1.0);     \n"
+             "}", header);
+
+    // Broken on purpose, to make sure failures are reported immediately even
+    // when the driver compiles programs asynchronously
+    snprintf(frag_shader, sizeof(frag_shader), "%s"
+             "void main() {                              \n"
+             "    undefined_function();                  \n"
+             "}", header);
+
+    struct pl_pass_params params = {
+        .type           = PL_PASS_RASTER,
+        .target_format  = fbo_fmt,
+        .vertex_shader  = vert_shader,
+        .glsl_shader    = frag_shader,
+        .vertex_type    = PL_PRIM_TRIANGLE_STRIP,
+        .vertex_stride  = 2 * sizeof(float),
+        .num_vertex_attribs = 1,
+        .vertex_attribs = &(struct pl_vertex_attrib) {
+            .name     = "pos",
+            .fmt      = vert_fmt,
+        },
+    };
+
+    printf("testing opengl pass creation failure\n");
+    pl_pass pass = pl_pass_create(gpu, &params);
+    REQUIRE(!pass);
+
+    // Same for the internal asynchronous path, once waited on
+    pass = pl_pass_create_async(gpu, &params);
+    if (pass) {
+        REQUIRE(!pl_pass_wait(gpu, pass));
+        pl_pass_destroy(gpu, &pass);
+    }
+}
+
+#define RING_TEX_SIZE 2048
+#define RING_CHUNKS 16
+
+static void opengl_upload_ring_tests(pl_gpu gpu)
+{
+    pl_fmt fmt = pl_find_fmt(gpu, PL_FMT_UNORM, 4, 8, 8, PL_FMT_CAP_HOST_READABLE);
+    if (!fmt || gpu->limits.max_tex_2d_dim < RING_TEX_SIZE)
+        return;
+
+    printf("testing opengl upload ring\n");
+    pl_tex tex = pl_tex_create(gpu, pl_tex_params(
+        .w = RING_TEX_SIZE,
+        .h = RING_TEX_SIZE,
+        .format = fmt,
+        .host_writable = true,
+        .host_readable = true,
+    ));
+    REQUIRE(tex);
+
+    pl_buf buf = pl_buf_create(gpu, pl_buf_params(
+        .size = 4096,
+        .host_writable = true,
+        .host_readable = true,
+    ));
+    REQUIRE(buf);
+
+    static uint8_t src[RING_TEX_SIZE * RING_TEX_SIZE * 4];
+    static uint8_t ref[sizeof(src)], dst[sizeof(src)];
+    for (int i = 0; i < sizeof(ref); i++)
+        ref[i] = (i * 7 + i / 4093) & 0xFF;
+
+    // Upload more data than fits into the ring at once, in chunks, without
+    // synchronizing in between, to make sure it gets recycled correctly
+    struct pl_gl *p = PL_PRIV(gpu);
+    const uint64_t head = p->ring.head;
+    const int rows = RING_TEX_SIZE / RING_CHUNKS;
+    const size_t chunk_size = sizeof(src) / RING_CHUNKS;
+    for (int n = 0; n < RING_CHUNKS; n++) {
+        uint8_t *chunk = src + n * chunk_size;
+        memcpy(chunk, ref + n * chunk_size, chunk_size);
+        REQUIRE(pl_tex_upload(gpu, pl_tex_transfer_params(
+            .tex = tex,
+            .rc = {
+                .x1 = RING_TEX_SIZE,
+                .y0 = n * rows,
+                .y1 = (n + 1) * rows,
+            },
+            .ptr = chunk,
+        )));
+
+        // The data must have been staged by the time the upload returns
+        memset(chunk, 0, chunk_size);
+
+        // Interleave some buffer updates, which also go through the ring
+        pl_buf_write(gpu, buf, 0, ref + n, buf->params.size);
+    }
+
+    REQUIRE(pl_buf_read(gpu, buf, 0, dst, buf->params.size));
+    REQUIRE_MEMEQ(dst, ref + RING_CHUNKS - 1, buf->params.size);
+
+    REQUIRE(pl_tex_download(gpu, pl_tex_transfer_params(
+        .tex = tex,
+        .ptr = dst,
+    )));
+    REQUIRE_MEMEQ(dst, ref, sizeof(dst));
+
+    if (p->has_ring)
+        REQUIRE_CMP(p->ring.head - head, >=, sizeof(src), PRIu64);
+
+    pl_buf_destroy(gpu, &buf);
+    pl_tex_destroy(gpu, &tex);
+}
+
 #define PBUFFER_WIDTH 640
 #define PBUFFER_HEIGHT 480
 
@@ -264,6 +389,8 @@ int main()
         gpu_shader_tests(gpu);
         gpu_interop_tests(gpu);
         opengl_interop_tests(gpu);
+        opengl_pass_tests(gpu);
+        opengl_upload_ring_tests(gpu);
         opengl_swapchain_tests(gl, dpy, surf);
         opengl_test_export_import(gl, PL_HANDLE_DMA_BUF);
 
@@ -0,0 +1,107 @@
+#include "tests.h"
+
+#include <dirent.h>
+
+#include <libplacebo/gpu.h>
+
+#include "glsl/spirv.h"
+
+static const struct pl_glsl_version glsl_ver = {
+    .version = 450,
+    .vulkan = true,
+    .compute = true,
+};
+
+static const char *test_shader =
+    "#version 450\n"
+    "layout(local_size_x = 8) in;\n"
+    "layout(std430, binding = 0) buffer data { float v[]; };\n"
+    "void main() {\n"
+    "    uint id = gl_GlobalInvocationID.x;\n"
+    "    v[id] = v[id] * 3.0 + 0.5;\n"
+    "}\n";
+
+// Returns the name of the only file in `dir`
+static char *cache_file(void *alloc, const char *dir)
+{
+    char *name = NULL;
+    DIR *d = opendir(dir);
+    REQUIRE(d);
+    for (struct dirent *e; (e = readdir(d));) {
+        if (e->d_name[0] == '.')
+            continue;
+        REQUIRE(!name);
+        name = pl_asprintf(alloc, "%s/%s", dir, e->d_name);
+    }
+    closedir(d);
+    REQUIRE(name);
+    return name;
+}
+
+static void test_cache(struct spirv_compiler *spirv, const char *shader,
+                       pl_str ref)
+{
+    void *tmp = pl_tmp(NULL);
+    const char *tmpdir = getenv("TMPDIR");
+    char *dir = pl_asprintf(tmp, "%s/plspirvXXXXXX", PL_DEF(tmpdir, "/tmp"));
+    REQUIRE(mkdtemp(dir));
+    pl_spirv_cache_dir(dir);
+    spirv_cache_flush();
+
+    // Freshly compiled SPIR-V gets written to disk, without leftovers
+    pl_str out = spirv_compile_glsl(spirv, tmp, &glsl_ver, GLSL_SHADER_COMPUTE, shader);
+    REQUIRE(pl_str_equals(out, ref));
+    char *path = cache_file(tmp, dir);
+    REQUIRE(pl_str_endswith0(pl_str0(path), ".spv"));
+
+    // Modify the last word of the cached SPIR-V, and make sure it's loaded
+    FILE *file = fopen(path, "r+b");
+    REQUIRE(file);
+    REQUIRE(fseek(file, -4, SEEK_END) == 0);
+    REQUIRE(fwrite("\xff\xff\xff\xff", 4, 1, file) == 1);
+    REQUIRE(fclose(file) == 0);
+
+    spirv_cache_flush();
+    out = spirv_compile_glsl(spirv, tmp, &glsl_ver, GLSL_SHADER_COMPUTE, shader);
+    REQUIRE_CMP(out.len, ==, ref.len, "zu");
+    REQUIRE(!pl_str_equals(out, ref));
+
+    // Truncated files must be ignored, and get replaced
+    file = fopen(path, "wb");
+    REQUIRE(file);
+    REQUIRE(fwrite("PLSC", 4, 1, file) == 1);
+    REQUIRE(fclose(file) == 0);
+
+    spirv_cache_flush();
+    out = spirv_compile_glsl(spirv, tmp, &glsl_ver, GLSL_SHADER_COMPUTE, shader);
+    REQUIRE(pl_str_equals(out, ref));
+    REQUIRE(strcmp(cache_file(tmp, dir), path) == 0);
+
+    pl_spirv_cache_dir(NULL);
+    spirv_cache_flush();
+    REQUIRE(remove(path) == 0);
+    REQUIRE(remove(dir) == 0);
+    pl_free(tmp);
+}
+
+int main()
+{
+    pl_log log = pl_test_logger();
+    struct spirv_compiler *spirv;
+    spirv = spirv_compiler_create(log, &(struct pl_spirv_version) {
+        .env_version = pl_spirv_version_to_vulkan(PL_SPV_VERSION(1, 5)),
+        .spv_version = PL_SPV_VERSION(1, 5),
+    });
+    if (!spirv)
+        return SKIP;
+
+    void *tmp = pl_tmp(NULL);
+    pl_str ref = spirv_compile_glsl(spirv, tmp, &glsl_ver, GLSL_SHADER_COMPUTE,
+                                    test_shader);
+    REQUIRE(ref.len);
+    test_cache(spirv, test_shader, ref);
+
+    pl_free(tmp);
+    spirv_compiler_destroy(&spirv);
+    pl_log_destroy(&log);
+}
@@ -1,5 +1,7 @@
 #include "tests.h"
 
+#include <time.h>
+
 static const pl_str null = {0};
 static const pl_str test = PL_STR0("test");
 static const pl_str empty = PL_STR0("");
@@ -14,6 +16,159 @@ static inline bool is_empty(pl_str str)
     return !str.len;
 }
 
+static int cmp_u64(const void *pa, const void *pb)
+{
+    uint64_t a = *(const uint64_t *) pa, b = *(const uint64_t *) pb;
+    return (a > b) - (a < b);
+}
+
+static void require_unique(uint64_t *hashes, int num)
+{
+    qsort(hashes, num, sizeof(*hashes), cmp_u64);
+    for (int i = 1; i < num; i++)
+        REQUIRE_CMP(hashes[i], !=, hashes[i - 1], PRIx64);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+static void test_hash(void *tmp)
+{
+    // All short inputs, including the empty string
+    enum { NUM_SHORT = 1 + 256 + 256 * 256 };
+    uint64_t *hashes = pl_calloc_ptr(tmp, NUM_SHORT, hashes);
+    uint8_t buf[2];
+    int num = 0;
+    hashes[num++] = pl_mem_hash(buf, 0);
+    for (int a = 0; a < 256; a++) {
+        buf[0] = a;
+        hashes[num++] = pl_mem_hash(buf, 1);
+        for (int b = 0; b < 256; b++) {
+            buf[1] = b;
+            hashes[num++] = pl_mem_hash(buf, 2);
+        }
+    }
+    require_unique(hashes, num);
+
+    // All single bit flips of a buffer, at every length up to its size
+    enum { FLIP_SIZE = 128, NUM_FLIPS = FLIP_SIZE * (FLIP_SIZE * 8 + 1) };
+    uint8_t data[FLIP_SIZE] = {0};
+    hashes = pl_calloc_ptr(tmp, NUM_FLIPS, hashes);
+    num = 0;
+    for (int len = 1; len <= FLIP_SIZE; len++) {
+        hashes[num++] = pl_mem_hash(data, len);
+        for (int bit = 0; bit < len * 8; bit++) {
+            data[bit / 8] ^= 1 << (bit % 8);
+            hashes[num++] = pl_mem_hash(data, len);
+            data[bit / 8] ^= 1 << (bit % 8);
+        }
+    }
+    require_unique(hashes, num);
+
+    // Near-identical, shader-like strings
+    enum { NUM_SHADERS = 1 << 18 };
+    hashes = pl_calloc_ptr(tmp, NUM_SHADERS, hashes);
+    for (int i = 0; i < NUM_SHADERS; i++) {
+        char str[128];
+        int len = snprintf(str, sizeof(str),
+                           "vec4 color = texture(src_tex_%d, pos) * %d.0;\n",
+                           i & 0xFF, i >> 8);
+        hashes[i] = pl_mem_hash(str, len);
+    }
+    require_unique(hashes, NUM_SHADERS);
+
+    // Microbenchmark, for typical shader-sized inputs
+    enum { BENCH_BYTES = 1 << 26 };
+    static const size_t sizes[] = { 16, 64, 256, 1024, 4096, 16384 };
+    uint8_t *bench = pl_alloc(tmp, sizes[PL_ARRAY_SIZE(sizes) - 1]);
+    for (int i = 0; i < sizes[PL_ARRAY_SIZE(sizes) - 1]; i++)
+        bench[i] = i * 31;
+
+    for (int n = 0; n < PL_ARRAY_SIZE(sizes); n++) {
+        uint64_t accum = 0;
+        const int iters = BENCH_BYTES / sizes[n];
+        double start = now();
+        for (int i = 0; i < iters; i++)
+            pl_hash_merge(&accum, pl_mem_hash(bench, sizes[n]));
+        double secs = now() - start;
+        printf("pl_mem_hash: %5zu bytes: %6.2f GB/s (%016"PRIx64")\n",
+               sizes[n], iters * sizes[n] / secs * 1e-9, accum);
+    }
+}
+
+static bool roundtrip_float(void *tmp, pl_str *str, float f)
+{
+    str->len = 0;
+    pl_str_append_asprintf_c(tmp, str, "%f", f);
+
+    // Must always be a valid GLSL float literal
+    const char *cstr = (const char *) str->buf;
+    if (!strchr(cstr, '.') && !strchr(cstr, 'e'))
+        return false;
+
+    char *end;
+    float parsed = strtof(cstr, &end);
+    return *end == '\0' && memcmp(&parsed, &f, sizeof(f)) == 0;
+}
+
+static void test_format_float(void *tmp)
+{
+    pl_str str = {0};
+    pl_str_append_asprintf_c(tmp, &str, "%f %f %f %f %f %f %f %f %f",
+                             0.0, -0.0, 0.5, 100.0, 1e-5, 0.1f, 1.0 / 3.0,
+                             3.4028234663852886e38, 16777216.0);
+    REQUIRE(pl_str_equals0(str, "0.0 -0.0 0.5 100.0 1e-5 0.1 0.3333333333333333 "
+                                "3.4028235e38 16777216.0"));
+
+    str.len = 0;
+    pl_str_append_memprintf_c(tmp, &str, "%f", &(double) { 0.25 });
+    REQUIRE(pl_str_equals0(str, "0.25"));
+
+    // Every exponent, with a stride through the mantissas
+    for (uint32_t bits = 0; bits < 0x7F800000; bits += 257) {
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        if (!roundtrip_float(tmp, &str, f) || !roundtrip_float(tmp, &str, -f)) {
+            fprintf(stderr, "Failed round-trip for %a: %s\n", f, str.buf);
+            exit(1);
+        }
+    }
+
+    // Edges of every exponent
+    for (uint32_t exp = 0; exp < 0xFF; exp++) {
+        static const uint32_t mant[] = { 0x0, 0x1, 0x400000, 0x7FFFFE, 0x7FFFFF };
+        for (int i = 0; i < PL_ARRAY_SIZE(mant); i++) {
+            uint32_t bits = (exp << 23) | mant[i];
+            float f;
+            memcpy(&f, &bits, sizeof(f));
+            if (!roundtrip_float(tmp, &str, f)) {
+                fprintf(stderr, "Failed round-trip for %a: %s\n", f, str.buf);
+                exit(1);
+            }
+        }
+    }
+
+    // Random doubles
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    for (int i = 0; i < 1000000; i++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        double d;
+        memcpy(&d, &state, sizeof(d));
+        if (!isfinite(d))
+            continue;
+        str.len = 0;
+        pl_str_append_asprintf_c(tmp, &str, "%f", d);
+        if (strtod((char *) str.buf, NULL) != d) {
+            fprintf(stderr, "Failed round-trip for %a: %s\n", d, str.buf);
+            exit(1);
+        }
+    }
+}
+
 int main()
 {
     void *tmp = pl_tmp(NULL);
@@ -34,7 +189,7 @@ int main()
         1, 1.0f, 0xFFll, (size_t) 0, PL_STR_FMT(empty),
         (unsigned short) 0xCAFEu, (unsigned short) 0x1, (unsigned short) 0,
         (unsigned short) 0xFFFFu);
-    REQUIRE(pl_str_equals0(buf, "test1 1.00000000000000000000 255 0 x cafe 1 0 ffff"));
+    REQUIRE(pl_str_equals0(buf, "test1 1.0 255 0 x cafe 1 0 ffff"));
 
     REQUIRE_CMP(pl_strchr(null, ' '), <, 0, "d");
     REQUIRE_CMP((int) pl_strspn(null, " "), ==, 0, "d");
@@ -130,6 +285,38 @@ int main()
     res = pl_str_builder_exec(builder);
     REQUIRE(pl_str_equals0(res, "foo 123 bar 56 bat quack baz 3735928559 test123"));
 
+    // Hashes should only depend on the contents, not on how they were built
+    pl_str_builder direct = pl_str_builder_alloc(tmp);
+    pl_str_builder copy = pl_str_builder_alloc(tmp);
+    pl_str_builder ref = pl_str_builder_alloc(tmp);
+    pl_str_builder child = pl_str_builder_alloc(tmp);
+    pl_str_builder_const_str(direct, "head ");
+    pl_str_builder_printf_c(direct, "%d %s", 42, "child");
+    pl_str_builder_str0(direct, " tail");
+
+    pl_str_builder_printf_c(child, "%d %s", 42, "child");
+    pl_str_builder_const_str(copy, "head ");
+    pl_str_builder_concat(copy, child);
+    pl_str_builder_str0(copy, " tail");
+    pl_str_builder_const_str(ref, "head ");
+    pl_str_builder_concat_ref(ref, child);
+    pl_str_builder_str0(ref, " tail");
+
+    REQUIRE_CMP(pl_str_builder_hash(copy), ==, pl_str_builder_hash(direct), PRIx64);
+    REQUIRE_CMP(pl_str_builder_hash(ref), ==, pl_str_builder_hash(direct), PRIx64);
+    REQUIRE(pl_str_equals0(pl_str_builder_exec(direct), "head 42 child tail"));
+    REQUIRE(pl_str_equals0(pl_str_builder_exec(copy), "head 42 child tail"));
+    REQUIRE(pl_str_equals0(pl_str_builder_exec(ref), "head 42 child tail"));
+
+    pl_str_builder_reset(direct);
+    pl_str_builder_printf_c(direct, "%d %s", 43, "child");
+    REQUIRE_CMP(pl_str_builder_hash(direct), !=, pl_str_builder_hash(child), PRIx64);
+    pl_str_builder_reset(direct);
+    pl_str_builder_printf_c(direct, "%d %s", 42, "child");
+    REQUIRE_CMP(pl_str_builder_hash(direct), ==, pl_str_builder_hash(child), PRIx64);
+
+    test_hash(tmp);
+    test_format_float(tmp);
     pl_free(tmp);
     return 0;
 }
@@ -147,6 +147,48 @@ static void vulkan_swapchain_tests(pl_vulkan vk, VkSurfaceKHR surf)
     pl_swapchain_destroy(&sw);
 }
 
+// Runs a single pass on a new dispatch object, optionally loaded from `cache`
+// and saved to `*out_cache`, and returns the number of pipeline cache hits
+// reported by the driver in the meantime
+static uint64_t pipeline_cache_hits(pl_log log, pl_vulkan vk,
+                                    const uint8_t *cache, uint8_t **out_cache)
+{
+    const struct vk_ctx *ctx = PL_PRIV(vk);
+    pl_tex fbo = pl_tex_create(vk->gpu, pl_tex_params(
+        .w = 16,
+        .h = 16,
+        .format = pl_find_fmt(vk->gpu, PL_FMT_UNORM, 4, 8, 8, PL_FMT_CAP_RENDERABLE),
+        .renderable = true,
+    ));
+    REQUIRE(fbo);
+
+    pl_dispatch dp = pl_dispatch_create(log, vk->gpu);
+    if (cache)
+        pl_dispatch_load(dp, cache);
+
+    uint64_t hits = ctx->pipe_cache_hits;
+    pl_shader sh = pl_dispatch_begin(dp);
+    REQUIRE(pl_shader_custom(sh, &(struct pl_custom_shader) {
+        .body = "color = vec4(0.25, 0.5, 0.75, 1.0);",
+        .output = PL_SHADER_SIG_COLOR,
+    }));
+    REQUIRE(pl_dispatch_finish(dp, pl_dispatch_params(
+        .shader = &sh,
+        .target = fbo,
+    )));
+    hits = ctx->pipe_cache_hits - hits;
+
+    if (out_cache) {
+        *out_cache = malloc(pl_dispatch_save(dp, NULL));
+        REQUIRE(*out_cache);
+        pl_dispatch_save(dp, *out_cache);
+    }
+
+    pl_dispatch_destroy(&dp);
+    pl_tex_destroy(vk->gpu, &fbo);
+    return hits;
+}
+
 int main()
 {
     pl_log log = pl_test_logger();
@@ -238,6 +280,192 @@ int main()
         // Print heap statistics
         pl_vk_print_heap(vk->gpu, PL_LOG_DEBUG);
 
+        // Test that passes run within a frame are batched into few submissions
+        pl_tex fbo = pl_tex_create(vk->gpu, pl_tex_params(
+            .w = 16,
+            .h = 16,
+            .format = pl_find_fmt(vk->gpu, PL_FMT_UNORM, 4, 8, 8, PL_FMT_CAP_RENDERABLE),
+            .renderable = true,
+        ));
+        REQUIRE(fbo);
+
+        pl_dispatch dp = pl_dispatch_create(log, vk->gpu);
+        pl_gpu_flush(vk->gpu);
+        for (int i = 0; i < 4; i++) {
+            pl_shader sh = pl_dispatch_begin(dp);
+            REQUIRE(pl_shader_custom(sh, &(struct pl_custom_shader) {
+                .body = "color = vec4(1.0);",
+                .output = PL_SHADER_SIG_COLOR,
+            }));
+            REQUIRE(pl_dispatch_finish(dp, pl_dispatch_params(
+                .shader = &sh,
+                .target = fbo,
+            )));
+        }
+        pl_gpu_flush(vk->gpu);
+
+        struct pl_vulkan_stats stats;
+        pl_vulkan_get_stats(vk, &stats);
+        REQUIRE_CMP(stats.frame_cmd_buffers, >=, 4, "d");
+        REQUIRE_CMP(stats.frame_submissions, <, stats.frame_cmd_buffers, "d");
+        REQUIRE_CMP(stats.cmd_buffers, >=, stats.submissions, PRIu64);
+        pl_dispatch_destroy(&dp);
+        pl_tex_destroy(vk->gpu, &fbo);
+
+        // Test memory statistics, and compaction of sparse slabs by
+        // recreating the surviving textures. Keeping only every 8th texture
+        // leaves several sparse slabs behind, at least one of which must be
+        // drained into the others.
+        const struct pl_tex_params tparams = {
+            .w = 64,
+            .h = 64,
+            .format = pl_find_fmt(vk->gpu, PL_FMT_UNORM, 4, 8, 8, PL_FMT_CAP_RENDERABLE),
+            .renderable = true,
+            .sampleable = true,
+        };
+
+        pl_tex texs[64] = {0};
+        for (int i = 0; i < PL_ARRAY_SIZE(texs); i++) {
+            texs[i] = pl_tex_create(vk->gpu, &tparams);
+            REQUIRE(texs[i]);
+        }
+
+        for (int i = 0; i < PL_ARRAY_SIZE(texs); i++) {
+            if (i % 8)
+                pl_tex_destroy(vk->gpu, &texs[i]);
+        }
+
+        for (int i = 0; i < 10; i++)
+            pl_gpu_flush(vk->gpu);
+
+        struct pl_vulkan_memory_stats before, after;
+        pl_vulkan_get_memory_stats(vk, &before);
+        REQUIRE_CMP(before.num_heaps, >, 0, "d");
+        REQUIRE_CMP(before.allocated, >=, before.used, PRIu64);
+        REQUIRE_CMP(before.allocated, >=, before.fragmented, PRIu64);
+        REQUIRE_CMP(before.num_slabs, >=, before.num_draining, "d");
+        REQUIRE_CMP(before.num_draining, >, 0, "d");
+        REQUIRE_CMP(before.heaps[0].size, >, 0, PRIu64);
+
+        for (int n = 0; n < 10; n++) {
+            for (int i = 0; i < PL_ARRAY_SIZE(texs); i += 8)
+                REQUIRE(pl_tex_recreate(vk->gpu, &texs[i], &tparams));
+            pl_gpu_flush(vk->gpu);
+        }
+
+        pl_vulkan_get_memory_stats(vk, &after);
+        REQUIRE_CMP(after.allocated, <=, before.allocated, PRIu64);
+        REQUIRE_CMP(after.fragmented, <=, before.fragmented, PRIu64);
+        REQUIRE(after.num_slabs < before.num_slabs ||
+                after.fragmented < before.fragmented);
+        pl_vk_print_heap(vk->gpu, PL_LOG_DEBUG);
+        for (int i = 0; i < PL_ARRAY_SIZE(texs); i++)
+            pl_tex_destroy(vk->gpu, &texs[i]);
+
+        // Test that async compute passes are correctly ordered with respect
+        // to the raster passes producing their inputs
+        REQUIRE_CMP(vk->gpu->limits.async_compute, ==,
+                    vk->queue_compute.index != vk->queue_graphics.index, "d");
+
+        const struct pl_tex_params sparams = {
+            .w = 16,
+            .h = 16,
+            .format = pl_find_fmt(vk->gpu, PL_FMT_UNORM, 4, 8, 8,
+                                  PL_FMT_CAP_RENDERABLE | PL_FMT_CAP_STORABLE),
+            .renderable = true,
+            .sampleable = true,
+            .storable = true,
+            .host_readable = true,
+        };
+
+        if (vk->gpu->glsl.compute && sparams.format) {
+            pl_tex stex[2];
+            for (int i = 0; i < PL_ARRAY_SIZE(stex); i++) {
+                stex[i] = pl_tex_create(vk->gpu, &sparams);
+                REQUIRE(stex[i]);
+            }
+
+            dp = pl_dispatch_create(log, vk->gpu);
+            for (int n = 0; n < 8; n++) {
+                pl_shader sh = pl_dispatch_begin(dp);
+                REQUIRE(pl_shader_custom(sh, &(struct pl_custom_shader) {
+                    .body = "color = vec4(val);",
+                    .output = PL_SHADER_SIG_COLOR,
+                    .num_variables = 1,
+                    .variables = &(struct pl_shader_var) {
+                        .var = pl_var_float("val"),
+                        .data = &(float) { n / 8.0f },
+                    },
+                }));
+                REQUIRE(pl_dispatch_finish(dp, pl_dispatch_params(
+                    .shader = &sh,
+                    .target = stex[0],
+                )));
+
+                sh = pl_dispatch_begin(dp);
+                REQUIRE(pl_shader_custom(sh, &(struct pl_custom_shader) {
+                    .body = "ivec2 pos = ivec2(gl_GlobalInvocationID);          \n"
+                            "imageStore(dst, pos, texelFetch(src, pos, 0));     \n",
+                    .compute = true,
+                    .compute_group_size = { 8, 8 },
+                    .num_descriptors = 2,
+                    .descriptors = (struct pl_shader_desc[]) {
+                        {
+                            .desc = {
+                                .name = "src",
+                                .type = PL_DESC_SAMPLED_TEX,
+                            },
+                            .binding.object = stex[0],
+                        }, {
+                            .desc = {
+                                .name = "dst",
+                                .type = PL_DESC_STORAGE_IMG,
+                                .access = PL_DESC_ACCESS_WRITEONLY,
+                            },
+                            .binding.object = stex[1],
+                        },
+                    },
+                }));
+                REQUIRE(pl_dispatch_compute(dp, pl_dispatch_compute_params(
+                    .shader = &sh,
+                    .dispatch_size = { 2, 2, 1 },
+                    .async_compute = true,
+                )));
+
+                uint8_t pixels[16 * 16 * 4];
+                REQUIRE(pl_tex_download(vk->gpu, pl_tex_transfer_params(
+                    .tex = stex[1],
+                    .ptr = pixels,
+                )));
+
+                int expected = lrintf(n * 255 / 8.0f);
+                for (int i = 0; i < PL_ARRAY_SIZE(pixels); i++)
+                    REQUIRE_CMP(abs(pixels[i] - expected), <=, 1, "d");
+            }
+
+            pl_dispatch_destroy(&dp);
+            for (int i = 0; i < PL_ARRAY_SIZE(stex); i++)
+                pl_tex_destroy(vk->gpu, &stex[i]);
+        }
+
+        // Test that passes re-created from their cached program actually hit
+        // the pipeline cache. Only checked if the driver can tell us.
+        const struct vk_ctx *ctx = PL_PRIV(vk);
+        const bool feedback = ctx->api_ver >= VK_API_VERSION_1_3;
+        uint8_t *dp_cache = NULL;
+        pipeline_cache_hits(log, vk, NULL, &dp_cache);
+        uint64_t hits = pipeline_cache_hits(log, vk, dp_cache, NULL);
+        if (feedback)
+            REQUIRE_CMP(hits, >, 0, PRIu64);
+        free(dp_cache);
+
+        // Test saving the device-wide pipeline cache
+        size_t cache_size = pl_vulkan_save_pipeline_cache(vk, NULL, 0);
+        REQUIRE(cache_size);
+        uint8_t *cache = malloc(cache_size);
+        REQUIRE(cache);
+        REQUIRE_CMP(pl_vulkan_save_pipeline_cache(vk, cache, cache_size), ==, cache_size, "zu");
+
         // Test importing this context via the vulkan interop API
         pl_vulkan vk2 = pl_vulkan_import(log, pl_vulkan_import_params(
             .instance = vk->instance,
@@ -253,6 +481,14 @@ int main()
             .queue_transfer = vk->queue_transfer,
         ));
         REQUIRE(vk2);
+        pl_vulkan_load_pipeline_cache(vk2, cache, cache_size);
+        free(cache);
+
+        // New passes are created against the loaded device-wide cache, which
+        // already contains the same pipeline
+        hits = pipeline_cache_hits(log, vk2, NULL, NULL);
+        if (feedback)
+            REQUIRE_CMP(hits, >, 0, PRIu64);
         pl_vulkan_destroy(&vk2);
 
         // Run these tests last because they disable some validation layers
@@ -284,6 +520,15 @@ int main()
         gpu_interop_tests(vk->gpu);
         pl_vulkan_destroy(&vk);
 
+        // Test running callbacks on a dedicated completion thread
+        params.completion_thread = true;
+        vk = pl_vulkan_create(log, &params);
+        REQUIRE(vk);
+        pl_buffer_tests(vk->gpu);
+        pl_texture_tests(vk->gpu);
+        pl_shader_tests(vk->gpu);
+        pl_vulkan_destroy(&vk);
+
         // Reduce log spam after first tested device
         pl_log_level_update(log, PL_LOG_INFO);
     }
@@ -30,25 +30,127 @@ static VkResult vk_cmd_poll(struct vk_ctx *vk, struct vk_cmd *cmd,
     }, timeout);
 }
 
-static void flush_callbacks(struct vk_ctx *vk)
+// Callbacks are run while holding `vk->callback_lock`, but never `vk->lock`,
+// so they are free to record, submit and poll commands themselves. The lock is
+// recursive, and `callback_depth` tracks how deeply the thread currently
+// holding it is nested. `in_thread` is only updated by the outermost level.
+static void lock_callbacks(struct vk_ctx *vk, bool in_thread)
 {
-    while (vk->num_pending_callbacks) {
-        const struct vk_callback *cb = vk->pending_callbacks++;
-        vk->num_pending_callbacks--;
-        cb->run(cb->priv, cb->arg);
+    pl_mutex_lock(&vk->callback_lock);
+    if (!vk->callback_depth++)
+        vk->in_thread = in_thread;
+}
+
+static bool trylock_callbacks(struct vk_ctx *vk, bool in_thread)
+{
+    if (pl_mutex_trylock(&vk->callback_lock))
+        return false;
+    if (!vk->callback_depth++)
+        vk->in_thread = in_thread;
+    return true;
+}
+
+static bool has_ready_callbacks(struct vk_ctx *vk)
+{
+    pl_mutex_lock(&vk->lock);
+    bool ret = vk->ready_callbacks_head < vk->ready_callbacks.num;
+    pl_mutex_unlock(&vk->lock);
+    return ret;
+}
+
+static bool run_ready_callbacks(struct vk_ctx *vk);
+
+// Must be called without holding `vk->lock`.
+static void unlock_callbacks(struct vk_ctx *vk)
+{
+    bool outermost = vk->callback_depth == 1;
+    bool in_thread = vk->in_thread;
+    vk->callback_depth--;
+    pl_mutex_unlock(&vk->callback_lock);
+    if (!outermost)
+        return;
+
+    // Other threads may have retired commands while we were holding the lock,
+    // without being able to run their callbacks, so pick those up
+    while (has_ready_callbacks(vk) && trylock_callbacks(vk, in_thread)) {
+        run_ready_callbacks(vk);
+        vk->callback_depth--;
+        pl_mutex_unlock(&vk->callback_lock);
     }
 }
 
-static void vk_cmd_reset(struct vk_ctx *vk, struct vk_cmd *cmd)
+// Runs a callback, or defers it if it's a local callback and it either can't
+// run on this thread, or other local callbacks are still waiting to run.
+static void run_callback(struct vk_ctx *vk, const struct vk_callback *cb)
+{
+    if (cb->local) {
+        pl_mutex_lock(&vk->lock);
+        bool defer = vk->in_thread || vk->local_callbacks.num;
+        if (defer)
+            PL_ARRAY_APPEND(vk->alloc, vk->local_callbacks, *cb);
+        pl_mutex_unlock(&vk->lock);
+        if (defer)
+            return;
+    }
+
+    cb->run(cb->priv, cb->arg);
+}
+
+// Runs the callbacks of all retired commands, in FIFO order. Must be called
+// with `vk->callback_lock` held, but not `vk->lock`. Since these are popped
+// one at a time, callbacks recursively running this function (e.g. by polling
+// commands) preserve the overall order. Returns whether any callbacks were run.
+static bool run_ready_callbacks(struct vk_ctx *vk)
+{
+    bool ret = false;
+    pl_mutex_lock(&vk->lock);
+    while (vk->ready_callbacks_head < vk->ready_callbacks.num) {
+        struct vk_callback cb = vk->ready_callbacks.elem[vk->ready_callbacks_head++];
+        pl_mutex_unlock(&vk->lock);
+        run_callback(vk, &cb);
+        ret = true;
+        pl_mutex_lock(&vk->lock);
+    }
+
+    vk->ready_callbacks.num = vk->ready_callbacks_head = 0;
+    pl_mutex_unlock(&vk->lock);
+    return ret;
+}
+
+// Runs all deferred local callbacks. Must not be called from the completion
+// thread, and must be called with `vk->callback_lock` held, but not
+// `vk->lock`. Returns whether any callbacks were run.
+static bool run_local_callbacks(struct vk_ctx *vk)
+{
+    bool ret = false;
+    pl_mutex_lock(&vk->lock);
+    while (vk->local_callbacks_head < vk->local_callbacks.num) {
+        struct vk_callback cb = vk->local_callbacks.elem[vk->local_callbacks_head++];
+        pl_mutex_unlock(&vk->lock);
+        cb.run(cb.priv, cb.arg);
+        ret = true;
+        pl_mutex_lock(&vk->lock);
+    }
+
+    vk->local_callbacks.num = vk->local_callbacks_head = 0;
+    pl_mutex_unlock(&vk->lock);
+    return ret;
+}
+
+// Runs the ready callbacks, unless another thread is already busy doing so,
+// in which case that thread will pick them up instead. Never blocks on other
+// threads, so this is safe to call while holding unrelated locks (that the
+// callbacks may need). Must be called without holding `vk->lock`.
+static void try_run_ready_callbacks(struct vk_ctx *vk)
 {
-    // Flush possible callbacks left over from a previous command still in the
-    // process of being reset, whose callback triggered this command being
-    // reset.
-    flush_callbacks(vk);
-    vk->pending_callbacks = cmd->callbacks.elem;
-    vk->num_pending_callbacks = cmd->callbacks.num;
-    flush_callbacks(vk);
+    if (trylock_callbacks(vk, false)) {
+        run_ready_callbacks(vk);
+        unlock_callbacks(vk);
+    }
+}
 
+static void vk_cmd_reset(struct vk_ctx *vk, struct vk_cmd *cmd)
+{
     cmd->callbacks.num = 0;
     cmd->deps.num = 0;
     cmd->depstages.num = 0;
@@ -70,6 +172,17 @@ static void vk_cmd_destroy(struct vk_ctx *vk, struct vk_cmd *cmd)
     pl_free(cmd);
 }
 
+// Moves the callbacks of a command that is no longer queued or pending to the
+// list of ready callbacks, and returns the command to its pool. Must be called
+// with `vk->lock` held. The callbacks are run separately, without the lock.
+static void vk_cmd_recycle(struct vk_ctx *vk, struct vk_cmd *cmd)
+{
+    for (int i = 0; i < cmd->callbacks.num; i++)
+        PL_ARRAY_APPEND(vk->alloc, vk->ready_callbacks, cmd->callbacks.elem[i]);
+    vk_cmd_reset(vk, cmd);
+    PL_ARRAY_APPEND(cmd->pool, cmd->pool->cmds, cmd);
+}
+
 static struct vk_cmd *vk_cmd_create(struct vk_ctx *vk, struct vk_cmdpool *pool)
 {
     struct vk_cmd *cmd = pl_zalloc_ptr(NULL, cmd);
@@ -106,20 +219,50 @@ error:
     return NULL;
 }
 
-void vk_dev_callback(struct vk_ctx *vk, vk_cb callback,
-                     const void *priv, const void *arg)
+static void dev_callback(struct vk_ctx *vk, struct vk_callback cb)
 {
     pl_mutex_lock(&vk->lock);
-    if (vk->cmds_pending.num > 0) {
+    if (vk->cmds_queued.num > 0) {
+        struct vk_cmd *last_cmd = vk->cmds_queued.elem[vk->cmds_queued.num - 1];
+        PL_ARRAY_APPEND(last_cmd, last_cmd->callbacks, cb);
+    } else if (vk->num_cmds_submitting > 0) {
+        struct vk_cmd *last_cmd = vk->cmds_submitting[vk->num_cmds_submitting - 1];
+        PL_ARRAY_APPEND(last_cmd, last_cmd->callbacks, cb);
+    } else if (vk->cmds_pending.num > 0) {
         struct vk_cmd *last_cmd = vk->cmds_pending.elem[vk->cmds_pending.num - 1];
-        vk_cmd_callback(last_cmd, callback, priv, arg);
+        PL_ARRAY_APPEND(last_cmd, last_cmd->callbacks, cb);
     } else {
         // The device was already idle, so we can just immediately call it
-        callback((void *) priv, (void *) arg);
+        // (after any still outstanding callbacks of retired commands)
+        PL_ARRAY_APPEND(vk->alloc, vk->ready_callbacks, cb);
+        pl_mutex_unlock(&vk->lock);
+        try_run_ready_callbacks(vk);
+        return;
     }
     pl_mutex_unlock(&vk->lock);
 }
 
+void vk_dev_callback(struct vk_ctx *vk, vk_cb callback,
+                     const void *priv, const void *arg)
+{
+    dev_callback(vk, (struct vk_callback) {
+        .run  = callback,
+        .priv = (void *) priv,
+        .arg  = (void *) arg,
+    });
+}
+
+void vk_dev_callback_local(struct vk_ctx *vk, vk_cb callback,
+                           const void *priv, const void *arg)
+{
+    dev_callback(vk, (struct vk_callback) {
+        .run   = callback,
+        .priv  = (void *) priv,
+        .arg   = (void *) arg,
+        .local = true,
+    });
+}
+
 void vk_cmd_callback(struct vk_cmd *cmd, vk_cb callback,
                      const void *priv, const void *arg)
 {
@@ -130,6 +273,17 @@ void vk_cmd_callback(struct vk_cmd *cmd, vk_cb callback,
     });
 }
 
+void vk_cmd_callback_local(struct vk_cmd *cmd, vk_cb callback,
+                           const void *priv, const void *arg)
+{
+    PL_ARRAY_APPEND(cmd, cmd->callbacks, (struct vk_callback) {
+        .run   = callback,
+        .priv  = (void *) priv,
+        .arg   = (void *) arg,
+        .local = true,
+    });
+}
+
 void vk_cmd_dep(struct vk_cmd *cmd, VkPipelineStageFlags stage, pl_vulkan_sem dep)
 {
     assert(cmd->deps.num == cmd->depstages.num);
@@ -313,84 +467,182 @@ bool vk_cmd_submit(struct vk_ctx *vk, struct vk_cmd **pcmd)
         return true;
 
     *pcmd = NULL;
-    struct vk_cmdpool *pool = cmd->pool;
-
     VK(vk->EndCommandBuffer(cmd->buf));
 
-    VkTimelineSemaphoreSubmitInfo tinfo = {
-        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
-        .waitSemaphoreValueCount = cmd->depvalues.num,
-        .pWaitSemaphoreValues = cmd->depvalues.elem,
-        .signalSemaphoreValueCount = cmd->sigvalues.num,
-        .pSignalSemaphoreValues = cmd->sigvalues.elem,
-    };
+    pl_mutex_lock(&vk->lock);
+    PL_ARRAY_APPEND(vk->alloc, vk->cmds_queued, cmd);
+    pl_mutex_unlock(&vk->lock);
+    return true;
 
-    VkSubmitInfo sinfo = {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .pNext = &tinfo,
-        .commandBufferCount = 1,
-        .pCommandBuffers = &cmd->buf,
-        .waitSemaphoreCount = cmd->deps.num,
-        .pWaitSemaphores = cmd->deps.elem,
-        .pWaitDstStageMask = cmd->depstages.elem,
-        .signalSemaphoreCount = cmd->sigs.num,
-        .pSignalSemaphores = cmd->sigs.elem,
-    };
+error:
+    // The callbacks are left for the next `vk_poll_commands`, since the caller
+    // may be holding locks that they need
+    pl_mutex_lock(&vk->lock);
+    vk_cmd_recycle(vk, cmd);
+    pl_mutex_unlock(&vk->lock);
+    vk->failed = true;
+    return false;
+}
 
-    if (pl_msg_test(vk->log, PL_LOG_TRACE)) {
-        PL_TRACE(vk, "Submitting command %p on queue %p (QF %d):",
-                 (void *) cmd->buf, (void *) cmd->queue, pool->qf);
-        for (int n = 0; n < cmd->deps.num; n++) {
-            PL_TRACE(vk, "    waits on semaphore 0x%"PRIx64" = %"PRIu64,
-                     (uint64_t) cmd->deps.elem[n], cmd->depvalues.elem[n]);
-        }
-        for (int n = 0; n < cmd->sigs.num; n++) {
-            PL_TRACE(vk, "    signals semaphore 0x%"PRIx64" = %"PRIu64,
-                    (uint64_t) cmd->sigs.elem[n], cmd->sigvalues.elem[n]);
+// Submits `num` queued commands, which must all target the same queue, with
+// a single vkQueueSubmit call. Must be called with `vk->submit_lock` held, but
+// not `vk->lock`. Returns false on failure, in which case the commands are
+// left to the caller to recycle.
+static bool submit_batch(struct vk_ctx *vk, struct vk_cmd **cmds, int num)
+{
+    struct vk_cmdpool *pool = cmds[0]->pool;
+    VkQueue queue = cmds[0]->queue;
+    int qindex = cmds[0]->qindex;
+    pl_assert(vk->submit_infos.num >= num);
+
+    for (int i = 0; i < num; i++) {
+        struct vk_cmd *cmd = cmds[i];
+        pl_assert(cmd->queue == queue);
+
+        VkTimelineSemaphoreSubmitInfo *tinfo = &vk->timeline_infos.elem[i];
+        *tinfo = (VkTimelineSemaphoreSubmitInfo) {
+            .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+            .waitSemaphoreValueCount = cmd->depvalues.num,
+            .pWaitSemaphoreValues = cmd->depvalues.elem,
+            .signalSemaphoreValueCount = cmd->sigvalues.num,
+            .pSignalSemaphoreValues = cmd->sigvalues.elem,
+        };
+
+        vk->submit_infos.elem[i] = (VkSubmitInfo) {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .pNext = tinfo,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &cmd->buf,
+            .waitSemaphoreCount = cmd->deps.num,
+            .pWaitSemaphores = cmd->deps.elem,
+            .pWaitDstStageMask = cmd->depstages.elem,
+            .signalSemaphoreCount = cmd->sigs.num,
+            .pSignalSemaphores = cmd->sigs.elem,
+        };
+
+        if (pl_msg_test(vk->log, PL_LOG_TRACE)) {
+            PL_TRACE(vk, "Submitting command %p on queue %p (QF %d, batch %d/%d):",
+                     (void *) cmd->buf, (void *) queue, pool->qf, i + 1, num);
+            for (int n = 0; n < cmd->deps.num; n++) {
+                PL_TRACE(vk, "    waits on semaphore 0x%"PRIx64" = %"PRIu64,
+                         (uint64_t) cmd->deps.elem[n], cmd->depvalues.elem[n]);
+            }
+            for (int n = 0; n < cmd->sigs.num; n++) {
+                PL_TRACE(vk, "    signals semaphore 0x%"PRIx64" = %"PRIu64,
+                        (uint64_t) cmd->sigs.elem[n], cmd->sigvalues.elem[n]);
+            }
         }
-        if (cmd->callbacks.num)
-            PL_TRACE(vk, "    signals %d callbacks", cmd->callbacks.num);
     }
 
-    vk->lock_queue(vk->queue_ctx, pool->qf, cmd->qindex);
-    VkResult res = vk->QueueSubmit(cmd->queue, 1, &sinfo, VK_NULL_HANDLE);
-    vk->unlock_queue(vk->queue_ctx, pool->qf, cmd->qindex);
+    vk->lock_queue(vk->queue_ctx, pool->qf, qindex);
+    VkResult res = vk->QueueSubmit(queue, num, vk->submit_infos.elem, VK_NULL_HANDLE);
+    vk->unlock_queue(vk->queue_ctx, pool->qf, qindex);
     PL_VK_ASSERT(res, "vkQueueSubmit");
 
     pl_mutex_lock(&vk->lock);
-    PL_ARRAY_APPEND(vk->alloc, vk->cmds_pending, cmd);
+    for (int i = 0; i < num; i++)
+        PL_ARRAY_APPEND(vk->alloc, vk->cmds_pending, cmds[i]);
+    vk->cmds_submitting += num;
+    vk->num_cmds_submitting -= num;
+    if (vk->thread_running)
+        pl_cond_broadcast(&vk->thread_cond);
+
+    vk->stats.submissions++;
+    vk->stats.cmd_buffers += num;
+    vk->frame_submissions++;
+    vk->frame_cmd_buffers += num;
     pl_mutex_unlock(&vk->lock);
     return true;
 
 error:
-    vk_cmd_reset(vk, cmd);
     pl_mutex_lock(&vk->lock);
-    PL_ARRAY_APPEND(pool, pool->cmds, cmd);
-    pl_mutex_unlock(&vk->lock);
+    vk->cmds_submitting += num;
+    vk->num_cmds_submitting -= num;
     vk->failed = true;
+    pl_mutex_unlock(&vk->lock);
     return false;
 }
 
-bool vk_poll_commands(struct vk_ctx *vk, uint64_t timeout)
+bool vk_flush_commands(struct vk_ctx *vk)
 {
-    bool ret = false;
+    bool ret = true;
+    pl_mutex_lock(&vk->submit_lock);
     pl_mutex_lock(&vk->lock);
 
+    // Detach the queued commands, so that other threads can keep recording
+    // and queueing new commands while we're busy submitting these
+    struct vk_cmd **cmds = vk->cmds_queued.elem;
+    int num_cmds = vk->cmds_queued.num;
+    vk->cmds_queued.elem = NULL;
+    vk->cmds_queued.num = 0;
+    vk->cmds_submitting = cmds;
+    vk->num_cmds_submitting = num_cmds;
+
+    if (vk->submit_infos.num < num_cmds) {
+        PL_ARRAY_RESIZE(vk->alloc, vk->submit_infos, num_cmds);
+        PL_ARRAY_RESIZE(vk->alloc, vk->timeline_infos, num_cmds);
+        vk->submit_infos.num = vk->timeline_infos.num = num_cmds;
+    }
+    pl_mutex_unlock(&vk->lock);
+
+    // Failed commands are compacted to the front of `cmds`, and only recycled
+    // at the end, after all batches were submitted
+    int num_failed = 0;
+    for (int start = 0, end; start < num_cmds; start = end) {
+        for (end = start + 1; end < num_cmds; end++) {
+            if (cmds[end]->queue != cmds[start]->queue)
+                break;
+        }
+        if (!submit_batch(vk, &cmds[start], end - start)) {
+            for (int i = start; i < end; i++)
+                cmds[num_failed++] = cmds[i];
+            ret = false;
+        }
+    }
+
+    pl_mutex_lock(&vk->lock);
+    pl_assert(!vk->num_cmds_submitting);
+    vk->cmds_submitting = NULL;
+    for (int i = 0; i < num_failed; i++)
+        vk_cmd_recycle(vk, cmds[i]);
+
+    // Re-use the allocation if nothing else was queued in the meantime
+    if (!vk->cmds_queued.elem) {
+        vk->cmds_queued.elem = cmds;
+    } else {
+        pl_free(cmds);
+    }
+
+    pl_mutex_unlock(&vk->lock);
+    pl_mutex_unlock(&vk->submit_lock);
+    if (num_failed)
+        try_run_ready_callbacks(vk);
+    return ret;
+}
+
+// Retires all completed commands, blocking for at most `timeout` for the
+// first one. Their callbacks are only moved to the list of ready callbacks,
+// which the caller is responsible for running. Must be called without holding
+// `vk->lock`.
+static bool retire_commands(struct vk_ctx *vk, uint64_t timeout)
+{
+    bool ret = false;
+    pl_mutex_lock(&vk->lock);
     while (vk->cmds_pending.num) {
         struct vk_cmd *cmd = vk->cmds_pending.elem[0];
-        struct vk_cmdpool *pool = cmd->pool;
         pl_mutex_unlock(&vk->lock); // don't hold mutex while blocking
-        if (vk_cmd_poll(vk, cmd, timeout) == VK_TIMEOUT)
-            return ret;
+        VkResult res = vk_cmd_poll(vk, cmd, timeout);
         pl_mutex_lock(&vk->lock);
+        if (res == VK_TIMEOUT)
+            break;
         if (!vk->cmds_pending.num || vk->cmds_pending.elem[0] != cmd)
             continue; // another thread modified this state while blocking
 
         PL_TRACE(vk, "VkSemaphore signalled: 0x%"PRIx64" = %"PRIu64,
                  (uint64_t) cmd->sync.sem, cmd->sync.value);
-        PL_ARRAY_REMOVE_AT(vk->cmds_pending, 0); // remove before callbacks
-        vk_cmd_reset(vk, cmd);
-        PL_ARRAY_APPEND(pool, pool->cmds, cmd);
+        PL_ARRAY_REMOVE_AT(vk->cmds_pending, 0);
+        vk_cmd_recycle(vk, cmd);
+        vk->cmds_completed++;
         ret = true;
 
         // If we've successfully spent some time waiting for at least one
@@ -401,10 +653,133 @@ bool vk_poll_commands(struct vk_ctx *vk, uint64_t timeout)
         timeout = 0;
     }
 
+    if (ret && vk->thread_running)
+        pl_cond_broadcast(&vk->thread_cond);
+    pl_mutex_unlock(&vk->lock);
+    return ret;
+}
+
+// Waits for at most `timeout` for the completion thread to retire a command.
+// Must be called with `vk->callback_lock` held exactly once, since it's
+// released while waiting, and without holding `vk->lock`.
+static bool wait_completion_thread(struct vk_ctx *vk, uint64_t timeout)
+{
+    bool ret = run_ready_callbacks(vk);
+    ret |= run_local_callbacks(vk);
+    if (ret || !timeout)
+        return ret;
+
+    pl_mutex_lock(&vk->lock);
+    uint64_t completed = vk->cmds_completed;
     pl_mutex_unlock(&vk->lock);
+    unlock_callbacks(vk);
+
+    pl_mutex_lock(&vk->lock);
+    while (vk->cmds_pending.num && vk->cmds_completed == completed) {
+        if (pl_cond_timedwait(&vk->thread_cond, &vk->lock, timeout) == ETIMEDOUT)
+            break;
+    }
+    ret = vk->cmds_completed != completed;
+    pl_mutex_unlock(&vk->lock);
+
+    // Make sure the callbacks of the retired command have finished running
+    lock_callbacks(vk, false);
+    run_ready_callbacks(vk);
+    run_local_callbacks(vk);
     return ret;
 }
 
+bool vk_poll_commands(struct vk_ctx *vk, uint64_t timeout)
+{
+    if (timeout)
+        vk_flush_commands(vk);
+
+    pl_mutex_lock(&vk->lock);
+    bool thread_running = vk->thread_running;
+    pl_mutex_unlock(&vk->lock);
+
+    // Non-blocking polls are also used opportunistically while holding other
+    // locks, which callbacks running on another thread may be waiting on. So
+    // never wait for those to finish; the other thread will pick up the
+    // callbacks of any commands retired here.
+    if (!timeout && !trylock_callbacks(vk, false))
+        return !thread_running && retire_commands(vk, 0);
+    if (timeout)
+        lock_callbacks(vk, false);
+
+    bool ret;
+    if (thread_running && vk->callback_depth == 1) {
+        ret = wait_completion_thread(vk, timeout);
+    } else {
+        // Without a completion thread, or when called from inside a callback
+        // (which prevents the completion thread from making progress), retire
+        // the commands directly
+        ret = retire_commands(vk, timeout);
+        ret |= run_ready_callbacks(vk);
+    }
+    unlock_callbacks(vk);
+    return ret;
+}
+
+static PL_THREAD_VOID completion_thread(void *arg)
+{
+    struct vk_ctx *vk = arg;
+    pl_mutex_lock(&vk->lock);
+    while (!vk->thread_quit || vk->cmds_pending.num) {
+        if (!vk->cmds_pending.num) {
+            pl_cond_wait(&vk->thread_cond, &vk->lock);
+            continue;
+        }
+
+        pl_mutex_unlock(&vk->lock);
+        if (retire_commands(vk, UINT64_MAX)) {
+            lock_callbacks(vk, true);
+            run_ready_callbacks(vk);
+            unlock_callbacks(vk);
+        }
+        pl_mutex_lock(&vk->lock);
+    }
+    pl_mutex_unlock(&vk->lock);
+    PL_THREAD_RETURN();
+}
+
+bool vk_completion_thread_start(struct vk_ctx *vk)
+{
+    pl_assert(!vk->thread_running);
+    vk->thread_quit = false;
+    if (pl_thread_create(&vk->thread, completion_thread, vk) != 0) {
+        PL_WARN(vk, "Failed creating completion thread, running callbacks "
+                "on the calling threads instead");
+        return false;
+    }
+
+    pl_mutex_lock(&vk->lock);
+    vk->thread_running = true;
+    pl_mutex_unlock(&vk->lock);
+    return true;
+}
+
+void vk_completion_thread_stop(struct vk_ctx *vk)
+{
+    if (!vk->thread_running)
+        return;
+
+    pl_mutex_lock(&vk->lock);
+    vk->thread_quit = true;
+    pl_cond_broadcast(&vk->thread_cond);
+    pl_mutex_unlock(&vk->lock);
+    pl_thread_join(vk->thread);
+
+    pl_mutex_lock(&vk->lock);
+    vk->thread_running = false;
+    pl_mutex_unlock(&vk->lock);
+
+    lock_callbacks(vk, false);
+    run_ready_callbacks(vk);
+    run_local_callbacks(vk);
+    unlock_callbacks(vk);
+}
+
 void vk_rotate_queues(struct vk_ctx *vk)
 {
     pl_mutex_lock(&vk->lock);
@@ -416,6 +791,10 @@ void vk_rotate_queues(struct vk_ctx *vk)
         PL_TRACE(vk, "QF %d: %d/%d", pool->qf, pool->idx_queues, pool->num_queues);
     }
 
+    vk->stats.frame_submissions = vk->frame_submissions;
+    vk->stats.frame_cmd_buffers = vk->frame_cmd_buffers;
+    vk->frame_submissions = vk->frame_cmd_buffers = 0;
+
     pl_mutex_unlock(&vk->lock);
 }
 
@@ -423,3 +802,11 @@ void vk_wait_idle(struct vk_ctx *vk)
 {
     while (vk_poll_commands(vk, UINT64_MAX)) ;
 }
+
+void pl_vulkan_get_stats(pl_vulkan pl_vk, struct pl_vulkan_stats *out_stats)
+{
+    struct vk_ctx *vk = PL_PRIV(pl_vk);
+    pl_mutex_lock(&vk->lock);
+    *out_stats = vk->stats;
+    pl_mutex_unlock(&vk->lock);
+}
@@ -28,6 +28,7 @@ struct vk_callback {
     vk_cb run;
     void *priv;
     void *arg;
+    bool local; // never run on the completion thread
 };
 
 // Associate a callback with the completion of all currently pending commands.
@@ -35,6 +36,10 @@ struct vk_callback {
 void vk_dev_callback(struct vk_ctx *vk, vk_cb callback,
                      const void *priv, const void *arg);
 
+// Like `vk_dev_callback`, but with the semantics of `vk_cmd_callback_local`.
+void vk_dev_callback_local(struct vk_ctx *vk, vk_cb callback,
+                           const void *priv, const void *arg);
+
 // Helper wrapper around command buffers that also track dependencies,
 // callbacks and synchronization primitives
 //
@@ -64,6 +69,13 @@ struct vk_cmd {
 void vk_cmd_callback(struct vk_cmd *cmd, vk_cb callback,
                      const void *priv, const void *arg);
 
+// Like `vk_cmd_callback`, but the callback is never run from the completion
+// thread (if any). Instead, it's deferred until the next `vk_poll_commands`
+// call from any other thread. Use this for callbacks that modify state which
+// is not otherwise synchronized with the threads using the `pl_gpu`.
+void vk_cmd_callback_local(struct vk_cmd *cmd, vk_cb callback,
+                           const void *priv, const void *arg);
+
 // Associate a raw dependency for the current command. This semaphore must
 // signal by the corresponding stage before the command may execute.
 void vk_cmd_dep(struct vk_cmd *cmd, VkPipelineStageFlags stage, pl_vulkan_sem dep);
@@ -127,27 +139,66 @@ void vk_cmdpool_destroy(struct vk_ctx *vk, struct vk_cmdpool *pool);
 struct vk_cmd *vk_cmd_begin(struct vk_ctx *vk, struct vk_cmdpool *pool,
                             pl_debug_tag debug_tag);
 
-// Finish recording a command buffer and submit it for execution. This function
+// Finish recording a command buffer and queue it for execution. This function
 // takes over ownership of **cmd, and sets *cmd to NULL in doing so.
+//
+// Note: Queued commands are only actually submitted to the GPU by the next
+// call to `vk_flush_commands`, which batches them together.
 bool vk_cmd_submit(struct vk_ctx *vk, struct vk_cmd **cmd);
 
-// Block until some commands complete executing. This is the only function that
-// actually processes the callbacks. Will wait at most `timeout` nanoseconds
-// for the completion of any command. The timeout may also be passed as 0, in
-// which case this function will not block, but only poll for completed
-// commands. Returns whether any forward progress was made.
+// Submit all queued commands for execution. Runs of consecutive commands
+// targeting the same queue are submitted with a single vkQueueSubmit call, but
+// the overall submission order is preserved. Returns false if any submission
+// failed.
+//
+// The queued commands are detached under `vk->lock`, but submitted without
+// holding it, so other threads may keep recording and queueing commands (or
+// retiring completed ones) in the meantime. Concurrent flushes are serialized
+// by `vk->submit_lock`, which must not be acquired while holding `vk->lock`.
+bool vk_flush_commands(struct vk_ctx *vk);
+
+// Block until some commands complete executing. Unless the completion thread
+// is running, this is the only function that actually processes the
+// callbacks. Will wait at most `timeout` nanoseconds for the completion of any
+// command. The timeout may also be passed as 0, in which case this function
+// will not block, but only poll for completed commands. Returns whether any
+// forward progress was made.
 //
-// This does *not* flush any queued commands, forgetting to do so may result
-// in infinite loops if waiting for the completion of callbacks that were
-// never flushed!
+// If `timeout` is nonzero, this first calls `vk_flush_commands`. It does *not*
+// submit any command that is still being recorded, and forgetting to do so may
+// result in infinite loops if waiting for the completion of callbacks that
+// were never submitted!
+//
+// Callbacks are run without holding `vk->lock`, so they may freely record,
+// submit and poll commands of their own. With a timeout of 0, this never waits
+// for callbacks that are currently running on another thread, which makes it
+// safe to call while holding locks those callbacks may need.
 bool vk_poll_commands(struct vk_ctx *vk, uint64_t timeout);
 
 // Rotate through queues in each command pool. Call this once per frame, after
 // submitting all of the command buffers for that frame. Calling this more
-// often than that is possible but bad for performance.
+// often than that is possible but bad for performance. This also marks the
+// end of a frame for the purposes of `pl_vulkan_stats`.
 void vk_rotate_queues(struct vk_ctx *vk);
 
 // Wait until all commands are complete, i.e. the device is idle. This is
 // basically equivalent to calling `vk_poll_commands` with a timeout of
 // UINT64_MAX until it returns `false`.
 void vk_wait_idle(struct vk_ctx *vk);
+
+// Start a dedicated thread which waits for pending commands and retires them
+// (running their callbacks) as soon as they complete, rather than whenever
+// the next thread happens to call `vk_poll_commands`. While this thread is
+// running, `vk_poll_commands` instead waits for it to make progress, and only
+// runs deferred local callbacks itself (unless called from inside a callback,
+// in which case it retires commands directly, as the thread can't proceed).
+//
+// Commands are still retired strictly in submission order, and callbacks
+// never run concurrently with each other, since they all execute while
+// holding `vk->callback_lock`. Local callbacks run in FIFO order relative to
+// each other, but may run after the callbacks of subsequent commands.
+bool vk_completion_thread_start(struct vk_ctx *vk);
+
+// Stop the completion thread, after all pending commands have been retired.
+// Does nothing if the thread was not running.
+void vk_completion_thread_stop(struct vk_ctx *vk);
@@ -95,13 +95,67 @@ struct vk_ctx {
 
     // Pending commands. These are shared for the entire mpvk_ctx to ensure
     // submission and callbacks are FIFO
+    PL_ARRAY(struct vk_cmd *) cmds_queued;  // recorded but not submitted
     PL_ARRAY(struct vk_cmd *) cmds_pending; // submitted but not completed
 
-    // Pending callbacks that still need to be drained before processing
-    // callbacks for the next command (in case commands are recursively being
-    // polled from another callback)
-    const struct vk_callback *pending_callbacks;
-    int num_pending_callbacks;
+    // Commands taken from `cmds_queued` by `vk_flush_commands`, which are in
+    // the process of being submitted without holding `lock`.
+    struct vk_cmd **cmds_submitting;
+    int num_cmds_submitting;
+
+    // Serializes `vk_flush_commands`, to preserve the submission order while
+    // calling into the queue without holding `lock`. Also protects the
+    // submission scratch space. Must be acquired before `lock`, if both are
+    // needed at the same time.
+    pl_mutex submit_lock;
+
+    // Scratch space for batched submissions, and the resulting statistics
+    PL_ARRAY(VkSubmitInfo) submit_infos;
+    PL_ARRAY(VkTimelineSemaphoreSubmitInfo) timeline_infos;
+    struct pl_vulkan_stats stats;
+    int frame_submissions;
+    int frame_cmd_buffers;
+
+    // Device-wide pipeline cache, which the per-pass pipeline caches get
+    // merged into. Pipeline creation against it counts as a user of the
+    // cache; merging into it requires exclusive access, so it waits for all
+    // users to finish, while blocking new users in the meantime.
+    VkPipelineCache pipe_cache;
+    pl_mutex pipe_cache_lock;
+    pl_cond pipe_cache_cond;
+    int pipe_cache_users;
+    int pipe_cache_writers;
+    bool pipe_cache_loaded; // see `pl_vulkan_load_pipeline_cache`
+    uint64_t pipe_cache_hits; // as reported by the driver, for testing
+
+    // Serializes running command callbacks, which happens without holding
+    // `lock`. This is recursive, since callbacks may poll commands themselves,
+    // and `callback_depth` tracks the nesting level of the current holder.
+    // Protects `in_thread`. Must be acquired before `submit_lock` or `lock`,
+    // if those are needed at the same time.
+    pl_mutex callback_lock;
+    int callback_depth;
+
+    // Callbacks of retired commands that still need to run, in FIFO order.
+    // Protected by `lock`, so that commands can be retired without having to
+    // wait for other threads to finish running callbacks.
+    PL_ARRAY(struct vk_callback) ready_callbacks;
+    int ready_callbacks_head;
+
+    // Optional completion thread, which retires pending commands and runs
+    // their callbacks in the background. See `vk_completion_thread_start`.
+    pl_thread thread;
+    pl_cond thread_cond;    // signalled on new pending commands and completions
+    bool thread_running;
+    bool thread_quit;
+    bool in_thread;         // set while the completion thread runs callbacks
+    uint64_t cmds_completed;
+
+    // Callbacks that may not run on the completion thread, deferred until the
+    // next call to `vk_poll_commands` from any other thread. Protected by
+    // `lock`, like `ready_callbacks`.
+    PL_ARRAY(struct vk_callback) local_callbacks;
+    int local_callbacks_head;
 
     // Instance-level function pointers
     PL_VK_FUN(CreateDevice);
@@ -115,6 +169,7 @@ struct vk_ctx {
     PL_VK_FUN(GetPhysicalDeviceFormatProperties2KHR);
     PL_VK_FUN(GetPhysicalDeviceImageFormatProperties2KHR);
     PL_VK_FUN(GetPhysicalDeviceMemoryProperties);
+    PL_VK_FUN(GetPhysicalDeviceMemoryProperties2);
     PL_VK_FUN(GetPhysicalDeviceProperties);
     PL_VK_FUN(GetPhysicalDeviceProperties2);
     PL_VK_FUN(GetPhysicalDeviceQueueFamilyProperties);
@@ -150,7 +205,7 @@ struct vk_ctx {
     PL_VK_FUN(CmdEndRenderPass);
     PL_VK_FUN(CmdPipelineBarrier);
     PL_VK_FUN(CmdPushConstants);
-    PL_VK_FUN(CmdPushDescriptorSetKHR);
+    PL_VK_FUN(CmdPushDescriptorSetWithTemplateKHR);
     PL_VK_FUN(CmdResetQueryPool);
     PL_VK_FUN(CmdSetEvent);
     PL_VK_FUN(CmdSetScissor);
@@ -165,6 +220,7 @@ struct vk_ctx {
     PL_VK_FUN(CreateDebugReportCallbackEXT);
     PL_VK_FUN(CreateDescriptorPool);
     PL_VK_FUN(CreateDescriptorSetLayout);
+    PL_VK_FUN(CreateDescriptorUpdateTemplate);
     PL_VK_FUN(CreateEvent);
     PL_VK_FUN(CreateFence);
     PL_VK_FUN(CreateFramebuffer);
@@ -185,6 +241,7 @@ struct vk_ctx {
     PL_VK_FUN(DestroyDebugReportCallbackEXT);
     PL_VK_FUN(DestroyDescriptorPool);
     PL_VK_FUN(DestroyDescriptorSetLayout);
+    PL_VK_FUN(DestroyDescriptorUpdateTemplate);
     PL_VK_FUN(DestroyDevice);
     PL_VK_FUN(DestroyEvent);
     PL_VK_FUN(DestroyFence);
@@ -219,6 +276,7 @@ struct vk_ctx {
     PL_VK_FUN(GetSwapchainImagesKHR);
     PL_VK_FUN(InvalidateMappedMemoryRanges);
     PL_VK_FUN(MapMemory);
+    PL_VK_FUN(MergePipelineCaches);
     PL_VK_FUN(QueuePresentKHR);
     PL_VK_FUN(QueueSubmit);
     PL_VK_FUN(QueueWaitIdle);
@@ -227,7 +285,7 @@ struct vk_ctx {
     PL_VK_FUN(ResetQueryPoolEXT);
     PL_VK_FUN(SetDebugUtilsObjectNameEXT);
     PL_VK_FUN(SetHdrMetadataEXT);
-    PL_VK_FUN(UpdateDescriptorSets);
+    PL_VK_FUN(UpdateDescriptorSetWithTemplate);
     PL_VK_FUN(WaitForFences);
     PL_VK_FUN(WaitSemaphoresKHR);
 
@@ -73,6 +73,7 @@ static const struct vk_fun vk_inst_funs[] = {
     PL_VK_INST_FUN(GetPhysicalDeviceFormatProperties2KHR),
     PL_VK_INST_FUN(GetPhysicalDeviceImageFormatProperties2KHR),
     PL_VK_INST_FUN(GetPhysicalDeviceMemoryProperties),
+    PL_VK_INST_FUN(GetPhysicalDeviceMemoryProperties2),
     PL_VK_INST_FUN(GetPhysicalDeviceProperties),
     PL_VK_INST_FUN(GetPhysicalDeviceProperties2),
     PL_VK_INST_FUN(GetPhysicalDeviceQueueFamilyProperties),
@@ -104,7 +105,7 @@ static const struct vk_ext vk_device_extensions[] = {
     }, {
         .name = VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME,
         .funs = (const struct vk_fun[]) {
-            PL_VK_DEV_FUN(CmdPushDescriptorSetKHR),
+            PL_VK_DEV_FUN(CmdPushDescriptorSetWithTemplateKHR),
             {0}
         },
     }, {
@@ -149,6 +150,8 @@ static const struct vk_ext vk_device_extensions[] = {
 #endif
     }, {
         .name = VK_EXT_PCI_BUS_INFO_EXTENSION_NAME,
+    }, {
+        .name = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
     }, {
         .name = VK_EXT_HDR_METADATA_EXTENSION_NAME,
         .funs = (const struct vk_fun[]) {
@@ -213,6 +216,7 @@ const char * const pl_vulkan_recommended_extensions[] = {
     VK_KHR_EXTERNAL_SEMAPHORE_WIN32_EXTENSION_NAME,
 #endif
     VK_EXT_PCI_BUS_INFO_EXTENSION_NAME,
+    VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
     VK_EXT_HDR_METADATA_EXTENSION_NAME,
     VK_EXT_HOST_QUERY_RESET_EXTENSION_NAME,
     VK_KHR_IMAGE_FORMAT_LIST_EXTENSION_NAME,
@@ -314,6 +318,7 @@ static const struct vk_fun vk_dev_funs[] = {
     PL_VK_DEV_FUN(CreateComputePipelines),
     PL_VK_DEV_FUN(CreateDescriptorPool),
     PL_VK_DEV_FUN(CreateDescriptorSetLayout),
+    PL_VK_DEV_FUN(CreateDescriptorUpdateTemplate),
     PL_VK_DEV_FUN(CreateEvent),
     PL_VK_DEV_FUN(CreateFence),
     PL_VK_DEV_FUN(CreateFramebuffer),
@@ -332,6 +337,7 @@ static const struct vk_fun vk_dev_funs[] = {
     PL_VK_DEV_FUN(DestroyCommandPool),
     PL_VK_DEV_FUN(DestroyDescriptorPool),
     PL_VK_DEV_FUN(DestroyDescriptorSetLayout),
+    PL_VK_DEV_FUN(DestroyDescriptorUpdateTemplate),
     PL_VK_DEV_FUN(DestroyDevice),
     PL_VK_DEV_FUN(DestroyEvent),
     PL_VK_DEV_FUN(DestroyFence),
@@ -359,12 +365,13 @@ static const struct vk_fun vk_dev_funs[] = {
     PL_VK_DEV_FUN(GetQueryPoolResults),
     PL_VK_DEV_FUN(InvalidateMappedMemoryRanges),
     PL_VK_DEV_FUN(MapMemory),
+    PL_VK_DEV_FUN(MergePipelineCaches),
     PL_VK_DEV_FUN(QueueSubmit),
     PL_VK_DEV_FUN(QueueWaitIdle),
     PL_VK_DEV_FUN(ResetEvent),
     PL_VK_DEV_FUN(ResetFences),
     PL_VK_DEV_FUN(SetDebugUtilsObjectNameEXT),
-    PL_VK_DEV_FUN(UpdateDescriptorSets),
+    PL_VK_DEV_FUN(UpdateDescriptorSetWithTemplate),
     PL_VK_DEV_FUN(WaitForFences),
 };
 
@@ -867,10 +874,13 @@ void pl_vulkan_destroy(pl_vulkan *pl_vk)
         if ((*pl_vk)->gpu) {
             PL_DEBUG(vk, "Waiting for remaining commands...");
             pl_gpu_finish((*pl_vk)->gpu);
+            pl_assert(vk->cmds_queued.num == 0);
             pl_assert(vk->cmds_pending.num == 0);
 
             pl_gpu_destroy((*pl_vk)->gpu);
         }
+        vk_completion_thread_stop(vk);
+        vk->DestroyPipelineCache(vk->dev, vk->pipe_cache, PL_VK_ALLOC);
         vk_malloc_destroy(&vk->ma);
         for (int i = 0; i < vk->pools.num; i++)
             vk_cmdpool_destroy(vk, vk->pools.elem[i]);
@@ -881,6 +891,11 @@ void pl_vulkan_destroy(pl_vulkan *pl_vk)
 
     pl_vk_inst_destroy(&vk->internal_instance);
     pl_mutex_destroy(&vk->lock);
+    pl_mutex_destroy(&vk->submit_lock);
+    pl_mutex_destroy(&vk->callback_lock);
+    pl_mutex_destroy(&vk->pipe_cache_lock);
+    pl_cond_destroy(&vk->pipe_cache_cond);
+    pl_cond_destroy(&vk->thread_cond);
     pl_free_ptr((void **) pl_vk);
 }
 
@@ -1322,7 +1337,8 @@ static void unlock_queue(pl_vulkan pl_vk, int qf, int qidx)
     vk->unlock_queue(vk->queue_ctx, qf, qidx);
 }
 
-static bool finalize_context(struct pl_vulkan_t *pl_vk, int max_glsl_version)
+static bool finalize_context(struct pl_vulkan_t *pl_vk, int max_glsl_version,
+                             bool completion_thread)
 {
     struct vk_ctx *vk = PL_PRIV(pl_vk);
 
@@ -1334,6 +1350,17 @@ static bool finalize_context(struct pl_vulkan_t *pl_vk, int max_glsl_version)
     if (!vk->ma)
         return false;
 
+    VkPipelineCacheCreateInfo pcinfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+    };
+
+    VkResult res = vk->CreatePipelineCache(vk->dev, &pcinfo, PL_VK_ALLOC,
+                                           &vk->pipe_cache);
+    if (res != VK_SUCCESS) {
+        PL_WARN(vk, "Failed creating pipeline cache: %s", vk_res_str(res));
+        vk->pipe_cache = VK_NULL_HANDLE;
+    }
+
     pl_vk->gpu = pl_gpu_create_vk(vk);
     if (!pl_vk->gpu)
         return false;
@@ -1398,6 +1425,11 @@ static bool finalize_context(struct pl_vulkan_t *pl_vk, int max_glsl_version)
 
     pl_assert(vk->lock_queue);
     pl_assert(vk->unlock_queue);
+
+    // Not fatal, since callbacks are otherwise run by the pl_gpu users
+    if (completion_thread)
+        vk_completion_thread_start(vk);
+
     return true;
 }
 
@@ -1415,6 +1447,11 @@ pl_vulkan pl_vulkan_create(pl_log log, const struct pl_vulkan_params *params)
     };
 
     pl_mutex_init_type(&vk->lock, PL_MUTEX_RECURSIVE);
+    pl_mutex_init(&vk->submit_lock);
+    pl_mutex_init_type(&vk->callback_lock, PL_MUTEX_RECURSIVE);
+    pl_mutex_init(&vk->pipe_cache_lock);
+    pl_cond_init(&vk->pipe_cache_cond);
+    pl_cond_init(&vk->thread_cond);
     if (!vk->GetInstanceProcAddr)
         goto error;
 
@@ -1498,7 +1535,7 @@ pl_vulkan pl_vulkan_create(pl_log log, const struct pl_vulkan_params *params)
     if (!device_init(vk, params))
         goto error;
 
-    if (!finalize_context(pl_vk, params->max_glsl_version))
+    if (!finalize_context(pl_vk, params->max_glsl_version, params->completion_thread))
         goto error;
 
     return pl_vk;
@@ -1530,6 +1567,11 @@ pl_vulkan pl_vulkan_import(pl_log log, const struct pl_vulkan_import_params *par
     };
 
     pl_mutex_init_type(&vk->lock, PL_MUTEX_RECURSIVE);
+    pl_mutex_init(&vk->submit_lock);
+    pl_mutex_init_type(&vk->callback_lock, PL_MUTEX_RECURSIVE);
+    pl_mutex_init(&vk->pipe_cache_lock);
+    pl_cond_init(&vk->pipe_cache_cond);
+    pl_cond_init(&vk->thread_cond);
     if (!vk->GetInstanceProcAddr)
         goto error;
 
@@ -1626,6 +1668,9 @@ pl_vulkan pl_vulkan_import(pl_log log, const struct pl_vulkan_import_params *par
         }
     }
 
+    for (int n = 0; n < params->num_extensions; n++)
+        PL_ARRAY_APPEND(vk->alloc, vk->exts, params->extensions[n]);
+
     uint32_t qfnum = 0;
     vk->GetPhysicalDeviceQueueFamilyProperties(vk->physd, &qfnum, NULL);
     VkQueueFamilyProperties *qfs = pl_calloc_ptr(tmp, qfnum, qfs);
@@ -1695,7 +1740,7 @@ next_qf: ;
         goto error;
     }
 
-    if (!finalize_context(pl_vk, params->max_glsl_version))
+    if (!finalize_context(pl_vk, params->max_glsl_version, params->completion_thread))
         goto error;
 
     pl_free(tmp);
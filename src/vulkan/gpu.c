@@ -162,6 +162,11 @@ struct vk_cmd *_begin_cmd(pl_gpu gpu, enum queue_type type, const char *label,
     case GRAPHICS: pool = vk->pool_graphics; break;
     case COMPUTE:  pool = vk->pool_compute;  break;
     case TRANSFER: pool = vk->pool_transfer; break;
+    case ANY_COMPUTE:
+        pool = vk->pool_compute;
+        if (p->cmd && (p->cmd->pool->props.queueFlags & VK_QUEUE_COMPUTE_BIT))
+            pool = p->cmd->pool;
+        break;
     default: pl_unreachable();
     }
 
@@ -192,7 +197,7 @@ static void timer_end_cb(void *ptimer, void *pindex)
     timer->pending &= ~timer_bit(index);
 }
 
-bool _end_cmd(pl_gpu gpu, struct vk_cmd **pcmd, bool submit)
+bool _end_cmd(pl_gpu gpu, struct vk_cmd **pcmd, bool submit, bool flush)
 {
     struct pl_vk *p = PL_PRIV(gpu);
     struct vk_ctx *vk = p->vk;
@@ -203,6 +208,8 @@ bool _end_cmd(pl_gpu gpu, struct vk_cmd **pcmd, bool submit)
             ret = vk_cmd_submit(p->vk, &p->cmd);
             pl_mutex_unlock(&p->recording);
         }
+        if (flush)
+            ret &= vk_flush_commands(vk);
         return ret;
     }
 
@@ -215,8 +222,8 @@ bool _end_cmd(pl_gpu gpu, struct vk_cmd **pcmd, bool submit)
                               timer->qpool, timer->index_write + 1);
 
         timer->pending |= timer_bit(timer->index_write);
-        vk_cmd_callback(cmd, (vk_cb) timer_end_cb, timer,
-                        (void *) (uintptr_t) timer->index_write);
+        vk_cmd_callback_local(cmd, (vk_cb) timer_end_cb, timer,
+                              (void *) (uintptr_t) timer->index_write);
 
         timer->index_write = (timer->index_write + 2) % QUERY_POOL_SIZE;
         if (timer->index_write == timer->index_read) {
@@ -234,6 +241,8 @@ bool _end_cmd(pl_gpu gpu, struct vk_cmd **pcmd, bool submit)
         ret = vk_cmd_submit(vk, &p->cmd);
 
     pl_mutex_unlock(&p->recording);
+    if (flush)
+        ret &= vk_flush_commands(vk);
     return ret;
 }
 
@@ -244,9 +253,9 @@ void vk_gpu_idle_callback(pl_gpu gpu, vk_cb cb, const void *priv, const void *ar
 
     pl_mutex_lock(&p->recording);
     if (p->cmd) {
-        vk_cmd_callback(p->cmd, cb, priv, arg);
+        vk_cmd_callback_local(p->cmd, cb, priv, arg);
     } else {
-        vk_dev_callback(vk, cb, priv, arg);
+        vk_dev_callback_local(vk, cb, priv, arg);
     }
     pl_mutex_unlock(&p->recording);
 }
@@ -526,6 +535,7 @@ pl_gpu pl_gpu_create_vk(struct vk_ctx *vk)
         .max_mapped_size    = vk_malloc_avail(vk->ma, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT),
         .max_buffer_texels  = vk->limits.maxTexelBufferElements,
         .align_host_ptr     = host_props.minImportedHostPointerAlignment,
+        .align_ubo_offset   = vk->limits.minUniformBufferOffsetAlignment,
         .host_cached        = vk_malloc_avail(vk->ma, VK_MEMORY_PROPERTY_HOST_CACHED_BIT),
         // pl_tex
         .max_tex_1d_dim     = vk->limits.maxImageDimension1D,
@@ -552,6 +562,7 @@ pl_gpu pl_gpu_create_vk(struct vk_ctx *vk)
         },
         .fragment_queues    = vk->pool_graphics->num_queues,
         .compute_queues     = vk->pool_compute->num_queues,
+        .async_compute      = vk->pool_compute != vk->pool_graphics,
     };
 
     gpu->export_caps.buf = vk_malloc_handle_caps(vk->ma, false);
@@ -571,7 +582,7 @@ pl_gpu pl_gpu_create_vk(struct vk_ctx *vk)
         gpu->pci.function = pci_props.pciFunction;
     }
 
-    if (vk->CmdPushDescriptorSetKHR)
+    if (vk->CmdPushDescriptorSetWithTemplateKHR)
         p->max_push_descriptors = pushd_props.maxPushDescriptors;
 
     if (vk->ResetQueryPoolEXT) {
@@ -913,6 +924,7 @@ static const struct pl_gpu_fns pl_fns_vk = {
     .tex_create             = vk_tex_create,
     .tex_destroy            = vk_tex_deref,
     .tex_invalidate         = vk_tex_invalidate,
+    .tex_relocate           = vk_tex_relocate,
     .tex_clear_ex           = vk_tex_clear_ex,
     .tex_blit               = vk_tex_blit,
     .tex_upload             = vk_tex_upload,
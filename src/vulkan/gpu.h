@@ -48,6 +48,7 @@ enum queue_type {
     COMPUTE,
     TRANSFER,
     ANY,
+    ANY_COMPUTE, // current queue if it supports compute, else COMPUTE
 };
 
 struct pl_vk {
@@ -69,23 +70,31 @@ struct pl_vk {
     // Array of VkSamplers for every combination of sample/address modes
     VkSampler samplers[PL_TEX_SAMPLE_MODE_COUNT][PL_TEX_ADDRESS_MODE_COUNT];
 
+    // Source of `desc_id` for textures and buffers
+    _Atomic uint64_t desc_id;
+
     // To avoid spamming warnings
     bool warned_modless;
 };
 
 struct vk_cmd *_begin_cmd(pl_gpu, enum queue_type, const char *label, pl_timer);
-bool _end_cmd(pl_gpu, struct vk_cmd **, bool submit);
+bool _end_cmd(pl_gpu, struct vk_cmd **, bool submit, bool flush);
 
+// CMD_FINISH keeps recording into the current command, CMD_QUEUE ends it and
+// queues it for the next (batched) submission, and CMD_SUBMIT additionally
+// flushes all queued commands to the GPU. CMD_SUBMIT(NULL) can be used to
+// submit and flush the current command, if any.
 #define CMD_BEGIN(type)              _begin_cmd(gpu, type, __func__, NULL)
 #define CMD_BEGIN_TIMED(type, timer) _begin_cmd(gpu, type, __func__, timer)
-#define CMD_FINISH(cmd) _end_cmd(gpu, cmd, false)
-#define CMD_SUBMIT(cmd) _end_cmd(gpu, cmd, true)
+#define CMD_FINISH(cmd) _end_cmd(gpu, cmd, false, false)
+#define CMD_QUEUE(cmd)  _end_cmd(gpu, cmd, true, false)
+#define CMD_SUBMIT(cmd) _end_cmd(gpu, cmd, true, true)
 
 // Helper to fire a callback the next time the `pl_gpu` is in an idle state
 //
 // Use this instead of `vk_dev_callback` when you need to clean up after
 // resources that might possibly still be in use by the `pl_gpu` at the time of
-// creating the callback.
+// creating the callback. The callback is never run on the completion thread.
 void vk_gpu_idle_callback(pl_gpu, vk_cb, const void *priv, const void *arg);
 
 struct pl_tex_vk {
@@ -101,6 +110,7 @@ struct pl_tex_vk {
     VkImageUsageFlags usage_flags;
     // for sampling
     VkImageView view;
+    uint64_t desc_id; // unique per `view`, never reused
     // for rendering
     VkFramebuffer framebuffer;
     // for vk_tex_upload/download fallback code
@@ -117,11 +127,16 @@ struct pl_tex_vk {
     uint32_t qf; // last queue family to access this texture (for barriers)
     bool may_invalidate;
     bool held;
+    // backing memory may be swapped out by `vk_tex_relocate`. Only set for
+    // internally created, non-planar, non-exported textures, and cleared
+    // permanently once the VkImage is handed out by `pl_vulkan_unwrap`
+    bool relocatable;
 };
 
 pl_tex vk_tex_create(pl_gpu, const struct pl_tex_params *);
 void vk_tex_deref(pl_gpu, pl_tex);
 void vk_tex_invalidate(pl_gpu, pl_tex);
+void vk_tex_relocate(pl_gpu, pl_tex);
 void vk_tex_clear_ex(pl_gpu, pl_tex, const union pl_clear_color);
 void vk_tex_blit(pl_gpu, const struct pl_tex_blit_params *);
 bool vk_tex_upload(pl_gpu, const struct pl_tex_transfer_params *);
@@ -136,6 +151,7 @@ struct pl_buf_vk {
     struct vk_memslice mem;
     enum queue_type update_queue;
     VkBufferView view; // for texel buffers
+    uint64_t desc_id; // unique per buffer, never reused
 
     // synchronization and current state
     struct vk_sem sem;
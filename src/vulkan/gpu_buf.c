@@ -106,6 +106,7 @@ pl_buf vk_buf_create(pl_gpu gpu, const struct pl_buf_params *params)
     buf->params.initial_data = NULL;
 
     struct pl_buf_vk *buf_vk = PL_PRIV(buf);
+    buf_vk->desc_id = atomic_fetch_add(&p->desc_id, 1);
     pl_rc_init(&buf_vk->rc);
     vk_sem_init(&buf_vk->sem);
 
@@ -138,7 +139,14 @@ pl_buf vk_buf_create(pl_gpu gpu, const struct pl_buf_params *params)
     if (params->uniform) {
         mparams.buf_usage |= VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
         *align = pl_lcm(*align, vk->limits.minUniformBufferOffsetAlignment);
-        mem_type = PL_BUF_MEM_DEVICE;
+        if (params->host_mapped) {
+            // Persistently mapped UBOs are written by the host but read by
+            // the GPU, so prefer host-visible VRAM and only fall back to
+            // system memory if there is none
+            mparams.optimal |= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        } else {
+            mem_type = PL_BUF_MEM_DEVICE;
+        }
         if (params->format) {
             mparams.buf_usage |= VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT;
             is_texel = true;
@@ -169,7 +177,7 @@ pl_buf vk_buf_create(pl_gpu gpu, const struct pl_buf_params *params)
 
     if (params->host_writable || params->initial_data) {
         // Buffers should be written using mapped memory if possible
-        mparams.optimal = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        mparams.optimal |= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
         // Use the transfer queue for updates on very large buffers (1 MB)
         if (params->size > 1024*1024)
             buf_vk->update_queue = TRANSFER;
@@ -178,9 +186,10 @@ pl_buf vk_buf_create(pl_gpu gpu, const struct pl_buf_params *params)
     if (params->host_mapped || params->host_readable) {
         mparams.required |= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
 
-        if (params->size > 1024) {
+        if (params->size > 1024 && (params->host_readable || !params->uniform)) {
             // Prefer cached memory for large buffers (1 kB) which may be read
-            // from, because uncached reads are extremely slow
+            // from, because uncached reads are extremely slow. Mapped UBOs
+            // are only ever written to by the host, so they are exempt
             mparams.optimal |= VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
         }
     }
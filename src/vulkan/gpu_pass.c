@@ -18,6 +18,13 @@
 #include "gpu.h"
 #include "glsl/spirv.h"
 
+// Descriptor data in the layout expected by `pl_pass_vk.dsTemplate`
+union vk_ds_entry {
+    VkDescriptorImageInfo image;
+    VkDescriptorBufferInfo buffer;
+    VkBufferView view;
+};
+
 // For pl_pass.priv
 struct pl_pass_vk {
     // Pipeline / render pass
@@ -28,22 +35,29 @@ struct pl_pass_vk {
     // Descriptor set (bindings)
     bool use_pushd;
     VkDescriptorSetLayout dsLayout;
+    VkDescriptorUpdateTemplate dsTemplate;
     VkDescriptorPool dsPool;
     // To keep track of which descriptor sets are and aren't available, we
     // allocate a fixed number and use a bitmask of all available sets.
     VkDescriptorSet dss[16];
     uint16_t dmask;
+    // Contents last written to each descriptor set (`num_descriptors` entries
+    // per set), used to skip redundant updates. Only valid for sets in
+    // `dsvalid`. `dscache_ids` holds the `desc_id` of each bound object, since
+    // a handle may be reused by a different object after being destroyed.
+    union vk_ds_entry *dscache;
+    uint64_t *dscache_ids;
+    uint16_t dsvalid;
 
     // For recompilation
     VkVertexInputAttributeDescription *attrs;
-    VkPipelineCache cache;
+    VkPipelineCache cache; // or VK_NULL_HANDLE to use the device-wide cache
     VkShaderModule vert;
     VkShaderModule shader;
 
     // For updating
-    VkWriteDescriptorSet *dswrite;
-    VkDescriptorImageInfo *dsiinfo;
-    VkDescriptorBufferInfo *dsbinfo;
+    union vk_ds_entry *dsdata;
+    uint64_t *dsids;
     VkSpecializationInfo specInfo;
     size_t spec_size;
 };
@@ -64,6 +78,7 @@ static void pass_destroy_cb(pl_gpu gpu, pl_pass pass)
     vk->DestroyRenderPass(vk->dev, pass_vk->renderPass, PL_VK_ALLOC);
     vk->DestroyPipelineLayout(vk->dev, pass_vk->pipeLayout, PL_VK_ALLOC);
     vk->DestroyPipelineCache(vk->dev, pass_vk->cache, PL_VK_ALLOC);
+    vk->DestroyDescriptorUpdateTemplate(vk->dev, pass_vk->dsTemplate, PL_VK_ALLOC);
     vk->DestroyDescriptorPool(vk->dev, pass_vk->dsPool, PL_VK_ALLOC);
     vk->DestroyDescriptorSetLayout(vk->dev, pass_vk->dsLayout, PL_VK_ALLOC);
     vk->DestroyShaderModule(vk->dev, pass_vk->vert, PL_VK_ALLOC);
@@ -100,6 +115,95 @@ struct vk_cache_header {
     size_t pipecache_len;
 };
 
+// Pipelines may be created from multiple threads at the same time, but
+// merging into the device-wide pipeline cache requires exclusive access.
+// Pending merges take priority, so they can't be starved by a steady stream
+// of pipeline creations.
+static VkPipelineCache pipe_cache_acquire(struct vk_ctx *vk)
+{
+    pl_mutex_lock(&vk->pipe_cache_lock);
+    while (vk->pipe_cache_writers)
+        pl_cond_wait(&vk->pipe_cache_cond, &vk->pipe_cache_lock);
+    vk->pipe_cache_users++;
+    pl_mutex_unlock(&vk->pipe_cache_lock);
+    return vk->pipe_cache;
+}
+
+static void pipe_cache_release(struct vk_ctx *vk)
+{
+    pl_mutex_lock(&vk->pipe_cache_lock);
+    if (!--vk->pipe_cache_users)
+        pl_cond_broadcast(&vk->pipe_cache_cond);
+    pl_mutex_unlock(&vk->pipe_cache_lock);
+}
+
+// Merges the contents of `cache` into the device-wide pipeline cache
+static void pipe_cache_merge(struct vk_ctx *vk, VkPipelineCache cache)
+{
+    if (!vk->pipe_cache)
+        return;
+
+    pl_mutex_lock(&vk->pipe_cache_lock);
+    vk->pipe_cache_writers++;
+    while (vk->pipe_cache_users)
+        pl_cond_wait(&vk->pipe_cache_cond, &vk->pipe_cache_lock);
+    VkResult res = vk->MergePipelineCaches(vk->dev, vk->pipe_cache, 1, &cache);
+    vk->pipe_cache_writers--;
+    pl_cond_broadcast(&vk->pipe_cache_cond);
+    pl_mutex_unlock(&vk->pipe_cache_lock);
+
+    if (res != VK_SUCCESS)
+        PL_WARN(vk, "Failed merging pipeline caches: %s", vk_res_str(res));
+}
+
+size_t pl_vulkan_save_pipeline_cache(pl_vulkan pl_vk, uint8_t *out_cache,
+                                     size_t size)
+{
+    struct vk_ctx *vk = PL_PRIV(pl_vk);
+    if (!vk->pipe_cache)
+        return 0;
+
+    VkPipelineCache cache = pipe_cache_acquire(vk);
+    if (!out_cache)
+        size = 0;
+    VkResult res = vk->GetPipelineCacheData(vk->dev, cache, &size, out_cache);
+    pipe_cache_release(vk);
+
+    if (res != VK_SUCCESS && res != VK_INCOMPLETE) {
+        PL_ERR(vk, "Failed getting pipeline cache data: %s", vk_res_str(res));
+        return 0;
+    }
+
+    return size;
+}
+
+void pl_vulkan_load_pipeline_cache(pl_vulkan pl_vk, const uint8_t *cache,
+                                   size_t size)
+{
+    struct vk_ctx *vk = PL_PRIV(pl_vk);
+    if (!vk->pipe_cache || !size)
+        return;
+
+    // Data from incompatible drivers/devices is silently ignored by the driver
+    VkPipelineCacheCreateInfo pcinfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .pInitialData = cache,
+        .initialDataSize = size,
+    };
+
+    VkPipelineCache tmp = VK_NULL_HANDLE;
+    VK(vk->CreatePipelineCache(vk->dev, &pcinfo, PL_VK_ALLOC, &tmp));
+    pipe_cache_merge(vk, tmp);
+    PL_DEBUG(vk, "Merged %zu bytes into device pipeline cache", size);
+
+    pl_mutex_lock(&vk->pipe_cache_lock);
+    vk->pipe_cache_loaded = true;
+    pl_mutex_unlock(&vk->pipe_cache_lock);
+
+error:
+    vk->DestroyPipelineCache(vk->dev, tmp, PL_VK_ALLOC);
+}
+
 static uint64_t cache_signature(pl_gpu gpu, const struct pl_pass_params *params)
 {
     struct pl_vk *p = PL_PRIV(gpu);
@@ -162,6 +266,11 @@ static VkResult vk_compile_glsl(pl_gpu gpu, void *alloc,
     return out_spirv->len ? VK_SUCCESS : VK_ERROR_INITIALIZATION_FAILED;
 }
 
+static const VkPipelineBindPoint bindPoint[] = {
+    [PL_PASS_RASTER]  = VK_PIPELINE_BIND_POINT_GRAPHICS,
+    [PL_PASS_COMPUTE] = VK_PIPELINE_BIND_POINT_COMPUTE,
+};
+
 static const VkShaderStageFlags stageFlags[] = {
     [PL_PASS_RASTER]  = VK_SHADER_STAGE_FRAGMENT_BIT |
                         VK_SHADER_STAGE_VERTEX_BIT,
@@ -199,6 +308,19 @@ static VkResult vk_recreate_pipelines(struct vk_ctx *vk, pl_pass pass,
     if (!specInfo->dataSize)
         specInfo = NULL;
 
+    // Used to find out whether the pipeline cache was hit, if supported
+    VkPipelineCreationFeedback feedback = {0};
+    VkPipelineCreationFeedbackCreateInfo finfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO,
+        .pPipelineCreationFeedback = &feedback,
+    };
+
+    const void *pnext = vk->api_ver >= VK_API_VERSION_1_3 ? &finfo : NULL;
+    VkPipelineCache cache = pass_vk->cache;
+    if (!cache)
+        cache = pipe_cache_acquire(vk);
+
+    VkResult res = VK_ERROR_UNKNOWN;
     switch (params->type) {
     case PL_PASS_RASTER: {
         static const VkBlendFactor blendFactors[] = {
@@ -233,6 +355,7 @@ static VkResult vk_recreate_pipelines(struct vk_ctx *vk, pl_pass pass,
 
         VkGraphicsPipelineCreateInfo cinfo = {
             .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+            .pNext = pnext,
             .flags = flags,
             .stageCount = 2,
             .pStages = (VkPipelineShaderStageCreateInfo[]) {
@@ -298,13 +421,15 @@ static VkResult vk_recreate_pipelines(struct vk_ctx *vk, pl_pass pass,
             .basePipelineIndex = -1,
         };
 
-        return vk->CreateGraphicsPipelines(vk->dev, pass_vk->cache, 1, &cinfo,
-                                           PL_VK_ALLOC, out_pipe);
+        res = vk->CreateGraphicsPipelines(vk->dev, cache, 1, &cinfo,
+                                          PL_VK_ALLOC, out_pipe);
+        break;
     }
 
     case PL_PASS_COMPUTE: {
         VkComputePipelineCreateInfo cinfo = {
             .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .pNext = pnext,
             .flags = flags,
             .stage = {
                 .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
@@ -318,16 +443,30 @@ static VkResult vk_recreate_pipelines(struct vk_ctx *vk, pl_pass pass,
             .basePipelineIndex = -1,
         };
 
-        return vk->CreateComputePipelines(vk->dev, pass_vk->cache, 1, &cinfo,
-                                          PL_VK_ALLOC, out_pipe);
+        res = vk->CreateComputePipelines(vk->dev, cache, 1, &cinfo,
+                                         PL_VK_ALLOC, out_pipe);
+        break;
     }
 
     case PL_PASS_INVALID:
     case PL_PASS_TYPE_COUNT:
-        break;
+        pl_unreachable();
     }
 
-    pl_unreachable();
+    if (!pass_vk->cache)
+        pipe_cache_release(vk);
+
+    const VkPipelineCreationFeedbackFlags hit =
+        VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT |
+        VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT;
+    if (res == VK_SUCCESS && (feedback.flags & hit) == hit) {
+        PL_TRACE(vk, "Pipeline cache hit");
+        pl_mutex_lock(&vk->pipe_cache_lock);
+        vk->pipe_cache_hits++;
+        pl_mutex_unlock(&vk->pipe_cache_lock);
+    }
+
+    return res;
 }
 
 pl_pass vk_pass_create(pl_gpu gpu, const struct pl_pass_params *params)
@@ -355,9 +494,8 @@ pl_pass vk_pass_create(pl_gpu gpu, const struct pl_pass_params *params)
         goto error;
     }
 
-    pass_vk->dswrite = pl_calloc(pass, num_desc, sizeof(VkWriteDescriptorSet));
-    pass_vk->dsiinfo = pl_calloc(pass, num_desc, sizeof(VkDescriptorImageInfo));
-    pass_vk->dsbinfo = pl_calloc(pass, num_desc, sizeof(VkDescriptorBufferInfo));
+    pass_vk->dsdata = pl_calloc_ptr(pass, num_desc, pass_vk->dsdata);
+    pass_vk->dsids = pl_calloc_ptr(pass, num_desc, pass_vk->dsids);
 
 #define NUM_DS (PL_ARRAY_SIZE(pass_vk->dss))
 
@@ -447,6 +585,10 @@ pl_pass vk_pass_create(pl_gpu gpu, const struct pl_pass_params *params)
             };
 
             VK(vk->AllocateDescriptorSets(vk->dev, &ainfo, pass_vk->dss));
+            pass_vk->dscache = pl_calloc_ptr(pass, NUM_DS * num_desc,
+                                             pass_vk->dscache);
+            pass_vk->dscache_ids = pl_calloc_ptr(pass, NUM_DS * num_desc,
+                                                 pass_vk->dscache_ids);
         }
     }
 
@@ -498,6 +640,37 @@ no_descriptors: ;
     VK(vk->CreatePipelineLayout(vk->dev, &linfo, PL_VK_ALLOC,
                                 &pass_vk->pipeLayout));
 
+    if (num_desc) {
+        VkDescriptorUpdateTemplateEntry *entries;
+        entries = pl_calloc_ptr(tmp, num_desc, entries);
+        for (int i = 0; i < num_desc; i++) {
+            const struct pl_desc *desc = &params->descriptors[i];
+            entries[i] = (VkDescriptorUpdateTemplateEntry) {
+                .dstBinding = desc->binding,
+                .descriptorCount = 1,
+                .descriptorType = dsType[desc->type],
+                .offset = i * sizeof(union vk_ds_entry),
+                .stride = sizeof(union vk_ds_entry),
+            };
+        }
+
+        VkDescriptorUpdateTemplateCreateInfo tinfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO,
+            .descriptorUpdateEntryCount = num_desc,
+            .pDescriptorUpdateEntries = entries,
+            .templateType = pass_vk->use_pushd
+                ? VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR
+                : VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET,
+            .descriptorSetLayout = pass_vk->dsLayout,
+            .pipelineBindPoint = bindPoint[params->type],
+            .pipelineLayout = pass_vk->pipeLayout,
+            .set = 0,
+        };
+
+        VK(vk->CreateDescriptorUpdateTemplate(vk->dev, &tinfo, PL_VK_ALLOC,
+                                              &pass_vk->dsTemplate));
+    }
+
     pl_str vert = {0}, frag = {0}, comp = {0}, pipecache = {0};
     uint64_t sig = cache_signature(gpu, params);
     if (vk_use_cached_program(params, p->spirv, &vert, &frag, &comp, &pipecache, sig)) {
@@ -524,13 +697,23 @@ no_descriptors: ;
         }
     }
 
-    VkPipelineCacheCreateInfo pcinfo = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
-        .pInitialData = pipecache.buf,
-        .initialDataSize = pipecache.len,
-    };
+    // Passes without pipeline state of their own are created directly
+    // against the device-wide pipeline cache if it was loaded by the user, to
+    // reuse the state from there. Otherwise, each pass gets its own pipeline
+    // cache, which is persisted as part of the cached program, and merged
+    // into the device-wide cache afterwards.
+    pl_mutex_lock(&vk->pipe_cache_lock);
+    bool use_device_cache = !pipecache.len && vk->pipe_cache_loaded;
+    pl_mutex_unlock(&vk->pipe_cache_lock);
+    if (!use_device_cache) {
+        VkPipelineCacheCreateInfo pcinfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+            .pInitialData = pipecache.buf,
+            .initialDataSize = pipecache.len,
+        };
 
-    VK(vk->CreatePipelineCache(vk->dev, &pcinfo, PL_VK_ALLOC, &pass_vk->cache));
+        VK(vk->CreatePipelineCache(vk->dev, &pcinfo, PL_VK_ALLOC, &pass_vk->cache));
+    }
 
     VkShaderModuleCreateInfo sinfo = {
         .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
@@ -620,12 +803,15 @@ no_descriptors: ;
 
     // Update params->cached_program
     pl_str cache = {0};
-    VK(vk->GetPipelineCacheData(vk->dev, pass_vk->cache, &cache.len, NULL));
-    cache.buf = pl_alloc(tmp, cache.len);
-    VK(vk->GetPipelineCacheData(vk->dev, pass_vk->cache, &cache.len, cache.buf));
-    if (!has_spec) {
-        vk->DestroyPipelineCache(vk->dev, pass_vk->cache, PL_VK_ALLOC);
-        pass_vk->cache = VK_NULL_HANDLE;
+    if (pass_vk->cache) {
+        VK(vk->GetPipelineCacheData(vk->dev, pass_vk->cache, &cache.len, NULL));
+        cache.buf = pl_alloc(tmp, cache.len);
+        VK(vk->GetPipelineCacheData(vk->dev, pass_vk->cache, &cache.len, cache.buf));
+        pipe_cache_merge(vk, pass_vk->cache);
+        if (!has_spec) {
+            vk->DestroyPipelineCache(vk->dev, pass_vk->cache, PL_VK_ALLOC);
+            pass_vk->cache = VK_NULL_HANDLE;
+        }
     }
 
     struct vk_cache_header header = {
@@ -671,21 +857,15 @@ static const VkPipelineStageFlags passStages[] = {
 };
 
 static void vk_update_descriptor(pl_gpu gpu, struct vk_cmd *cmd, pl_pass pass,
-                                 struct pl_desc_binding db,
-                                 VkDescriptorSet ds, int idx)
+                                 struct pl_desc_binding db, int idx)
 {
     struct pl_vk *p = PL_PRIV(gpu);
     struct pl_pass_vk *pass_vk = PL_PRIV(pass);
     struct pl_desc *desc = &pass->params.descriptors[idx];
 
-    VkWriteDescriptorSet *wds = &pass_vk->dswrite[idx];
-    *wds = (VkWriteDescriptorSet) {
-        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-        .dstSet = ds,
-        .dstBinding = desc->binding,
-        .descriptorCount = 1,
-        .descriptorType = dsType[desc->type],
-    };
+    // Cleared explicitly, since the contents get compared with `memcmp`
+    union vk_ds_entry *entry = &pass_vk->dsdata[idx];
+    memset(entry, 0, sizeof(*entry));
 
     static const VkAccessFlags access[PL_DESC_ACCESS_COUNT] = {
         [PL_DESC_ACCESS_READONLY]   = VK_ACCESS_SHADER_READ_BIT,
@@ -704,14 +884,10 @@ static void vk_update_descriptor(pl_gpu gpu, struct vk_cmd *cmd, pl_pass pass,
                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
                        VK_QUEUE_FAMILY_IGNORED);
 
-        VkDescriptorImageInfo *iinfo = &pass_vk->dsiinfo[idx];
-        *iinfo = (VkDescriptorImageInfo) {
-            .sampler = p->samplers[db.sample_mode][db.address_mode],
-            .imageView = tex_vk->view,
-            .imageLayout = tex_vk->layout,
-        };
-
-        wds->pImageInfo = iinfo;
+        entry->image.sampler = p->samplers[db.sample_mode][db.address_mode];
+        entry->image.imageView = tex_vk->view;
+        entry->image.imageLayout = tex_vk->layout;
+        pass_vk->dsids[idx] = tex_vk->desc_id;
         return;
     }
     case PL_DESC_STORAGE_IMG: {
@@ -722,13 +898,9 @@ static void vk_update_descriptor(pl_gpu gpu, struct vk_cmd *cmd, pl_pass pass,
                        access[desc->access], VK_IMAGE_LAYOUT_GENERAL,
                        VK_QUEUE_FAMILY_IGNORED);
 
-        VkDescriptorImageInfo *iinfo = &pass_vk->dsiinfo[idx];
-        *iinfo = (VkDescriptorImageInfo) {
-            .imageView = tex_vk->view,
-            .imageLayout = tex_vk->layout,
-        };
-
-        wds->pImageInfo = iinfo;
+        entry->image.imageView = tex_vk->view;
+        entry->image.imageLayout = tex_vk->layout;
+        pass_vk->dsids[idx] = tex_vk->desc_id;
         return;
     }
     case PL_DESC_BUF_UNIFORM:
@@ -739,14 +911,10 @@ static void vk_update_descriptor(pl_gpu gpu, struct vk_cmd *cmd, pl_pass pass,
         vk_buf_barrier(gpu, cmd, buf, passStages[pass->params.type],
                        access[desc->access], 0, buf->params.size, false);
 
-        VkDescriptorBufferInfo *binfo = &pass_vk->dsbinfo[idx];
-        *binfo = (VkDescriptorBufferInfo) {
-            .buffer = buf_vk->mem.buf,
-            .offset = buf_vk->mem.offset,
-            .range = buf->params.size,
-        };
-
-        wds->pBufferInfo = binfo;
+        entry->buffer.buffer = buf_vk->mem.buf;
+        entry->buffer.offset = buf_vk->mem.offset + db.buf_offset;
+        entry->buffer.range = PL_DEF(db.buf_size, buf->params.size - db.buf_offset);
+        pass_vk->dsids[idx] = buf_vk->desc_id;
         return;
     }
     case PL_DESC_BUF_TEXEL_UNIFORM:
@@ -757,7 +925,8 @@ static void vk_update_descriptor(pl_gpu gpu, struct vk_cmd *cmd, pl_pass pass,
         vk_buf_barrier(gpu, cmd, buf, passStages[pass->params.type],
                        access[desc->access], 0, buf->params.size, false);
 
-        wds->pTexelBufferView = &buf_vk->view;
+        entry->view = buf_vk->view;
+        pass_vk->dsids[idx] = buf_vk->desc_id;
         return;
     }
     case PL_DESC_INVALID:
@@ -768,6 +937,35 @@ static void vk_update_descriptor(pl_gpu gpu, struct vk_cmd *cmd, pl_pass pass,
     pl_unreachable();
 }
 
+// Writes the current descriptor data to a descriptor set, unless it already
+// contains exactly this data
+static void vk_write_descriptors(pl_gpu gpu, pl_pass pass, int ds_idx)
+{
+    struct pl_vk *p = PL_PRIV(gpu);
+    struct vk_ctx *vk = p->vk;
+    struct pl_pass_vk *pass_vk = PL_PRIV(pass);
+
+    const int num_desc = pass->params.num_descriptors;
+    const size_t size = num_desc * sizeof(union vk_ds_entry);
+    const size_t ids_size = num_desc * sizeof(uint64_t);
+    union vk_ds_entry *cache = &pass_vk->dscache[ds_idx * num_desc];
+    uint64_t *cache_ids = &pass_vk->dscache_ids[ds_idx * num_desc];
+    const uint16_t dsbit = 1u << ds_idx;
+
+    if ((pass_vk->dsvalid & dsbit) &&
+        memcmp(cache_ids, pass_vk->dsids, ids_size) == 0 &&
+        memcmp(cache, pass_vk->dsdata, size) == 0)
+    {
+        return;
+    }
+
+    vk->UpdateDescriptorSetWithTemplate(vk->dev, pass_vk->dss[ds_idx],
+                                        pass_vk->dsTemplate, pass_vk->dsdata);
+    memcpy(cache, pass_vk->dsdata, size);
+    memcpy(cache_ids, pass_vk->dsids, ids_size);
+    pass_vk->dsvalid |= dsbit;
+}
+
 static void vk_release_descriptor(pl_gpu gpu, struct vk_cmd *cmd, pl_pass pass,
                                   struct pl_desc_binding db, int idx)
 {
@@ -848,45 +1046,46 @@ void vk_pass_run(pl_gpu gpu, const struct pl_pass_run_params *params)
         }
     }
 
+    // Compute passes stay on the current queue (avoiding a queue switch and
+    // the associated semaphores) unless explicitly marked as asynchronous
     static const enum queue_type types[] = {
         [PL_PASS_RASTER]  = GRAPHICS,
-        [PL_PASS_COMPUTE] = COMPUTE,
+        [PL_PASS_COMPUTE] = ANY_COMPUTE,
     };
 
-    struct vk_cmd *cmd = CMD_BEGIN_TIMED(types[pass->params.type], params->timer);
+    enum queue_type type = types[pass->params.type];
+    if (pass->params.type == PL_PASS_COMPUTE && params->async_compute)
+        type = COMPUTE;
+
+    struct vk_cmd *cmd = CMD_BEGIN_TIMED(type, params->timer);
     if (!cmd)
         goto error;
 
     // Find a descriptor set to use
     VkDescriptorSet ds = VK_NULL_HANDLE;
+    int ds_idx = -1;
     if (!pass_vk->use_pushd) {
         for (int i = 0; i < PL_ARRAY_SIZE(pass_vk->dss); i++) {
             uint16_t dsbit = 1u << i;
             if (pass_vk->dmask & dsbit) {
                 ds = pass_vk->dss[i];
+                ds_idx = i;
                 pass_vk->dmask &= ~dsbit; // unset
-                vk_cmd_callback(cmd, (vk_cb) set_ds, pass_vk,
-                                (void *)(uintptr_t) dsbit);
+                vk_cmd_callback_local(cmd, (vk_cb) set_ds, pass_vk,
+                                      (void *)(uintptr_t) dsbit);
                 break;
             }
         }
     }
 
-    // Update the dswrite structure with all of the new values
+    // Update the descriptor data with all of the new values
     for (int i = 0; i < pass->params.num_descriptors; i++)
-        vk_update_descriptor(gpu, cmd, pass, params->desc_bindings[i], ds, i);
+        vk_update_descriptor(gpu, cmd, pass, params->desc_bindings[i], i);
 
-    if (!pass_vk->use_pushd) {
-        vk->UpdateDescriptorSets(vk->dev, pass->params.num_descriptors,
-                                 pass_vk->dswrite, 0, NULL);
-    }
+    if (ds)
+        vk_write_descriptors(gpu, pass, ds_idx);
 
     // Bind the pipeline, descriptor set, etc.
-    static const VkPipelineBindPoint bindPoint[] = {
-        [PL_PASS_RASTER]  = VK_PIPELINE_BIND_POINT_GRAPHICS,
-        [PL_PASS_COMPUTE] = VK_PIPELINE_BIND_POINT_COMPUTE,
-    };
-
     vk->CmdBindPipeline(cmd->buf, bindPoint[pass->params.type],
                         PL_DEF(pass_vk->pipe, pass_vk->base));
 
@@ -896,10 +1095,9 @@ void vk_pass_run(pl_gpu gpu, const struct pl_pass_run_params *params)
     }
 
     if (pass_vk->use_pushd) {
-        vk->CmdPushDescriptorSetKHR(cmd->buf, bindPoint[pass->params.type],
-                                    pass_vk->pipeLayout, 0,
-                                    pass->params.num_descriptors,
-                                    pass_vk->dswrite);
+        vk->CmdPushDescriptorSetWithTemplateKHR(cmd->buf, pass_vk->dsTemplate,
+                                                pass_vk->pipeLayout, 0,
+                                                pass_vk->dsdata);
     }
 
     if (pass->params.push_constants_size) {
@@ -1006,8 +1204,9 @@ void vk_pass_run(pl_gpu gpu, const struct pl_pass_run_params *params)
     for (int i = 0; i < pass->params.num_descriptors; i++)
         vk_release_descriptor(gpu, cmd, pass, params->desc_bindings[i], i);
 
-    // submit this command buffer for better intra-frame granularity
-    CMD_SUBMIT(&cmd);
+    // use a separate command buffer for better intra-frame granularity, but
+    // leave it to be submitted as part of the next batch
+    CMD_QUEUE(&cmd);
 
 error:
     return;
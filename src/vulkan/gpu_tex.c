@@ -244,6 +244,7 @@ pl_tex vk_tex_create(pl_gpu gpu, const struct pl_tex_params *params)
 
     struct pl_tex_vk *tex_vk = PL_PRIV(tex);
     struct pl_fmt_vk *fmtp = PL_PRIV(fmt);
+    tex_vk->desc_id = atomic_fetch_add(&p->desc_id, 1);
     tex_vk->img_fmt = fmtp->vk_fmt->tfmt;
     tex_vk->num_planes = fmt->num_planes;
     for (int i = 0; i < tex_vk->num_planes; i++)
@@ -614,6 +615,8 @@ pl_tex vk_tex_create(pl_gpu gpu, const struct pl_tex_params *params)
         tex->params.host_writable = writable;
     }
 
+    // Only images that were never shared with anybody else may be moved
+    tex_vk->relocatable = !tex_vk->num_planes && !handle_type;
     return tex;
 
 error:
@@ -621,6 +624,119 @@ error:
     return NULL;
 }
 
+// Moves an idle texture out of a slab that is being drained, by re-creating
+// its image in a new allocation. The contents are discarded, so this is only
+// called for textures re-used by `pl_tex_recreate`.
+void vk_tex_relocate(pl_gpu gpu, pl_tex tex)
+{
+    struct pl_vk *p = PL_PRIV(gpu);
+    struct vk_ctx *vk = p->vk;
+    struct pl_tex_vk *tex_vk = PL_PRIV(tex);
+    const struct pl_tex_params *params = &tex->params;
+
+    if (!tex_vk->relocatable || tex_vk->held)
+        return;
+    if (tex_vk->ext_sync || tex_vk->ext_deps.num)
+        return;
+    if (pl_rc_count(&tex_vk->rc) > 1)
+        return; // still referenced by pending commands
+    if (!vk_malloc_should_move(vk->ma, &tex_vk->mem))
+        return;
+
+    uint32_t qfs[3] = {0};
+    for (int i = 0; i < vk->pools.num; i++)
+        qfs[i] = vk->pools.elem[i]->qf;
+
+    VkImageCreateInfo iinfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = tex_vk->type,
+        .format = tex_vk->img_fmt,
+        .extent = (VkExtent3D) {
+            .width  = params->w,
+            .height = PL_MAX(1, params->h),
+            .depth  = PL_MAX(1, params->d)
+        },
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = tex_vk->usage_flags,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .sharingMode = vk->pools.num > 1 ? VK_SHARING_MODE_CONCURRENT
+                                         : VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = vk->pools.num,
+        .pQueueFamilyIndices = qfs,
+    };
+
+    VkImage img = VK_NULL_HANDLE;
+    struct vk_memslice mem = {0};
+    VK(vk->CreateImage(vk->dev, &iinfo, PL_VK_ALLOC, &img));
+
+    VkMemoryDedicatedRequirements ded_reqs = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS_KHR,
+    };
+
+    VkMemoryRequirements2 reqs = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2_KHR,
+        .pNext = &ded_reqs,
+    };
+
+    VkImageMemoryRequirementsInfo2 req_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2_KHR,
+        .image = img,
+    };
+
+    vk->GetImageMemoryRequirements2(vk->dev, &req_info, &reqs);
+    if (ded_reqs.prefersDedicatedAllocation)
+        goto error;
+
+    struct vk_malloc_params mparams = {
+        .reqs = reqs.memoryRequirements,
+        .optimal = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        .debug_tag = params->debug_tag,
+    };
+
+    if (!vk_malloc_slice(vk->ma, &mem, &mparams))
+        goto error;
+    if (mem.priv == tex_vk->mem.priv)
+        goto error; // no better place for it, leave it where it is
+
+    VK(vk->BindImageMemory(vk->dev, img, mem.vkmem, mem.offset));
+
+    VkImage old_img = tex_vk->img;
+    VkImageView old_view = tex_vk->view;
+    VkFramebuffer old_fb = tex_vk->framebuffer;
+    struct vk_memslice old_mem = tex_vk->mem;
+
+    tex_vk->img = img;
+    tex_vk->mem = mem;
+    tex_vk->view = VK_NULL_HANDLE;
+    tex_vk->framebuffer = VK_NULL_HANDLE;
+    if (!vk_init_image(gpu, tex, PL_DEF(params->debug_tag, "relocated"))) {
+        vk->DestroyFramebuffer(vk->dev, tex_vk->framebuffer, PL_VK_ALLOC);
+        vk->DestroyImageView(vk->dev, tex_vk->view, PL_VK_ALLOC);
+        tex_vk->img = old_img;
+        tex_vk->mem = old_mem;
+        tex_vk->view = old_view;
+        tex_vk->framebuffer = old_fb;
+        goto error;
+    }
+
+    PL_TRACE(gpu, "Relocated texture %dx%dx%d (%s) out of sparse slab",
+             params->w, params->h, params->d, PL_DEF(params->debug_tag, "unknown"));
+
+    tex_vk->desc_id = atomic_fetch_add(&p->desc_id, 1);
+    vk->DestroyFramebuffer(vk->dev, old_fb, PL_VK_ALLOC);
+    vk->DestroyImageView(vk->dev, old_view, PL_VK_ALLOC);
+    vk->DestroyImage(vk->dev, old_img, PL_VK_ALLOC);
+    vk_malloc_free(vk->ma, &old_mem);
+    return;
+
+error:
+    vk->DestroyImage(vk->dev, img, PL_VK_ALLOC);
+    vk_malloc_free(vk->ma, &mem);
+}
+
 void vk_tex_invalidate(pl_gpu gpu, pl_tex tex)
 {
     struct pl_tex_vk *tex_vk = PL_PRIV(tex);
@@ -1155,6 +1271,7 @@ error:
 
 pl_tex pl_vulkan_wrap(pl_gpu gpu, const struct pl_vulkan_wrap_params *params)
 {
+    struct pl_vk *p = PL_PRIV(gpu);
     pl_fmt fmt = NULL;
     for (int i = 0; i < gpu->num_formats; i++) {
         const struct vk_format **vkfmt = PL_PRIV(gpu->formats[i]);
@@ -1223,6 +1340,7 @@ pl_tex pl_vulkan_wrap(pl_gpu gpu, const struct pl_vulkan_wrap_params *params)
     case 2: tex_vk->type = VK_IMAGE_TYPE_2D; break;
     case 3: tex_vk->type = VK_IMAGE_TYPE_3D; break;
     }
+    tex_vk->desc_id = atomic_fetch_add(&p->desc_id, 1);
     tex_vk->external_img = true;
     tex_vk->held = !fmt->num_planes;
     tex_vk->img = params->image;
@@ -1283,6 +1401,7 @@ VkImage pl_vulkan_unwrap(pl_gpu gpu, pl_tex tex, VkFormat *out_format,
                          VkImageUsageFlags *out_flags)
 {
     struct pl_tex_vk *tex_vk = PL_PRIV(tex);
+    tex_vk->relocatable = false; // the user may hold on to the VkImage
 
     if (out_format)
         *out_format = tex_vk->img_fmt;
@@ -53,6 +53,10 @@
 // this many invocations of `vk_malloc_garbage_collect` will be released.
 #define MAXIMUM_SLAB_AGE 8
 
+// Slabs with less than 1/N of their pages in use are considered sparse, and
+// will be drained if the rest of the pool can absorb their contents.
+#define SPARSE_SLAB_RATIO 4
+
 // A single slab represents a contiguous region of allocated memory. Actual
 // allocations are served as pages of this. Slabs are organized into pools,
 // each of which contains a list of slabs of differing page sizes.
@@ -67,9 +71,11 @@ struct vk_slab {
 
     // free space accounting (only for non-dedicated slabs)
     uint64_t spacemap;      // bitset of available pages
+    int pages;              // total number of pages
     size_t pagesize;        // size in bytes per page
     size_t used;            // number of bytes actually in use
     uint64_t age;           // timestamp of last use
+    bool draining;          // avoid for new allocations, see `SPARSE_SLAB_RATIO`
 
     // optional, depends on the memory type:
     VkBuffer buffer;        // buffer spanning the entire slab
@@ -100,8 +106,59 @@ struct vk_malloc {
     VkPhysicalDeviceMemoryProperties props;
     PL_ARRAY(struct vk_pool) pools;
     uint64_t age;
+
+    // Per-heap memory budget and usage. Refreshed from VK_EXT_memory_budget
+    // (if available) on every garbage collection, and updated by our own
+    // allocations in between. Without the extension, the budget is the heap
+    // size, and the usage only counts memory allocated by us.
+    bool has_budget;
+    _Atomic uint64_t heap_budget[VK_MAX_MEMORY_HEAPS];
+    _Atomic uint64_t heap_usage[VK_MAX_MEMORY_HEAPS];
 };
 
+static void update_budget(struct vk_malloc *ma)
+{
+    struct vk_ctx *vk = ma->vk;
+    if (!ma->has_budget)
+        return;
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+    };
+
+    VkPhysicalDeviceMemoryProperties2 props = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+        .pNext = &budget,
+    };
+
+    vk->GetPhysicalDeviceMemoryProperties2(vk->physd, &props);
+    for (int i = 0; i < ma->props.memoryHeapCount; i++) {
+        atomic_store(&ma->heap_budget[i], budget.heapBudget[i]);
+        atomic_store(&ma->heap_usage[i], budget.heapUsage[i]);
+    }
+}
+
+static inline uint64_t heap_headroom(struct vk_malloc *ma, int heap)
+{
+    uint64_t budget = atomic_load(&ma->heap_budget[heap]);
+    uint64_t usage = atomic_load(&ma->heap_usage[heap]);
+    return budget > usage ? budget - usage : 0;
+}
+
+static inline uint64_t slab_fullmap(const struct vk_slab *slab)
+{
+    return slab->pages == 64 ? ~0LLU : ~(~0LLU << slab->pages);
+}
+
+// Free space in a slab that can't be returned to the driver, because other
+// pages of the same slab are still in use
+static inline size_t slab_fragmented(const struct vk_slab *slab)
+{
+    if (slab->spacemap == slab_fullmap(slab))
+        return 0;
+    return __builtin_popcountll(slab->spacemap) * slab->pagesize;
+}
+
 static inline float efficiency(size_t used, size_t total)
 {
     if (!total)
@@ -132,12 +189,15 @@ void vk_malloc_print_stats(struct vk_malloc *ma, enum pl_log_level lev)
     size_t total_size = 0;
     size_t total_used = 0;
     size_t total_res = 0;
+    size_t total_frag = 0;
 
     PL_MSG(vk, lev, "Memory heaps supported by device:");
     for (int i = 0; i < ma->props.memoryHeapCount; i++) {
         VkMemoryHeap heap = ma->props.memoryHeaps[i];
-        PL_MSG(vk, lev, "    %d: flags 0x%x size %s",
-                i, (unsigned) heap.flags, PRINT_SIZE(heap.size));
+        PL_MSG(vk, lev, "    %d: flags 0x%x size %s budget %s usage %s",
+                i, (unsigned) heap.flags, PRINT_SIZE(heap.size),
+                PRINT_SIZE(atomic_load(&ma->heap_budget[i])),
+                PRINT_SIZE(atomic_load(&ma->heap_usage[i])));
     }
 
     PL_DEBUG(vk, "Memory types supported by device:");
@@ -166,6 +226,7 @@ void vk_malloc_print_stats(struct vk_malloc *ma, enum pl_log_level lev)
         size_t pool_size = 0;
         size_t pool_used = 0;
         size_t pool_res = 0;
+        size_t pool_frag = 0;
 
         for (int j = 0; j < pool->slabs.num; j++) {
             struct vk_slab *slab = pool->slabs.elem[j];
@@ -175,40 +236,56 @@ void vk_malloc_print_stats(struct vk_malloc *ma, enum pl_log_level lev)
             size_t slab_res = slab->size - avail;
 
             PL_MSG(vk, lev, "    Slab %2d: %8"PRIx64" x %s: "
-                   "%s used %s res %s alloc from heap %d, efficiency %.2f%%  [%s]",
+                   "%s used %s res %s alloc from heap %d, efficiency %.2f%%%s  [%s]",
                    j, slab->spacemap, PRINT_SIZE(slab->pagesize),
                    PRINT_SIZE(slab->used), PRINT_SIZE(slab_res),
                    PRINT_SIZE(slab->size), (int) slab->mtype.heapIndex,
                    efficiency(slab->used, slab_res),
+                   slab->draining ? " (draining)" : "",
                    PL_DEF(slab->debug_tag, "unknown"));
 
             pool_size += slab->size;
             pool_used += slab->used;
             pool_res += slab_res;
+            pool_frag += slab_fragmented(slab);
             pl_mutex_unlock(&slab->lock);
         }
 
         PL_MSG(vk, lev, "    Pool summary: %s used %s res %s alloc, "
-               "efficiency %.2f%%, utilization %.2f%%",
+               "efficiency %.2f%%, utilization %.2f%%, fragmentation %.2f%%",
                PRINT_SIZE(pool_used), PRINT_SIZE(pool_res),
                PRINT_SIZE(pool_size), efficiency(pool_used, pool_res),
-               efficiency(pool_res, pool_size));
+               efficiency(pool_res, pool_size),
+               pool_size ? efficiency(pool_frag, pool_size) : 0.0f);
 
         total_size += pool_size;
         total_used += pool_used;
         total_res += pool_res;
+        total_frag += pool_frag;
     }
     pl_mutex_unlock(&ma->lock);
 
     PL_MSG(vk, lev, "Memory summary: %s used %s res %s alloc, "
-           "efficiency %.2f%%, utilization %.2f%%",
+           "efficiency %.2f%%, utilization %.2f%%, fragmentation %.2f%%",
            PRINT_SIZE(total_used), PRINT_SIZE(total_res),
            PRINT_SIZE(total_size), efficiency(total_used, total_res),
-           efficiency(total_res, total_size));
+           efficiency(total_res, total_size),
+           total_size ? efficiency(total_frag, total_size) : 0.0f);
 }
 
-static void slab_free(struct vk_ctx *vk, struct vk_slab *slab)
+// Keeps track of our own allocations in between budget queries
+static void heap_account(struct vk_malloc *ma, int heap, VkDeviceSize size,
+                         bool alloc)
 {
+    uint64_t usage = atomic_load(&ma->heap_usage[heap]), new_usage;
+    do {
+        new_usage = alloc ? usage + size : usage - PL_MIN(usage, size);
+    } while (!atomic_compare_exchange_weak(&ma->heap_usage[heap], &usage, new_usage));
+}
+
+static void slab_free(struct vk_malloc *ma, struct vk_slab *slab)
+{
+    struct vk_ctx *vk = ma->vk;
     if (!slab)
         return;
 
@@ -279,6 +356,8 @@ static void slab_free(struct vk_ctx *vk, struct vk_slab *slab)
     vk->DestroyBuffer(vk->dev, slab->buffer, PL_VK_ALLOC);
     // also implicitly unmaps the memory if needed
     vk->FreeMemory(vk->dev, slab->mem, PL_VK_ALLOC);
+    if (slab->mem)
+        heap_account(ma, slab->mtype.heapIndex, slab->size, false);
 
     pl_mutex_destroy(&slab->lock);
     pl_free(slab);
@@ -286,12 +365,13 @@ static void slab_free(struct vk_ctx *vk, struct vk_slab *slab)
 
 // type_mask: optional
 // thread-safety: safe
-static bool find_best_memtype(const struct vk_malloc *ma, uint32_t type_mask,
+static bool find_best_memtype(struct vk_malloc *ma, uint32_t type_mask,
                               const struct vk_malloc_params *params,
                               uint32_t *out_index)
 {
     struct vk_ctx *vk = ma->vk;
-    int best = -1;
+    bool found = false;
+    int best = 0;
 
     // The vulkan spec requires memory types to be sorted in the "optimal"
     // order, so the first matching type we find will be the best/fastest one.
@@ -317,13 +397,20 @@ static bool find_best_memtype(const struct vk_malloc *ma, uint32_t type_mask,
 
         // Calculate the score as the number of optimal property flags matched
         int score = __builtin_popcountl(mtype->propertyFlags & params->optimal);
-        if (score > best) {
+
+        // Heaps that would exceed their memory budget are only used as a
+        // last resort, ranking below any heap that still has room left
+        if (params->reqs.size > heap_headroom(ma, mtype->heapIndex))
+            score -= 32;
+
+        if (!found || score > best) {
             *out_index = i;
             best = score;
+            found = true;
         }
     }
 
-    if (best < 0) {
+    if (!found) {
         PL_ERR(vk, "Found no memory type matching property flags 0x%x and type "
                "bits 0x%x!",
                (unsigned) params->required, (unsigned) type_mask);
@@ -357,6 +444,41 @@ static bool buf_external_check(struct vk_ctx *vk, VkBufferUsageFlags usage,
                                  handle_type, import);
 }
 
+// Immediately releases all empty slabs backed by a given heap, regardless of
+// their age. Used to recover from allocation failures.
+//
+// thread-safety: safe, but must not be called with `ma->lock` held
+static bool reclaim_empty_slabs(struct vk_malloc *ma, uint32_t heap)
+{
+    struct vk_ctx *vk = ma->vk;
+    size_t freed = 0;
+
+    pl_mutex_lock(&ma->lock);
+    for (int i = 0; i < ma->pools.num; i++) {
+        struct vk_pool *pool = &ma->pools.elem[i];
+        for (int n = 0; n < pool->slabs.num; n++) {
+            struct vk_slab *slab = pool->slabs.elem[n];
+            pl_mutex_lock(&slab->lock);
+            bool empty = !slab->used && slab->spacemap == slab_fullmap(slab);
+            pl_mutex_unlock(&slab->lock);
+            if (!empty || slab->mtype.heapIndex != heap)
+                continue;
+
+            freed += slab->size;
+            slab_free(ma, slab);
+            PL_ARRAY_REMOVE_AT(pool->slabs, n--);
+        }
+    }
+    pl_mutex_unlock(&ma->lock);
+
+    if (freed) {
+        PL_DEBUG(vk, "Reclaimed %s of empty slabs from heap %d",
+                 PRINT_SIZE(freed), (int) heap);
+    }
+
+    return freed;
+}
+
 // thread-safety: safe
 static struct vk_slab *slab_alloc(struct vk_malloc *ma,
                                   const struct vk_malloc_params *params)
@@ -459,6 +581,13 @@ static struct vk_slab *slab_alloc(struct vk_malloc *ma,
              (int) minfo.memoryTypeIndex, (int) mtype->heapIndex);
 
     VkResult res = vk->AllocateMemory(vk->dev, &minfo, PL_VK_ALLOC, &slab->mem);
+    if (res == VK_ERROR_OUT_OF_DEVICE_MEMORY &&
+        reclaim_empty_slabs(ma, mtype->heapIndex))
+    {
+        // Retry once, after giving back the memory we were holding on to
+        res = vk->AllocateMemory(vk->dev, &minfo, PL_VK_ALLOC, &slab->mem);
+    }
+
     switch (res) {
     case VK_ERROR_OUT_OF_DEVICE_MEMORY:
     case VK_ERROR_OUT_OF_HOST_MEMORY:
@@ -473,6 +602,7 @@ static struct vk_slab *slab_alloc(struct vk_malloc *ma,
     }
 
     slab->mtype = *mtype;
+    heap_account(ma, mtype->heapIndex, slab->size, true);
     if (mtype->propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
         VK(vk->MapMemory(vk->dev, slab->mem, 0, VK_WHOLE_SIZE, 0, &slab->data));
         slab->coherent = mtype->propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
@@ -516,14 +646,14 @@ static struct vk_slab *slab_alloc(struct vk_malloc *ma,
 error:
     if (params->debug_tag)
         PL_ERR(vk, "  for malloc: %s", params->debug_tag);
-    slab_free(vk, slab);
+    slab_free(ma, slab);
     return NULL;
 }
 
-static void pool_uninit(struct vk_ctx *vk, struct vk_pool *pool)
+static void pool_uninit(struct vk_malloc *ma, struct vk_pool *pool)
 {
     for (int i = 0; i < pool->slabs.num; i++)
-        slab_free(vk, pool->slabs.elem[i]);
+        slab_free(ma, pool->slabs.elem[i]);
 
     pl_free(pool->slabs.elem);
     *pool = (struct vk_pool) {0};
@@ -536,6 +666,14 @@ struct vk_malloc *vk_malloc_create(struct vk_ctx *vk)
     vk->GetPhysicalDeviceMemoryProperties(vk->physd, &ma->props);
     ma->vk = vk;
 
+    for (int i = 0; i < ma->props.memoryHeapCount; i++)
+        atomic_init(&ma->heap_budget[i], ma->props.memoryHeaps[i].size);
+    for (int i = 0; i < vk->exts.num; i++) {
+        if (strcmp(vk->exts.elem[i], VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+            ma->has_budget = true;
+    }
+    update_budget(ma);
+
     vk_malloc_print_stats(ma, PL_LOG_INFO);
     return ma;
 }
@@ -548,12 +686,64 @@ void vk_malloc_destroy(struct vk_malloc **ma_ptr)
 
     vk_malloc_print_stats(ma, PL_LOG_DEBUG);
     for (int i = 0; i < ma->pools.num; i++)
-        pool_uninit(ma->vk, &ma->pools.elem[i]);
+        pool_uninit(ma, &ma->pools.elem[i]);
 
     pl_mutex_destroy(&ma->lock);
     pl_free_ptr(ma_ptr);
 }
 
+static inline int slab_used_pages(const struct vk_slab *slab)
+{
+    return slab->pages - __builtin_popcountll(slab->spacemap);
+}
+
+// Marks sparse slabs as draining, as long as their contents fit into the free
+// space of the remaining slabs. New allocations avoid draining slabs, so they
+// empty out as their objects get freed or moved (see `vk_malloc_should_move`),
+// after which they are garbage collected as usual.
+static void pool_pick_draining(struct vk_pool *pool)
+{
+    size_t absorb = 0, res = 0;
+    for (int n = 0; n < pool->slabs.num; n++) {
+        struct vk_slab *slab = pool->slabs.elem[n];
+        pl_mutex_lock(&slab->lock);
+        int used = slab_used_pages(slab);
+        slab->draining = used && used * SPARSE_SLAB_RATIO < slab->pages;
+        if (slab->draining) {
+            res += used * slab->pagesize;
+        } else {
+            absorb += (slab->pages - used) * slab->pagesize;
+        }
+        pl_mutex_unlock(&slab->lock);
+    }
+
+    // Keep the fullest sparse slabs around as targets, until the contents of
+    // the remaining ones fit
+    while (res > absorb) {
+        struct vk_slab *target = NULL;
+        int target_used = 0;
+        for (int n = 0; n < pool->slabs.num; n++) {
+            struct vk_slab *slab = pool->slabs.elem[n];
+            pl_mutex_lock(&slab->lock);
+            int used = slab_used_pages(slab);
+            if (slab->draining && (!target || used > target_used)) {
+                target = slab;
+                target_used = used;
+            }
+            pl_mutex_unlock(&slab->lock);
+        }
+
+        if (!target)
+            break;
+
+        pl_mutex_lock(&target->lock);
+        target->draining = false;
+        res -= PL_MIN(res, target_used * target->pagesize);
+        absorb += (target->pages - target_used) * target->pagesize;
+        pl_mutex_unlock(&target->lock);
+    }
+}
+
 void vk_malloc_garbage_collect(struct vk_malloc *ma)
 {
     struct vk_ctx *vk = ma->vk;
@@ -575,12 +765,15 @@ void vk_malloc_garbage_collect(struct vk_malloc *ma)
                      PRINT_SIZE(slab->size), pool->index);
 
             pl_mutex_unlock(&slab->lock);
-            slab_free(ma->vk, slab);
+            slab_free(ma, slab);
             PL_ARRAY_REMOVE_AT(pool->slabs, n--);
         }
+
+        pool_pick_draining(pool);
     }
 
     pl_mutex_unlock(&ma->lock);
+    update_budget(ma);
 }
 
 pl_handle_caps vk_malloc_handle_caps(const struct vk_malloc *ma, bool import)
@@ -603,10 +796,9 @@ pl_handle_caps vk_malloc_handle_caps(const struct vk_malloc *ma, bool import)
 
 void vk_malloc_free(struct vk_malloc *ma, struct vk_memslice *slice)
 {
-    struct vk_ctx *vk = ma->vk;
     struct vk_slab *slab = slice->priv;
     if (!slab || slab->dedicated) {
-        slab_free(vk, slab);
+        slab_free(ma, slab);
         goto done;
     }
 
@@ -624,6 +816,18 @@ done:
     *slice = (struct vk_memslice) {0};
 }
 
+bool vk_malloc_should_move(struct vk_malloc *ma, const struct vk_memslice *slice)
+{
+    struct vk_slab *slab = slice->priv;
+    if (!slab || slab->dedicated)
+        return false;
+
+    pl_mutex_lock(&slab->lock);
+    bool draining = slab->draining;
+    pl_mutex_unlock(&slab->lock);
+    return draining;
+}
+
 static inline bool pool_params_eq(const struct vk_malloc_params *a,
                                   const struct vk_malloc_params *b)
 {
@@ -675,6 +879,12 @@ static struct vk_slab *pool_get_page(struct vk_malloc *ma, struct vk_pool *pool,
     size = PL_ALIGN2(size, PAGE_SIZE_ALIGN);
     const size_t pagesize = PL_ALIGN(size, align);
 
+    // Prefer slabs that are not being drained, and out of those, the one
+    // with the fewest free pages, to keep allocations densely packed
+    struct vk_slab *best = NULL;
+    int best_avail = 0;
+    bool best_draining = false;
+
     for (int i = 0; i < pool->slabs.num; i++) {
         slab = pool->slabs.elem[i];
         if (slab->pagesize < size)
@@ -685,15 +895,32 @@ static struct vk_slab *pool_get_page(struct vk_malloc *ma, struct vk_pool *pool,
             continue;
 
         pl_mutex_lock(&slab->lock);
-        int page_idx = __builtin_ffsll(slab->spacemap);
-        if (!page_idx--) {
-            pl_mutex_unlock(&slab->lock);
+        int avail = __builtin_popcountll(slab->spacemap);
+        bool draining = slab->draining;
+        pl_mutex_unlock(&slab->lock);
+        if (!avail) {
             // Increase the number of slabs to allocate for new slabs the
             // more existing full slabs exist for this size range
             slab_pages = PL_MIN(slab_pages << 1, MAXIMUM_PAGE_COUNT);
             continue;
         }
 
+        bool better = !best || (best_draining && !draining) ||
+                      (best_draining == draining && avail < best_avail);
+        if (better) {
+            best = slab;
+            best_avail = avail;
+            best_draining = draining;
+        }
+    }
+
+    if (best) {
+        // Pages can only have been freed up in the meantime, since taking
+        // them requires holding `ma->lock`
+        slab = best;
+        pl_mutex_lock(&slab->lock);
+        int page_idx = __builtin_ffsll(slab->spacemap) - 1;
+        pl_assert(page_idx >= 0);
         slab->spacemap ^= 0x1LLU << page_idx;
         *offset = page_idx * slab->pagesize;
         return slab;
@@ -717,7 +944,8 @@ static struct vk_slab *pool_get_page(struct vk_malloc *ma, struct vk_pool *pool,
         return NULL;
     pl_mutex_lock(&slab->lock);
 
-    slab->spacemap = (slab_pages == sizeof(uint64_t) * 8) ? ~0LLU : ~(~0LLU << slab_pages);
+    slab->pages = slab_pages;
+    slab->spacemap = slab_fullmap(slab);
     slab->pagesize = pagesize;
     PL_ARRAY_APPEND(NULL, pool->slabs, slab);
 
@@ -877,6 +1105,7 @@ static bool vk_malloc_import(struct vk_malloc *ma, struct vk_memslice *out,
     slab = pl_alloc_ptr(NULL, slab);
     *slab = (struct vk_slab) {
         .mem = vkmem,
+        .mtype = ma->props.memoryTypes[ainfo.memoryTypeIndex],
         .dedicated = true,
         .imported = true,
         .buffer = buffer,
@@ -942,6 +1171,7 @@ static bool vk_malloc_import(struct vk_malloc *ma, struct vk_memslice *out,
     if (buffer)
         VK(vk->BindBufferMemory(vk->dev, buffer, vkmem, 0));
 
+    heap_account(ma, slab->mtype.heapIndex, slab->size, true);
     return true;
 
 error:
@@ -1035,3 +1265,35 @@ bool vk_malloc_slice(struct vk_malloc *ma, struct vk_memslice *out,
     };
     return true;
 }
+
+void pl_vulkan_get_memory_stats(pl_vulkan pl_vk,
+                                struct pl_vulkan_memory_stats *out_stats)
+{
+    struct vk_ctx *vk = PL_PRIV(pl_vk);
+    struct vk_malloc *ma = vk->ma;
+    *out_stats = (struct pl_vulkan_memory_stats) {
+        .num_heaps = ma->props.memoryHeapCount,
+    };
+
+    for (int i = 0; i < ma->props.memoryHeapCount; i++) {
+        out_stats->heaps[i].size = ma->props.memoryHeaps[i].size;
+        out_stats->heaps[i].budget = atomic_load(&ma->heap_budget[i]);
+        out_stats->heaps[i].usage = atomic_load(&ma->heap_usage[i]);
+    }
+
+    pl_mutex_lock(&ma->lock);
+    for (int i = 0; i < ma->pools.num; i++) {
+        struct vk_pool *pool = &ma->pools.elem[i];
+        for (int j = 0; j < pool->slabs.num; j++) {
+            struct vk_slab *slab = pool->slabs.elem[j];
+            pl_mutex_lock(&slab->lock);
+            out_stats->allocated += slab->size;
+            out_stats->used += slab->used;
+            out_stats->fragmented += slab_fragmented(slab);
+            out_stats->num_slabs++;
+            out_stats->num_draining += slab->draining;
+            pl_mutex_unlock(&slab->lock);
+        }
+    }
+    pl_mutex_unlock(&ma->lock);
+}
@@ -64,8 +64,17 @@ bool vk_malloc_slice(struct vk_malloc *ma, struct vk_memslice *out,
 
 void vk_malloc_free(struct vk_malloc *ma, struct vk_memslice *slice);
 
-// Clean up unused slabs. Call this roughly once per frame to reduce
-// memory pressure / memory leaks.
+// Returns true if the slice lives in a sparsely used slab that is being
+// drained. Callers that can cheaply re-allocate an object (e.g. because its
+// contents were invalidated) should do so, to allow the slab to be freed.
+//
+// Note: A new allocation may still end up in the same slab, if there is no
+// better place for it. Compare `vk_memslice.priv` to detect this.
+bool vk_malloc_should_move(struct vk_malloc *ma, const struct vk_memslice *slice);
+
+// Clean up unused slabs, refresh the memory budget and pick sparse slabs to
+// drain. Call this roughly once per frame to reduce memory pressure / memory
+// leaks.
 void vk_malloc_garbage_collect(struct vk_malloc *ma);
 
 // For debugging purposes. Doesn't include dedicated slab allocations!
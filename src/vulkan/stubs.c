@@ -52,6 +52,29 @@ pl_vulkan pl_vulkan_get(pl_gpu gpu)
     return NULL;
 }
 
+size_t pl_vulkan_save_pipeline_cache(pl_vulkan vk, uint8_t *out_cache,
+                                     size_t size)
+{
+    pl_unreachable();
+}
+
+void pl_vulkan_load_pipeline_cache(pl_vulkan vk, const uint8_t *cache,
+                                   size_t size)
+{
+    pl_unreachable();
+}
+
+void pl_vulkan_get_stats(pl_vulkan vk, struct pl_vulkan_stats *out_stats)
+{
+    pl_unreachable();
+}
+
+void pl_vulkan_get_memory_stats(pl_vulkan vk,
+                                struct pl_vulkan_memory_stats *out_stats)
+{
+    pl_unreachable();
+}
+
 VkPhysicalDevice pl_vulkan_choose_device(pl_log log,
                               const struct pl_vulkan_device_params *params)
 {